@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "include/bn2.h"
+#include "include/qr_params.h"
+#include "include/qr_engine.h"
+#include "include/barrier_qr.h"
+#include "include/bench_report.h"
+#include "include/tuning.h"
+
+// Benchmark driver: loads (or generates) the matrix once and times every
+// requested mode in this process on a fresh copy of it, after warm-up runs.
+// Modes are "barrier" and the dynamic schedulers of --sched. With --tune
+// FILE it instead searches the best tile shape of every scheduler mode by
+// successive halving and records it in the tuning database FILE.
+
+struct bench_options_t {
+    std::vector<std::string> modes = {"barrier", "fifo", "steal", "priority"};
+    int warmup = 1;
+    int reps = 5;
+    std::string json;      // One line of JSON per run of bench.out, appended; "-" for stdout.
+    std::string csv;       // One row per mode (results/fig3_agg_by_config.csv columns).
+    std::string runs_csv;  // One row per timed run (results/fig3_all_runs.csv columns).
+    std::string tune;      // Tuning database to record the searched tile shapes in.
+};
+
+struct mode_result_t {
+    std::string mode;
+    std::vector<double> times_ms;
+    double min_ms = 0, max_ms = 0, mean_ms = 0, median_ms = 0, stddev_ms = 0;
+    double gflops = 0;     // At the median time.
+};
+
+void print_bench_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <filename | random:N | random:RxC> [options]\n"
+              << "  --modes LIST      comma separated: barrier, fifo, steal, priority (default: all)\n"
+              << "  --warmup N        untimed runs per mode (default 1)\n"
+              << "  --reps N          timed runs per mode (default 5)\n"
+              << "  --json FILE       append the results as one line of JSON (- for stdout)\n"
+              << "  --csv FILE        append one row per mode (min/median/mean/stddev/max, GFLOP/s)\n"
+              << "  --runs-csv FILE   append one row per timed run\n"
+              << "  --tune FILE       search the best ALPHA/BETA of every scheduler mode instead,\n"
+              << "                    by successive halving, and record them in the tuning database FILE\n"
+              << "and the options of a.out:\n";
+    print_qr_usage(prog);
+}
+
+// Takes the bench options out of argv; the remaining ones go to
+// parse_qr_params.
+std::vector<char*> parse_bench_options(int argc, char* argv[], bench_options_t& opts) {
+    std::vector<char*> rest = {argv[0], argv[1]};
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        bool ours = opt == "--modes" || opt == "--warmup" || opt == "--reps" || opt == "--json" ||
+                    opt == "--csv" || opt == "--runs-csv" || opt == "--tune";
+        if (!ours) {
+            rest.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for option " + opt + ".");
+        }
+        const char* value = argv[++i];
+        if (opt == "--modes") {
+            opts.modes = split_list(value);
+        } else if (opt == "--warmup") {
+            opts.warmup = parse_int_option(opt, value);
+        } else if (opt == "--reps") {
+            opts.reps = parse_int_option(opt, value);
+        } else if (opt == "--json") {
+            opts.json = value;
+        } else if (opt == "--csv") {
+            opts.csv = value;
+        } else if (opt == "--tune") {
+            opts.tune = value;
+        } else {
+            opts.runs_csv = value;
+        }
+    }
+    if (opts.warmup < 0 || opts.reps < 1) {
+        throw std::invalid_argument("Need --warmup >= 0 and --reps >= 1.");
+    }
+    if (opts.modes.empty()) {
+        throw std::invalid_argument("No modes to run.");
+    }
+    for (const std::string& mode : opts.modes) {
+        if (mode != "barrier") {
+            parse_scheduler(mode);
+        }
+    }
+    return rest;
+}
+
+// random:RxC: uniform values in [-0.5, 0.5), seeded by the shape.
+matrix_t<double> generate_matrix(int rows, int cols, const qr_params_t& params) {
+    matrix_t<double> mat(rows, cols, params.layout, params.alloc);
+    std::mt19937_64 rng(static_cast<uint64_t>(rows) * 100000 + cols);
+    std::uniform_real_distribution<double> dist(-0.5, 0.5);
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            mat.set(i, j, dist(rng));
+        }
+    }
+    return mat;
+}
+
+// Floating-point operations of a Householder QR of a rows x cols matrix.
+double qr_flops(int rows, int cols) {
+    double big = std::max(rows, cols), small = std::min(rows, cols);
+    return 2.0 * big * small * small - 2.0 * small * small * small / 3.0;
+}
+
+// Restores the pristine input into work (same shape and layout), outside
+// the timed region and without reallocating.
+template <class T>
+void restore_matrix(matrix_t<T>& work, const matrix_t<T>& pristine) {
+    size_t count = static_cast<size_t>(pristine.rows()) * pristine.ld();
+    std::memcpy(work.data_ptr(), pristine.data_ptr(), count * sizeof(T));
+}
+
+// The warm-up and timed runs of one mode on a copy of pristine.
+template <class T>
+std::vector<double> time_mode(QREngine& engine, const matrix_t<T>& pristine, const qr_params_t& run, bool barrier,
+                              const bench_options_t& opts) {
+    matrix_t<T> work = pristine;
+    std::vector<double> times_ms;
+    for (int rep = 0; rep < opts.warmup + opts.reps; ++rep) {
+        restore_matrix(work, pristine);
+        qr_run_stats_t stats = barrier ? factorize_barrier(work, run) : engine.factorize(work, run);
+        if (rep >= opts.warmup) {
+            times_ms.push_back(stats.elapsed_ms);
+        }
+    }
+    return times_ms;
+}
+
+void summarize(mode_result_t& r, double flops) {
+    std::vector<double> sorted = r.times_ms;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    r.min_ms = sorted.front();
+    r.max_ms = sorted.back();
+    r.median_ms = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    double sum = 0;
+    for (double t : sorted) {
+        sum += t;
+    }
+    r.mean_ms = sum / n;
+    double var = 0;
+    for (double t : sorted) {
+        var += (t - r.mean_ms) * (t - r.mean_ms);
+    }
+    r.stddev_ms = n > 1 ? std::sqrt(var / (n - 1)) : 0.0;
+    r.gflops = r.median_ms > 0 ? flops / (r.median_ms * 1e6) : 0.0;
+}
+
+std::string size_label(const matrix_t<double>& mat) {
+    return mat.rows() == mat.cols() ? std::to_string(mat.rows())
+                                    : std::to_string(mat.rows()) + "x" + std::to_string(mat.cols());
+}
+
+void write_results(const bench_options_t& opts, const qr_params_t& params, const matrix_t<double>& mat,
+                   const std::vector<mode_result_t>& results) {
+    std::string size = size_label(mat);
+    if (!opts.json.empty()) {
+        std::ofstream file;
+        std::ostream& os = open_append(opts.json, file, nullptr);
+        os << std::setprecision(6) << "{\"matrix\":" << json_string(params.label) << ",\"rows\":" << mat.rows()
+           << ",\"cols\":" << mat.cols() << ",\"warmup\":" << opts.warmup << ",\"reps\":" << opts.reps;
+        for (const auto& kv : describe_qr_params(params)) {
+            if (kv.first != "sched") {
+                os << "," << json_string(kv.first) << ":" << json_string(kv.second);
+            }
+        }
+        os << ",\"results\":[";
+        for (size_t k = 0; k < results.size(); ++k) {
+            const mode_result_t& r = results[k];
+            os << (k ? "," : "") << "{\"mode\":" << json_string(r.mode) << ",\"min_ms\":" << r.min_ms
+               << ",\"median_ms\":" << r.median_ms << ",\"mean_ms\":" << r.mean_ms
+               << ",\"stddev_ms\":" << r.stddev_ms << ",\"max_ms\":" << r.max_ms << ",\"gflops\":" << r.gflops
+               << ",\"times_ms\":[";
+            for (size_t i = 0; i < r.times_ms.size(); ++i) {
+                os << (i ? "," : "") << r.times_ms[i];
+            }
+            os << "]}";
+        }
+        os << "]}" << std::endl;
+    }
+    if (!opts.csv.empty()) {
+        std::ofstream file;
+        std::ostream& os = open_append(opts.csv, file,
+            "matrix_size,threads,mode,alpha,beta,runs,avg_time_ms,std_time_ms,min_time_ms,max_time_ms,"
+            "median_time_ms,gflops");
+        for (const mode_result_t& r : results) {
+            os << std::setprecision(6) << size << "," << params.num_threads << "," << r.mode << "," << params.alpha
+               << "," << params.beta << "," << r.times_ms.size() << "," << r.mean_ms << "," << r.stddev_ms << ","
+               << r.min_ms << "," << r.max_ms << "," << r.median_ms << "," << r.gflops << "\n";
+        }
+    }
+    if (!opts.runs_csv.empty()) {
+        std::ofstream file;
+        std::ostream& os = open_append(opts.runs_csv, file, "matrix_size,threads,mode,alpha,beta,run_idx,time_ms");
+        for (const mode_result_t& r : results) {
+            for (size_t i = 0; i < r.times_ms.size(); ++i) {
+                os << std::setprecision(6) << size << "," << params.num_threads << "," << r.mode << ","
+                   << params.alpha << "," << params.beta << "," << i << "," << r.times_ms[i] << "\n";
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        print_bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench_options_t opts;
+    qr_params_t params;
+    try
+    {
+        std::vector<char*> rest = parse_bench_options(argc, argv, opts);
+        parse_qr_params(static_cast<int>(rest.size()), rest.data(), params);
+        if (params.batch > 1 || params.tsqr_leaf > 0 || !params.trace.empty())
+        {
+            throw std::invalid_argument("bench.out times single factorizations; drop --batch, --tsqr and --trace.");
+        }
+        if (!opts.tune.empty() && params.precision != precision_t::f64)
+        {
+            throw std::invalid_argument("--tune searches double precision shapes only.");
+        }
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << std::endl;
+        print_bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    params.label = argv[1];
+
+    try
+    {
+        matrix_t<double> pristine;
+        int rows = 0, cols = 0;
+        if (parse_random_spec(argv[1], rows, cols))
+        {
+            pristine = generate_matrix(rows, cols, params);
+        }
+        else
+        {
+            pristine = load_qr_matrix(argv[1], params);
+        }
+        matrix_t<float> single;
+        if (params.precision == precision_t::f32)
+        {
+            single = matrix_t<float>(pristine, pristine.layout(), pristine.alloc_policy());
+        }
+        double flops = qr_flops(pristine.rows(), pristine.cols());
+
+        QREngine engine(params.num_threads, params.affinity, params.idle);
+        if (!opts.tune.empty())
+        {
+            TuningDB db = TuningDB::load(opts.tune);
+            tuning_options_t tuning;
+            tuning.warmup = opts.warmup;
+            for (const std::string& mode : opts.modes)
+            {
+                if (mode == "barrier")
+                {
+                    continue;
+                }
+                qr_params_t run = params;
+                run.scheduler = parse_scheduler(mode);
+                tuning_result_t best = tune_tile_shape(engine, pristine, run, tuning);
+                std::cout << std::left << std::setw(10) << mode << " ALPHA=" << best.alpha << " BETA=" << best.beta
+                          << ", median " << best.time_ms << " ms (" << best.candidates << " candidates, "
+                          << best.rounds << " rounds, " << best.runs << " runs)" << std::endl;
+                db.record({pristine.rows(), pristine.cols(), params.num_threads, mode, best.alpha, best.beta,
+                           best.time_ms, cpu_model_name()});
+            }
+            db.save(opts.tune);
+            return 0;
+        }
+
+        std::vector<mode_result_t> results;
+        for (const std::string& mode : opts.modes)
+        {
+            qr_params_t run = params;
+            bool barrier = mode == "barrier";
+            if (!barrier)
+            {
+                run.scheduler = parse_scheduler(mode);
+            }
+            mode_result_t result;
+            result.mode = mode;
+            result.times_ms = params.precision == precision_t::f32 ? time_mode(engine, single, run, barrier, opts)
+                                                                   : time_mode(engine, pristine, run, barrier, opts);
+            summarize(result, flops);
+            std::cout << std::left << std::setw(10) << mode << std::fixed << std::setprecision(3)
+                      << " min " << result.min_ms << " ms, median " << result.median_ms << " ms, stddev "
+                      << result.stddev_ms << " ms, " << result.gflops << " GFLOP/s" << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            results.push_back(std::move(result));
+        }
+        write_results(opts, params, pristine, results);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
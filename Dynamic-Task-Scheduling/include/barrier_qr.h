@@ -0,0 +1,18 @@
+#pragma once
+
+#include "qr_engine.h"
+
+// Barrier-synchronised baseline (barrier.out, and the "barrier" mode of
+// bench.out). Every call starts params.num_threads pthreads and walks the
+// pivot blocks in order: worker 0 runs the type-1 task of the block, and
+// then every worker runs the type-2 updates of the task rows below it
+// round-robin, with a pthread barrier around each of the two phases.
+//
+// The counters of --perf are written when the call returns; --trace,
+// --batch and --tsqr are for the dynamic scheduler only. The elapsed time
+// covers thread creation and join, as in the original driver.
+// Instantiated for double and float.
+template <class T>
+qr_run_stats_t factorize_barrier(matrix_t<T>& mat, const qr_params_t& params);
+template <class T>
+qr_run_stats_t factorize_barrier(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors);
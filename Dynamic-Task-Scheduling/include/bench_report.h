@@ -0,0 +1,57 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Report helpers shared by the benchmark drivers (bench_main.cpp,
+// sched_bench_main.cpp).
+
+inline std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Opens FILE for appending ("-": stdout) and writes the header if it is new or empty.
+inline std::ostream& open_append(const std::string& path, std::ofstream& file, const char* header) {
+    if (path == "-") {
+        if (header) {
+            std::cout << header << "\n";
+        }
+        return std::cout;
+    }
+    bool fresh;
+    {
+        std::ifstream probe(path, std::ios::ate);
+        fresh = !probe || probe.tellg() == 0;
+    }
+    file.open(path, std::ios::app);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path + " for writing.");
+    }
+    if (fresh && header) {
+        file << header << "\n";
+    }
+    return file;
+}
+
+inline std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <fstream>
@@ -5,6 +7,7 @@
 #include <string>
 #include <stdexcept>
 #include <initializer_list>
+#include <new>
 
 #include <chrono>
 #include <functional>
@@ -15,8 +18,14 @@
 
 #include <mutex>
 #include <optional>
+#include <memory>
+#include <cstdint>
 #include <atomic>
 
+#include "placement.h"
+#include "matrix_file.h"
+#include "matrix_text.h"
+
 // Helper function to get a string representation of the time unit.
 template <typename Duration>
 constexpr const char* get_time_unit() {
@@ -57,33 +66,112 @@ auto measure_exec_time(Func&& func, Args&&... args) {
     }
 }
 
+// Storage of a matrix_t. Rows are always contiguous; the layouts differ in
+// the row stride (ld).
+//  - row_major: ld == cols, the layout of the matrix files.
+//  - padded: ld rounded up to whole cache lines (and never a multiple of
+//    4 KiB, so neighbouring rows do not alias in the L1). Every row, and so
+//    every BETA-row tile of the task grid, then starts on its own cache line
+//    and no two tasks share a line at a tile border. The padding columns are
+//    zero; the Householder kernels treat them as zero columns, which leaves
+//    the factorization unchanged.
+enum class matrix_layout_t {
+    row_major,
+    padded,
+};
+
 template <class T>
 class matrix_t {
 private:
     int m;   // Number of rows
     int n;   // Number of columns
+    int ld_; // Row stride in elements (>= n)
+    matrix_layout_t layout_;
     T* data; // Pointer to allocated array holding matrix elements
 
+    alloc_policy_t policy_;    // How the storage is obtained (huge pages, NUMA).
+    size_t mapped_bytes_;      // Size of the mapping behind data, 0 for heap storage.
+
+    static constexpr size_t ALIGNMENT = CACHE_LINE_SIZE;
+
+    // Zeroed storage, at least cache-line aligned. Mapped storage is zero
+    // without being touched, so first-touch placement still applies.
+    T* allocate(size_t count, size_t& mapped_bytes) const {
+        static_assert(std::is_trivially_copyable<T>::value, "matrix_t holds plain values");
+        placed_block_t block = placement_alloc(count * sizeof(T), policy_);
+        mapped_bytes = block.mapped_bytes;
+        T* p = static_cast<T*>(block.ptr);
+        if (block.mapped_bytes == 0) {
+            std::fill(p, p + count, T());
+        }
+        return p;
+    }
+
+    static void release(T* p, size_t mapped_bytes) {
+        placed_block_t block;
+        block.ptr = p;
+        block.mapped_bytes = mapped_bytes;
+        placement_free(block);
+    }
+
+    static int stride_for(int cols, matrix_layout_t layout) {
+        if (layout == matrix_layout_t::row_major || cols <= 0) {
+            return cols;
+        }
+        const int line = static_cast<int>(ALIGNMENT / sizeof(T) > 0 ? ALIGNMENT / sizeof(T) : 1);
+        int ld = (cols + line - 1) / line * line;
+        if ((static_cast<size_t>(ld) * sizeof(T)) % 4096 == 0) {
+            ld += line;
+        }
+        return ld;
+    }
+
+    size_t index(int row, int col) const {
+        return static_cast<size_t>(row) * ld_ + col;
+    }
+
+    // (Re)allocates zeroed storage for rows x cols in the current layout.
+    void allocate_storage(int rows, int cols) {
+        release(data, mapped_bytes_);
+        data = nullptr;
+        m = rows;
+        n = cols;
+        ld_ = stride_for(cols, layout_);
+        if (m > 0 && n > 0) {
+            data = allocate(static_cast<size_t>(m) * ld_, mapped_bytes_);
+        }
+    }
+
 public:
     // Default constructor
-    matrix_t() : m(0), n(0), data(nullptr) {}
+    matrix_t() : m(0), n(0), ld_(0), layout_(matrix_layout_t::row_major), data(nullptr), mapped_bytes_(0) {}
 
     // Parameterized constructor
-    matrix_t(int rows, int cols) : m(rows), n(cols), data(nullptr) {
+    matrix_t(int rows, int cols, matrix_layout_t layout = matrix_layout_t::row_major,
+             const alloc_policy_t& policy = alloc_policy_t())
+        : m(0), n(0), ld_(0), layout_(layout), data(nullptr), policy_(policy), mapped_bytes_(0) {
         if (rows > 0 && cols > 0) {
-            data = new T[rows * cols];
+            allocate_storage(rows, cols);
+        } else {
+            m = rows;
+            n = cols;
+            ld_ = cols;
         }
     }
 
     // Constructor to read matrix from a file
-    matrix_t(const std::string& filename) : m(0), n(0), data(nullptr) {
+    matrix_t(const std::string& filename, matrix_layout_t layout = matrix_layout_t::row_major,
+             const alloc_policy_t& policy = alloc_policy_t())
+        : m(0), n(0), ld_(0), layout_(layout), data(nullptr), policy_(policy), mapped_bytes_(0) {
         read_matrix(filename);
     }
 
     // Initializer list constructor
-    matrix_t(std::initializer_list<std::initializer_list<T>> init) : m(0), n(0), data(nullptr) {
+    matrix_t(std::initializer_list<std::initializer_list<T>> init)
+        : m(0), n(0), ld_(0), layout_(matrix_layout_t::row_major), data(nullptr), mapped_bytes_(0) {
         m = static_cast<int>(init.size());
         n = (m > 0) ? static_cast<int>(init.begin()->size()) : 0;
+        ld_ = n;
 
         // Check that all rows have the same number of columns.
         for (const auto& row : init) {
@@ -94,7 +182,7 @@ public:
 
         // Allocate memory.
         if (m * n > 0) {
-            data = new T[m * n];
+            data = allocate(static_cast<size_t>(m) * n, mapped_bytes_);
         }
 
         // Populate the matrix.
@@ -102,43 +190,65 @@ public:
         for (const auto& row : init) {
             int j = 0;
             for (const auto& value : row) {
-                data[i * n + j] = value;
+                data[index(i, j)] = value;
                 ++j;
             }
             ++i;
         }
     }
 
-    // Copy constructor
-    matrix_t(const matrix_t& other) : m(other.m), n(other.n), data(nullptr) {
-        if (m * n > 0) {
-            data = new T[m * n];
-            for (int i = 0; i < m * n; ++i) {
-                data[i] = other.data[i];
+    // Converting copy (float <-> double), in the given layout and policy.
+    template <class U>
+    matrix_t(const matrix_t<U>& other, matrix_layout_t layout, const alloc_policy_t& policy = alloc_policy_t())
+        : m(0), n(0), ld_(0), layout_(layout), data(nullptr), policy_(policy), mapped_bytes_(0) {
+        if (other.rows() > 0 && other.cols() > 0) {
+            allocate_storage(other.rows(), other.cols());
+            for (int i = 0; i < m; ++i) {
+                const U* src = other.data_ptr() + static_cast<size_t>(i) * other.ld();
+                std::transform(src, src + n, data + index(i, 0), [](U v) { return static_cast<T>(v); });
             }
+        } else {
+            m = other.rows();
+            n = other.cols();
+            ld_ = n;
+        }
+    }
+
+    // Copy constructor
+    matrix_t(const matrix_t& other)
+        : m(other.m), n(other.n), ld_(other.ld_), layout_(other.layout_), data(nullptr),
+          policy_(other.policy_), mapped_bytes_(0) {
+        if (other.data != nullptr) {
+            data = allocate(static_cast<size_t>(m) * ld_, mapped_bytes_);
+            std::copy(other.data, other.data + static_cast<size_t>(m) * ld_, data);
         }
     }
 
     // Move constructor
-    matrix_t(matrix_t&& other) noexcept : m(other.m), n(other.n), data(other.data) {
+    matrix_t(matrix_t&& other) noexcept
+        : m(other.m), n(other.n), ld_(other.ld_), layout_(other.layout_), data(other.data),
+          policy_(other.policy_), mapped_bytes_(other.mapped_bytes_) {
         other.m = 0;
         other.n = 0;
+        other.ld_ = 0;
         other.data = nullptr;
+        other.mapped_bytes_ = 0;
     }
 
     // Copy assignment operator
     matrix_t& operator=(const matrix_t& other) {
         if (this != &other) {
             // Delete current data.
-            delete[] data;
+            release(data, mapped_bytes_);
             m = other.m;
             n = other.n;
+            ld_ = other.ld_;
+            layout_ = other.layout_;
+            policy_ = other.policy_;
             data = nullptr;
-            if (m * n > 0) {
-                data = new T[m * n];
-                for (int i = 0; i < m * n; ++i) {
-                    data[i] = other.data[i];
-                }
+            if (other.data != nullptr) {
+                data = allocate(static_cast<size_t>(m) * ld_, mapped_bytes_);
+                std::copy(other.data, other.data + static_cast<size_t>(m) * ld_, data);
             }
         }
         return *this;
@@ -148,161 +258,121 @@ public:
     matrix_t& operator=(matrix_t&& other) noexcept {
         if (this != &other) {
             // Delete current data.
-            delete[] data;
+            release(data, mapped_bytes_);
             m = other.m;
             n = other.n;
+            ld_ = other.ld_;
+            layout_ = other.layout_;
+            policy_ = other.policy_;
             data = other.data;
+            mapped_bytes_ = other.mapped_bytes_;
 
             other.m = 0;
             other.n = 0;
+            other.ld_ = 0;
             other.data = nullptr;
+            other.mapped_bytes_ = 0;
         }
         return *this;
     }
 
     // Destructor
     ~matrix_t() {
-        delete[] data;
+        release(data, mapped_bytes_);
     }
 
-    // Fill the matrix with a constant value of type T.
+    // Fill the matrix with a constant value of type T (padding stays zero).
     void fill(const T& value) {
         if (data != nullptr) {
-            std::fill(data, data + m * n, value);
+            for (int i = 0; i < m; ++i) {
+                std::fill(data + index(i, 0), data + index(i, n), value);
+            }
+        }
+    }
+
+    // Converts the storage to another layout, keeping the values.
+    void set_layout(matrix_layout_t layout) {
+        if (layout == layout_) {
+            return;
         }
+        layout_ = layout;
+        int new_ld = stride_for(n, layout);
+        if (data == nullptr || new_ld == ld_) {
+            ld_ = new_ld;
+            return;
+        }
+
+        size_t converted_bytes = 0;
+        T* converted = allocate(static_cast<size_t>(m) * new_ld, converted_bytes);
+        for (int i = 0; i < m; ++i) {
+            std::copy(data + index(i, 0), data + index(i, n), converted + static_cast<size_t>(i) * new_ld);
+        }
+        release(data, mapped_bytes_);
+        data = converted;
+        mapped_bytes_ = converted_bytes;
+        ld_ = new_ld;
     }
 
-    // Method to read matrix from a file.
+    // Method to read matrix from a file, into the current layout.
     void read_matrix(const std::string& filename) {
         // Clean up any previously allocated data.
-        delete[] data;
+        release(data, mapped_bytes_);
         data = nullptr;
         m = 0;
         n = 0;
+        ld_ = 0;
 
-        std::ifstream infile(filename);
-        if (!infile.is_open()) {
-            throw std::runtime_error("Error opening file: " + filename);
-        }
-
-        std::string line;
-        if (!std::getline(infile, line)) {
-            throw std::runtime_error("Error: file is empty.");
-        }
-
-        // Try to interpret the first line as a header containing m and n.
-        bool headerParsed = false;
-        {
-            std::istringstream iss(line);
-            int possible_m, possible_n;
-            if (iss >> possible_m >> possible_n) {
-                std::string extra;
-                if (!(iss >> extra)) { // Exactly two tokens found.
-                    headerParsed = true;
-                    m = possible_m;
-                    n = possible_n;
-                }
-            }
+        if (is_binary_matrix_file(filename)) {
+            read_binary(filename);
+            return;
         }
 
-        if (headerParsed) {
-            // Allocate memory for the matrix data.
-            if (m * n > 0) {
-                data = new T[m * n];
-            }
-
-            // Read m*n values from the file.
-            for (int i = 0; i < m; ++i) {
-                for (int j = 0; j < n; ++j) {
-                    if (!(infile >> data[i * n + j])) {
-                        throw std::runtime_error("Error reading matrix value at (" +
-                                                 std::to_string(i) + ", " + std::to_string(j) + ").");
-                    }
-                }
-            }
-
-            // Ensure there is no extra data.
-            T extra;
-            if (infile >> extra) {
-                throw std::runtime_error("Extra data found in the file after reading the matrix.");
-            }
+        text_matrix_file_t file(filename);
+        if (static_cast<size_t>(file.rows()) * file.cols() > 0) {
+            allocate_storage(file.rows(), file.cols());
+            file.parse(data, ld_);
         } else {
-            // No valid header found: treat the file as pure matrix data.
-            std::vector<T> temp_data;
-            {
-                std::istringstream row_stream(line);
-                T value;
-                while (row_stream >> value) {
-                    temp_data.push_back(value);
-                }
-            }
-            if (temp_data.empty()) {
-                throw std::runtime_error("Error: first line does not contain any matrix data.");
-            }
-            // Determine number of columns from the first line.
-            n = temp_data.size();
-            m = 1; // One row has been read already.
-
-            // Process the rest of the file.
-            while (std::getline(infile, line)) {
-                if (line.empty()) {
-                    continue;
-                }
-                std::istringstream row_stream(line);
-                int col_count = 0;
-                T value;
-                while (row_stream >> value) {
-                    temp_data.push_back(value);
-                    ++col_count;
-                }
-                if (col_count != n) {
-                    throw std::runtime_error("Inconsistent number of columns in the matrix file. "
-                                             "Expected " + std::to_string(n) + ", but got " +
-                                             std::to_string(col_count) + ".");
-                }
-                ++m;
-            }
-            // Allocate memory and copy the temporary data.
-            if (m * n > 0) {
-                data = new T[m * n];
-            }
-            for (size_t i = 0; i < temp_data.size(); i++) {
-                data[i] = temp_data[i];
-            }
+            m = file.rows();
+            n = file.cols();
+            ld_ = n;
         }
-        infile.close();
     }
 
     // Accessor methods.
     int rows() const { return m; }
     int cols() const { return n; }
 
+    // Row stride of data_ptr(), in elements.
+    int ld() const { return ld_; }
+    matrix_layout_t layout() const { return layout_; }
+    const alloc_policy_t& alloc_policy() const { return policy_; }
+
     // Element access operators.
     T& operator()(int row, int col) {
         if (row < 0 || row >= m || col < 0 || col >= n) {
             throw std::out_of_range("Matrix indices out of range");
         }
-        return data[row * n + col];
+        return data[index(row, col)];
     }
 
     const T& operator()(int row, int col) const {
         if (row < 0 || row >= m || col < 0 || col >= n) {
             throw std::out_of_range("Matrix indices out of range");
         }
-        return data[row * n + col];
+        return data[index(row, col)];
     }
 
     // Inline getter.
     inline T get(int row, int col) const {
-        return data[row * n + col];
+        return data[index(row, col)];
     }
 
     // Inline setter.
     inline void set(int row, int col, T value) {
-        data[row * n + col] = value;
+        data[index(row, col)] = value;
     }
 
-    // Return raw pointer to data (non-const and const).
+    // Return raw pointer to data (non-const and const). Rows are ld() apart.
     inline T* data_ptr() {
         return data;
     }
@@ -320,13 +390,106 @@ public:
 
         for (int i = 0; i < m; ++i) {
             for (int j = 0; j < n; ++j) {
-                std::cout << data[i * n + j] << " ";
+                std::cout << data[index(i, j)] << " ";
             }
             std::cout << "\n";
         }
     }
 
-    // Save the matrix to a file.
+    // Binary matrix files (matrix_file.h).
+
+    // Loads a binary matrix file (matrix_file.h) into the current layout and
+    // allocation policy. When the file already has the matching dtype and
+    // row stride and the policy is plain heap storage, the data is mapped
+    // copy-on-write instead of read: nothing is copied until it is written.
+    void read_binary(const std::string& filename) {
+        matrix_file_t file(filename);
+        int rows = file.rows();
+        int cols = file.cols();
+
+        if (file.dtype() == matrix_dtype_of<T>() && file.ld() == stride_for(cols, layout_) &&
+            policy_.uses_heap() && rows > 0 && cols > 0) {
+            if (void* mapped = file.map()) {
+                m = rows;
+                n = cols;
+                ld_ = file.ld();
+                data = static_cast<T*>(mapped);
+                mapped_bytes_ = file.data_bytes();
+                return;
+            }
+        }
+
+        allocate_storage(rows, cols);
+        for (int i = 0; i < m; ++i) {
+            file.read_row(i, data + index(i, 0), n);
+        }
+    }
+
+    // Maps a binary matrix file of dtype T shared and read-write, in the
+    // file's layout: from then on the matrix is the file. Pages are read
+    // when first touched, writes reach the file, and written-back pages can
+    // be dropped (include/tile_pager.h), so the matrix need not fit in
+    // memory. Throws std::runtime_error if the file cannot be mapped so.
+    void map_binary(const std::string& filename) {
+        matrix_file_t file(filename, true);
+        if (file.dtype() != matrix_dtype_of<T>() || file.rows() == 0 || file.cols() == 0) {
+            throw std::runtime_error("Cannot map " + filename + ": it needs to be a non-empty matrix of " +
+                                     (std::is_same<T, float>::value ? "floats." : "doubles."));
+        }
+        void* mapped = file.map_shared();
+        if (mapped == nullptr) {
+            throw std::runtime_error("Cannot map " + filename + " shared.");
+        }
+        release(data, mapped_bytes_);
+        m = file.rows();
+        n = file.cols();
+        ld_ = file.ld();
+        layout_ = file.padded() ? matrix_layout_t::padded : matrix_layout_t::row_major;
+        data = static_cast<T*>(mapped);
+        mapped_bytes_ = file.data_bytes();
+    }
+
+    // Creates filename as a zero rows x cols binary matrix file in the
+    // current layout and maps it as map_binary() does.
+    void create_binary(const std::string& filename, int rows, int cols) {
+        create_matrix_file(filename, matrix_dtype_of<T>(), rows, cols, stride_for(cols, layout_),
+                           layout_ == matrix_layout_t::padded);
+        map_binary(filename);
+    }
+
+    // Writes the matrix as a binary file with its current layout, padding
+    // included, so that it maps back without a copy.
+    void save_binary(const std::string& filename) const {
+        static_assert(matrix_dtype_of<T>() != matrix_dtype_t::unknown,
+                      "binary matrix files hold float or double");
+        std::ofstream outfile(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            throw std::runtime_error("Error opening file for writing: " + filename);
+        }
+
+        matrix_file_header_t header = {};
+        std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+        header.version = MATRIX_FILE_VERSION;
+        header.dtype = static_cast<uint32_t>(matrix_dtype_of<T>());
+        header.rows = m;
+        header.cols = n;
+        header.ld = ld_;
+        header.layout = layout_ == matrix_layout_t::padded ? 1 : 0;
+        header.byte_order = MATRIX_FILE_BYTE_ORDER;
+        header.data_offset = MATRIX_FILE_DATA_OFFSET;
+
+        std::vector<char> head(MATRIX_FILE_DATA_OFFSET, 0);
+        std::memcpy(head.data(), &header, sizeof(header));
+        outfile.write(head.data(), head.size());
+        if (data != nullptr) {
+            outfile.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * m * ld_));
+        }
+        if (outfile.fail()) {
+            throw std::runtime_error("Error writing matrix data to file: " + filename);
+        }
+    }
+
+    // Save the matrix to a file (always row-major text, whatever the layout).
     void save(const std::string& filename) const {
         if (m == 0 || n == 0 || data == nullptr) {
             std::cerr << "Matrix is not allocated.\n";
@@ -341,7 +504,7 @@ public:
         // Write the matrix data.
         for (int i = 0; i < m; ++i) {
             for (int j = 0; j < n; ++j) {
-                outfile << data[i * n + j];
+                outfile << data[index(i, j)];
                 if (j < n - 1) {
                     outfile << " ";
                 }
@@ -355,6 +518,43 @@ public:
     }
 };
 
+// A matrix file read a few rows at a time, for a factorization that starts
+// on its first rows while the rest load (QREngine::factorize_streaming()).
+// Text files are opened for streaming (matrix_text.h), so nothing scans
+// the values before the first rows are in.
+class matrix_stream_t {
+public:
+    explicit matrix_stream_t(const std::string& filename) {
+        if (is_binary_matrix_file(filename)) {
+            binary_ = std::make_unique<matrix_file_t>(filename);
+        } else {
+            text_ = std::make_unique<text_matrix_file_t>(filename, 1, true);
+        }
+    }
+
+    int rows() const { return binary_ ? binary_->rows() : text_->rows(); }
+    int cols() const { return binary_ ? binary_->cols() : text_->cols(); }
+
+    // Reads rows [loaded, last) (last clipped to rows()) into mat, a matrix
+    // of the file's shape in any layout, and returns the rows read so far.
+    // Rows are read in order: loaded is what the previous call returned.
+    template <class T>
+    int load(matrix_t<T>& mat, int loaded, int last) {
+        last = std::min(last, rows());
+        if (text_) {
+            return text_->parse_rows(mat.data_ptr(), mat.ld(), last);
+        }
+        for (int i = loaded; i < last; ++i) {
+            binary_->read_row(i, mat.data_ptr() + static_cast<size_t>(i) * mat.ld(), cols());
+        }
+        return std::max(loaded, last);
+    }
+
+private:
+    std::unique_ptr<matrix_file_t> binary_;
+    std::unique_ptr<text_matrix_file_t> text_;
+};
+
 class DependencyTable {
     size_t m;        // Number of rows
     size_t n;        // Number of columns
@@ -527,7 +727,7 @@ public:
     inline bool getDependency(size_t i, size_t j) const {
         size_t idx = i * n + j;
         // Acquire ordering to ensure we read the latest value from any writer
-        return data[idx].load(std::memory_order_seq_cst);
+        return data[idx].load(std::memory_order_acquire);
     }
 
     // Sets the dependency value at (i, j) using an atomic store
@@ -535,7 +735,7 @@ public:
         size_t idx = i * n + j;
         // Release ordering to ensure that prior writes in this thread are visible
         // to other threads that subsequently acquire this location
-        data[idx].store(value, std::memory_order_seq_cst);
+        data[idx].store(value, std::memory_order_release);
     }
 
     // Overloaded operator() for safe indexing (read)
@@ -573,45 +773,70 @@ public:
     size_t cols() const { return n; }
 };
 
-struct Task {
-    unsigned char type;
-    unsigned int priority;
-    bool enq_nxt_t1;
-    size_t row_start;
-    size_t row_end;
-    size_t col_start;
-    size_t col_end;
-    size_t chunk_idx_i;
-    size_t chunk_idx_j;
+struct Task;
+
+// Successors of a task: a view into the successor array of its TaskTable.
+struct task_successors_t {
+    Task* const* first = nullptr;
+    uint32_t count = 0;
+
+    Task* const* begin() const { return first; }
+    Task* const* end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Task* operator[](size_t k) const { return first[k]; }
+};
+
+// One task record per cache line, so that the dependency counters of
+// neighbouring tasks do not share a line.
+struct alignas(64) Task {
+    uint8_t type;
+    uint32_t priority;
+    int32_t num_deps;                 // Number of predecessors in the task graph.
+    std::atomic<int32_t> unmet;       // Predecessors not completed yet (starts at num_deps).
+    int32_t row_start;
+    int32_t row_end;
+    int32_t col_start;
+    int32_t col_end;
+    int32_t chunk_idx_i;
+    int32_t chunk_idx_j;
+    int32_t matrix = 0;               // Index of its matrix in a batched job.
+    task_successors_t successors;     // Tasks released by this one.
 };
 
+// The task graph of one factorization. Only the valid tasks are stored, row
+// after row in one arena: row i holds the tasks (i, 0) .. (i, row length - 1),
+// so (i, j) is found with one offset lookup. The successor lists share one
+// array. init() on a table of the same or a smaller graph reuses both
+// buffers, so a table can be rebuilt in place without touching the
+// allocator.
 class TaskTable {
 private:
-    int m;                     // number of task rows
-    int n;                     // number of task columns
-    std::vector<Task*> data;      // vector holding pointers to Task objects
+    int m;                                // number of task rows
+    int n;                                // number of task columns
+    int factor_rows;                      // task rows of the matrix (the rest hold right-hand sides)
+    int pivot_blocks;                     // task columns of pivots (a solve adds one more)
+    int num_tasks;                        // number of valid tasks
+    std::unique_ptr<Task[]> tasks;        // valid tasks, row-major
+    size_t capacity;                      // records allocated in 'tasks'
+    std::vector<int32_t> row_offset;      // m + 1 entries: first task of every row in 'tasks'
+    std::vector<Task*> successor_list;    // successor lists of all tasks, back to back
 
 public:
     TaskTable()
-        : m(0), n(0)
+        : m(0), n(0), factor_rows(0), pivot_blocks(0), num_tasks(0), capacity(0)
     {
-        // 'data' is initially empty.
+        // The arena is initially empty.
     }
 
     // Parameterized constructor that calls init().
     template <typename T>
     TaskTable(int total_task_rows, int total_task_cols, int alpha, int beta, matrix_t<T>& mat)
-        : m(0), n(0)
+        : m(0), n(0), factor_rows(0), pivot_blocks(0), num_tasks(0), capacity(0)
     {
         init(total_task_rows, total_task_cols, alpha, beta, mat);
     }
 
-    ~TaskTable() {
-        for (Task* t : data) {
-            delete t;
-        }
-    }
-
     // Disallow copy construction and copy assignment.
     TaskTable(const TaskTable&) = delete;
     TaskTable& operator=(const TaskTable&) = delete;
@@ -620,77 +845,145 @@ public:
     TaskTable(TaskTable&&) noexcept = default;
     TaskTable& operator=(TaskTable&&) noexcept = default;
 
+    // Builds the graph of a factorization with total_task_rows x
+    // total_task_cols tiles. With rhs_count > 0 the rows of the matrix are
+    // followed by one task row per BETA right-hand sides of a least-squares
+    // solve: a type-3 task per pivot block applies that block's reflectors to
+    // the right-hand sides, and a type-4 task in one extra column solves with
+    // L once every row of the matrix is factorized.
     template <typename T>
-    void init(int total_task_rows, int total_task_cols, int alpha, int beta, matrix_t<T>& mat) {
-        // Delete any previously allocated tasks.
-        for (Task* t : data) {
-            delete t;
-        }
-        data.clear();
-
-        m = total_task_rows;
-        n = total_task_cols;
-        data.resize(m * n, nullptr);
-
+    void init(int total_task_rows, int total_task_cols, int alpha, int beta, matrix_t<T>& mat,
+              int rhs_count = 0) {
+        init(total_task_rows, total_task_cols, alpha, beta, mat.rows(), mat.cols(), rhs_count);
+    }
+
+    // The graph of a rows x cols matrix without the matrix, as the scheduler
+    // benchmark (sched_bench_main.cpp) builds it.
+    void init(int total_task_rows, int total_task_cols, int alpha, int beta, int mat_rows, int mat_cols,
+              int rhs_count = 0) {
+        int rhs_rows = rhs_count > 0 ? (rhs_count + beta - 1) / beta : 0;
+        factor_rows = total_task_rows;
+        pivot_blocks = total_task_cols;
+        m = factor_rows + rhs_rows;
+        n = pivot_blocks + (rhs_rows > 0);
         int beta_div_alpha = beta / alpha;
+        int pivots = std::min(mat_rows, mat_cols);
 
-        int ctr = 1;
+        // Row i covers the columns j < (i + 1) * beta_div_alpha: its type-1
+        // tasks and the type-2 updates with the pivots of earlier rows. A
+        // right-hand side row covers every column.
+        row_offset.assign(m + 1, 0);
         for (int i = 0; i < m; ++i) {
-            for (int j = 0; j < n; ++j) {
-                Task* new_task = new Task();
+            int length = i < factor_rows ? std::min(pivot_blocks, (i + 1) * beta_div_alpha) : n;
+            row_offset[i + 1] = row_offset[i] + length;
+        }
+        num_tasks = row_offset[m];
+        if (static_cast<size_t>(num_tasks) > capacity) {
+            tasks.reset(new Task[num_tasks]);
+            capacity = num_tasks;
+        }
 
-                // Set the type and possibly the enq_nxt_t1 flag based on the indices and beta_by_alpha.
-                if (i * beta_div_alpha <= j && j < (i+1) * beta_div_alpha){
-                    new_task->type = 1;
-                    ctr = i + 1;
-                } else {
-                    new_task->type = 2;
-                    if (i == ctr && ((i-1) * beta_div_alpha <= j && j < i * beta_div_alpha)){
-                        new_task->enq_nxt_t1 = true;
-                    } else {
-                        new_task->enq_nxt_t1 = false;
-                    }
-                }
+        // Wire the task graph. Every task (i, j) with j > 0 follows the previous
+        // update of the same tile, (i, j-1); a type-2 or type-3 task also needs
+        // the reflectors of pivot block j from the type-1 task
+        // (j / beta_div_alpha, j), and that task releases the tasks (k, j) of
+        // every later row k. A type-4 task also waits for the last task of
+        // every row of the matrix. A type-1 task lists its successor on the
+        // panel (the next type-1 task of its tile) before the updates.
+        size_t edges = 0;
+        for (int i = 0; i < m; ++i) {
+            edges += static_cast<size_t>(std::max(0, row_length(i) - 1));
+            if (i < factor_rows) {
+                edges += static_cast<size_t>(std::max(0, std::min(pivot_blocks - i * beta_div_alpha,
+                                                                  beta_div_alpha))) * (m - 1 - i);
+            }
+        }
+        edges += static_cast<size_t>(factor_rows) * rhs_rows;
+        successor_list.resize(edges);
 
-                // If j is outside the designated range, free new_task and leave the cell as nullptr.
-                if (j >= (i+1) * beta_div_alpha) {
-                    delete new_task;
-                    continue;
+        size_t next_edge = 0;
+        for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < row_length(i); ++j) {
+                Task* t = &tasks[row_offset[i] + j];
+                int tile = i < factor_rows ? i : i - factor_rows;
+                int limit = i < factor_rows ? mat_rows : rhs_count;
+                if (i < factor_rows) {
+                    t->type = i * beta_div_alpha <= j ? 1 : 2;
+                } else {
+                    t->type = j < pivot_blocks ? 3 : 4;
                 }
 
-                // Set the boundaries for the task.
-                new_task->row_start   = alpha * j + 1;
-                new_task->row_end     = std::min(alpha *(j + 1) + 1, mat.rows());
-                new_task->col_start   = beta * i + 1;
-                new_task->col_end     = std::min(beta  *(i + 1) + 1, mat.rows());
-                new_task->chunk_idx_i = i;
-                new_task->chunk_idx_j = j;
+                // Set the boundaries for the task: pivots [row_start, row_end)
+                // applied to the matrix rows (or right-hand sides)
+                // [col_start, col_end). A type-4 task takes every pivot.
+                t->row_start   = t->type == 4 ? 0 : alpha * j;
+                t->row_end     = t->type == 4 ? pivots : std::min(alpha * (j + 1), pivots);
+                t->col_start   = beta * tile;
+                t->col_end     = std::min(beta  * (tile + 1), limit);
+                t->chunk_idx_i = i;
+                t->chunk_idx_j = j;
+                t->matrix      = 0;
 
                 // bottomL = (total_task_rows - 1 - i) + (total_task_cols - 1 - j) + 1
-                new_task->priority = (m - 1 - i) + (n - 1 - j) + 1;
-                // Store the task pointer in the vector.
-                data[i * n + j] = new_task;
+                t->priority = (m - 1 - i) + (n - 1 - j) + 1;
+                t->num_deps = t->type == 4 ? 1 + factor_rows : (j > 0) + (t->type != 1);
+                t->unmet.store(t->num_deps, std::memory_order_relaxed);
+
+                Task** first = successor_list.data() + next_edge;
+                if (j + 1 < row_length(i)) {
+                    successor_list[next_edge++] = t + 1;
+                }
+                if (t->type == 1) {
+                    for (int k = i + 1; k < m; ++k) {
+                        successor_list[next_edge++] = &tasks[row_offset[k] + j];
+                    }
+                }
+                if (i < factor_rows && j + 1 == row_length(i)) {
+                    for (int k = factor_rows; k < m; ++k) {
+                        successor_list[next_edge++] = &tasks[row_offset[k] + pivot_blocks];
+                    }
+                }
+                t->successors.first = first;
+                t->successors.count = static_cast<uint32_t>(successor_list.data() + next_edge - first);
             }
         }
     }
 
+    // Re-arms the dependency counters for another run over the same graph.
+    // Not thread-safe.
+    void reset() {
+        for (Task& t : *this) {
+            t.unmet.store(t.num_deps, std::memory_order_relaxed);
+        }
+    }
+
+    // Number of tasks in task row i: (i, 0) .. (i, row_length(i) - 1).
+    int row_length(int i) const {
+        return row_offset[i + 1] - row_offset[i];
+    }
+
+    // The task at (i, j), or nullptr outside the band of valid tasks.
     inline Task* getTask(int i, int j) const {
-        return data[i * n + j];
+        return j < row_length(i) ? &tasks[row_offset[i] + j] : nullptr;
     }
 
     // Overloaded operator() for accessing the task at (i, j) with bounds checking.
     Task* operator()(int i, int j) const {
-        if (i >= m || j >= n)
+        if (i < 0 || j < 0 || i >= m || j >= n)
             throw std::out_of_range("Index out of bounds in TaskTable::operator()");
-        return data[i * n + j];
+        return getTask(i, j);
     }
 
+    // The valid tasks in row-major order.
+    Task* begin() const { return tasks.get(); }
+    Task* end() const { return tasks.get() + num_tasks; }
+
     // Prints the task table.
-    // For each cell, it prints the task type (or "N" if the pointer is nullptr).
+    // For each cell, it prints the task priority (or "N" outside the band).
     void printTaskTable() const {
         for (int i = 0; i < m; ++i) {
             for (int j = 0; j < n; ++j) {
-                Task* t = data[i * n + j];
+                Task* t = getTask(i, j);
                 if (t)
                     std::cout << static_cast<int>(t->priority) << " ";
                 else
@@ -703,6 +996,28 @@ public:
     // Accessors for the number of rows and columns.
     int rows() const { return m; }
     int cols() const { return n; }
+    int numTasks() const { return num_tasks; }
+    int factorRows() const { return factor_rows; }
+    int pivotBlocks() const { return pivot_blocks; }
+
+    // Scheduling rank for the priority scheduler: every type-1 task (the
+    // panel factorizations, on the critical path) above every type-2 task,
+    // then by bottom level. Ranks lie in [0, numRanks()).
+    size_t rank(const Task* t) const {
+        size_t levels = static_cast<size_t>(m + n);
+        return t->type == 1 ? levels + t->priority : t->priority;
+    }
+
+    size_t numRanks() const { return 2 * static_cast<size_t>(m + n); }
+
+    // Number of tasks with every rank, to size a BucketPriorityQueue.
+    std::vector<size_t> rankCounts() const {
+        std::vector<size_t> counts(numRanks(), 0);
+        for (const Task& t : *this) {
+            ++counts[rank(&t)];
+        }
+        return counts;
+    }
 };
 
 template <class T>
@@ -803,137 +1118,441 @@ class CircularQueueMtx {
     }
 };
 
+// Bounded lock-free multi-producer / multi-consumer FIFO ring (D. Vyukov's
+// bounded MPMC queue). Every slot carries a sequence number: slot
+// p % capacity is free for the push at position p when its sequence is p,
+// and holds that push's value when it is p + 1; the pop at p hands it on to
+// the push at p + capacity. A push or pop claims its position with one CAS
+// and publishes with one release store on the slot, so a value is never
+// read before it is written. push_bulk() / pop_bulk() claim a whole run of
+// consecutive slots with a single CAS. Positions are 64-bit and never wrap.
 template<class T>
 class CircularQueueAtomic {
-    T* buffer;          // Raw array storage for elements.
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> buffer;
     const size_t capacity;    // Maximum number of elements allowed.
 
-    // Two atomic counters (which may be negative) track the logical indices.
-    std::atomic<int64_t> left;  // Points to the first valid element.
-    std::atomic<int64_t> right; // Points to one past the last valid element.
+    alignas(64) std::atomic<uint64_t> head;  // Next position to pop.
+    alignas(64) std::atomic<uint64_t> tail;  // Next position to push.
+
+    Slot& slot(uint64_t pos) { return buffer[pos % capacity]; }
 
-    // A mutex used only for query operations.
-    mutable std::mutex query_mutex;
-    
 public:
-    // Constructs the deque with the given capacity.
-    // (Capacity is the maximum number of elements that can be stored.)
+    // Constructs the queue with the given capacity (at least 1).
     explicit CircularQueueAtomic(size_t cap)
-      : capacity(cap), left(0), right(0)
+      : buffer(new Slot[cap > 0 ? cap : 1]), capacity(cap > 0 ? cap : 1), head(0), tail(0)
     {
-        // Allocate a raw array for storage.
-        buffer = new T[capacity];
-    }
-
-    ~CircularQueueAtomic() {
-        delete[] buffer;
+        for (size_t i = 0; i < capacity; ++i) {
+            buffer[i].seq.store(i, std::memory_order_relaxed);
+        }
     }
 
-    // Returns true if the deque is empty.
-    bool empty() const {
-        std::lock_guard<std::mutex> lock(query_mutex);
-        return (right.load(std::memory_order_acquire) - left.load(std::memory_order_acquire)) == 0;
-    }
+    CircularQueueAtomic(const CircularQueueAtomic&) = delete;
+    CircularQueueAtomic& operator=(const CircularQueueAtomic&) = delete;
 
-    // Returns true if the deque is full.
-    bool full() const {
-        std::lock_guard<std::mutex> lock(query_mutex);
-        return (right.load(std::memory_order_acquire) - left.load(std::memory_order_acquire)) >= static_cast<int64_t>(capacity);
-    }
+    size_t max_size() const { return capacity; }
 
-    // Returns the current number of elements.
+    // Snapshots: exact while no push or pop is in flight.
     size_t size() const {
-        std::lock_guard<std::mutex> lock(query_mutex);
-        return static_cast<size_t>(right.load(std::memory_order_acquire) - left.load(std::memory_order_acquire));
+        uint64_t h = head.load(std::memory_order_acquire);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        return t > h ? static_cast<size_t>(t - h) : 0;
     }
 
-    // ---- Lock-free update methods (using atomics & compare_exchange) ----
+    bool empty() const { return size() == 0; }
 
-    // push_back: Append an element at the back.
-    // Returns false if the deque is full.
-    bool push_back(const T &value) {
+    bool full() const { return size() >= capacity; }
+
+    // Appends count values starting at values, as many as there are free
+    // slots for, in order; returns how many were pushed.
+    size_t push_bulk(const T* values, size_t count) {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t pos = tail.load(std::memory_order_relaxed);
         while (true) {
-            int64_t current_right = right.load(std::memory_order_relaxed);
-            int64_t current_left  = left.load(std::memory_order_acquire);
-            if ((current_right - current_left) >= static_cast<int64_t>(capacity))
-                return false;  // full
-
-            if (right.compare_exchange_weak(current_right, current_right + 1,
-                                            std::memory_order_acq_rel, std::memory_order_relaxed))
-            {
-                size_t index = static_cast<size_t>(current_right % capacity);
-                buffer[index] = value;
-                return true;
+            size_t k = 0;
+            while (k < count && slot(pos + k).seq.load(std::memory_order_acquire) == pos + k) {
+                ++k;
+            }
+            if (k == 0) {
+                uint64_t seq = slot(pos).seq.load(std::memory_order_acquire);
+                if (seq < pos) {
+                    return 0;  // full: its last pop has not handed the slot on yet
+                }
+                pos = tail.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (tail.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < k; ++i) {
+                    Slot& s = slot(pos + i);
+                    s.value = values[i];
+                    s.seq.store(pos + i + 1, std::memory_order_release);
+                }
+                return k;
             }
         }
     }
 
-    // push_front: Insert an element at the front.
-    // Returns false if the deque is full.
-    bool push_front(const T &value) {
+    // Removes up to max values, oldest first, into out; returns how many. A
+    // pop stops at the first slot whose push is still in flight.
+    size_t pop_bulk(T* out, size_t max) {
+        if (max == 0) {
+            return 0;
+        }
+        uint64_t pos = head.load(std::memory_order_relaxed);
         while (true) {
-            int64_t current_left  = left.load(std::memory_order_relaxed);
-            int64_t current_right = right.load(std::memory_order_acquire);
-            if ((current_right - current_left) >= static_cast<int64_t>(capacity))
-                return false;  // full
-
-            int64_t new_left = current_left - 1;
-            if (left.compare_exchange_weak(current_left, new_left,
-                                           std::memory_order_acq_rel, std::memory_order_relaxed))
-            {
-                size_t index = static_cast<size_t>(((new_left % capacity) + capacity) % capacity);
-                buffer[index] = value;
-                return true;
+            size_t k = 0;
+            while (k < max && slot(pos + k).seq.load(std::memory_order_acquire) == pos + k + 1) {
+                ++k;
+            }
+            if (k == 0) {
+                uint64_t seq = slot(pos).seq.load(std::memory_order_acquire);
+                if (seq < pos + 1) {
+                    return 0;  // empty, or the oldest push is still in flight
+                }
+                pos = head.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (head.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < k; ++i) {
+                    Slot& s = slot(pos + i);
+                    out[i] = s.value;
+                    s.seq.store(pos + i + capacity, std::memory_order_release);
+                }
+                return k;
             }
         }
     }
 
-    // pop_front: Remove and return an element from the front.
-    // Returns std::nullopt if the deque is empty.
+    // Appends value; returns false if the queue is full.
+    bool push_back(const T &value) {
+        return push_bulk(&value, 1) == 1;
+    }
+
+    // Removes the oldest value; std::nullopt if there is none.
     std::optional<T> pop_front() {
-        while (true) {
-            int64_t current_left  = left.load(std::memory_order_relaxed);
-            int64_t current_right = right.load(std::memory_order_acquire);
-            if (current_left == current_right)
-                return std::nullopt;  // empty
-
-            if (left.compare_exchange_weak(current_left, current_left + 1,
-                                           std::memory_order_acq_rel, std::memory_order_relaxed))
-            {
-                size_t index = static_cast<size_t>(((current_left % capacity) + capacity) % capacity);
-                T value = buffer[index];
-                return value;
-            }
+        T value;
+        if (pop_bulk(&value, 1) == 0) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Aliases, so that the ring reads as any other FIFO queue.
+    inline bool push(const T &value) {
+        return push_back(value);
+    }
+
+    inline std::optional<T> pop() {
+        return pop_front();
+    }
+
+    // As tbb::concurrent_queue::try_pop.
+    bool try_pop(T& value) {
+        return pop_bulk(&value, 1) == 1;
+    }
+};
+
+// Chase-Lev work-stealing deque ("Correct and Efficient Work-Stealing for Weak
+// Memory Models", Le et al., PPoPP'13). Only the owning thread may call
+// push_back/pop_back (LIFO end); any thread may steal from the front (FIFO
+// end). The buffer grows on demand; retired buffers are kept until the deque
+// is destroyed because a concurrent thief may still be reading them.
+template <class T>
+class WorkStealingDeque {
+    struct Array {
+        int64_t capacity;
+        int64_t mask;
+        std::atomic<T>* buffer;
+
+        explicit Array(int64_t cap) : capacity(cap), mask(cap - 1), buffer(new std::atomic<T>[cap]) {}
+        ~Array() { delete[] buffer; }
+
+        T get(int64_t i) const { return buffer[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T value) { buffer[i & mask].store(value, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<int64_t> top;     // Next index to steal from.
+    alignas(64) std::atomic<int64_t> bottom;  // Next index the owner pushes to.
+    std::atomic<Array*> array;
+    std::vector<Array*> retired;              // Owner-only.
+
+    Array* grow(Array* old, int64_t b, int64_t t) {
+        Array* bigger = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        retired.push_back(old);
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+    // Constructs the deque; the initial capacity is rounded up to a power of two.
+    explicit WorkStealingDeque(size_t initial_capacity = 1024) : top(0), bottom(0) {
+        int64_t cap = 1;
+        while (cap < static_cast<int64_t>(initial_capacity)) {
+            cap <<= 1;
+        }
+        array.store(new Array(cap), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque() {
+        delete array.load(std::memory_order_relaxed);
+        for (Array* a : retired) {
+            delete a;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Approximate number of elements (exact when no operation is in flight).
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Owner: push at the back. Never fails; the buffer grows when full.
+    bool push_back(const T& value) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array* a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            a = grow(a, b, t);
         }
+        a->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
     }
 
-    // pop_back: Remove and return an element from the back.
-    // Returns std::nullopt if the deque is empty.
+    // Owner: pop the most recently pushed element.
     std::optional<T> pop_back() {
-        while (true) {
-            int64_t current_right = right.load(std::memory_order_relaxed);
-            int64_t current_left  = left.load(std::memory_order_acquire);
-            if (current_left == current_right)
-                return std::nullopt;  // empty
-
-            int64_t new_right = current_right - 1;
-            if (right.compare_exchange_weak(current_right, new_right,
-                                            std::memory_order_acq_rel, std::memory_order_relaxed))
-            {
-                size_t index = static_cast<size_t>(((new_right % capacity) + capacity) % capacity);
-                T value = buffer[index];
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // Empty.
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        T value = a->get(b);
+        if (t == b) {
+            // Last element: race against thieves for it.
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) {
+                return std::nullopt;
+            }
+        }
+        return value;
+    }
+
+    // Any thread: take the oldest element. Returns std::nullopt when the deque
+    // is empty or another thread won the race for the element.
+    std::optional<T> steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return std::nullopt;
+        }
+
+        Array* a = array.load(std::memory_order_acquire);
+        T value = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+};
+
+// Bucketed priority queue for a task graph whose priorities are small
+// integers known up front. Every priority has its own FIFO bucket with room
+// for exactly the elements that will ever be pushed with it, so a bucket is
+// an array with two monotonic counters and never wraps (no ABA). A two-level
+// bitmap records which buckets may be non-empty; pop() takes the oldest
+// element of the highest one. Push and pop cost a few atomic operations on
+// the bucket and its bitmap words, independent of the number of elements.
+template <class T>
+class BucketPriorityQueue {
+    struct Slot {
+        std::atomic<bool> full{false};
+        T value;
+    };
+
+    struct alignas(64) Bucket {
+        std::atomic<size_t> head{0};  // Next slot to pop.
+        std::atomic<size_t> tail{0};  // Next slot to push (reserved, maybe not written yet).
+        size_t begin = 0;             // Slots [begin, begin + capacity) of the slot array.
+        size_t capacity = 0;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<Bucket[]> buckets;
+    std::unique_ptr<std::atomic<uint64_t>[]> mask;     // Bit b: bucket b may be non-empty.
+    std::unique_ptr<std::atomic<uint64_t>[]> summary;  // Bit w: mask[w] may be non-zero.
+    size_t num_buckets = 0;
+    size_t mask_words = 0;
+    size_t summary_words = 0;
+
+    static int highest_bit(uint64_t word) { return 63 - __builtin_clzll(word); }
+
+    void mark(size_t b) {
+        size_t w = b / 64;
+        mask[w].fetch_or(uint64_t(1) << (b % 64));
+        summary[w / 64].fetch_or(uint64_t(1) << (w % 64));
+    }
+
+    bool bucket_nonempty(const Bucket& bucket) const {
+        return bucket.head.load() < bucket.tail.load();
+    }
+
+    std::optional<T> pop_bucket(Bucket& bucket) {
+        size_t h = bucket.head.load(std::memory_order_acquire);
+        while (h < bucket.tail.load(std::memory_order_acquire)) {
+            Slot& slot = slots[bucket.begin + h];
+            if (!slot.full.load(std::memory_order_acquire)) {
+                return std::nullopt;  // Its push is still in flight.
+            }
+            T value = slot.value;
+            if (bucket.head.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel,
+                                                  std::memory_order_acquire)) {
                 return value;
             }
         }
+        return std::nullopt;
     }
 
-    // push: Alias for push_back so that the deque can be used as a normal FIFO queue.
-    inline bool push(const T &value) {
-        return push_back(value);
+public:
+    BucketPriorityQueue() = default;
+
+    explicit BucketPriorityQueue(const std::vector<size_t>& capacity_per_priority) {
+        init(capacity_per_priority);
+    }
+
+    BucketPriorityQueue(const BucketPriorityQueue&) = delete;
+    BucketPriorityQueue& operator=(const BucketPriorityQueue&) = delete;
+
+    // Sizes the queue: at most capacity_per_priority[p] pushes with priority p
+    // over its whole lifetime. Not thread-safe; discards the contents.
+    void init(const std::vector<size_t>& capacity_per_priority) {
+        num_buckets = capacity_per_priority.size();
+        mask_words = (num_buckets + 63) / 64;
+        summary_words = (mask_words + 63) / 64;
+        buckets.reset(new Bucket[num_buckets]);
+        mask.reset(new std::atomic<uint64_t>[mask_words]);
+        summary.reset(new std::atomic<uint64_t>[summary_words]);
+        for (size_t w = 0; w < mask_words; ++w) {
+            mask[w].store(0, std::memory_order_relaxed);
+        }
+        for (size_t w = 0; w < summary_words; ++w) {
+            summary[w].store(0, std::memory_order_relaxed);
+        }
+        size_t total = 0;
+        for (size_t p = 0; p < num_buckets; ++p) {
+            buckets[p].begin = total;
+            buckets[p].capacity = capacity_per_priority[p];
+            total += capacity_per_priority[p];
+        }
+        slots.reset(new Slot[total]);
     }
 
-    // pop: Alias for pop_front so that the deque can be used as a normal FIFO queue.
-    inline std::optional<T> pop() {
-        return pop_front();
+    // Empties the queue for another lifetime of the same capacities, without
+    // reallocating. Not thread-safe.
+    void clear() {
+        for (size_t w = 0; w < mask_words; ++w) {
+            mask[w].store(0, std::memory_order_relaxed);
+        }
+        for (size_t w = 0; w < summary_words; ++w) {
+            summary[w].store(0, std::memory_order_relaxed);
+        }
+        for (size_t p = 0; p < num_buckets; ++p) {
+            for (size_t k = 0; k < buckets[p].capacity; ++k) {
+                slots[buckets[p].begin + k].full.store(false, std::memory_order_relaxed);
+            }
+            buckets[p].head.store(0, std::memory_order_relaxed);
+            buckets[p].tail.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t num_priorities() const { return num_buckets; }
+
+    // Any thread. Throws std::out_of_range past the priority's capacity.
+    void push(const T& value, size_t priority) {
+        if (priority >= num_buckets) {
+            throw std::out_of_range("Priority out of range in BucketPriorityQueue.");
+        }
+        Bucket& bucket = buckets[priority];
+        size_t t = bucket.tail.fetch_add(1, std::memory_order_acq_rel);
+        if (t >= bucket.capacity) {
+            throw std::out_of_range("Bucket capacity exceeded in BucketPriorityQueue.");
+        }
+        Slot& slot = slots[bucket.begin + t];
+        slot.value = value;
+        slot.full.store(true, std::memory_order_release);
+        mark(priority);
+    }
+
+    // Any thread: the oldest element of the highest priority, or std::nullopt
+    // if no pushed element is left. An element whose push is still in flight
+    // may be missed; it is found once its push returns. A bucket whose oldest
+    // element is in flight is skipped, and the lower ones are still scanned.
+    std::optional<T> pop() {
+        for (size_t sw = summary_words; sw-- > 0;) {
+            uint64_t sbits = summary[sw].load();
+            while (sbits != 0) {
+                size_t w = sw * 64 + highest_bit(sbits);
+                sbits &= ~(uint64_t(1) << (w % 64));
+                uint64_t bits = mask[w].load();
+                if (bits == 0) {
+                    summary[sw].fetch_and(~(uint64_t(1) << (w % 64)));
+                    if ((bits = mask[w].load()) == 0) {
+                        continue;
+                    }
+                    summary[sw].fetch_or(uint64_t(1) << (w % 64));
+                }
+                while (bits != 0) {
+                    size_t b = w * 64 + highest_bit(bits);
+                    bits &= ~(uint64_t(1) << (b % 64));
+                    if (auto value = pop_bucket(buckets[b])) {
+                        return value;
+                    }
+                    // Drained (or mid-push): clear the bit, and set it again if an
+                    // element slipped in, so that no push goes unseen.
+                    mask[w].fetch_and(~(uint64_t(1) << (b % 64)));
+                    if (bucket_nonempty(buckets[b])) {
+                        mask[w].fetch_or(uint64_t(1) << (b % 64));
+                        summary[sw].fetch_or(uint64_t(1) << (w % 64));
+                    }
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool empty() const {
+        for (size_t b = 0; b < num_buckets; ++b) {
+            if (bucket_nonempty(buckets[b])) {
+                return false;
+            }
+        }
+        return true;
     }
 };
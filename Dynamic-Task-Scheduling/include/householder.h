@@ -0,0 +1,625 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Householder kernels shared by the dynamic (main.cpp) and barrier
+// (barrier_main.cpp) schedulers.
+//
+// A task applies the pivots [row_start, row_end) to the matrix rows up to
+// col_end (type 1, which also builds the reflectors) or to the rows
+// [col_start, col_end) (type 2). The reflector of pivot p is stored in row p
+// of the matrix; its (up, b) pair goes to up_array[p] / b_array[p]. A zero b
+// marks a degenerate pivot that is skipped by the type-2 updates.
+//
+// n is the row stride of mat (matrix_t::ld()). Columns between the matrix
+// width and n must be zero; they behave as zero columns and stay zero.
+//
+// Every kernel is a template on the scalar type T, instantiated for double
+// and float; the reflectors (up, b and the T factors) have the type of the
+// matrix.
+//
+// Offsets into mat, rhs and tail are index_t: an out-of-core matrix passes
+// 2^31 elements long before its rows or stride do.
+typedef long long index_t;
+
+// Builds the reflector for row lpivot. Returns false if it is degenerate.
+template <class T>
+inline bool make_reflector(T* mat, int n, int lpivot, T& up, T& b)
+{
+    T sm, sm1, cl, clinv;
+
+    cl = std::fabs(mat[(index_t)lpivot * n + lpivot]);
+    sm1 = 0;
+
+    for (int k = lpivot + 1; k < n; k++)
+    {
+        sm = std::fabs(mat[(index_t)lpivot * n + k]);
+        sm1 += sm * sm;
+        cl = std::fmax(sm, cl);
+    }
+
+    if (cl <= 0.0)
+    {
+        return false;
+    }
+    clinv = T(1) / cl;
+
+    T d__1 = mat[(index_t)lpivot * n + lpivot] * clinv;
+    sm = d__1 * d__1;
+    sm += sm1 * clinv * clinv;
+
+    cl *= std::sqrt(sm);
+
+    if (mat[(index_t)lpivot * n + lpivot] > 0.0)
+    {
+        cl = -cl;
+    }
+
+    up = mat[(index_t)lpivot * n + lpivot] - cl;
+    mat[(index_t)lpivot * n + lpivot] = cl;
+
+    b = up * mat[(index_t)lpivot * n + lpivot];
+
+    if (b >= 0.0)
+    {
+        return false;
+    }
+
+    b = T(1) / b;
+    return true;
+}
+
+// Applies the reflector stored in row lpivot to row j.
+template <class T>
+inline void apply_reflector(T* mat, int n, int lpivot, T up, T b, int j)
+{
+    T sm = mat[(index_t)j * n + lpivot] * up;
+
+    for (int i__ = lpivot + 1; i__ < n; i__++)
+    {
+        sm += mat[(index_t)j * n + i__] * mat[(index_t)lpivot * n + i__];
+    }
+
+    if (sm == 0.0)
+    {
+        return;
+    }
+
+    sm *= b;
+    mat[(index_t)j * n + lpivot] += sm * up;
+
+    for (int i__ = lpivot + 1; i__ < n; i__++)
+    {
+        mat[(index_t)j * n + i__] += sm * mat[(index_t)lpivot * n + i__];
+    }
+}
+
+// Builds the reflector of pivot lpivot and applies it to rows (lpivot, col_end).
+template <class T>
+inline void task1_pivot(T* mat, int n, int lpivot, int col_end, T* up_array, T* b_array)
+{
+    T up = 0.0, b = 0.0;
+
+    if (!make_reflector(mat, n, lpivot, up, b))
+    {
+        up_array[lpivot] = 0.0;
+        b_array[lpivot] = 0.0;
+        return;
+    }
+
+    up_array[lpivot] = up;
+    b_array[lpivot] = b;
+
+    for (int j = lpivot + 1; j < col_end; j++)
+    {
+        apply_reflector(mat, n, lpivot, up, b, j);
+    }
+}
+
+// Generic kernels: any tile shape, including the clipped tiles at the matrix edge.
+template <class T>
+inline void complete_task1(T* mat, int n, int row_start, int row_end, int col_end,
+                           T* up_array, T* b_array)
+{
+    for (int lpivot = row_start; lpivot < row_end; lpivot++)
+    {
+        task1_pivot(mat, n, lpivot, col_end, up_array, b_array);
+    }
+}
+
+template <class T>
+inline void complete_task2(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                           const T* up_array, const T* b_array)
+{
+    for (int lpivot = row_start; lpivot < row_end; lpivot++)
+    {
+        T up = up_array[lpivot];
+        T b = b_array[lpivot];
+
+        if (b == 0.0)
+        {
+            continue;
+        }
+
+        for (int j = col_start; j < col_end; j++)
+        {
+            apply_reflector(mat, n, lpivot, up, b, j);
+        }
+    }
+}
+
+// Right-hand sides for least squares. A right-hand side is a vector as wide
+// as the matrix (cols entries; rhs row r at rhs + r * ldr) that takes the
+// pivots like a matrix row that never pivots itself. Once every pivot has
+// been applied, its first k entries (k = number of pivots) are Q^T b for
+// A = Q R the QR factorization of A = mat^T, with R = L^T and L the lower
+// triangle left in mat.
+template <class T>
+inline void apply_reflectors_rhs(const T* mat, int n, int cols, int row_start, int row_end,
+                                 const T* up_array, const T* b_array,
+                                 T* rhs, int ldr, int rhs_start, int rhs_end)
+{
+    for (int lpivot = row_start; lpivot < row_end; lpivot++)
+    {
+        T up = up_array[lpivot];
+        T b = b_array[lpivot];
+
+        if (b == 0.0)
+        {
+            continue;
+        }
+
+        const T* v = mat + (index_t)lpivot * n;
+        for (int r = rhs_start; r < rhs_end; r++)
+        {
+            T* c = rhs + (index_t)r * ldr;
+            T sm = c[lpivot] * up;
+            for (int i = lpivot + 1; i < cols; i++)
+            {
+                sm += c[i] * v[i];
+            }
+            if (sm == 0.0)
+            {
+                continue;
+            }
+            sm *= b;
+            c[lpivot] += sm * up;
+            for (int i = lpivot + 1; i < cols; i++)
+            {
+                c[i] += sm * v[i];
+            }
+        }
+    }
+}
+
+// Back-substitution R x = c[0:k] for right-hand sides that have taken all k
+// pivots, x overwriting c[0:k]. Row p of L (mat) is read once per
+// right-hand side: x_p is final when reached, and its multiples are then
+// removed from the entries before it. R must be non-singular.
+template <class T>
+inline void back_substitute_rhs(const T* mat, int n, int k, T* rhs, int ldr, int rhs_start, int rhs_end)
+{
+    for (int r = rhs_start; r < rhs_end; r++)
+    {
+        T* c = rhs + (index_t)r * ldr;
+        for (int p = k - 1; p >= 0; p--)
+        {
+            const T* l = mat + (index_t)p * n;
+            T x = c[p] / l[p];
+            c[p] = x;
+            for (int i = 0; i < p; i++)
+            {
+                c[i] -= l[i] * x;
+            }
+        }
+    }
+}
+
+// Rows appended to a factorized matrix (QREngine::append_rows). Row p of
+// the matrix being reduced is row p of L followed by tail[p * ldt, + k),
+// the entries of the k appended rows of A for pivot p. L is lower
+// triangular and stays so, so the reflector of pivot p has entries only at
+// column p of the matrix (the diagonal) and in tail row p: a pivot costs
+// O(k) per row. Only the lower triangle of mat is read or written, which
+// leaves the reflectors of the first factorization in place.
+template <class T>
+inline bool make_append_reflector(T* mat, int n, T* tail, int ldt, int k, int lpivot, T& up, T& b)
+{
+    T sm, sm1, cl, clinv;
+    T* d = mat + (index_t)lpivot * n + lpivot;
+    const T* v = tail + (index_t)lpivot * ldt;
+
+    cl = std::fabs(*d);
+    sm1 = 0;
+
+    for (int q = 0; q < k; q++)
+    {
+        sm = std::fabs(v[q]);
+        sm1 += sm * sm;
+        cl = std::fmax(sm, cl);
+    }
+
+    if (cl <= 0.0)
+    {
+        return false;
+    }
+    clinv = T(1) / cl;
+
+    T d__1 = *d * clinv;
+    sm = d__1 * d__1;
+    sm += sm1 * clinv * clinv;
+
+    cl *= std::sqrt(sm);
+
+    if (*d > 0.0)
+    {
+        cl = -cl;
+    }
+
+    up = *d - cl;
+    *d = cl;
+
+    b = up * *d;
+
+    if (b >= 0.0)
+    {
+        return false;
+    }
+
+    b = T(1) / b;
+    return true;
+}
+
+template <class T>
+inline void apply_append_reflector(T* mat, int n, T* tail, int ldt, int k, int lpivot, T up, T b, int j)
+{
+    const T* v = tail + (index_t)lpivot * ldt;
+    T* c = tail + (index_t)j * ldt;
+    T sm = mat[(index_t)j * n + lpivot] * up;
+
+    for (int q = 0; q < k; q++)
+    {
+        sm += c[q] * v[q];
+    }
+
+    if (sm == 0.0)
+    {
+        return;
+    }
+
+    sm *= b;
+    mat[(index_t)j * n + lpivot] += sm * up;
+
+    for (int q = 0; q < k; q++)
+    {
+        c[q] += sm * v[q];
+    }
+}
+
+// Type 1 and type 2 of the append graph, as complete_task1 / complete_task2.
+template <class T>
+inline void append_task1(T* mat, int n, T* tail, int ldt, int k, int row_start, int row_end, int col_end,
+                         T* up_array, T* b_array)
+{
+    for (int lpivot = row_start; lpivot < row_end; lpivot++)
+    {
+        T up = 0.0, b = 0.0;
+        if (!make_append_reflector(mat, n, tail, ldt, k, lpivot, up, b))
+        {
+            up_array[lpivot] = 0.0;
+            b_array[lpivot] = 0.0;
+            continue;
+        }
+        up_array[lpivot] = up;
+        b_array[lpivot] = b;
+        for (int j = lpivot + 1; j < col_end; j++)
+        {
+            apply_append_reflector(mat, n, tail, ldt, k, lpivot, up, b, j);
+        }
+    }
+}
+
+template <class T>
+inline void append_task2(T* mat, int n, T* tail, int ldt, int k, int row_start, int row_end, int col_start,
+                         int col_end, const T* up_array, const T* b_array)
+{
+    for (int lpivot = row_start; lpivot < row_end; lpivot++)
+    {
+        T up = up_array[lpivot];
+        T b = b_array[lpivot];
+
+        if (b == 0.0)
+        {
+            continue;
+        }
+
+        for (int j = col_start; j < col_end; j++)
+        {
+            apply_append_reflector(mat, n, tail, ldt, k, lpivot, up, b, j);
+        }
+    }
+}
+
+// Specialized kernels: full ALPHA_T x BETA_T tiles run with constant trip
+// counts; clipped tiles fall back to the generic kernels.
+template <class T, int ALPHA_T>
+void complete_task1_fixed(T* mat, int n, int row_start, int row_end, int col_end,
+                          T* up_array, T* b_array)
+{
+    if (row_end - row_start != ALPHA_T)
+    {
+        complete_task1(mat, n, row_start, row_end, col_end, up_array, b_array);
+        return;
+    }
+
+    for (int p = 0; p < ALPHA_T; p++)
+    {
+        task1_pivot(mat, n, row_start + p, col_end, up_array, b_array);
+    }
+}
+
+template <class T, int ALPHA_T, int BETA_T>
+void complete_task2_fixed(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                          const T* up_array, const T* b_array)
+{
+    if (row_end - row_start != ALPHA_T || col_end - col_start != BETA_T)
+    {
+        complete_task2(mat, n, row_start, row_end, col_start, col_end, up_array, b_array);
+        return;
+    }
+
+    for (int p = 0; p < ALPHA_T; p++)
+    {
+        int lpivot = row_start + p;
+        T up = up_array[lpivot];
+        T b = b_array[lpivot];
+
+        if (b == 0.0)
+        {
+            continue;
+        }
+
+        for (int r = 0; r < BETA_T; r++)
+        {
+            apply_reflector(mat, n, lpivot, up, b, col_start + r);
+        }
+    }
+}
+
+// Compact WY form. With v_p the reflector of pivot p (v_p[p] = up_array[p],
+// v_p[k] = mat[p][k] for k > p, zero before p) and tau_p = -b_array[p], the
+// panel [row_start, row_end) applies H_start ... H_end-1 = I - V T V^T.
+// build_block_reflector() computes the upper triangular T (k x k, row-major,
+// k = row_end - row_start) as LAPACK's dlarft does for forward, columnwise
+// storage; a degenerate pivot (b == 0) gets a zero row and column.
+template <class T>
+inline void build_block_reflector(const T* mat, int n, int row_start, int row_end,
+                                  const T* up_array, const T* b_array, T* t)
+{
+    int k = row_end - row_start;
+
+    for (int i = 0; i < k; i++)
+    {
+        int pi = row_start + i;
+        T tau = -b_array[pi];
+
+        // g[m] = v_m . v_i for m < i, kept in the (still unused) lower part of row i.
+        T* g = t + i * k;
+        for (int m = 0; m < i; m++)
+        {
+            int pm = row_start + m;
+            T s = mat[(index_t)pm * n + pi] * up_array[pi];
+            for (int c = pi + 1; c < n; c++)
+            {
+                s += mat[(index_t)pm * n + c] * mat[(index_t)pi * n + c];
+            }
+            g[m] = s;
+        }
+
+        // T[0:i, i] = -tau * T[0:i, 0:i] * g
+        for (int r = 0; r < i; r++)
+        {
+            T s = 0.0;
+            for (int m = r; m < i; m++)
+            {
+                s += t[r * k + m] * g[m];
+            }
+            t[r * k + i] = -tau * s;
+        }
+
+        for (int m = 0; m < i; m++)
+        {
+            g[m] = 0.0;
+        }
+        t[i * k + i] = tau;
+    }
+}
+
+// Type 2 with the block reflector of the panel: C = C - (C V) T V^T for the
+// rows C = [col_start, col_end), one row at a time.
+template <class T>
+inline void complete_task2_wy(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                              const T* up_array, const T* t)
+{
+    int k = row_end - row_start;
+    std::vector<T> w(k);
+
+    for (int j = col_start; j < col_end; j++)
+    {
+        T* c = mat + (index_t)j * n;
+
+        // w = c V
+        for (int i = 0; i < k; i++)
+        {
+            int p = row_start + i;
+            T s = c[p] * up_array[p];
+            for (int l = p + 1; l < n; l++)
+            {
+                s += c[l] * mat[(index_t)p * n + l];
+            }
+            w[i] = s;
+        }
+
+        // w = w T, from the last column so w[0:i] is still unchanged.
+        for (int i = k - 1; i >= 0; i--)
+        {
+            T s = 0.0;
+            for (int m = 0; m <= i; m++)
+            {
+                s += w[m] * t[m * k + i];
+            }
+            w[i] = s;
+        }
+
+        // c = c - w V^T
+        for (int i = 0; i < k; i++)
+        {
+            int p = row_start + i;
+            c[p] -= w[i] * up_array[p];
+            for (int l = p + 1; l < n; l++)
+            {
+                c[l] -= w[i] * mat[(index_t)p * n + l];
+            }
+        }
+    }
+}
+
+template <class T>
+using task1_kernel_t = void (*)(T*, int, int, int, int, T*, T*);
+template <class T>
+using task2_kernel_t = void (*)(T*, int, int, int, int, int, const T*, const T*);
+template <class T>
+using task2_wy_kernel_t = void (*)(T*, int, int, int, int, int, const T*, const T*);
+
+template <class T>
+struct task_kernels_t {
+    task1_kernel_t<T> task1;
+    task2_kernel_t<T> task2;
+    task2_wy_kernel_t<T> task2_wy;  // Type 2 with the compact WY block reflector.
+};
+
+namespace householder_detail {
+
+// Tile sizes with a specialized kernel: ALPHA in [2, MAX_TILE] and BETA a
+// multiple of ALPHA up to MAX_TILE (the grid scripts/experiment1b.py sweeps).
+constexpr int MAX_TILE = 32;
+
+template <class T, int A, int... Ks>
+bool select_beta(int beta, task_kernels_t<T>& k, std::integer_sequence<int, Ks...>)
+{
+    return ((beta == A * (Ks + 1) ? (k.task2 = &complete_task2_fixed<T, A, A * (Ks + 1)>, true) : false) || ...);
+}
+
+template <class T, int... Is>
+bool select_alpha(int alpha, int beta, task_kernels_t<T>& k, std::integer_sequence<int, Is...>)
+{
+    return ((alpha == Is + 2
+                 ? (k.task1 = &complete_task1_fixed<T, Is + 2>,
+                    select_beta<T, Is + 2>(beta, k, std::make_integer_sequence<int, MAX_TILE / (Is + 2)>{}),
+                    true)
+                 : false) || ...);
+}
+
+} // namespace householder_detail
+
+// Instruction set of the kernels. The scalar kernels above are the fallback;
+// the SIMD ones live in src/householder_avx2.cpp / src/householder_avx512.cpp,
+// each compiled for its ISA, and are only called after a CPU check.
+enum class simd_isa_t {
+    automatic,  // Best ISA the CPU supports.
+    scalar,
+    avx2,       // AVX2 + FMA.
+    avx512,     // AVX-512F.
+};
+
+inline const char* simd_isa_name(simd_isa_t isa)
+{
+    switch (isa)
+    {
+        case simd_isa_t::automatic: return "auto";
+        case simd_isa_t::scalar:    return "scalar";
+        case simd_isa_t::avx2:      return "avx2";
+        case simd_isa_t::avx512:    return "avx512";
+    }
+    return "unknown";
+}
+
+// Fill k with the kernels of that ISA for the tile shape. They return false
+// when the ISA was not compiled in (non-x86 builds). The float kernels hold
+// twice as many lanes per vector.
+bool select_task_kernels_avx2(int alpha, int beta, task_kernels_t<double>& k);
+bool select_task_kernels_avx2(int alpha, int beta, task_kernels_t<float>& k);
+bool select_task_kernels_avx512(int alpha, int beta, task_kernels_t<double>& k);
+bool select_task_kernels_avx512(int alpha, int beta, task_kernels_t<float>& k);
+
+// True if the kernels of that ISA were compiled in and the CPU can run them.
+inline bool simd_isa_supported(simd_isa_t isa)
+{
+    task_kernels_t<double> probe{};
+    switch (isa)
+    {
+        case simd_isa_t::automatic:
+        case simd_isa_t::scalar:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case simd_isa_t::avx2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                   select_task_kernels_avx2(0, 0, probe);
+        case simd_isa_t::avx512:
+            return __builtin_cpu_supports("avx512f") && select_task_kernels_avx512(0, 0, probe);
+#else
+        default:
+            return false;
+#endif
+    }
+    return false;
+}
+
+inline simd_isa_t detect_simd_isa()
+{
+    if (simd_isa_supported(simd_isa_t::avx512))
+    {
+        return simd_isa_t::avx512;
+    }
+    if (simd_isa_supported(simd_isa_t::avx2))
+    {
+        return simd_isa_t::avx2;
+    }
+    return simd_isa_t::scalar;
+}
+
+// Picks the kernels for a tile shape and ISA: specialized ones when
+// available, the generic ones otherwise. Throws std::invalid_argument if the
+// requested ISA cannot run here.
+template <class T = double>
+task_kernels_t<T> select_task_kernels(int alpha, int beta, simd_isa_t isa = simd_isa_t::automatic)
+{
+    if (isa == simd_isa_t::automatic)
+    {
+        isa = detect_simd_isa();
+    }
+    if (!simd_isa_supported(isa))
+    {
+        throw std::invalid_argument(std::string("No ") + simd_isa_name(isa) + " kernels for this CPU and build.");
+    }
+
+    task_kernels_t<T> k{&complete_task1<T>, &complete_task2<T>, &complete_task2_wy<T>};
+    switch (isa)
+    {
+        case simd_isa_t::avx2:
+            select_task_kernels_avx2(alpha, beta, k);
+            break;
+        case simd_isa_t::avx512:
+            select_task_kernels_avx512(alpha, beta, k);
+            break;
+        default:
+            householder_detail::select_alpha<T>(alpha, beta, k,
+                                                std::make_integer_sequence<int, householder_detail::MAX_TILE - 1>{});
+            break;
+    }
+    return k;
+}
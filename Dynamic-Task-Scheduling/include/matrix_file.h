@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary matrix files (.dtsm). A 64-byte header, zero fill up to data_offset
+// and then rows * ld elements in native byte order, row after row: the
+// storage of a matrix_t as it is in memory. data_offset is a multiple of the
+// page size, so a file whose dtype and stride match the requested ones is
+// mapped straight into the matrix instead of being read. Padding columns
+// (ld > cols) are written as zero and must stay zero.
+//
+//   offset  size  field
+//        0     8  magic "DTSMATRX"
+//        8     4  version (1)
+//       12     4  dtype (matrix_dtype_t)
+//       16     8  rows
+//       24     8  cols
+//       32     8  ld, the row stride in elements (>= cols)
+//       40     4  layout (0 row-major, 1 padded)
+//       44     4  byte order mark 0x01020304 as written by the producer
+//       48     8  data_offset in bytes
+//       56     8  reserved, zero
+
+enum class matrix_dtype_t : uint32_t {
+    unknown = 0,
+    float64 = 1,
+    float32 = 2,
+};
+
+template <class T>
+constexpr matrix_dtype_t matrix_dtype_of() {
+    return std::is_same<T, double>::value ? matrix_dtype_t::float64
+         : std::is_same<T, float>::value  ? matrix_dtype_t::float32
+                                          : matrix_dtype_t::unknown;
+}
+
+inline size_t matrix_dtype_size(matrix_dtype_t dtype) {
+    switch (dtype) {
+        case matrix_dtype_t::float64: return 8;
+        case matrix_dtype_t::float32: return 4;
+        default: return 0;
+    }
+}
+
+constexpr char MATRIX_FILE_MAGIC[8] = {'D', 'T', 'S', 'M', 'A', 'T', 'R', 'X'};
+constexpr uint32_t MATRIX_FILE_VERSION = 1;
+constexpr uint32_t MATRIX_FILE_BYTE_ORDER = 0x01020304;
+constexpr uint64_t MATRIX_FILE_DATA_OFFSET = 4096;
+
+struct matrix_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t ld;
+    uint32_t layout;
+    uint32_t byte_order;
+    uint64_t data_offset;
+    uint64_t reserved;
+};
+static_assert(sizeof(matrix_file_header_t) == 64, "the header is 64 bytes on disk");
+
+// True if the file starts with the binary magic; text files never do.
+inline bool is_binary_matrix_file(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(MATRIX_FILE_MAGIC)];
+    bool binary = ::pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic)) &&
+                  std::memcmp(magic, MATRIX_FILE_MAGIC, sizeof(magic)) == 0;
+    ::close(fd);
+    return binary;
+}
+
+// Open binary matrix file with a validated header. Closes the descriptor
+// when it goes out of scope.
+class matrix_file_t {
+public:
+    // writable opens the file for map_shared().
+    explicit matrix_file_t(const std::string& filename, bool writable = false)
+        : fd_(::open(filename.c_str(), writable ? O_RDWR : O_RDONLY)) {
+        if (fd_ < 0) {
+            throw std::runtime_error("Error opening file: " + filename);
+        }
+        if (::pread(fd_, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_)) ||
+            std::memcmp(header_.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC)) != 0) {
+            close();
+            throw std::runtime_error("Error: " + filename + " is not a binary matrix file.");
+        }
+        std::string problem;
+        struct stat st;
+        if (header_.byte_order != MATRIX_FILE_BYTE_ORDER) {
+            problem = "written with a different byte order";
+        } else if (header_.version != MATRIX_FILE_VERSION) {
+            problem = "unsupported version " + std::to_string(header_.version);
+        } else if (matrix_dtype_size(dtype()) == 0) {
+            problem = "unsupported dtype " + std::to_string(header_.dtype);
+        } else if (header_.rows > INT32_MAX || header_.cols > INT32_MAX || header_.ld > INT32_MAX ||
+                   header_.ld < header_.cols || header_.data_offset < sizeof(header_)) {
+            problem = "invalid shape";
+        } else if (::fstat(fd_, &st) != 0 ||
+                   static_cast<uint64_t>(st.st_size) < header_.data_offset + data_bytes()) {
+            problem = "file is truncated";
+        }
+        if (!problem.empty()) {
+            close();
+            throw std::runtime_error("Error reading binary matrix " + filename + ": " + problem + ".");
+        }
+    }
+
+    ~matrix_file_t() { close(); }
+
+    matrix_file_t(const matrix_file_t&) = delete;
+    matrix_file_t& operator=(const matrix_file_t&) = delete;
+
+    int rows() const { return static_cast<int>(header_.rows); }
+    int cols() const { return static_cast<int>(header_.cols); }
+    int ld() const { return static_cast<int>(header_.ld); }
+    matrix_dtype_t dtype() const { return static_cast<matrix_dtype_t>(header_.dtype); }
+    bool padded() const { return header_.layout == 1; }
+    size_t data_bytes() const { return header_.rows * header_.ld * matrix_dtype_size(dtype()); }
+
+    // Private (copy-on-write) mapping of the data, or nullptr when the data
+    // offset is not page aligned or the mapping fails. Unmap with data_bytes().
+    void* map() const {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (data_bytes() == 0 || header_.data_offset % page != 0) {
+            return nullptr;
+        }
+        void* p = mmap(nullptr, data_bytes(), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd_,
+                       static_cast<off_t>(header_.data_offset));
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    // Shared read-write mapping of the data of a file opened writable: the
+    // pages are the file's, so writes reach it and pages not in use can be
+    // dropped once written back. nullptr as for map().
+    void* map_shared() const {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (data_bytes() == 0 || header_.data_offset % page != 0) {
+            return nullptr;
+        }
+        void* p = mmap(nullptr, data_bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                       static_cast<off_t>(header_.data_offset));
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    // Reads count elements of row into dst, converting from the file dtype.
+    template <class T>
+    void read_row(int row, T* dst, int count) const {
+        size_t elem = matrix_dtype_size(dtype());
+        off_t offset = static_cast<off_t>(header_.data_offset + static_cast<uint64_t>(row) * header_.ld * elem);
+        if (dtype() == matrix_dtype_of<T>()) {
+            read_exact(dst, count * elem, offset);
+        } else if (dtype() == matrix_dtype_t::float64) {
+            convert_row<double>(dst, count, offset);
+        } else {
+            convert_row<float>(dst, count, offset);
+        }
+    }
+
+private:
+    template <class F, class T>
+    void convert_row(T* dst, int count, off_t offset) const {
+        constexpr int CHUNK = 1024;
+        F buf[CHUNK];
+        for (int j = 0; j < count; j += CHUNK) {
+            int len = count - j < CHUNK ? count - j : CHUNK;
+            read_exact(buf, len * sizeof(F), offset + static_cast<off_t>(j * sizeof(F)));
+            for (int k = 0; k < len; ++k) {
+                dst[j + k] = static_cast<T>(buf[k]);
+            }
+        }
+    }
+
+    void read_exact(void* dst, size_t bytes, off_t offset) const {
+        char* p = static_cast<char*>(dst);
+        while (bytes > 0) {
+            ssize_t got = ::pread(fd_, p, bytes, offset);
+            if (got <= 0) {
+                throw std::runtime_error("Error reading binary matrix data.");
+            }
+            p += got;
+            bytes -= got;
+            offset += got;
+        }
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int fd_;
+    matrix_file_header_t header_;
+};
+
+// Creates (or truncates) filename as a binary matrix file of rows x cols
+// with row stride ld, all zero. The data is left as a hole, so no block is
+// written until it is; throws std::runtime_error if the file cannot be
+// written.
+inline void create_matrix_file(const std::string& filename, matrix_dtype_t dtype, int rows, int cols, int ld,
+                               bool padded) {
+    matrix_file_header_t header = {};
+    std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.dtype = static_cast<uint32_t>(dtype);
+    header.rows = rows;
+    header.cols = cols;
+    header.ld = ld;
+    header.layout = padded ? 1 : 0;
+    header.byte_order = MATRIX_FILE_BYTE_ORDER;
+    header.data_offset = MATRIX_FILE_DATA_OFFSET;
+
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    off_t size = static_cast<off_t>(MATRIX_FILE_DATA_OFFSET +
+                                    static_cast<uint64_t>(rows) * ld * matrix_dtype_size(dtype));
+    bool ok = fd >= 0 && ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+              ::ftruncate(fd, size) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!ok) {
+        throw std::runtime_error("Error creating binary matrix file: " + filename);
+    }
+}
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Text matrix files: an optional header line holding exactly the two
+// integers m and n, then the values separated by whitespace. With a header
+// the values are a plain stream of m * n numbers; without one every
+// non-empty line is a row and the first line sets the number of columns.
+//
+// The file is mapped and cut into chunks of whole lines, one per thread.
+// A first pass counts the values (and checks the column count of every
+// line) per chunk, and a second pass parses each chunk with
+// std::from_chars straight into the matrix at the offset the counts give.
+// Errors are those of the stream parser this replaces and, when several
+// chunks fail, the one nearest the start of the file is reported.
+//
+// A file opened for streaming skips both passes: its shape comes from the
+// header or from a count of the non-empty lines, and parse_rows() parses
+// the values in order, a few rows at a time, making the checks of the
+// count pass as it goes.
+class text_matrix_file_t {
+public:
+    // Chunks smaller than this are not worth a thread.
+    static constexpr size_t MIN_CHUNK_BYTES = size_t(1) << 20;
+
+    explicit text_matrix_file_t(const std::string& filename, int threads = 0, bool streaming = false)
+        : begin_(nullptr), end_(nullptr), mapped_bytes_(0), header_(false), rows_(0), cols_(0) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Error opening file: " + filename);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Error: file is empty.");
+        }
+        mapped_bytes_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, mapped_bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Error opening file: " + filename);
+        }
+        begin_ = static_cast<const char*>(p);
+        end_ = begin_ + mapped_bytes_;
+        try {
+            if (streaming) {
+                scan_shape();
+            } else {
+                scan(threads);
+            }
+        } catch (...) {
+            munmap(const_cast<char*>(begin_), mapped_bytes_);
+            throw;
+        }
+    }
+
+    ~text_matrix_file_t() {
+        munmap(const_cast<char*>(begin_), mapped_bytes_);
+    }
+
+    text_matrix_file_t(const text_matrix_file_t&) = delete;
+    text_matrix_file_t& operator=(const text_matrix_file_t&) = delete;
+
+    bool has_header() const { return header_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+
+    // Parses the values into data, row i at data + i * ld. Throws
+    // std::runtime_error at the first value that is not a number.
+    template <class T>
+    void parse(T* data, size_t ld) const {
+        std::vector<std::string> errors(chunks_.size());
+        run_chunks([&](size_t c) {
+            const chunk_t& chunk = chunks_[c];
+            size_t k = chunk.first_value;
+            size_t row = chunk.first_row;
+            for (const char* line = chunk.begin; line < chunk.end;) {
+                const char* eol = find_eol(line, chunk.end);
+                if (header_) {
+                    for_tokens(line, eol, [&](const char* b, const char* e) {
+                        if (errors[c].empty() && !parse_value(b, e, data[(k / cols_) * ld + k % cols_])) {
+                            errors[c] = value_error(k / cols_, k % cols_);
+                        }
+                        ++k;
+                    });
+                } else if (eol > line) {
+                    size_t j = 0;
+                    T* dst = data + row * ld;
+                    for_tokens(line, eol, [&](const char* b, const char* e) {
+                        if (errors[c].empty() && !parse_value(b, e, dst[j])) {
+                            errors[c] = value_error(row, j);
+                        }
+                        ++j;
+                    });
+                    ++row;
+                }
+                line = eol + 1;
+            }
+        });
+        throw_first(errors);
+    }
+
+    // Streaming files: parses the values of the rows up to last (clipped to
+    // rows()) that are not parsed yet into data, row i at data + i * ld, and
+    // returns the number of rows parsed so far. Throws std::runtime_error as
+    // parse() and the count pass would.
+    template <class T>
+    int parse_rows(T* data, size_t ld, int last) {
+        last = std::min(last, rows_);
+        const size_t values = static_cast<size_t>(rows_) * cols_;
+        while (parsed_rows_ < last) {
+            if (cursor_ >= end_) {
+                throw std::runtime_error(value_error(next_value_ / cols_, next_value_ % cols_));
+            }
+            const char* eol = find_eol(cursor_, end_);
+            if (header_) {
+                for_tokens(cursor_, eol, [&](const char* b, const char* e) {
+                    size_t k = next_value_++;
+                    if (k >= values) {
+                        throw std::runtime_error("Extra data found in the file after reading the matrix.");
+                    }
+                    if (!parse_value(b, e, data[(k / cols_) * ld + k % cols_])) {
+                        throw std::runtime_error(value_error(k / cols_, k % cols_));
+                    }
+                });
+                parsed_rows_ = static_cast<int>(next_value_ / cols_);
+            } else if (count_tokens(cursor_, eol) > 0) {
+                size_t j = 0;
+                T* dst = data + static_cast<size_t>(parsed_rows_) * ld;
+                for_tokens(cursor_, eol, [&](const char* b, const char* e) {
+                    if (j < static_cast<size_t>(cols_) && !parse_value(b, e, dst[j])) {
+                        throw std::runtime_error(value_error(parsed_rows_, j));
+                    }
+                    ++j;
+                });
+                if (j != static_cast<size_t>(cols_)) {
+                    throw std::runtime_error("Inconsistent number of columns in the matrix file. "
+                                             "Expected " + std::to_string(cols_) + ", but got " +
+                                             std::to_string(j) + ".");
+                }
+                ++parsed_rows_;
+            }
+            cursor_ = std::min(eol + 1, end_);
+        }
+        if (header_ && parsed_rows_ == rows_ && count_tokens(cursor_, end_) > 0) {
+            throw std::runtime_error("Extra data found in the file after reading the matrix.");
+        }
+        return parsed_rows_;
+    }
+
+private:
+    struct chunk_t {
+        const char* begin;
+        const char* end;
+        size_t values = 0;       // Values in the chunk.
+        size_t rows = 0;         // Non-empty lines (rows without a header).
+        size_t first_value = 0;  // Prefix sums over the previous chunks.
+        size_t first_row = 0;
+    };
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+    }
+
+    static const char* find_eol(const char* p, const char* end) {
+        const void* nl = std::memchr(p, '\n', end - p);
+        return nl ? static_cast<const char*>(nl) : end;
+    }
+
+    template <class F>
+    static void for_tokens(const char* p, const char* end, F&& f) {
+        while (true) {
+            while (p < end && is_space(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                return;
+            }
+            const char* b = p;
+            while (p < end && !is_space(*p)) {
+                ++p;
+            }
+            f(b, p);
+        }
+    }
+
+    static size_t count_tokens(const char* p, const char* end) {
+        size_t count = 0;
+        for_tokens(p, end, [&](const char*, const char*) { ++count; });
+        return count;
+    }
+
+    // A whole token must be a number; a leading '+' is accepted like operator>>.
+    template <class T>
+    static bool parse_value(const char* b, const char* e, T& out) {
+        if (b != e && *b == '+') {
+            ++b;
+        }
+        std::from_chars_result r = std::from_chars(b, e, out);
+        return r.ec == std::errc() && r.ptr == e;
+    }
+
+    static std::string value_error(size_t i, size_t j) {
+        return "Error reading matrix value at (" + std::to_string(i) + ", " + std::to_string(j) + ").";
+    }
+
+    static void throw_first(const std::vector<std::string>& errors) {
+        for (const std::string& e : errors) {
+            if (!e.empty()) {
+                throw std::runtime_error(e);
+            }
+        }
+    }
+
+    template <class F>
+    void run_chunks(F&& f) const {
+        if (chunks_.size() == 1) {
+            f(0);
+            return;
+        }
+        std::vector<std::thread> threads;
+        for (size_t c = 0; c < chunks_.size(); ++c) {
+            threads.emplace_back([&f, c] { f(c); });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    void scan(int threads) {
+        const char* first_eol = find_eol(begin_, end_);
+
+        // Header: exactly two integer tokens on the first line.
+        std::vector<std::pair<const char*, const char*>> tokens;
+        for_tokens(begin_, first_eol, [&](const char* b, const char* e) { tokens.emplace_back(b, e); });
+        int header_m = 0, header_n = 0;
+        header_ = tokens.size() == 2 && parse_value(tokens[0].first, tokens[0].second, header_m) &&
+                  parse_value(tokens[1].first, tokens[1].second, header_n);
+        if (header_ && (header_m < 0 || header_n < 0)) {
+            throw std::runtime_error("Error: negative matrix dimensions in the header.");
+        }
+        if (!header_) {
+            cols_ = static_cast<int>(tokens.size());
+            if (cols_ == 0) {
+                throw std::runtime_error("Error: first line does not contain any matrix data.");
+            }
+        }
+
+        // Chunks of whole lines over the data.
+        const char* body = header_ ? std::min(first_eol + 1, end_) : begin_;
+        size_t bytes = end_ - body;
+        if (threads <= 0) {
+            threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        size_t count = std::max<size_t>(1, std::min<size_t>(threads, bytes / MIN_CHUNK_BYTES));
+        for (size_t c = 0; c < count; ++c) {
+            const char* b = c == 0 ? body : chunks_.back().end;
+            const char* e = c + 1 == count ? end_ : body + bytes / count * (c + 1);
+            if (e < b) {
+                e = b;
+            }
+            if (e < end_) {
+                e = std::min(find_eol(e, end_) + 1, end_);
+            }
+            chunk_t chunk;
+            chunk.begin = b;
+            chunk.end = e;
+            chunks_.push_back(chunk);
+        }
+
+        // Count pass, checking the column count of every row.
+        std::vector<std::string> errors(chunks_.size());
+        run_chunks([&](size_t c) {
+            chunk_t& chunk = chunks_[c];
+            for (const char* line = chunk.begin; line < chunk.end;) {
+                const char* eol = find_eol(line, chunk.end);
+                size_t n = count_tokens(line, eol);
+                chunk.values += n;
+                if (!header_ && eol > line) {
+                    if (n != static_cast<size_t>(cols_) && errors[c].empty()) {
+                        errors[c] = "Inconsistent number of columns in the matrix file. "
+                                    "Expected " + std::to_string(cols_) + ", but got " + std::to_string(n) + ".";
+                    }
+                    ++chunk.rows;
+                }
+                line = eol + 1;
+            }
+        });
+        throw_first(errors);
+
+        size_t values = 0, rows = 0;
+        for (chunk_t& chunk : chunks_) {
+            chunk.first_value = values;
+            chunk.first_row = rows;
+            values += chunk.values;
+            rows += chunk.rows;
+        }
+
+        if (header_) {
+            rows_ = header_m;
+            cols_ = header_n;
+            size_t expected = static_cast<size_t>(header_m) * header_n;
+            if (values > expected) {
+                throw std::runtime_error("Extra data found in the file after reading the matrix.");
+            }
+            if (values < expected) {
+                throw std::runtime_error(value_error(values / header_n, values % header_n));
+            }
+        } else {
+            rows_ = static_cast<int>(rows);
+        }
+    }
+
+    // The shape of a streaming file: the header, or the columns of the first
+    // line and the number of lines with a value.
+    void scan_shape() {
+        const char* first_eol = find_eol(begin_, end_);
+        std::vector<std::pair<const char*, const char*>> tokens;
+        for_tokens(begin_, first_eol, [&](const char* b, const char* e) { tokens.emplace_back(b, e); });
+        header_ = tokens.size() == 2 && parse_value(tokens[0].first, tokens[0].second, rows_) &&
+                  parse_value(tokens[1].first, tokens[1].second, cols_);
+        if (header_) {
+            if (rows_ < 0 || cols_ < 0) {
+                throw std::runtime_error("Error: negative matrix dimensions in the header.");
+            }
+            cursor_ = std::min(first_eol + 1, end_);
+            if (cols_ == 0) {
+                parsed_rows_ = rows_;
+            }
+            return;
+        }
+        rows_ = 0;
+        cols_ = static_cast<int>(tokens.size());
+        if (cols_ == 0) {
+            throw std::runtime_error("Error: first line does not contain any matrix data.");
+        }
+        cursor_ = begin_;
+        for (const char* line = begin_; line < end_;) {
+            const char* eol = find_eol(line, end_);
+            const char* p = line;
+            while (p < eol && is_space(*p)) {
+                ++p;
+            }
+            rows_ += p < eol;
+            line = eol + 1;
+        }
+    }
+
+    const char* begin_;
+    const char* end_;
+    size_t mapped_bytes_;
+    bool header_;
+    int rows_;
+    int cols_;
+    std::vector<chunk_t> chunks_;
+    const char* cursor_ = nullptr;  // Streaming: the first line not parsed yet.
+    size_t next_value_ = 0;         // Streaming, with a header: values parsed.
+    int parsed_rows_ = 0;
+};
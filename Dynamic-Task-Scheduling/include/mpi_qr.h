@@ -0,0 +1,65 @@
+#pragma once
+
+#include "qr_engine.h"
+
+// Factorization of one matrix split over the processes of MPI_COMM_WORLD
+// (mpi.out, built with make mpi; in other builds factorize_mpi() throws).
+//
+// Task rows (BETA-row tiles) are dealt out cyclically: process r of P owns
+// the task rows i with i % P == r, with the panels of the pivot blocks in
+// them. Rows are dealt out whole because a reflector spans whole rows:
+// with the columns split as well, every reflector application would need a
+// reduction across processes. Each process runs its share on a QREngine
+// (factorize_partitioned()), under the scheduler of params. As soon as one
+// of its panel tasks is done, the calling thread broadcasts the pivot rows
+// and reflectors of the block while the workers go on with their updates,
+// and it receives the panels of the other processes the same way.
+
+struct mpi_qr_stats_t {
+    qr_run_stats_t run;           // The local job.
+    int ranks = 0;
+    int owned_task_rows = 0;
+    int panels_sent = 0;          // Pivot blocks broadcast by this process.
+    int panels_received = 0;
+    double bytes_received = 0;
+    double panel_wait_ms = 0;     // Worker time spent waiting for panels from elsewhere.
+    double released_bytes = 0;    // Received pivot rows given back once no local update needs them.
+};
+
+// The process of ranks that owns task row i.
+inline int mpi_task_row_owner(int task_row, int ranks) {
+    return task_row % ranks;
+}
+
+// Whether this process (rank of ranks) owns matrix row row under params.
+inline bool mpi_owns_row(int row, const qr_params_t& params, int rank, int ranks) {
+    return mpi_task_row_owner(row / params.beta, ranks) == rank;
+}
+
+// A rows x cols matrix in params.layout on mapped storage left untouched
+// (params.alloc with first_touch placement), for factorize_mpi(): a
+// process only writes its own rows and the pivot rows it receives, so
+// only they take memory.
+template <class T>
+matrix_t<T> make_distributed_matrix(int rows, int cols, const qr_params_t& params);
+
+// Gives back the pages that lie wholly in rows [first, last) of a matrix
+// from make_distributed_matrix(), rows the process has no use for, and
+// returns the bytes released: 0 on the heap or with huge pages.
+template <class T>
+size_t release_distributed_rows(matrix_t<T>& mat, int first, int last);
+
+// Collective over MPI_COMM_WORLD: every process calls it with the same
+// shape and params, mat holding its own rows. On return those rows are
+// factorized as QREngine::factorize() would leave them, and factors
+// holds the reflectors of every pivot block; the other rows are
+// undefined. Without huge pages, the pages that lie wholly in pivot rows
+// received from elsewhere are released once the local updates with them
+// are done. MPI must be initialized with at least MPI_THREAD_FUNNELED,
+// and this called from the main thread: the workers never call MPI. If
+// the local job throws, the process finishes its share of the broadcasts
+// before rethrowing, so that no process is left waiting on it; the
+// results elsewhere are then undefined.
+template <class T>
+mpi_qr_stats_t factorize_mpi(QREngine& engine, matrix_t<T>& mat, const qr_params_t& params,
+                             qr_factors_t<T>& factors);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+#include "qr_params.h"
+
+// A device that runs type-2 updates out of its own memory, for the engine's
+// --offload mode. The panels stay on the CPU workers: a device gets the
+// tiles it updates and the pivot rows and reflectors of the panels it
+// applies, keeps a tile until its updates are done, and then hands it back.
+// A backend is a table of entry points, as the kernels are; the engine
+// calls them from the thread that drives the device (the client of the
+// job), never concurrently.
+//
+// Experimental: the only backend is offload_device_t::emulated
+// (src/offload_emulated.cpp), a stand-in that runs the CPU kernels on a
+// copy of the matrix. It exercises the engine's side of the interface but
+// gains nothing over the workers; a GPU backend with its own streams and
+// asynchronous copies would fill in the same table.
+
+// One type-2 task: pivots [row_start, row_end) of block j applied to the
+// matrix rows [col_start, col_end), as in the task graph.
+struct offload_update_t {
+    int row_start;
+    int row_end;
+    int col_start;
+    int col_end;
+    int block;
+};
+
+template <class T>
+struct offload_backend_t {
+    const char* name = nullptr;
+    // Device storage for a rows x cols matrix of row stride ld and its
+    // reflectors under params; returns the device handle.
+    void* (*open)(int rows, int cols, int ld, const qr_params_t& params) = nullptr;
+    void (*close)(void* device) = nullptr;
+    // Host rows [row_start, row_end) to the device, from column col on.
+    void (*upload_rows)(void* device, const T* mat, int row_start, int row_end, int col) = nullptr;
+    // Device rows [row_start, row_end) back to the host.
+    void (*download_rows)(void* device, T* mat, int row_start, int row_end) = nullptr;
+    // up and b of pivots [row_start, row_end), and with update_t::wy the T
+    // factor t of their block.
+    void (*upload_reflectors)(void* device, const T* up, const T* b, int row_start, int row_end, int block,
+                              const T* t) = nullptr;
+    // Runs count updates of distinct tiles and waits for them.
+    void (*run_updates)(void* device, const offload_update_t* updates, int count) = nullptr;
+};
+
+// The backend of device d. Throws std::invalid_argument if this build has
+// none for it.
+template <class T>
+offload_backend_t<T> select_offload_backend(offload_device_t d);
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Hint to the CPU that we are busy-waiting (frees pipeline resources for a
+// hyperthread sibling).
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+// What an idle worker does while the ready queues are empty: spin for
+// 'spin' polls, then yield for 'yield' polls, then sleep until a task is
+// pushed (unless 'park' is false, in which case it keeps spinning).
+struct idle_policy_t {
+    int spin = 4096;
+    int yield = 64;
+    bool park = true;
+};
+
+// Parks idle workers on a condition variable. The epoch counter closes the
+// window between "queues looked empty" and "went to sleep": a worker
+// announces itself in 'sleepers' before its last look at the queues, and a
+// producer that sees a sleeper bumps the epoch before notifying, so either
+// the worker finds the task or it is woken for it.
+class WorkerParker {
+    alignas(64) std::atomic<int> sleepers;
+    alignas(64) std::atomic<unsigned> epoch;
+    std::atomic<bool> done;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+public:
+    WorkerParker() : sleepers(0), epoch(0), done(false) {}
+
+    WorkerParker(const WorkerParker&) = delete;
+    WorkerParker& operator=(const WorkerParker&) = delete;
+
+    // Re-arms the parker for another run.
+    void reset() {
+        done.store(false, std::memory_order_relaxed);
+    }
+
+    // True once shutdown() has been called.
+    bool finished() const {
+        return done.load(std::memory_order_acquire);
+    }
+
+    // Called after pushing 'count' tasks. Cheap when nobody sleeps.
+    void notify(int count = 1) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int waiting = sleepers.load(std::memory_order_relaxed);
+        if (waiting == 0 || count <= 0) {
+            return;
+        }
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count >= waiting) {
+            cv.notify_all();
+        } else {
+            for (int i = 0; i < count; ++i) {
+                cv.notify_one();
+            }
+        }
+    }
+
+    // Termination broadcast: wakes every parked worker for good.
+    void shutdown() {
+        done.store(true, std::memory_order_release);
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_all();
+    }
+
+    // Sleeps until notify() or shutdown(). try_pop is the caller's last look
+    // at the queues; if it succeeds the worker does not sleep and park
+    // returns true.
+    template <class TryPop>
+    bool park(TryPop&& try_pop) {
+        unsigned ticket = epoch.load(std::memory_order_acquire);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (try_pop()) {
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (epoch.load(std::memory_order_acquire) == ticket && !finished()) {
+                cv.wait(lock);
+            }
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+// Per-worker idle state machine driven by an idle_policy_t.
+class IdleBackoff {
+    const idle_policy_t& policy;
+    int rounds;
+
+public:
+    explicit IdleBackoff(const idle_policy_t& p) : policy(p), rounds(0) {}
+
+    // Call after a successful pop.
+    void reset() { rounds = 0; }
+
+    // Call after an unsuccessful pop. Returns true when the worker should
+    // park; the caller then calls reset() after waking.
+    bool wait() {
+        if (rounds < policy.spin) {
+            ++rounds;
+            cpu_relax();
+            return false;
+        }
+        if (rounds < policy.spin + policy.yield) {
+            ++rounds;
+            std::this_thread::yield();
+            return false;
+        }
+        if (!policy.park) {
+            cpu_relax();
+            return false;
+        }
+        return true;
+    }
+};
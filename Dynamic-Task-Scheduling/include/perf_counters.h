@@ -0,0 +1,309 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware (and software) performance counters per worker thread, charged
+// to what the worker was doing: type-1 kernels, type-2 kernels or
+// everything in between (popping, releasing successors, idling). All
+// events of a thread form one perf_event group read with a single read(),
+// so every charge costs one system call. Events the CPU, kernel or
+// perf_event_paranoid setting do not allow are left out and reported as
+// unavailable; DRAM traffic is estimated as LLC misses times the line size
+// because the memory controller counters are per socket, not per thread.
+
+struct perf_event_spec_t {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+#if defined(__linux__)
+inline const std::vector<perf_event_spec_t>& perf_event_specs() {
+    static const std::vector<perf_event_spec_t> specs = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"llc_references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+        {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"stalled_cycles_frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+        {"stalled_cycles_backend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+        {"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    };
+    return specs;
+}
+#else
+inline const std::vector<perf_event_spec_t>& perf_event_specs() {
+    static const std::vector<perf_event_spec_t> specs;
+    return specs;
+}
+#endif
+
+constexpr int PERF_MAX_EVENTS = 9;
+constexpr int PERF_LINE_BYTES = 64;
+
+struct perf_values_t {
+    uint64_t value[PERF_MAX_EVENTS] = {};
+
+    perf_values_t& operator+=(const perf_values_t& o) {
+        for (int k = 0; k < PERF_MAX_EVENTS; ++k) {
+            value[k] += o.value[k];
+        }
+        return *this;
+    }
+};
+
+// The counters of the calling thread. Not copyable; open() from the thread
+// to be measured.
+class PerfCounterGroup {
+    int leader = -1;
+    std::vector<int> fds;
+    std::vector<int> events;  // Index into perf_event_specs() of every open fd, in group order.
+
+public:
+    PerfCounterGroup() = default;
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+    ~PerfCounterGroup() { close(); }
+
+    // Opens every available event for the calling thread; hardware events
+    // count user mode only.
+    // Returns false if none could be opened.
+    bool open() {
+        close();
+#if defined(__linux__)
+        const auto& specs = perf_event_specs();
+        for (int k = 0; k < static_cast<int>(specs.size()); ++k) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = specs[k].type;
+            attr.config = specs[k].config;
+            attr.disabled = leader < 0 ? 1 : 0;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            // Software events (context switches, faults) happen in the
+            // kernel; count them there when allowed.
+            attr.exclude_kernel = specs[k].type == PERF_TYPE_SOFTWARE ? 0 : 1;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0 && !attr.exclude_kernel) {
+                attr.exclude_kernel = 1;
+                fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            }
+            if (fd < 0) {
+                continue;
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds.push_back(fd);
+            events.push_back(k);
+        }
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        return leader >= 0;
+    }
+
+    void close() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            ::close(fd);
+        }
+#endif
+        fds.clear();
+        events.clear();
+        leader = -1;
+    }
+
+    bool is_open() const { return leader >= 0; }
+
+    bool has_event(int k) const {
+        for (int e : events) {
+            if (e == k) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Current counts, scaled up if the group was multiplexed. All zero when
+    // not open.
+    perf_values_t read() const {
+        perf_values_t out;
+#if defined(__linux__)
+        if (leader < 0) {
+            return out;
+        }
+        uint64_t buf[3 + PERF_MAX_EVENTS];
+        ssize_t want = static_cast<ssize_t>((3 + fds.size()) * sizeof(uint64_t));
+        if (::read(leader, buf, sizeof(buf)) < want || buf[0] != fds.size()) {
+            return out;
+        }
+        double scale = buf[2] > 0 && buf[2] < buf[1] ? static_cast<double>(buf[1]) / buf[2] : 1.0;
+        for (size_t n = 0; n < fds.size(); ++n) {
+            out.value[events[n]] = static_cast<uint64_t>(buf[3 + n] * scale);
+        }
+#endif
+        return out;
+    }
+};
+
+// What the counts between two charges are attributed to.
+enum class perf_category_t {
+    type1,      // Type-1 task kernels (panel factorization).
+    type2,      // Type-2 task kernels (updates).
+    scheduler,  // Everything else: queues, dependency release, idling.
+};
+
+constexpr int PERF_CATEGORIES = 3;
+
+inline const char* perf_category_name(perf_category_t c) {
+    switch (c) {
+        case perf_category_t::type1:     return "type1";
+        case perf_category_t::type2:     return "type2";
+        case perf_category_t::scheduler: return "scheduler";
+    }
+    return "unknown";
+}
+
+// Per-worker totals. charge(c) adds the counts since the previous charge
+// (or start()) to category c.
+class alignas(64) PerfAccumulator {
+    PerfCounterGroup group;
+    perf_values_t last;
+
+public:
+    perf_values_t totals[PERF_CATEGORIES];
+    uint64_t tasks[PERF_CATEGORIES] = {};
+
+    // From the worker thread, before its first task.
+    bool start() {
+        bool ok = group.open();
+        last = group.read();
+        return ok;
+    }
+
+    void charge(perf_category_t c) {
+        perf_values_t now = group.read();
+        perf_values_t& total = totals[static_cast<int>(c)];
+        for (int k = 0; k < PERF_MAX_EVENTS; ++k) {
+            total.value[k] += now.value[k] - last.value[k];
+        }
+        last = now;
+        if (c != perf_category_t::scheduler) {
+            ++tasks[static_cast<int>(c)];
+        }
+    }
+
+    // From the worker thread, after its last task. The counters stay open
+    // (and describe which events were available) until destruction.
+    void stop() {
+        charge(perf_category_t::scheduler);
+    }
+
+    const PerfCounterGroup& counters() const { return group; }
+};
+
+// Machine-readable per-run totals: one line of JSON with the run's
+// parameters, the wall time and, per category, the task count, every event
+// (null where a worker could not open it) and derived ratios.
+inline void write_perf_report(std::ostream& os, const std::vector<PerfAccumulator>& workers, double wall_ms,
+                              const std::vector<std::pair<std::string, std::string>>& run) {
+    const auto& specs = perf_event_specs();
+    std::vector<bool> available(specs.size(), !workers.empty());
+    for (const PerfAccumulator& w : workers) {
+        for (size_t k = 0; k < specs.size(); ++k) {
+            available[k] = available[k] && w.counters().has_event(static_cast<int>(k));
+        }
+    }
+
+    auto index_of = [&](const char* name) {
+        for (size_t k = 0; k < specs.size(); ++k) {
+            if (std::strcmp(specs[k].name, name) == 0) {
+                return static_cast<int>(k);
+            }
+        }
+        return -1;
+    };
+    auto ratio = [&](const perf_values_t& v, const char* num, const char* den) {
+        int a = index_of(num), b = index_of(den);
+        if (a < 0 || b < 0 || !available[a] || !available[b] || v.value[b] == 0) {
+            return std::string("null");
+        }
+        std::ostringstream ss;
+        ss << std::setprecision(6) << static_cast<double>(v.value[a]) / v.value[b];
+        return ss.str();
+    };
+
+    os << "{\"run\":{";
+    for (size_t k = 0; k < run.size(); ++k) {
+        os << (k ? "," : "") << "\"" << run[k].first << "\":\"" << run[k].second << "\"";
+    }
+    os << "},\"wall_ms\":" << wall_ms << ",\"workers\":" << workers.size() << ",\"events\":{";
+    for (size_t k = 0; k < specs.size(); ++k) {
+        os << (k ? "," : "") << "\"" << specs[k].name << "\":" << (available[k] ? "true" : "false");
+    }
+    os << "},\"categories\":{";
+    for (int c = 0; c < PERF_CATEGORIES; ++c) {
+        perf_values_t total;
+        uint64_t tasks = 0;
+        for (const PerfAccumulator& w : workers) {
+            total += w.totals[c];
+            tasks += w.tasks[c];
+        }
+        os << (c ? "," : "") << "\"" << perf_category_name(static_cast<perf_category_t>(c)) << "\":{\"tasks\":" << tasks;
+        for (size_t k = 0; k < specs.size(); ++k) {
+            os << ",\"" << specs[k].name << "\":";
+            if (available[k]) {
+                os << total.value[k];
+            } else {
+                os << "null";
+            }
+        }
+        os << ",\"ipc\":" << ratio(total, "instructions", "cycles")
+           << ",\"llc_miss_ratio\":" << ratio(total, "llc_misses", "llc_references")
+           << ",\"dram_bytes_est\":";
+        int misses = index_of("llc_misses");
+        if (misses >= 0 && available[misses]) {
+            os << total.value[misses] * PERF_LINE_BYTES;
+        } else {
+            os << "null";
+        }
+        os << "}";
+    }
+    os << "}}\n";
+}
+
+// Appends the report to path (one JSON object per line and run), or writes
+// it to stdout for "-".
+inline void write_perf_report(const std::string& path, const std::vector<PerfAccumulator>& workers, double wall_ms,
+                              const std::vector<std::pair<std::string, std::string>>& run) {
+    if (path == "-") {
+        write_perf_report(std::cout, workers, wall_ms, run);
+        return;
+    }
+    std::ofstream out(path, std::ios::app);
+    if (!out.is_open()) {
+        throw std::runtime_error("Error opening file for writing: " + path);
+    }
+    write_perf_report(out, workers, wall_ms, run);
+}
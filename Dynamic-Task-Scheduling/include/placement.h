@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#endif
+
+// Where matrix memory and worker threads are placed: the allocation policy
+// of matrix_t and the CPU each worker is pinned to.
+
+// ============================ Memory placement ============================
+
+enum class huge_pages_t {
+    none,
+    transparent,  // madvise(MADV_HUGEPAGE) on a 2 MB aligned mapping.
+    hugetlb,      // MAP_HUGETLB: needs pages reserved in vm.nr_hugepages.
+};
+
+enum class numa_placement_t {
+    none,         // Whoever touches a page first (usually the loading thread).
+    interleave,   // Pages spread round-robin over the online nodes.
+    first_touch,  // Pages left untouched; the worker owning a tile touches it first.
+};
+
+struct alloc_policy_t {
+    huge_pages_t huge_pages = huge_pages_t::none;
+    numa_placement_t numa = numa_placement_t::none;
+
+    // Plain aligned operator new is enough.
+    bool uses_heap() const {
+        return huge_pages == huge_pages_t::none && numa == numa_placement_t::none;
+    }
+};
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// Parses a sysfs-style id list such as "0,2,4-7".
+inline std::vector<int> parse_id_list(const std::string& list) {
+    std::vector<int> ids;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty() || item == "\n") {
+            continue;
+        }
+        size_t dash = item.find('-');
+        try {
+            int first = std::stoi(item.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            if (first < 0 || last < first) {
+                throw std::invalid_argument(item);
+            }
+            for (int id = first; id <= last; ++id) {
+                ids.push_back(id);
+            }
+        } catch (const std::exception&) {
+            throw std::invalid_argument("Invalid id list: " + list);
+        }
+    }
+    return ids;
+}
+
+// Online NUMA nodes, {0} when the system does not say.
+inline std::vector<int> numa_online_nodes() {
+    std::ifstream in("/sys/devices/system/node/online");
+    std::string line;
+    if (in && std::getline(in, line)) {
+        std::vector<int> nodes = parse_id_list(line);
+        if (!nodes.empty()) {
+            return nodes;
+        }
+    }
+    return {0};
+}
+
+// Storage obtained by placement_alloc(); mapped_bytes == 0 means heap memory.
+struct placed_block_t {
+    void* ptr = nullptr;
+    size_t mapped_bytes = 0;
+};
+
+// Allocates bytes under the policy. Heap blocks are cache-line aligned and
+// uninitialized; mapped blocks are huge-page aligned (page aligned without
+// huge pages), zero and not yet touched, so their pages are placed by the
+// first thread that writes them. Throws std::runtime_error if the memory
+// cannot be obtained (for instance no reserved pages for hugetlb).
+inline placed_block_t placement_alloc(size_t bytes, const alloc_policy_t& policy) {
+    placed_block_t block;
+    if (bytes == 0) {
+        return block;
+    }
+    if (policy.uses_heap()) {
+        block.ptr = ::operator new(bytes, std::align_val_t(CACHE_LINE_SIZE));
+        return block;
+    }
+
+#if defined(__linux__)
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t align = policy.huge_pages == huge_pages_t::none ? page : HUGE_PAGE_SIZE;
+    size_t size = (bytes + align - 1) / align * align;
+    char* p = nullptr;
+
+    if (policy.huge_pages == huge_pages_t::hugetlb) {
+        void* m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (m == MAP_FAILED) {
+            throw std::runtime_error("Cannot map " + std::to_string(size) +
+                                     " bytes of huge pages; reserve them with vm.nr_hugepages.");
+        }
+        p = static_cast<char*>(m);
+    } else {
+        // Over-map by one alignment unit and trim both ends.
+        size_t span = size + align - page;
+        void* m = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED) {
+            throw std::runtime_error("Cannot map " + std::to_string(span) + " bytes.");
+        }
+        char* base = static_cast<char*>(m);
+        p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + align - 1) / align * align);
+        if (p > base) {
+            munmap(base, p - base);
+        }
+        if (base + span > p + size) {
+            munmap(p + size, base + span - (p + size));
+        }
+        if (policy.huge_pages == huge_pages_t::transparent) {
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+    }
+
+    if (policy.numa == numa_placement_t::interleave) {
+        // Best effort: without permission or NUMA support the default policy stays.
+        std::vector<int> nodes = numa_online_nodes();
+        int max_node = *std::max_element(nodes.begin(), nodes.end());
+        std::vector<unsigned long> mask(max_node / (8 * sizeof(unsigned long)) + 1, 0);
+        for (int node : nodes) {
+            mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+        }
+        syscall(SYS_mbind, p, size, MPOL_INTERLEAVE, mask.data(), max_node + 2, 0);
+    }
+
+    block.ptr = p;
+    block.mapped_bytes = size;
+    return block;
+#else
+    block.ptr = ::operator new(bytes, std::align_val_t(CACHE_LINE_SIZE));
+    return block;
+#endif
+}
+
+inline void placement_free(const placed_block_t& block) {
+    if (block.ptr == nullptr) {
+        return;
+    }
+#if defined(__linux__)
+    if (block.mapped_bytes > 0) {
+        munmap(block.ptr, block.mapped_bytes);
+        return;
+    }
+#endif
+    ::operator delete(block.ptr, std::align_val_t(CACHE_LINE_SIZE));
+}
+
+// ============================ Thread placement ============================
+
+enum class affinity_t {
+    none,     // Workers are not pinned.
+    compact,  // Worker t on the t-th CPU ordered by socket, core, sibling.
+    scatter,  // Workers spread round-robin over sockets, one per core first.
+    list,     // Worker t on cpus[t % cpus.size()].
+};
+
+struct affinity_policy_t {
+    affinity_t kind = affinity_t::none;
+    std::vector<int> cpus;  // For affinity_t::list.
+};
+
+struct cpu_info_t {
+    int cpu;
+    int package;
+    int core;
+};
+
+inline int read_sysfs_int(const std::string& path, int fallback) {
+    std::ifstream in(path);
+    int value;
+    return (in >> value) ? value : fallback;
+}
+
+// CPUs this process may run on, with their socket and core ids.
+inline std::vector<cpu_info_t> available_cpus() {
+    std::vector<cpu_info_t> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &set)) {
+                continue;
+            }
+            std::string topo = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            cpus.push_back({cpu, read_sysfs_int(topo + "physical_package_id", 0), read_sysfs_int(topo + "core_id", cpu)});
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        unsigned n = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < n; ++cpu) {
+            cpus.push_back({static_cast<int>(cpu), 0, static_cast<int>(cpu)});
+        }
+    }
+    return cpus;
+}
+
+// CPU of every worker under the policy; -1 means not pinned. Pure function of
+// the topology so it can be tested with a synthetic one.
+inline std::vector<int> affinity_map(const affinity_policy_t& policy, int num_threads,
+                                     std::vector<cpu_info_t> cpus) {
+    std::vector<int> map(num_threads, -1);
+    if (policy.kind == affinity_t::none || num_threads <= 0) {
+        return map;
+    }
+    if (policy.kind == affinity_t::list) {
+        for (int t = 0; t < num_threads && !policy.cpus.empty(); ++t) {
+            map[t] = policy.cpus[t % policy.cpus.size()];
+        }
+        return map;
+    }
+    if (cpus.empty()) {
+        return map;
+    }
+
+    std::sort(cpus.begin(), cpus.end(), [](const cpu_info_t& a, const cpu_info_t& b) {
+        return std::tie(a.package, a.core, a.cpu) < std::tie(b.package, b.core, b.cpu);
+    });
+
+    std::vector<int> order;
+    if (policy.kind == affinity_t::compact) {
+        for (const cpu_info_t& c : cpus) {
+            order.push_back(c.cpu);
+        }
+    } else {
+        // Per socket: first sibling of every core, then the second ones, ...
+        std::vector<std::vector<int>> per_package;
+        for (size_t k = 0; k < cpus.size();) {
+            size_t end = k;
+            while (end < cpus.size() && cpus[end].package == cpus[k].package) {
+                ++end;
+            }
+            std::vector<std::vector<int>> by_sibling;
+            for (size_t c = k; c < end;) {
+                size_t core_end = c;
+                while (core_end < end && cpus[core_end].core == cpus[c].core) {
+                    ++core_end;
+                }
+                for (size_t s = c; s < core_end; ++s) {
+                    if (by_sibling.size() <= s - c) {
+                        by_sibling.emplace_back();
+                    }
+                    by_sibling[s - c].push_back(cpus[s].cpu);
+                }
+                c = core_end;
+            }
+            per_package.emplace_back();
+            for (const auto& level : by_sibling) {
+                per_package.back().insert(per_package.back().end(), level.begin(), level.end());
+            }
+            k = end;
+        }
+        // Round-robin over sockets.
+        for (size_t rank = 0; order.size() < cpus.size(); ++rank) {
+            for (const auto& pkg : per_package) {
+                if (rank < pkg.size()) {
+                    order.push_back(pkg[rank]);
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < num_threads; ++t) {
+        map[t] = order[t % order.size()];
+    }
+    return map;
+}
+
+inline std::vector<int> affinity_map(const affinity_policy_t& policy, int num_threads) {
+    return affinity_map(policy, num_threads, available_cpus());
+}
+
+// Pins the calling thread to cpu (no-op for -1). Returns false on failure.
+inline bool pin_current_thread(int cpu) {
+    if (cpu < 0) {
+        return true;
+    }
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+// Copies src into dst (same shape, any layouts) with one thread per worker,
+// pinned like the workers: worker t copies the tiles of tile_rows rows with
+// index i % cpus.size() == t and so touches their pages first. Used with
+// numa_placement_t::first_touch to put each tile on its worker's node.
+template <class Matrix>
+void first_touch_copy(Matrix& dst, const Matrix& src, int tile_rows, const std::vector<int>& cpus) {
+    int workers = std::max<int>(1, static_cast<int>(cpus.size()));
+    int tiles = (dst.rows() + tile_rows - 1) / tile_rows;
+    size_t row_bytes = sizeof(*dst.data_ptr()) * dst.cols();
+
+    auto copy_tiles = [&](int t) {
+        pin_current_thread(cpus.empty() ? -1 : cpus[t]);
+        for (int tile = t; tile < tiles; tile += workers) {
+            int end = std::min(dst.rows(), (tile + 1) * tile_rows);
+            for (int r = tile * tile_rows; r < end; ++r) {
+                std::memcpy(dst.data_ptr() + static_cast<size_t>(r) * dst.ld(),
+                            src.data_ptr() + static_cast<size_t>(r) * src.ld(), row_bytes);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < workers; ++t) {
+        threads.emplace_back(copy_tiles, t);
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bn2.h"
+#include "parking.h"
+#include "placement.h"
+#include "qr_params.h"
+
+// Reusable tiled factorization engine (libqr.a). The engine owns a pool of
+// workers that live as long as it does, and the task graph, queues and
+// Householder buffers of the last matrix shape, so a steady stream of
+// factorizations pays neither thread creation nor reallocation.
+//
+// factorize() may be called repeatedly and from any number of client
+// threads; jobs run one at a time, in the order the callers got the job
+// lock, each on all the workers it asks for. Nothing is global: engines are
+// independent of each other.
+//
+// factorize_batch() runs the task graphs of several matrices as one job:
+// the (0, 0) task of every matrix is ready at the start and all tasks share
+// the ready queues, so independent matrices fill each other's pipeline
+// bubbles. Each matrix has its own reflector storage.
+//
+// factorize_tsqr() is for matrices with many more columns than rows, whose
+// few task rows leave the panel chain serial: it factorizes blocks of
+// columns as one batch, then merges their L factors pairwise, again in
+// batches, up a binary tree.
+//
+// solve() adds a least-squares solve to the factorization job: the
+// reflectors of every pivot block are applied to the right-hand sides as
+// soon as they exist, and the back-substitution starts when the last row
+// of the matrix is factorized.
+//
+// Every entry point is a template on the scalar type, instantiated for
+// double and float (whose SIMD kernels hold twice the lanes and move half
+// the bytes). solve_mixed() factorizes in float and refines the solutions
+// in double.
+//
+// append_rows() takes new rows of A (observations) into the L of a
+// factorization, at a cost that grows with the rows appended and not with
+// the observations so far.
+//
+// factorize_streaming() starts on a matrix whose rows are still loading:
+// each task row is held back until its rows are in, so loading the input
+// overlaps with factorizing what has arrived.
+//
+// With params.offload (experimental), part of the type-2 updates of
+// factorize() and solve() run on a device (include/offload.h), in batches,
+// while the panels stay on the workers; the client thread drives the
+// device.
+//
+// factorize_out_of_core() factorizes a matrix mapped from a binary file
+// that need not fit in memory, keeping at most a budget of its tiles in.
+//
+// factorize_partitioned() runs the share of one process in a factorization
+// split over several (src/mpi_qr.cpp).
+
+// Householder data of a factorization, beside the factored matrix itself.
+template <class T>
+struct qr_factors_t {
+    std::vector<T> up;  // Per pivot row: the leading entry of its reflector.
+    std::vector<T> b;   // Per pivot row: the reflector's scale (0 for a zero row).
+    std::vector<T> t;   // update_t::wy: the ALPHA x ALPHA T factor of every panel.
+};
+
+// Reflectors of an append_rows() update.
+template <class T>
+struct qr_append_t {
+    matrix_t<T> tail;         // n x k: row p holds the entries of pivot p's reflector on the appended rows.
+    qr_factors_t<T> factors;  // up / b of every pivot of the update.
+};
+
+struct qr_run_stats_t {
+    double elapsed_ms = 0;  // First task pushed to last task done.
+    int matrices = 0;
+    int tasks = 0;
+    int workers = 0;
+    bool reused_graph = false;  // Every task graph of the previous job was re-armed, not rebuilt.
+    int refinement_steps = 0;   // solve_mixed(): corrections applied to the float solutions.
+    bool refinement_fallback = false;  // solve_mixed(): refinement stalled, solved again in double.
+    int offloaded_tasks = 0;    // --offload: updates run on the device.
+    double offload_bytes = 0;   // --offload: bytes moved to and from the device.
+    double load_ms = 0;         // factorize_streaming(): time spent in the loader.
+    int split_tasks = 0;        // --granularity adaptive: updates shared out in pieces.
+    int merged_tasks = 0;       // --granularity adaptive: updates run straight after the previous one of their tile.
+    int tile_loads = 0;         // factorize_out_of_core(): tiles brought into the budget.
+    int tile_evictions = 0;     // factorize_out_of_core(): tiles written back to make room.
+    size_t peak_resident_bytes = 0;  // factorize_out_of_core(): most tile bytes in the budget at once.
+};
+
+// Iterative refinement of solve_mixed().
+struct refinement_options_t {
+    int max_steps = 30;
+    double tolerance = 1e-12;  // Stop once every correction is below tolerance * |x| (max norms).
+};
+
+// The task rows one process works on in a factorization split over
+// several. The whole task graph still runs, but the tasks of the other
+// rows only pass their dependencies on, except the panel (type-1) tasks:
+// for a pivot block factorized elsewhere, wait_panel(j) must return once
+// its pivot rows (from column ALPHA * j on), up, b and T are in place.
+// The hooks are called by the workers: panel_done(j) when an owned panel
+// task of block j is done, block_done(j) once the panel of block j and
+// every owned update with it are.
+struct task_partition_t {
+    std::vector<char> owned;  // Per task row.
+    std::function<void(int)> panel_done;
+    std::function<void(int)> wait_panel;
+    std::function<void(int)> block_done;
+};
+
+class QREngine {
+public:
+    // Starts num_threads workers, pinned as the affinity policy says. Between
+    // jobs they wait as the idle policy says (spin, yield, then sleep).
+    explicit QREngine(int num_threads, const affinity_policy_t& affinity = affinity_policy_t(),
+                      const idle_policy_t& idle = idle_policy_t());
+    ~QREngine();
+
+    QREngine(const QREngine&) = delete;
+    QREngine& operator=(const QREngine&) = delete;
+
+    int num_threads() const;
+
+    // Factorizes mat in place with the tile shape, scheduler, kernels and
+    // update of params, on min(params.num_threads, num_threads()) workers.
+    // The pinning of params is ignored (the pool is pinned for good); its
+    // --perf and --trace outputs are written when the job ends. Throws
+    // std::invalid_argument for parameters that cannot be scheduled.
+    template <class T>
+    qr_run_stats_t factorize(matrix_t<T>& mat, const qr_params_t& params);
+
+    // As above, and hands the reflectors out in factors (resized as needed;
+    // pass the same object again to reuse its storage).
+    template <class T>
+    qr_run_stats_t factorize(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors);
+
+    // Factorizes mat as factorize() does while its rows are loaded. mat has
+    // its full shape but only its first loaded rows need to hold data.
+    // load(loaded) runs on the calling thread once the workers have
+    // started, and again until it returns mat.rows(): each call fills
+    // rows from loaded on and returns how many rows are in now. The first
+    // task of a task row (and so the whole row) waits until the BETA rows
+    // of the row have arrived; nothing else in the graph changes. If load
+    // throws, the job still runs to the end, over whatever the rows hold,
+    // and the exception is then rethrown. Throws std::invalid_argument
+    // with --batch, --tsqr or --offload (whose device also needs the
+    // calling thread).
+    template <class T>
+    qr_run_stats_t factorize_streaming(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors,
+                                       const std::function<int(int)>& load);
+
+    // Factorizes mat as factorize() does, for a matrix that is a shared
+    // mapping of a binary file (matrix_t::map_binary / create_binary) and
+    // may be larger than memory. Tiles of BETA rows are paged within
+    // params.memory_budget_mb MiB (include/tile_pager.h): a task's tile is
+    // prefetched when the task gets ready, or when a task it waits on
+    // starts; ready tasks whose tile is in run before those whose tile is
+    // not, which then make room by writing back the least recently used
+    // tiles; and a tile is written back for good once no task touches it
+    // again. The budget bounds what the pager keeps in, not the page cache:
+    // the kernel may keep more while memory is free. The result is the same
+    // as factorize()'s and is in the file when the call returns. Throws
+    // std::invalid_argument with --batch, --tsqr, --offload or --stream.
+    template <class T>
+    qr_run_stats_t factorize_out_of_core(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors);
+
+    // Factorizes every matrix of the batch in place as one job (shapes may
+    // differ); factors[k], if given, receives the reflectors of mats[k].
+    template <class T>
+    qr_run_stats_t factorize_batch(std::vector<matrix_t<T>>& mats, const qr_params_t& params);
+    template <class T>
+    qr_run_stats_t factorize_batch(std::vector<matrix_t<T>>& mats, const qr_params_t& params,
+                                   std::vector<qr_factors_t<T>>& factors);
+
+    // Computes only L of mat (rows x cols, cols >= rows) with a TSQR tree:
+    // the leaves are blocks of params.tsqr_leaf columns (at least rows; the
+    // last block takes the remainder), and every level factorizes the
+    // pairs [L_a L_b] of the one below. mat is overwritten with [L 0]. L
+    // agrees with factorize() up to the signs of its columns; the
+    // reflectors of the tree are not kept.
+    template <class T>
+    qr_run_stats_t factorize_tsqr(matrix_t<T>& mat, const qr_params_t& params);
+
+    // Least squares: mat holds A^T (A is cols x rows, cols >= rows, full
+    // rank) and every row of rhs a right-hand side b, with mat.cols()
+    // entries. Factorizes mat in place and overwrites each row of rhs with
+    // x = argmin |A x - b| in its first mat.rows() entries; the rest hold
+    // the residual in the basis of Q (their norm is |A x - b|).
+    template <class T>
+    qr_run_stats_t solve(matrix_t<T>& mat, matrix_t<T>& rhs, const qr_params_t& params);
+    template <class T>
+    qr_run_stats_t solve(matrix_t<T>& mat, matrix_t<T>& rhs, const qr_params_t& params,
+                         qr_factors_t<T>& factors);
+
+    // Appends rows to A after a factorization: mat holds a factorized A^T
+    // (n x m, m >= n, as factorize() or solve() leave it) and every row of
+    // rows is a new observation, a row of A with n entries. The L of mat
+    // (its lower n x n triangle) is updated in place to the L of [A; rows],
+    // up to the signs of its columns. The task graph has the shape of the
+    // factorization's, so it is re-armed rather than rebuilt, but its
+    // reflectors span only the diagonal and the new rows: k rows cost
+    // O(n^2 k), however many came before. The reflectors of the
+    // factorization (the rest of mat) are left as they are; those of the
+    // update are handed out in update (pass the same object again to reuse
+    // its storage). The generic kernels run whatever --simd / --update say.
+    template <class T>
+    qr_run_stats_t append_rows(matrix_t<T>& mat, const matrix_t<T>& rows, const qr_params_t& params);
+    template <class T>
+    qr_run_stats_t append_rows(matrix_t<T>& mat, const matrix_t<T>& rows, const qr_params_t& params,
+                               qr_append_t<T>& update);
+
+    // Least squares as solve(), for well-conditioned A: factorizes a float
+    // copy of mat (which is left as it is) and refines each x in double,
+    // with the float R, until its corrections fall below opts.tolerance.
+    // The refinement reaches the double solution when cond(A)^2 times the
+    // float epsilon is well below 1; should it stall, the problem is solved
+    // again in double (stats.refinement_fallback). Only the first
+    // mat.rows() entries of each row of rhs are written back; the rest are
+    // zeroed. elapsed_ms covers the whole call.
+    qr_run_stats_t solve_mixed(const matrix_t<double>& mat, matrix_t<double>& rhs, const qr_params_t& params,
+                               const refinement_options_t& opts = refinement_options_t());
+
+    // Factorizes the owned task rows of mat in place, with the reflectors
+    // of every pivot block in factors; the rows of the other task rows are
+    // left as they are, and read only for the pivot rows wait_panel
+    // delivers. A worker waiting for a panel is blocked, so a panel from
+    // elsewhere should be on its way before its task gets ready. Throws
+    // std::invalid_argument for --batch / --tsqr, or if partition.owned
+    // does not have one entry per task row.
+    template <class T>
+    qr_run_stats_t factorize_partitioned(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors,
+                                         task_partition_t& partition);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// Solves the least-squares problems of rhs (as QREngine::solve) with a
+// matrix that has already been factorized, sequentially.
+template <class T>
+void solve_factored(const matrix_t<T>& factored, const qr_factors_t<T>& factors, matrix_t<T>& rhs);
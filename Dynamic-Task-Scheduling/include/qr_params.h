@@ -0,0 +1,518 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+#include "bn2.h"
+#include "parking.h"
+#include "householder.h"
+#include "placement.h"
+
+// Where ready tasks are queued.
+enum class scheduler_t {
+    fifo,      // One global queue shared by all workers.
+    steal,     // One deque per worker: LIFO for the owner, FIFO for thieves.
+    priority,  // One bucket per rank: panel tasks first, then by bottom level.
+};
+
+inline const char* scheduler_name(scheduler_t s) {
+    switch (s) {
+        case scheduler_t::fifo:  return "fifo";
+        case scheduler_t::steal: return "steal";
+        case scheduler_t::priority: return "priority";
+    }
+    return "unknown";
+}
+
+inline scheduler_t parse_scheduler(const std::string& name) {
+    if (name == "fifo") {
+        return scheduler_t::fifo;
+    } else if (name == "steal") {
+        return scheduler_t::steal;
+    } else if (name == "priority") {
+        return scheduler_t::priority;
+    }
+    throw std::invalid_argument("Unknown scheduler: " + name);
+}
+
+// How a type-2 task applies the pivots of a panel.
+enum class update_t {
+    reflector,  // One reflector at a time (matrix-vector work).
+    wy,         // All at once as the compact WY block reflector I - V T V^T.
+};
+
+inline const char* update_name(update_t u) {
+    return u == update_t::wy ? "wy" : "reflector";
+}
+
+inline update_t parse_update(const std::string& name) {
+    if (name == "reflector") {
+        return update_t::reflector;
+    } else if (name == "wy") {
+        return update_t::wy;
+    }
+    throw std::invalid_argument("Unknown update mode: " + name);
+}
+
+// Scalar type the matrix is factorized in. Single precision runs the float
+// kernels on a float copy of the input.
+enum class precision_t {
+    f64,  // double
+    f32,  // float
+};
+
+inline const char* precision_name(precision_t p) {
+    return p == precision_t::f32 ? "single" : "double";
+}
+
+inline precision_t parse_precision(const std::string& name) {
+    if (name == "double") {
+        return precision_t::f64;
+    } else if (name == "single") {
+        return precision_t::f32;
+    }
+    throw std::invalid_argument("Unknown precision: " + name);
+}
+
+// Where type-2 updates may run besides the CPU workers (include/offload.h).
+enum class offload_device_t {
+    none,
+    emulated,  // Experimental stand-in for a device: a second copy of the matrix, CPU kernels, no overlap.
+};
+
+inline const char* offload_device_name(offload_device_t d) {
+    return d == offload_device_t::emulated ? "emulated" : "none";
+}
+
+inline offload_device_t parse_offload_device(const std::string& name) {
+    if (name == "none") {
+        return offload_device_t::none;
+    } else if (name == "emulated") {
+        return offload_device_t::emulated;
+    }
+    throw std::invalid_argument("Unknown offload device: " + name);
+}
+
+// How type-2 tasks are sized while the graph runs.
+enum class granularity_t {
+    fixed,     // One task per ALPHA x BETA tile, as TaskTable::init builds it.
+    adaptive,  // Split an update over idle workers while the ready queue is shallow;
+               // chain the updates of a tile while it is deep.
+};
+
+inline const char* granularity_name(granularity_t g) {
+    return g == granularity_t::adaptive ? "adaptive" : "fixed";
+}
+
+inline granularity_t parse_granularity(const std::string& name) {
+    if (name == "fixed") {
+        return granularity_t::fixed;
+    } else if (name == "adaptive") {
+        return granularity_t::adaptive;
+    }
+    throw std::invalid_argument("Unknown granularity: " + name);
+}
+
+inline const char* layout_name(matrix_layout_t l) {
+    return l == matrix_layout_t::padded ? "padded" : "row";
+}
+
+inline matrix_layout_t parse_layout(const std::string& name) {
+    if (name == "row") {
+        return matrix_layout_t::row_major;
+    } else if (name == "padded") {
+        return matrix_layout_t::padded;
+    }
+    throw std::invalid_argument("Unknown matrix layout: " + name);
+}
+
+inline simd_isa_t parse_simd_isa(const std::string& name) {
+    if (name == "auto") {
+        return simd_isa_t::automatic;
+    } else if (name == "scalar") {
+        return simd_isa_t::scalar;
+    } else if (name == "avx2") {
+        return simd_isa_t::avx2;
+    } else if (name == "avx512") {
+        return simd_isa_t::avx512;
+    }
+    throw std::invalid_argument("Unknown kernel ISA: " + name);
+}
+
+inline const char* huge_pages_name(huge_pages_t h) {
+    switch (h) {
+        case huge_pages_t::none:        return "none";
+        case huge_pages_t::transparent: return "thp";
+        case huge_pages_t::hugetlb:     return "hugetlb";
+    }
+    return "unknown";
+}
+
+inline huge_pages_t parse_huge_pages(const std::string& name) {
+    if (name == "none") {
+        return huge_pages_t::none;
+    } else if (name == "thp") {
+        return huge_pages_t::transparent;
+    } else if (name == "hugetlb") {
+        return huge_pages_t::hugetlb;
+    }
+    throw std::invalid_argument("Unknown huge page mode: " + name);
+}
+
+inline const char* numa_placement_name(numa_placement_t p) {
+    switch (p) {
+        case numa_placement_t::none:        return "none";
+        case numa_placement_t::interleave:  return "interleave";
+        case numa_placement_t::first_touch: return "first-touch";
+    }
+    return "unknown";
+}
+
+inline numa_placement_t parse_numa_placement(const std::string& name) {
+    if (name == "none") {
+        return numa_placement_t::none;
+    } else if (name == "interleave") {
+        return numa_placement_t::interleave;
+    } else if (name == "first-touch") {
+        return numa_placement_t::first_touch;
+    }
+    throw std::invalid_argument("Unknown NUMA placement: " + name);
+}
+
+inline std::string affinity_name(const affinity_policy_t& a) {
+    switch (a.kind) {
+        case affinity_t::none:    return "none";
+        case affinity_t::compact: return "compact";
+        case affinity_t::scatter: return "scatter";
+        case affinity_t::list:    break;
+    }
+    std::string list;
+    for (int cpu : a.cpus) {
+        list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return list;
+}
+
+// "none", "compact", "scatter" or an explicit CPU list such as "0-3,8".
+inline affinity_policy_t parse_affinity(const std::string& name) {
+    affinity_policy_t policy;
+    if (name == "none") {
+        policy.kind = affinity_t::none;
+    } else if (name == "compact") {
+        policy.kind = affinity_t::compact;
+    } else if (name == "scatter") {
+        policy.kind = affinity_t::scatter;
+    } else {
+        policy.kind = affinity_t::list;
+        policy.cpus = parse_id_list(name);
+        if (policy.cpus.empty()) {
+            throw std::invalid_argument("Unknown affinity: " + name);
+        }
+    }
+    return policy;
+}
+
+// Run-time parameters of a factorization. These used to be the NUM_THREADS,
+// ALPHA and BETA macros of main.cpp / barrier_main.cpp.
+struct qr_params_t {
+    int num_threads = 28;   // Number of worker threads.
+    int alpha = 4;          // Pivots per task (width of a panel).
+    int beta = 16;          // Matrix rows per task (height of a tile).
+    scheduler_t scheduler = scheduler_t::fifo;
+    idle_policy_t idle;     // What workers do while no task is ready.
+    simd_isa_t simd = simd_isa_t::automatic;  // Instruction set of the kernels.
+    update_t update = update_t::reflector;
+    precision_t precision = precision_t::f64;  // For the drivers; the engine follows the matrix type.
+    matrix_layout_t layout = matrix_layout_t::padded;  // Storage of the matrix while it is factorized.
+    alloc_policy_t alloc;          // Huge pages and NUMA placement of the matrix.
+    affinity_policy_t affinity;    // CPU each worker is pinned to.
+    std::string trace;             // Output prefix of the task trace (built with TRACE=1), empty for none.
+    int trace_capacity = 1 << 18;  // Trace events kept per worker.
+    std::string perf;              // perf_event counter report ("-" for stdout), empty for none.
+    std::string label;             // Name of the input in reports (the matrix file).
+    int batch = 1;                 // Copies of the input factorized as one batched job.
+    int tsqr_leaf = 0;             // Columns per TSQR leaf block (0: factorize the matrix as a whole).
+    std::string tune_db;           // Tuning database to take ALPHA / BETA from (include/tuning.h), empty for none.
+    bool shape_given = false;      // --alpha or --beta was given; they win over the tuning database.
+    offload_device_t offload = offload_device_t::none;
+    int offload_batch = 16;        // Most ready updates shipped to the device at once.
+    double offload_share = -1;     // Fraction of the updates sent to the device; < 0: from measured throughput.
+    int stream_rows = 0;           // Rows loaded per step while factorizing (main.cpp); 0: load, then factorize.
+    granularity_t granularity = granularity_t::fixed;
+    int split_rows = 0;            // --granularity adaptive: fewest matrix rows in a piece of an update; 0: ALPHA.
+    int merge_depth = 4;           // --granularity adaptive: ready tasks per worker from which updates chain.
+    std::string out_of_core;       // Binary store the matrix is factorized in, out of core (main.cpp); empty for none.
+    int memory_budget_mb = 1024;   // --out-of-core: MiB of matrix tiles kept in memory.
+
+    int beta_div_alpha() const { return beta / alpha; }
+
+    // Number of task rows / columns for a rows x cols matrix: one task row
+    // per BETA matrix rows, one task column per ALPHA of its min(rows, cols)
+    // pivots.
+    int task_rows(int rows) const { return (rows + beta - 1) / beta; }
+    int task_cols(int rows, int cols) const { return (std::min(rows, cols) + alpha - 1) / alpha; }
+
+    // Throws std::invalid_argument if the tile shape cannot be scheduled.
+    void validate() const {
+        if (num_threads < 1) {
+            throw std::invalid_argument("Number of threads must be at least 1.");
+        }
+        if (alpha < 1 || beta < 1) {
+            throw std::invalid_argument("ALPHA and BETA must be positive.");
+        }
+        if (idle.spin < 0 || idle.yield < 0) {
+            throw std::invalid_argument("Idle spin and yield counts must not be negative.");
+        }
+        if (!simd_isa_supported(simd)) {
+            throw std::invalid_argument(std::string("No ") + simd_isa_name(simd) + " kernels for this CPU and build.");
+        }
+        if (batch < 1) {
+            throw std::invalid_argument("Batch size must be at least 1.");
+        }
+        if (tsqr_leaf < 0) {
+            throw std::invalid_argument("TSQR leaf width must not be negative.");
+        }
+        if (tsqr_leaf > 0 && batch > 1) {
+            throw std::invalid_argument("--tsqr and --batch cannot be combined.");
+        }
+        if (trace_capacity < 1) {
+            throw std::invalid_argument("Trace capacity must be at least 1.");
+        }
+        if (offload != offload_device_t::none) {
+            if (scheduler == scheduler_t::steal) {
+                throw std::invalid_argument("--offload needs --sched fifo or priority (the device cannot push "
+                                            "to the worker deques).");
+            }
+            if (batch > 1 || tsqr_leaf > 0) {
+                throw std::invalid_argument("--offload cannot be combined with --batch or --tsqr.");
+            }
+            if (offload_batch < 1 || offload_share > 1) {
+                throw std::invalid_argument("--offload-batch must be at least 1 and --offload-share at most 1.");
+            }
+        }
+        if (stream_rows < 0) {
+            throw std::invalid_argument("--stream must not be negative.");
+        }
+        if (stream_rows > 0 && (batch > 1 || tsqr_leaf > 0 || offload != offload_device_t::none ||
+                                alloc.numa == numa_placement_t::first_touch)) {
+            throw std::invalid_argument("--stream cannot be combined with --batch, --tsqr, --offload or "
+                                        "--numa first-touch.");
+        }
+        if (split_rows < 0 || merge_depth < 1) {
+            throw std::invalid_argument("--split-rows must not be negative and --merge-depth must be at least 1.");
+        }
+        if (granularity == granularity_t::adaptive && offload != offload_device_t::none) {
+            throw std::invalid_argument("--granularity adaptive cannot be combined with --offload.");
+        }
+        if (memory_budget_mb < 1) {
+            throw std::invalid_argument("--memory-budget must be at least 1 MiB.");
+        }
+        if (!out_of_core.empty() && (batch > 1 || tsqr_leaf > 0 || offload != offload_device_t::none ||
+                                     stream_rows > 0 || alloc.huge_pages != huge_pages_t::none ||
+                                     alloc.numa != numa_placement_t::none)) {
+            throw std::invalid_argument("--out-of-core cannot be combined with --batch, --tsqr, --offload, "
+                                        "--stream, --huge or --numa (the store's pages are the file's).");
+        }
+        if (beta < alpha || beta % alpha != 0) {
+            throw std::invalid_argument("BETA must be a multiple of ALPHA, got ALPHA=" +
+                                        std::to_string(alpha) + ", BETA=" + std::to_string(beta) + ".");
+        }
+    }
+};
+
+// The parameters that shape a run, as name / value pairs for reports.
+inline std::vector<std::pair<std::string, std::string>> describe_qr_params(const qr_params_t& p) {
+    return {
+        {"threads", std::to_string(p.num_threads)},
+        {"alpha", std::to_string(p.alpha)},
+        {"beta", std::to_string(p.beta)},
+        {"sched", scheduler_name(p.scheduler)},
+        {"simd", simd_isa_name(p.simd == simd_isa_t::automatic ? detect_simd_isa() : p.simd)},
+        {"update", update_name(p.update)},
+        {"precision", precision_name(p.precision)},
+        {"layout", layout_name(p.layout)},
+        {"huge", huge_pages_name(p.alloc.huge_pages)},
+        {"numa", numa_placement_name(p.alloc.numa)},
+        {"affinity", affinity_name(p.affinity)},
+        {"offload", offload_device_name(p.offload)},
+        {"granularity", granularity_name(p.granularity)},
+    };
+}
+
+inline void print_qr_usage(const char* prog, std::ostream& os = std::cerr) {
+    os << "Usage: " << prog << " <filename> [options]\n"
+       << "  -t, --threads N   number of worker threads\n"
+       << "  -a, --alpha A     pivots per task\n"
+       << "  -b, --beta B      matrix rows per task (multiple of ALPHA)\n"
+       << "  -s, --sched S     ready queue: fifo (global queue), steal (per-worker deques)\n"
+       << "                    or priority (panel tasks first, then critical path)\n"
+       << "  --idle MODE       idle workers: park (spin, yield, then sleep) or spin (never sleep)\n"
+       << "  --idle-spin N     polls spent spinning before yielding\n"
+       << "  --idle-yield N    polls spent yielding before sleeping\n"
+       << "  --simd ISA        kernels: auto (best the CPU supports), scalar, avx2 or avx512\n"
+       << "  --update MODE     type-2 update: reflector (one at a time) or wy (compact WY block)\n"
+       << "  --precision P     factorize in double or single (a float copy of the matrix)\n"
+       << "  --layout L        matrix storage: padded (cache-line aligned rows) or row (as in the file)\n"
+       << "  --huge MODE       huge pages for the matrix: none, thp (transparent) or hugetlb (reserved)\n"
+       << "  --numa MODE       matrix pages: none, interleave (over all nodes) or first-touch (by tile owner)\n"
+       << "  --affinity A      worker pinning: none, compact, scatter or a CPU list such as 0-3,8\n"
+       << "  --trace PREFIX    write PREFIX.json (Chrome trace) and PREFIX.csv (needs make TRACE=1)\n"
+       << "  --trace-capacity N  trace events kept per worker\n"
+       << "  --perf FILE       append per-run hardware counter totals as JSON to FILE (- for stdout)\n"
+       << "  --batch N         factorize N copies of the matrix as one batched job\n"
+       << "  --tsqr W          only compute L, by a TSQR tree over blocks of W columns\n"
+       << "  --tune-db FILE    take ALPHA and BETA from a tuning database unless given\n"
+       << "  --offload D       experimental: also run type-2 updates on a device: none or emulated\n"
+       << "                    (a stand-in that runs the CPU kernels on a copy of the matrix)\n"
+       << "  --offload-batch N most ready updates shipped to the device at once\n"
+       << "  --offload-share F fraction of the updates for the device (default: by measured throughput)\n"
+       << "  --stream N        start factorizing while the file loads, N rows per step (0: load first)\n"
+       << "  --granularity G   type-2 tasks: fixed (one per tile) or adaptive (split while workers idle,\n"
+       << "                    chained while the ready queue is deep)\n"
+       << "  --split-rows N    adaptive: fewest matrix rows per piece of a split update (default ALPHA)\n"
+       << "  --merge-depth N   adaptive: ready tasks per worker from which a tile's updates chain\n"
+       << "  --out-of-core F   factorize in the binary store F (created from the input), paging tiles\n"
+       << "                    in and out of memory; the result stays in F\n"
+       << "  --memory-budget N --out-of-core: MiB of matrix tiles kept in memory (default 1024)\n";
+}
+
+inline int parse_int_option(const std::string& opt, const char* value) {
+    try {
+        size_t pos = 0;
+        int result = std::stoi(value, &pos);
+        if (value[pos] == '\0') {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw std::invalid_argument("Invalid value for option " + opt + ": " + value);
+}
+
+inline double parse_double_option(const std::string& opt, const char* value) {
+    try {
+        size_t pos = 0;
+        double result = std::stod(value, &pos);
+        if (value[pos] == '\0') {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw std::invalid_argument("Invalid value for option " + opt + ": " + value);
+}
+
+// Parses the options following the positional <filename> argument.
+// Unknown options and malformed values throw std::invalid_argument.
+inline void parse_qr_params(int argc, char* argv[], qr_params_t& params) {
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for option " + opt + ".");
+        }
+        const char* value = argv[++i];
+
+        if (opt == "-t" || opt == "--threads") {
+            params.num_threads = parse_int_option(opt, value);
+        } else if (opt == "-a" || opt == "--alpha") {
+            params.alpha = parse_int_option(opt, value);
+            params.shape_given = true;
+        } else if (opt == "-b" || opt == "--beta") {
+            params.beta = parse_int_option(opt, value);
+            params.shape_given = true;
+        } else if (opt == "-s" || opt == "--sched") {
+            params.scheduler = parse_scheduler(value);
+        } else if (opt == "--idle") {
+            std::string mode = value;
+            if (mode != "park" && mode != "spin") {
+                throw std::invalid_argument("Unknown idle mode: " + mode);
+            }
+            params.idle.park = mode == "park";
+        } else if (opt == "--idle-spin") {
+            params.idle.spin = parse_int_option(opt, value);
+        } else if (opt == "--idle-yield") {
+            params.idle.yield = parse_int_option(opt, value);
+        } else if (opt == "--simd") {
+            params.simd = parse_simd_isa(value);
+        } else if (opt == "--update") {
+            params.update = parse_update(value);
+        } else if (opt == "--precision") {
+            params.precision = parse_precision(value);
+        } else if (opt == "--layout") {
+            params.layout = parse_layout(value);
+        } else if (opt == "--huge") {
+            params.alloc.huge_pages = parse_huge_pages(value);
+        } else if (opt == "--numa") {
+            params.alloc.numa = parse_numa_placement(value);
+        } else if (opt == "--affinity") {
+            params.affinity = parse_affinity(value);
+        } else if (opt == "--trace") {
+            params.trace = value;
+        } else if (opt == "--trace-capacity") {
+            params.trace_capacity = parse_int_option(opt, value);
+        } else if (opt == "--batch") {
+            params.batch = parse_int_option(opt, value);
+        } else if (opt == "--tune-db") {
+            params.tune_db = value;
+        } else if (opt == "--tsqr") {
+            params.tsqr_leaf = parse_int_option(opt, value);
+        } else if (opt == "--perf") {
+            params.perf = value;
+        } else if (opt == "--offload") {
+            params.offload = parse_offload_device(value);
+        } else if (opt == "--offload-batch") {
+            params.offload_batch = parse_int_option(opt, value);
+        } else if (opt == "--offload-share") {
+            params.offload_share = parse_double_option(opt, value);
+        } else if (opt == "--stream") {
+            params.stream_rows = parse_int_option(opt, value);
+        } else if (opt == "--granularity") {
+            params.granularity = parse_granularity(value);
+        } else if (opt == "--split-rows") {
+            params.split_rows = parse_int_option(opt, value);
+        } else if (opt == "--merge-depth") {
+            params.merge_depth = parse_int_option(opt, value);
+        } else if (opt == "--out-of-core") {
+            params.out_of_core = value;
+        } else if (opt == "--memory-budget") {
+            params.memory_budget_mb = parse_int_option(opt, value);
+        } else {
+            throw std::invalid_argument("Unknown option: " + opt);
+        }
+    }
+    params.validate();
+}
+
+// Loads the input matrix with the layout and allocation policy of params.
+// With first-touch placement the file is read into a staging copy, and each
+// BETA-row tile is then copied by a thread pinned to the CPU of the worker
+// that owns it (tile i belongs to worker i % num_threads), so that its pages
+// land on that worker's node.
+inline matrix_t<double> load_qr_matrix(const std::string& filename, const qr_params_t& params) {
+    if (params.alloc.numa != numa_placement_t::first_touch) {
+        return matrix_t<double>(filename, params.layout, params.alloc);
+    }
+    matrix_t<double> staging(filename);
+    matrix_t<double> placed(staging.rows(), staging.cols(), params.layout, params.alloc);
+    first_touch_copy(placed, staging, params.beta, affinity_map(params.affinity, params.num_threads));
+    return placed;
+}
+
+// Parses a generated matrix, "random:N" or "random:RxC", into rows and
+// cols; false for a file name. The drivers each have their generator.
+inline bool parse_random_spec(const std::string& spec, int& rows, int& cols) {
+    const std::string prefix = "random:";
+    if (spec.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    std::string shape = spec.substr(prefix.size());
+    size_t x = shape.find('x');
+    rows = parse_int_option(spec, shape.substr(0, x).c_str());
+    cols = x == std::string::npos ? rows : parse_int_option(spec, shape.substr(x + 1).c_str());
+    if (rows < 1 || cols < 1) {
+        throw std::invalid_argument("Invalid matrix shape: " + spec);
+    }
+    return true;
+}
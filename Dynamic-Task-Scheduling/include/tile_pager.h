@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Which BETA-row tiles of a file-mapped matrix (matrix_t::map_binary) are
+// meant to be in memory, for QREngine::factorize_out_of_core(). The pager
+// only advises the kernel: a tile that is not resident is still read on
+// first touch, and one that is dropped while in use is read back, so the
+// factorization is the same whatever the budget. What the pager decides is
+// how much of the matrix is in memory at once:
+// - admit(i) asks for tile i ahead of its task (MADV_WILLNEED) while the
+//   resident tiles stay within the budget;
+// - load(i) makes room for tile i by writing back and dropping the least
+//   recently used others;
+// - finish(i) writes back and drops a tile that no task touches again.
+// The calls are thread-safe.
+class TilePager {
+public:
+    // rows matrix rows of row_bytes each from base, in tiles of beta rows.
+    TilePager(void* base, size_t row_bytes, int rows, int beta, size_t budget_bytes)
+        : base_(static_cast<char*>(base)), row_bytes_(row_bytes), rows_(rows), beta_(beta),
+          tiles_((rows + beta - 1) / beta), budget_(budget_bytes),
+          state_(new std::atomic<uint8_t>[tiles_]), last_use_(new std::atomic<uint64_t>[tiles_]) {
+        for (int i = 0; i < tiles_; ++i) {
+            state_[i].store(cold, std::memory_order_relaxed);
+            last_use_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    TilePager(const TilePager&) = delete;
+    TilePager& operator=(const TilePager&) = delete;
+
+    int tiles() const { return tiles_; }
+
+    bool resident(int i) const { return state_[i].load(std::memory_order_acquire) == hot; }
+
+    // True if tile i is resident, or now is because it fits in the budget.
+    bool admit(int i) {
+        if (resident(i)) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_[i].load(std::memory_order_relaxed) == hot) {
+            return true;
+        }
+        if (resident_bytes_ + tile_bytes(i) > budget_) {
+            return false;
+        }
+        bring_in(i);
+        return true;
+    }
+
+    // Makes tile i resident, evicting others to stay within the budget.
+    void load(int i) {
+        if (resident(i)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_[i].load(std::memory_order_relaxed) == hot) {
+            return;
+        }
+        while (resident_bytes_ + tile_bytes(i) > budget_) {
+            int victim = -1;
+            for (int k = 0; k < tiles_; ++k) {
+                if (k != i && state_[k].load(std::memory_order_relaxed) == hot &&
+                    (victim < 0 || last_use_[k].load(std::memory_order_relaxed) <
+                                       last_use_[victim].load(std::memory_order_relaxed))) {
+                    victim = k;
+                }
+            }
+            if (victim < 0) {
+                break;  // A tile larger than the budget is loaded alone.
+            }
+            drop(victim, cold);
+            evictions_++;
+        }
+        bring_in(i);
+    }
+
+    // A task is about to run on tile i.
+    void touch(int i) {
+        last_use_[i].store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    // No task touches tile i again.
+    void finish(int i) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_[i].load(std::memory_order_relaxed) != done) {
+            drop(i, done);
+        }
+    }
+
+    // Writes back and drops every tile still in memory.
+    void finish_all() {
+        for (int i = 0; i < tiles_; ++i) {
+            finish(i);
+        }
+    }
+
+    int loads() const { return loads_; }
+    int evictions() const { return evictions_; }
+    size_t peak_bytes() const { return peak_bytes_; }
+
+    // Writes rows [first, last) back to the file and drops their pages, for
+    // filling a mapped matrix that does not fit in memory.
+    static void write_back(void* base, size_t row_bytes, int first, int last) {
+        char* begin = static_cast<char*>(base) + first * row_bytes;
+        char* end = static_cast<char*>(base) + last * row_bytes;
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        char* sync = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(begin) / page * page);
+        if (end > sync) {
+            msync(sync, end - sync, MS_SYNC);
+        }
+        // Only the pages wholly inside the rows, which no other tile shares.
+        char* first_page = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(begin) + page - 1) / page * page);
+        char* last_page = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(end) / page * page);
+        if (last_page > first_page) {
+#ifdef MADV_PAGEOUT
+            madvise(first_page, last_page - first_page, MADV_PAGEOUT);
+#else
+            madvise(first_page, last_page - first_page, MADV_DONTNEED);
+#endif
+        }
+    }
+
+private:
+    static constexpr uint8_t cold = 0;  // On disk (perhaps partly cached).
+    static constexpr uint8_t hot = 1;   // Counted in the budget.
+    static constexpr uint8_t done = 2;  // Written back for good.
+
+    int first_row(int i) const { return i * beta_; }
+    int last_row(int i) const { return std::min((i + 1) * beta_, rows_); }
+    size_t tile_bytes(int i) const { return (last_row(i) - first_row(i)) * row_bytes_; }
+
+    // With mutex_ held.
+    void bring_in(int i) {
+        char* begin = base_ + first_row(i) * row_bytes_;
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        char* aligned = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(begin) / page * page);
+        madvise(aligned, base_ + last_row(i) * row_bytes_ - aligned, MADV_WILLNEED);
+        resident_bytes_ += tile_bytes(i);
+        peak_bytes_ = std::max(peak_bytes_, resident_bytes_);
+        loads_++;
+        state_[i].store(hot, std::memory_order_release);
+    }
+
+    // With mutex_ held.
+    void drop(int i, uint8_t next) {
+        if (state_[i].load(std::memory_order_relaxed) == hot) {
+            resident_bytes_ -= tile_bytes(i);
+        }
+        state_[i].store(next, std::memory_order_release);
+        write_back(base_, row_bytes_, first_row(i), last_row(i));
+    }
+
+    char* base_;
+    size_t row_bytes_;
+    int rows_;
+    int beta_;
+    int tiles_;
+    size_t budget_;
+    std::unique_ptr<std::atomic<uint8_t>[]> state_;
+    std::unique_ptr<std::atomic<uint64_t>[]> last_use_;
+    std::atomic<uint64_t> clock_{1};
+    std::mutex mutex_;
+    size_t resident_bytes_ = 0;
+    size_t peak_bytes_ = 0;
+    int loads_ = 0;
+    int evictions_ = 0;
+};
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bn2.h"
+
+// Per-task execution tracing. The scheduler hooks in src/qr_engine.cpp are
+// compiled only with QR_TRACE=1 (make TRACE=1) and cost nothing otherwise;
+// the buffers, exporters and analysis below are plain code either way.
+
+#ifndef QR_TRACE
+#define QR_TRACE 0
+#endif
+
+#if QR_TRACE
+#define QR_TRACE_ONLY(...) __VA_ARGS__
+#else
+#define QR_TRACE_ONLY(...)
+#endif
+
+// Nanoseconds on the steady clock.
+inline uint64_t trace_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct trace_event_t {
+    int32_t i;            // chunk_idx_i of the task.
+    int32_t j;            // chunk_idx_j of the task.
+    uint8_t type;         // 1 or 2 (3 and 4 in a least-squares solve).
+    int32_t worker;       // Thread that ran it.
+    uint64_t release_ns;  // Last predecessor completed (pushed to a ready queue).
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int32_t matrix = 0;   // Index of the task's matrix in a batched job.
+};
+
+// Ring of the most recent events of one worker. Only its worker writes it,
+// so recording is a store and an increment; it is read after the join.
+class alignas(64) TraceBuffer {
+    std::vector<trace_event_t> events;
+    uint64_t next = 0;
+    size_t mask = 0;
+
+public:
+    // The capacity is rounded up to a power of two.
+    explicit TraceBuffer(size_t capacity = 1024) {
+        size_t cap = 1;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        events.resize(cap);
+        mask = cap - 1;
+    }
+
+    void record(const trace_event_t& e) {
+        events[next & mask] = e;
+        ++next;
+    }
+
+    size_t capacity() const { return events.size(); }
+
+    // Events overwritten because the ring was full.
+    uint64_t dropped() const { return next > events.size() ? next - events.size() : 0; }
+
+    // Kept events, oldest first.
+    std::vector<trace_event_t> snapshot() const {
+        std::vector<trace_event_t> out;
+        for (uint64_t k = dropped(); k < next; ++k) {
+            out.push_back(events[k & mask]);
+        }
+        return out;
+    }
+};
+
+// Events of all workers ordered by start time, timestamps relative to origin_ns.
+inline std::vector<trace_event_t> collect_trace(const std::vector<TraceBuffer>& buffers, uint64_t origin_ns) {
+    std::vector<trace_event_t> all;
+    for (const TraceBuffer& b : buffers) {
+        for (trace_event_t e : b.snapshot()) {
+            e.release_ns = e.release_ns > origin_ns ? e.release_ns - origin_ns : 0;
+            e.start_ns -= origin_ns;
+            e.end_ns -= origin_ns;
+            all.push_back(e);
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const trace_event_t& a, const trace_event_t& b) {
+        return a.start_ns < b.start_ns;
+    });
+    return all;
+}
+
+// Chrome trace event format (chrome://tracing, Perfetto): one complete event
+// per task on the row of its worker, timestamps in microseconds.
+inline void write_chrome_trace(const std::string& filename, const std::vector<trace_event_t>& events, int num_workers) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        throw std::runtime_error("Error opening file for writing: " + filename);
+    }
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    for (int w = 0; w < num_workers; ++w) {
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << w
+            << ",\"args\":{\"name\":\"worker " << w << "\"}},\n";
+    }
+    for (size_t k = 0; k < events.size(); ++k) {
+        const trace_event_t& e = events[k];
+        out << "{\"ph\":\"X\",\"name\":\"T" << int(e.type) << "(" << e.i << "," << e.j << ")\""
+            << ",\"cat\":\"type" << int(e.type) << "\",\"pid\":0,\"tid\":" << e.worker
+            << ",\"ts\":" << e.start_ns / 1e3 << ",\"dur\":" << (e.end_ns - e.start_ns) / 1e3
+            << ",\"args\":{\"matrix\":" << e.matrix << ",\"i\":" << e.i << ",\"j\":" << e.j
+            << ",\"release_us\":" << e.release_ns / 1e3
+            << ",\"queue_us\":" << (e.start_ns - std::min(e.start_ns, e.release_ns)) / 1e3 << "}}"
+            << (k + 1 < events.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    if (out.fail()) {
+        throw std::runtime_error("Error writing trace to file: " + filename);
+    }
+}
+
+inline void write_trace_csv(const std::string& filename, const std::vector<trace_event_t>& events) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        throw std::runtime_error("Error opening file for writing: " + filename);
+    }
+    out << "worker,i,j,type,release_ns,start_ns,end_ns,matrix\n";
+    for (const trace_event_t& e : events) {
+        out << e.worker << "," << e.i << "," << e.j << "," << int(e.type) << ","
+            << e.release_ns << "," << e.start_ns << "," << e.end_ns << "," << e.matrix << "\n";
+    }
+    if (out.fail()) {
+        throw std::runtime_error("Error writing trace to file: " + filename);
+    }
+}
+
+struct trace_summary_t {
+    uint64_t makespan_ns = 0;       // First start to last end.
+    uint64_t critical_path_ns = 0;  // Longest chain of measured task times through the graph.
+    uint64_t busy_ns = 0;           // Sum of task times.
+    double mean_queue_ns = 0;       // Release to start.
+    uint64_t max_queue_ns = 0;
+    std::vector<uint64_t> idle_ns;  // Per worker: makespan minus its task time.
+    size_t events = 0;
+};
+
+// Analysis of a complete trace (no dropped events) against the task graphs
+// of its matrices (tables[k] for the events of matrix k). The critical path
+// is the longest of the matrices' own.
+inline trace_summary_t summarize_trace(const std::vector<trace_event_t>& events,
+                                       const std::vector<const TaskTable*>& tables, int num_workers) {
+    trace_summary_t s;
+    s.events = events.size();
+    s.idle_ns.assign(num_workers, 0);
+    if (events.empty()) {
+        return s;
+    }
+
+    std::vector<size_t> offset(tables.size() + 1, 0);
+    for (size_t k = 0; k < tables.size(); ++k) {
+        offset[k + 1] = offset[k] + static_cast<size_t>(tables[k]->rows()) * tables[k]->cols();
+    }
+
+    uint64_t first = UINT64_MAX, last = 0;
+    std::vector<uint64_t> busy(num_workers, 0);
+    std::vector<uint64_t> duration(offset.back(), 0);
+    double queue_sum = 0;
+    for (const trace_event_t& e : events) {
+        uint64_t d = e.end_ns - e.start_ns;
+        uint64_t q = e.start_ns - std::min(e.start_ns, e.release_ns);
+        first = std::min(first, e.start_ns);
+        last = std::max(last, e.end_ns);
+        busy[e.worker] += d;
+        s.busy_ns += d;
+        queue_sum += q;
+        s.max_queue_ns = std::max(s.max_queue_ns, q);
+        duration[offset[e.matrix] + static_cast<size_t>(e.i) * tables[e.matrix]->cols() + e.j] = d;
+    }
+    s.makespan_ns = last - first;
+    s.mean_queue_ns = queue_sum / events.size();
+    for (int w = 0; w < num_workers; ++w) {
+        s.idle_ns[w] = s.makespan_ns > busy[w] ? s.makespan_ns - busy[w] : 0;
+    }
+
+    // Row-major order is topological: predecessors of (i, j) are (i, j-1)
+    // and tasks of earlier rows (a type-1 task, or for a type-4 task the last
+    // task of every matrix row).
+    std::vector<uint64_t> finish(duration.size(), 0);
+    for (size_t m = 0; m < tables.size(); ++m) {
+        const TaskTable& table = *tables[m];
+        for (int i = 0; i < table.rows(); ++i) {
+            for (int j = 0; j < table.cols(); ++j) {
+                const Task* t = table.getTask(i, j);
+                if (t == nullptr) {
+                    continue;
+                }
+                size_t k = offset[m] + static_cast<size_t>(i) * table.cols() + j;
+                finish[k] += duration[k];
+                s.critical_path_ns = std::max(s.critical_path_ns, finish[k]);
+                for (const Task* next : t->successors) {
+                    size_t kn = offset[m] + static_cast<size_t>(next->chunk_idx_i) * table.cols() + next->chunk_idx_j;
+                    finish[kn] = std::max(finish[kn], finish[k]);
+                }
+            }
+        }
+    }
+    return s;
+}
+
+inline trace_summary_t summarize_trace(const std::vector<trace_event_t>& events, const TaskTable& table,
+                                       int num_workers) {
+    return summarize_trace(events, std::vector<const TaskTable*>{&table}, num_workers);
+}
+
+inline void print_trace_summary(const trace_summary_t& s, uint64_t dropped, std::ostream& os) {
+    uint64_t idle = 0;
+    for (uint64_t v : s.idle_ns) {
+        idle += v;
+    }
+    os << std::fixed << std::setprecision(3)
+       << "Trace: " << s.events << " tasks";
+    if (dropped > 0) {
+        os << " (" << dropped << " dropped, raise --trace-capacity)";
+    }
+    os << "\n  makespan       " << s.makespan_ns / 1e6 << " ms"
+       << "\n  critical path  " << s.critical_path_ns / 1e6 << " ms"
+       << "\n  task time      " << s.busy_ns / 1e6 << " ms"
+       << "\n  idle time      " << idle / 1e6 << " ms over " << s.idle_ns.size() << " workers";
+    if (!s.idle_ns.empty()) {
+        os << " (max " << *std::max_element(s.idle_ns.begin(), s.idle_ns.end()) / 1e6 << " ms)";
+    }
+    os << "\n  queueing delay mean " << s.mean_queue_ns / 1e3 << " us, max " << s.max_queue_ns / 1e3 << " us\n";
+}
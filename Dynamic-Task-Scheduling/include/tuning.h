@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "qr_engine.h"
+
+// Tile shape tuning. A TuningDB maps (CPU model, scheduler, matrix shape,
+// threads) to the best ALPHA / BETA measured for it. a.out --tune-db FILE
+// takes its tile shape from the database unless --alpha / --beta are given;
+// bench.out --tune FILE measures a shape and records it.
+//
+// The file is CSV with a header line:
+//   rows,cols,threads,sched,alpha,beta,time_ms,cpu
+// (cpu last, as the rest of the line, since model names contain commas).
+// A results/fig3_best_by_size_threads.csv written by experiment1b.py is
+// read as well; its rows are taken as measured on this CPU.
+
+struct tuning_entry_t {
+    int rows = 0;
+    int cols = 0;
+    int threads = 0;
+    std::string sched;     // scheduler_name(), or "barrier".
+    int alpha = 0;
+    int beta = 0;
+    double time_ms = 0;    // Median time of the shape when it was measured.
+    std::string cpu;
+};
+
+class TuningDB {
+public:
+    // Reads path; a file that does not exist gives an empty database.
+    // Throws std::runtime_error for a file that cannot be parsed.
+    static TuningDB load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // Adds e, replacing the entry of the same key.
+    void record(const tuning_entry_t& e);
+
+    // The entry for this key, or failing that the nearest one of the same
+    // CPU and scheduler: the smallest sum of |log ratio| of rows, cols and
+    // threads. nullptr if there is none.
+    const tuning_entry_t* lookup(const std::string& cpu, const std::string& sched, int rows, int cols,
+                                 int threads) const;
+
+    const std::vector<tuning_entry_t>& entries() const { return entries_; }
+
+private:
+    std::vector<tuning_entry_t> entries_;
+};
+
+// The "model name" of /proc/cpuinfo, or "unknown".
+std::string cpu_model_name();
+
+// Sets params.alpha / beta from db for a rows x cols matrix. Returns the
+// entry used, or nullptr (params unchanged).
+const tuning_entry_t* apply_tuned_shape(const TuningDB& db, qr_params_t& params, int rows, int cols);
+
+struct tuning_options_t {
+    std::vector<int> alphas = {2, 4, 8, 16, 32};
+    std::vector<int> betas = {4, 8, 16, 32, 64};  // Pairs with BETA % ALPHA != 0 are skipped.
+    int warmup = 1;        // Untimed runs of every candidate, before its first round.
+    int first_reps = 1;    // Timed runs per candidate in the first round; doubled every round.
+};
+
+struct tuning_result_t {
+    int alpha = 0;
+    int beta = 0;
+    double time_ms = 0;    // Median of the winner's timed runs.
+    int candidates = 0;
+    int rounds = 0;
+    int runs = 0;          // Timed factorizations, over all rounds.
+};
+
+// Successive halving over the (ALPHA, BETA) pairs of opts with the other
+// settings of params: every round times each remaining candidate on a fresh
+// copy of input and keeps the faster half (by median of all its runs so
+// far), with twice the runs of the round before, until one is left.
+tuning_result_t tune_tile_shape(QREngine& engine, const matrix_t<double>& input, const qr_params_t& params,
+                                const tuning_options_t& opts = tuning_options_t());
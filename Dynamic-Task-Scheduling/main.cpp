@@ -1,322 +1,187 @@
 #include <iostream>
-#include <vector>
+#include <memory>
 #include <string>
-#include <cmath>
-#include <pthread.h>
-#include "include/bn2.h"
-#include <tbb/concurrent_priority_queue.h>
-#include <tbb/tbb.h>
-#include <unistd.h>
-#include <csignal>
+#include <vector>
 #include <cstdlib>
-#include <mutex>
-
-#define NUM_THREADS 28
-
-#define BETA 16
-#define ALPHA 4
-#define BETA_DIV_ALPHA ((int)BETA / (int)ALPHA)
-
-#define USE_PRIORITY_MAIN_QUEUE 0
-typedef struct
+#include <stdexcept>
+#include "include/bn2.h"
+#include "include/qr_params.h"
+#include "include/qr_engine.h"
+#include "include/tile_pager.h"
+#include "include/tuning.h"
+
+// Command-line driver: loads one matrix and factorizes it with a QREngine
+// (src/qr_engine.cpp), which owns the workers, the task graph and the ready
+// queues.
+
+// Factorizes mat as params says (batched, TSQR or alone) and prints the time.
+template <class T>
+void run_factorization(QREngine &engine, matrix_t<T> &mat, const qr_params_t &params)
 {
-    int tid;
-    int total_task_rows;
-    int total_task_cols;
-    int m;
-    int n;
-    double *mat;
-} thread_args_ts;
-
-std::vector<std::stringstream> logstreams(NUM_THREADS);
-
-TaskTable task_table;
-DependencyTableAtomic dependency_table;
-
-std::vector<double> global_up_array, global_b_array;
-
-
-struct TaskComparator {
-    bool operator()(const Task* a, const Task* b) const {
-        return a->priority < b->priority; 
+    if (params.batch > 1)
+    {
+        // Copies of the input share one scheduling domain; the first
+        // one is handed back in mat.
+        std::vector<matrix_t<T>> batch(params.batch, mat);
+        qr_run_stats_t stats = engine.factorize_batch(batch, params);
+        mat = std::move(batch[0]);
+        std::cout << "Time taken: " << static_cast<long long>(stats.elapsed_ms) << " ms" << std::endl;
+        std::cout << "Matrices per second: " << stats.matrices / (stats.elapsed_ms / 1e3) << std::endl;
     }
-};
-
-tbb::concurrent_queue<Task *> wait_queue;//, taskPQ;
-
-#if USE_PRIORITY_MAIN_QUEUE
-tbb::concurrent_priority_queue<Task *, TaskComparator> taskPQ;
-#else
-tbb::concurrent_queue<Task *> taskPQ;
-#endif
-//tbb::concurrent_priority_queue<Task *, TaskComparator> taskPQ(1024);
-
-void complete_task1(double *&mat, int m, int n, int row_start, int row_end, int col_start, int col_end)
-{
-
-    double sm, sm1, cl, clinv, up, b;
-    int _row_start = row_start == 1 ? 0 : row_start;
-
-    for (int lpivot = _row_start; lpivot < row_end; lpivot++)
+    else if (params.tsqr_leaf > 0)
     {
-        cl = fabs(mat[lpivot * n + lpivot]);
-        sm1 = 0;
-
-        for (int k = lpivot + 1; k < n; k++)
-        {
-            sm = fabs(mat[lpivot * n + k]);
-            sm1 += sm * sm;
-            cl = fmax(sm, cl);
-        }
-
-        if (cl <= 0.0)
-        {
-            return;
-        }
-        clinv = 1.0 / cl;
-
-        double d__1 = mat[lpivot * n + lpivot] * clinv;
-        sm = d__1 * d__1;
-        sm += sm1 * clinv * clinv;
-
-        cl *= sqrt(sm);
-
-        if (mat[lpivot * n + lpivot] > 0.0)
-        {
-            cl = -cl;
-        }
-
-        up = mat[lpivot * n + lpivot] - cl;
-        mat[lpivot * n + lpivot] = cl;
-
-        if (row_end - lpivot < 0)
-        {
-            return;
-        }
-
-        b = up * mat[lpivot * n + lpivot];
-
-        if (b >= 0.0)
+        qr_run_stats_t stats = engine.factorize_tsqr(mat, params);
+        std::cout << "Time taken: " << static_cast<long long>(stats.elapsed_ms) << " ms" << std::endl;
+    }
+    else
+    {
+        qr_run_stats_t stats = engine.factorize(mat, params);
+        std::cout << "Time taken: " << static_cast<long long>(stats.elapsed_ms) << " ms" << std::endl;
+        if (params.offload != offload_device_t::none)
         {
-            return;
+            std::cout << "Updates on the device: " << stats.offloaded_tasks << " of " << stats.tasks << " tasks, "
+                      << stats.offload_bytes / (1 << 20) << " MiB moved" << std::endl;
         }
-
-        b = 1.0 / b;
-
-        global_up_array[lpivot] = up;
-        global_b_array[lpivot] = b;
-
-        for (int j = lpivot + 1; j < col_end; j++)
+        if (params.granularity == granularity_t::adaptive)
         {
-            sm = mat[j * n + lpivot] * up;
-
-            for (int i__ = lpivot + 1; i__ < n; i__++)
-            {
-                sm += mat[j * n + i__] * mat[lpivot * n + i__];
-            }
-
-            if (sm == 0.0)
-            {
-                continue;
-            }
-
-            sm *= b;
-            mat[j * n + lpivot] += sm * up;
-
-            for (int i__ = lpivot + 1; i__ < n; i__++)
-            {
-                mat[j * n + i__] += sm * mat[lpivot * n + i__];
-            }
+            std::cout << "Adaptive granularity: " << stats.split_tasks << " updates split, " << stats.merged_tasks
+                      << " chained, of " << stats.tasks << " tasks" << std::endl;
         }
     }
 }
 
-void complete_task2(double *&mat, int m, int n, int row_start, int row_end, int col_start, int col_end)
+// --stream: factorizes a matrix of the stream's shape while the stream
+// fills it, params.stream_rows rows per step, and prints the times.
+template <class T>
+matrix_t<T> run_streaming(QREngine &engine, matrix_stream_t &stream, const qr_params_t &params)
 {
-
-    int _row_start = row_start == 1 ? 0 : row_start;
-    int _col_start = col_start == 1 ? 0 : col_start;
-
-    double up = 0.0, b = 0.0, sm = 0.0;
-
-    for (int lpivot = _row_start; lpivot < row_end; lpivot++)
-    {
-        up = global_up_array[lpivot];
-        b = global_b_array[lpivot];
-
-        for (int j = _col_start; j < col_end; j++)
-        {
-            sm = mat[j * n + lpivot] * up;
-
-            for (int i__ = lpivot + 1; i__ < n; i__++)
-            {
-                sm += mat[j * n + i__] * mat[lpivot * n + i__];
-            }
-
-            if (sm == 0.0)
-            {
-                continue;
-            }
-
-            sm *= b;
-            mat[j * n + lpivot] += sm * up;
-
-            for (int i__ = lpivot + 1; i__ < n; i__++)
-            {
-                mat[j * n + i__] += sm * mat[lpivot * n + i__];
-            }
-        }
-    }
+    matrix_t<T> mat(stream.rows(), stream.cols(), params.layout, params.alloc);
+    qr_factors_t<T> factors;
+    qr_run_stats_t stats = engine.factorize_streaming(mat, params, factors, [&](int loaded) {
+        return stream.load(mat, loaded, loaded + params.stream_rows);
+    });
+    std::cout << "Time taken: " << static_cast<long long>(stats.elapsed_ms) << " ms (loading included)" << std::endl;
+    std::cout << "Loading: " << static_cast<long long>(stats.load_ms) << " ms, overlapped with the factorization"
+              << std::endl;
+    return mat;
 }
 
-void *thdwork(void *params)
+// --out-of-core: copies the stream into the store params.out_of_core,
+// BETA rows at a time and writing each back, then factorizes the store
+// within params.memory_budget_mb and prints the time and the paging. The
+// result stays in the store.
+template <class T>
+void run_out_of_core(QREngine &engine, matrix_stream_t &stream, const qr_params_t &params)
 {
-    thread_args_ts *thread_args = (thread_args_ts *)params;
-
-    int total_task_rows = thread_args->total_task_rows;
-    int total_task_cols = thread_args->total_task_cols;
-    double *mat = thread_args->mat;
-    int m = thread_args->m;
-    int n = thread_args->n;
-    
-    while (1)
+    matrix_t<T> mat(0, 0, params.layout);
+    mat.create_binary(params.out_of_core, stream.rows(), stream.cols());
+    for (int loaded = 0; loaded < mat.rows();)
     {
-        Task *new_task = nullptr;
-        //auto queue_elem1 = taskPQ.pop();
-        if (taskPQ.try_pop(new_task)) ///Task *new_task = queue_elem1.value_or(nullptr))
-        {
-            int i = new_task->chunk_idx_i;
-            int j = new_task->chunk_idx_j;
-
-            int row_start = new_task->row_start;
-            int row_end = new_task->row_end;
-            int col_start = new_task->col_start;
-            int col_end = new_task->col_end;
-
-            if (new_task->type == 1)
-            {
-                complete_task1(mat, m, n, row_start, row_end, col_start, col_end);
-                dependency_table.setDependency(i, j, true);
-                for (int k = i + 1; k < total_task_rows; k++)
-                {
-                    Task *next_task = task_table.getTask(k, j);
-
-                    if (j == 0 || dependency_table.getDependency(k, j - 1))
-                    {
-                        taskPQ.push(next_task);
-                    }
-                    else
-                    {
-                        wait_queue.push(next_task);
-                    }
-                }
-            }
-            else if (new_task->type == 2)
-            {
-                complete_task2(mat, m, n, row_start, row_end, col_start, col_end);
-                dependency_table.setDependency(i, j, true);
-                if (new_task->enq_nxt_t1 && (j + 1) <= total_task_cols)
-                {
-                    taskPQ.push(task_table.getTask((j + 1) / BETA_DIV_ALPHA, j + 1));  
-                }
-            }
-        }
-    
-        Task *local_task = nullptr;
-        if (wait_queue.try_pop(local_task)) 
-        {
-            int i = local_task->chunk_idx_i;
-            int j = local_task->chunk_idx_j;
-            if (dependency_table.getDependency(i, j - 1))
-            {
-                taskPQ.push(local_task);
-            }
-            else
-            {
-                wait_queue.push(local_task);
-            }
-        }
-
-        if (dependency_table.getDependency(total_task_rows - 1, BETA_DIV_ALPHA * (total_task_rows - 1)))
-        {
-            break;
-        }
+        int now = stream.load(mat, loaded, loaded + params.beta);
+        TilePager::write_back(mat.data_ptr(), static_cast<size_t>(mat.ld()) * sizeof(T), loaded, now);
+        loaded = now;
     }
-
-    return nullptr;
+    qr_factors_t<T> factors;
+    qr_run_stats_t stats = engine.factorize_out_of_core(mat, params, factors);
+    std::cout << "Time taken: " << static_cast<long long>(stats.elapsed_ms) << " ms" << std::endl;
+    std::cout << "Tiles: " << stats.tile_loads << " loads, " << stats.tile_evictions << " evictions, peak "
+              << stats.peak_resident_bytes / double(1 << 20) << " MiB resident of " << params.memory_budget_mb
+              << " MiB" << std::endl;
 }
 
 int main(int argc, char *argv[])
 {
-    //std::cout << "[1]. Inside main." << std::endl;
-
     if (argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
+        print_qr_usage(argv[0]);
         return EXIT_FAILURE;
     }
 
-    matrix_t<double> data_matrix(argv[1]);
-
-    int total_task_rows = std::ceil(data_matrix.rows() / BETA);
-    int total_task_cols = std::ceil(data_matrix.rows() / ALPHA);
-
-    global_up_array.resize(data_matrix.rows(), 0.0);
-    global_b_array.resize(data_matrix.rows(), 0.0);
-
-    dependency_table.init(total_task_rows, total_task_cols);
-    task_table.init(total_task_rows, total_task_cols, ALPHA, BETA, data_matrix);
-    //task_table.printTaskTable();
-
-    std::vector<pthread_t> threads(NUM_THREADS);
-    std::vector<thread_args_ts> thread_args(NUM_THREADS);
-
-    // for(int i = 0 ; i<task_table.rows() ; i++)
-    // {
-    //     for(int j = 0 ; j<task_table.cols();j++)
-    //     {
-    //         if(task_table.getTask(i, j) !=nullptr)
-    //         flat_graph.push_back(task_table.getTask(i, j));
-    //     }
-    // }
-
-    // std::cout<<flat_graph.size()<<" "<<task_table.rows()<<" "<<task_table.cols()<<std::endl;
-    // std::sort(flat_graph.begin(),flat_graph.end(),comparator);
-
-    for (int i = 0; i < NUM_THREADS; i++)
+    qr_params_t params;
+    try
     {
-        thread_args[i].tid = i;
-        thread_args[i].total_task_rows = total_task_rows;
-        thread_args[i].total_task_cols = total_task_cols;
-        thread_args[i].m = data_matrix.rows();
-        thread_args[i].n = data_matrix.cols();
-        thread_args[i].mat = data_matrix.data_ptr();
+        parse_qr_params(argc, argv, params);
     }
-
-    //taskPQ = taskpq_init(7);
-    //taskpq_insert(taskPQ, task_table.getTask(0, 0), total_task_rows, total_task_cols);
-    // for(int i = 0 ; i<flat_graph.size() ; i++)
-    // taskPQ.push(flat_graph[i]);
-    taskPQ.push(task_table.getTask(0, 0));
-
-    auto start = std::chrono::high_resolution_clock::now();
-
-    for (int i = 0; i < NUM_THREADS; i++)
+    catch (const std::invalid_argument &e)
     {
-        pthread_create(&threads[i], NULL, thdwork, &thread_args[i]);
+        std::cerr << e.what() << std::endl;
+        print_qr_usage(argv[0]);
+        return EXIT_FAILURE;
     }
+    params.label = argv[1];
 
-    for (int i = 0; i < NUM_THREADS; i++)
+    matrix_t<double> data_matrix;
+    std::unique_ptr<matrix_stream_t> stream;
+    int rows = 0, cols = 0;
+    try
+    {
+        if (params.stream_rows > 0 || !params.out_of_core.empty())
+        {
+            stream = std::make_unique<matrix_stream_t>(argv[1]);
+            rows = stream->rows();
+            cols = stream->cols();
+        }
+        else
+        {
+            data_matrix = load_qr_matrix(argv[1], params);
+            rows = data_matrix.rows();
+            cols = data_matrix.cols();
+        }
+    }
+    catch (const std::runtime_error &e)
     {
-        pthread_join(threads[i], NULL);
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
- 
-    auto end = std::chrono::high_resolution_clock::now();
 
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    try
+    {
+        if (!params.tune_db.empty() && !params.shape_given)
+        {
+            TuningDB db = TuningDB::load(params.tune_db);
+            if (const tuning_entry_t *e = apply_tuned_shape(db, params, rows, cols))
+            {
+                std::cout << "Tile shape from " << params.tune_db << " (tuned for " << e->rows << " x " << e->cols
+                          << ", " << e->threads << " threads): ALPHA=" << params.alpha << ", BETA=" << params.beta
+                          << std::endl;
+                params.validate();
+            }
+        }
 
-    std::cout << "Time taken: " << elapsed << " ms" << std::endl;
-    //dependency_table.printDependencyTable();
+        QREngine engine(params.num_threads, params.affinity, params.idle);
+        if (!params.out_of_core.empty() && params.precision == precision_t::f32)
+        {
+            run_out_of_core<float>(engine, *stream, params);
+        }
+        else if (!params.out_of_core.empty())
+        {
+            run_out_of_core<double>(engine, *stream, params);
+        }
+        else if (stream && params.precision == precision_t::f32)
+        {
+            matrix_t<float> single = run_streaming<float>(engine, *stream, params);
+            data_matrix = matrix_t<double>(single, single.layout(), single.alloc_policy());
+        }
+        else if (stream)
+        {
+            data_matrix = run_streaming<double>(engine, *stream, params);
+        }
+        else if (params.precision == precision_t::f32)
+        {
+            matrix_t<float> single(data_matrix, data_matrix.layout(), data_matrix.alloc_policy());
+            run_factorization(engine, single, params);
+            data_matrix = matrix_t<double>(single, single.layout(), single.alloc_policy());
+        }
+        else
+        {
+            run_factorization(engine, data_matrix, params);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
     //data_matrix.save("output_intel.txt");
 
     return 0;
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <mpi.h>
+
+#include "bn2.h"
+#include "mpi_qr.h"
+#include "qr_params.h"
+
+// Distributed driver (make mpi): factorizes one matrix over the processes
+// of an MPI job, each owning every P-th task row (src/mpi_qr.cpp).
+
+namespace {
+
+void print_mpi_usage(const char* prog) {
+    std::cerr << "Usage: mpirun -np P " << prog << " <filename | random:N | random:RxC> [options]\n"
+              << "  --check           gather L on rank 0 and compare it with a factorization in one process\n"
+              << "and the options of a.out (--threads is per process):\n";
+    print_qr_usage(prog);
+}
+
+// The input matrix: a file, or random:RxC, whose rows are seeded by their
+// index. Each process reads or generates only the rows it owns: a binary
+// file (.dtsm) a row at a time, and a text file, which gives no row
+// offsets, by parsing it in order and giving back the pages of the task
+// rows it does not own as it goes.
+struct input_t {
+    std::string filename;
+    int rows = 0;
+    int cols = 0;
+    bool random = false;
+
+    // Takes the shape from spec or the file's header, without reading values.
+    void open(const std::string& spec) {
+        random = parse_random_spec(spec, rows, cols);
+        if (random) {
+            return;
+        }
+        filename = spec;
+        if (is_binary_matrix_file(filename)) {
+            matrix_file_t file(filename);
+            rows = file.rows();
+            cols = file.cols();
+        } else {
+            text_matrix_file_t file(filename, 1, true);
+            rows = file.rows();
+            cols = file.cols();
+        }
+    }
+
+    // Fills the rows of mat that process rank of ranks owns; with one
+    // process, all of them.
+    template <class T>
+    void load(matrix_t<T>& mat, const qr_params_t& params, int rank, int ranks) const {
+        T* data = mat.data_ptr();
+        const size_t ld = mat.ld();
+        if (random) {
+            for (int i = 0; i < rows; ++i) {
+                if (mpi_owns_row(i, params, rank, ranks)) {
+                    random_row(i, data + static_cast<size_t>(i) * ld);
+                }
+            }
+        } else if (is_binary_matrix_file(filename)) {
+            matrix_file_t file(filename);
+            for (int i = 0; i < rows; ++i) {
+                if (mpi_owns_row(i, params, rank, ranks)) {
+                    file.read_row(i, data + static_cast<size_t>(i) * ld, cols);
+                }
+            }
+        } else {
+            text_matrix_file_t file(filename, 1, true);
+            for (int first = 0; first < rows; first += params.beta) {
+                int last = std::min(first + params.beta, rows);
+                file.parse_rows(data, ld, last);
+                if (!mpi_owns_row(first, params, rank, ranks)) {
+                    release_distributed_rows(mat, first, last);
+                }
+            }
+        }
+    }
+
+    template <class T>
+    void random_row(int i, T* out) const {
+        std::mt19937_64 rng((static_cast<uint64_t>(rows) * 100000 + cols) * 1000003 + i);
+        std::uniform_real_distribution<double> dist(-0.5, 0.5);
+        for (int j = 0; j < cols; ++j) {
+            out[j] = static_cast<T>(dist(rng));
+        }
+    }
+};
+
+template <class T>
+MPI_Datatype mpi_scalar() {
+    return std::is_same<T, float>::value ? MPI_FLOAT : MPI_DOUBLE;
+}
+
+// Rows [first, last) of task row i.
+void task_row_span(int i, int rows, const qr_params_t& params, int& first, int& last) {
+    first = i * params.beta;
+    last = std::min(first + params.beta, rows);
+}
+
+// Collects the owned rows of every process into full on rank 0 and
+// returns the largest difference from a factorization of the whole matrix
+// there (L and the reflectors); 0 on the other ranks.
+template <class T>
+double check_factorization(QREngine& engine, const input_t& input, const qr_params_t& params, matrix_t<T>& mat,
+                           const qr_factors_t<T>& factors, int rank, int ranks) {
+    const int task_rows = params.task_rows(input.rows);
+    const int ld = mat.ld();
+    if (rank != 0) {
+        for (int i = rank; i < task_rows; i += ranks) {
+            int first = 0, last = 0;
+            task_row_span(i, input.rows, params, first, last);
+            MPI_Send(mat.data_ptr() + static_cast<size_t>(first) * ld, (last - first) * ld, mpi_scalar<T>(), 0, i,
+                     MPI_COMM_WORLD);
+        }
+        return 0;
+    }
+
+    matrix_t<T> reference(input.rows, input.cols, params.layout);
+    input.load(reference, params, 0, 1);
+    qr_factors_t<T> expected;
+    engine.factorize(reference, params, expected);
+
+    double diff = 0;
+    std::vector<T> rows(static_cast<size_t>(params.beta) * ld);
+    for (int i = 0; i < task_rows; ++i) {
+        int first = 0, last = 0;
+        task_row_span(i, input.rows, params, first, last);
+        const T* got = mat.data_ptr() + static_cast<size_t>(first) * ld;
+        int owner = mpi_task_row_owner(i, ranks);
+        if (owner != 0) {
+            MPI_Recv(rows.data(), (last - first) * ld, mpi_scalar<T>(), owner, i, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            got = rows.data();
+        }
+        for (int r = first; r < last; ++r) {
+            for (int c = 0; c < input.cols; ++c) {
+                diff = std::max(diff, std::fabs(static_cast<double>(got[(r - first) * ld + c]) - reference.get(r, c)));
+            }
+        }
+    }
+    for (size_t p = 0; p < expected.up.size(); ++p) {
+        diff = std::max(diff, std::fabs(static_cast<double>(factors.up[p]) - expected.up[p]));
+        diff = std::max(diff, std::fabs(static_cast<double>(factors.b[p]) - expected.b[p]));
+    }
+    return diff;
+}
+
+template <class T>
+void run_distributed(const input_t& input, const qr_params_t& params, bool check, int rank, int ranks) {
+    matrix_t<T> mat = make_distributed_matrix<T>(input.rows, input.cols, params);
+    input.load(mat, params, rank, ranks);
+
+    QREngine engine(params.num_threads, params.affinity, params.idle);
+    qr_factors_t<T> factors;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    mpi_qr_stats_t stats = factorize_mpi(engine, mat, params, factors);
+    double elapsed_ms = (MPI_Wtime() - start) * 1e3;
+
+    double local[3] = {elapsed_ms, stats.panel_wait_ms, stats.released_bytes};
+    double slowest[3] = {0, 0, 0};
+    double received = 0;
+    MPI_Reduce(local, slowest, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&stats.bytes_received, &received, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::cout << "Time taken: " << static_cast<long long>(slowest[0]) << " ms" << std::endl;
+        std::cout << "Processes: " << ranks << ", workers each: " << stats.run.workers
+                  << ", received: " << received / (1 << 20) << " MiB in all" << std::endl;
+        std::cout << "Most time waiting for panels: " << slowest[1] << " ms, most released: "
+                  << slowest[2] / (1 << 20) << " MiB" << std::endl;
+    }
+
+    if (check) {
+        double diff = check_factorization(engine, input, params, mat, factors, rank, ranks);
+        if (rank == 0) {
+            std::cout << "Check: max |difference| from one process: " << diff << std::endl;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0, ranks = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    if (argc < 2) {
+        if (rank == 0) {
+            print_mpi_usage(argv[0]);
+        }
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    bool check = false;
+    std::vector<char*> rest;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            rest.push_back(argv[i]);
+        }
+    }
+
+    qr_params_t params;
+    input_t input;
+    try {
+        parse_qr_params(static_cast<int>(rest.size()), rest.data(), params);
+        if (params.batch > 1 || params.tsqr_leaf > 0 || !params.trace.empty()) {
+            throw std::invalid_argument("mpi.out factorizes one matrix; drop --batch, --tsqr and --trace.");
+        }
+    } catch (const std::invalid_argument& e) {
+        if (rank == 0) {
+            std::cerr << e.what() << std::endl;
+            print_mpi_usage(argv[0]);
+        }
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    params.label = argv[1];
+
+    try {
+        input.open(argv[1]);
+        if (params.precision == precision_t::f32) {
+            run_distributed<float>(input, params, check, rank, ranks);
+        } else {
+            run_distributed<double>(input, params, check, rank, ranks);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[rank " << rank << "] " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
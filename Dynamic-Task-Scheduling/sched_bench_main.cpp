@@ -0,0 +1,590 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <tbb/concurrent_priority_queue.h>
+#include <tbb/concurrent_queue.h>
+
+#include "include/bn2.h"
+#include "include/bench_report.h"
+#include "include/parking.h"
+#include "include/placement.h"
+#include "include/qr_params.h"
+#include "include/trace.h"
+
+// Scheduler microbenchmark (make schedbench): runs the task graph of a
+// rows x cols factorization (TaskTable, as the engine builds it) with
+// kernels that do no math, so that what is timed is the scheduling alone.
+// Every ready-queue kind runs the same minimal worker loop: pop, spin for
+// --work, release the successors, push the ready ones. "barrier" walks the
+// pivot blocks as barrier.out does instead. For every queue and thread
+// count it reports tasks per second, the scheduling time per task (worker
+// time not spent in the kernels), the dispatch latency (a task's release to
+// its start) and the contention on the queue (empty polls per task, time
+// per successful pop).
+
+struct sched_options_t {
+    std::vector<std::string> queues = {"tbb-fifo", "tbb-priority", "mutex-ring", "atomic-ring", "bucket", "barrier"};
+    std::vector<int> threads = {1, 2, 4, 8, 16, 28, 52};
+    int work_ns = 0;       // Spin per task; 0 for null kernels.
+    int warmup = 1;
+    int reps = 5;
+    std::string json;      // One line of JSON per run of sched_bench.out, appended; "-" for stdout.
+    std::string csv;       // One row per queue and thread count.
+};
+
+// One run of the graph.
+struct sched_metrics_t {
+    double elapsed_ms = 0;
+    double tasks_per_s = 0;
+    double overhead_ns = 0;       // Per task: worker time outside the kernels.
+    double latency_mean_ns = 0;   // Release to start.
+    double latency_p99_ns = 0;
+    double empty_polls = 0;       // Per task.
+    double pop_ns = 0;            // Per successful pop.
+};
+
+const std::vector<std::string> known_queues = {"tbb-fifo", "tbb-priority", "mutex-ring", "atomic-ring", "bucket",
+                                               "barrier"};
+
+void print_sched_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <N | RxC> [options]\n"
+              << "  --queues LIST     comma separated: tbb-fifo, tbb-priority, mutex-ring (CircularQueueMtx),\n"
+              << "                    atomic-ring (CircularQueueAtomic), bucket (BucketPriorityQueue), barrier\n"
+              << "                    (default: all)\n"
+              << "  --thread-list L   comma separated thread counts (default 1,2,4,8,16,28,52)\n"
+              << "  --work W          kernel of every task: null or spin:NS (busy for NS nanoseconds)\n"
+              << "  --warmup N        untimed runs per configuration (default 1)\n"
+              << "  --reps N          timed runs per configuration (default 5); the median one is reported\n"
+              << "  --json FILE       append the results as one line of JSON (- for stdout)\n"
+              << "  --csv FILE        append one row per queue and thread count\n"
+              << "and of the options of a.out, --alpha, --beta, --affinity and --idle*:\n";
+    print_qr_usage(prog);
+}
+
+int parse_work(const std::string& value) {
+    if (value == "null") {
+        return 0;
+    }
+    const std::string prefix = "spin:";
+    if (value.compare(0, prefix.size(), prefix) == 0) {
+        int ns = parse_int_option("--work", value.substr(prefix.size()).c_str());
+        if (ns >= 0) {
+            return ns;
+        }
+    }
+    throw std::invalid_argument("Invalid value for option --work: " + value);
+}
+
+// Takes the options of this driver out of argv; the remaining ones go to
+// parse_qr_params.
+std::vector<char*> parse_sched_options(int argc, char* argv[], sched_options_t& opts) {
+    std::vector<char*> rest = {argv[0], argv[1]};
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        bool ours = opt == "--queues" || opt == "--thread-list" || opt == "--work" || opt == "--warmup" ||
+                    opt == "--reps" || opt == "--json" || opt == "--csv";
+        if (!ours) {
+            rest.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for option " + opt + ".");
+        }
+        const char* value = argv[++i];
+        if (opt == "--queues") {
+            opts.queues = split_list(value);
+        } else if (opt == "--thread-list") {
+            opts.threads.clear();
+            for (const std::string& item : split_list(value)) {
+                opts.threads.push_back(parse_int_option(opt, item.c_str()));
+            }
+        } else if (opt == "--work") {
+            opts.work_ns = parse_work(value);
+        } else if (opt == "--warmup") {
+            opts.warmup = parse_int_option(opt, value);
+        } else if (opt == "--reps") {
+            opts.reps = parse_int_option(opt, value);
+        } else if (opt == "--json") {
+            opts.json = value;
+        } else {
+            opts.csv = value;
+        }
+    }
+    if (opts.warmup < 0 || opts.reps < 1) {
+        throw std::invalid_argument("Need --warmup >= 0 and --reps >= 1.");
+    }
+    if (opts.queues.empty() || opts.threads.empty()) {
+        throw std::invalid_argument("No queues or thread counts to run.");
+    }
+    for (const std::string& queue : opts.queues) {
+        if (std::find(known_queues.begin(), known_queues.end(), queue) == known_queues.end()) {
+            throw std::invalid_argument("Unknown queue: " + queue);
+        }
+    }
+    for (int threads : opts.threads) {
+        if (threads < 1) {
+            throw std::invalid_argument("Thread counts must be at least 1.");
+        }
+    }
+    return rest;
+}
+
+// The ready queues, behind one interface: push a run of released tasks,
+// pop one.
+struct tbb_fifo_queue_t {
+    tbb::concurrent_queue<Task*> queue;
+
+    explicit tbb_fifo_queue_t(const TaskTable&) {}
+    void push(Task* const* tasks, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            queue.push(tasks[k]);
+        }
+    }
+    bool pop(Task*& task) { return queue.try_pop(task); }
+};
+
+struct tbb_priority_queue_t {
+    struct by_rank_t {
+        const TaskTable* table;
+        bool operator()(const Task* a, const Task* b) const { return table->rank(a) < table->rank(b); }
+    };
+    tbb::concurrent_priority_queue<Task*, by_rank_t> queue;
+
+    explicit tbb_priority_queue_t(const TaskTable& table) : queue(by_rank_t{&table}) {}
+    void push(Task* const* tasks, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            queue.push(tasks[k]);
+        }
+    }
+    bool pop(Task*& task) { return queue.try_pop(task); }
+};
+
+struct mutex_ring_queue_t {
+    CircularQueueMtx<Task*> queue;
+
+    explicit mutex_ring_queue_t(const TaskTable& table) : queue(table.numTasks()) {}
+    void push(Task* const* tasks, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            queue.push_back(tasks[k]);
+        }
+    }
+    bool pop(Task*& task) {
+        std::optional<Task*> front = queue.pop_front();
+        if (front) {
+            task = *front;
+        }
+        return front.has_value();
+    }
+};
+
+struct atomic_ring_queue_t {
+    CircularQueueAtomic<Task*> queue;
+
+    explicit atomic_ring_queue_t(const TaskTable& table) : queue(table.numTasks()) {}
+    void push(Task* const* tasks, size_t count) {
+        while (count > 0) {
+            size_t pushed = queue.push_bulk(tasks, count);
+            tasks += pushed;
+            count -= pushed;
+        }
+    }
+    bool pop(Task*& task) { return queue.try_pop(task); }
+};
+
+struct bucket_queue_t {
+    const TaskTable& table;
+    BucketPriorityQueue<Task*> queue;
+
+    explicit bucket_queue_t(const TaskTable& t) : table(t), queue(t.rankCounts()) {}
+    void push(Task* const* tasks, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            queue.push(tasks[k], table.rank(tasks[k]));
+        }
+    }
+    bool pop(Task*& task) {
+        std::optional<Task*> top = queue.pop();
+        if (top) {
+            task = *top;
+        }
+        return top.has_value();
+    }
+};
+
+// What one worker saw, alone on its cache lines.
+struct alignas(64) worker_stats_t {
+    std::vector<uint32_t> latencies_ns;
+    uint64_t empty_polls = 0;
+    uint64_t pops = 0;
+    uint64_t pop_ns = 0;
+};
+
+// One run of the graph: the table, re-armed for every run, and when each
+// task was released (for the dispatch latency).
+struct graph_run_t {
+    TaskTable& table;
+    int work_ns;
+    const idle_policy_t& idle;
+    std::vector<uint64_t> released;
+    std::atomic<int> remaining{0};
+    std::atomic<bool> go{false};
+
+    graph_run_t(TaskTable& t, int work, const idle_policy_t& idle_policy)
+        : table(t), work_ns(work), idle(idle_policy), released(t.numTasks(), 0) {}
+
+    size_t index(const Task* task) const { return static_cast<size_t>(task - table.begin()); }
+};
+
+inline void spin_for(int ns) {
+    if (ns <= 0) {
+        return;
+    }
+    uint64_t until = trace_now_ns() + static_cast<uint64_t>(ns);
+    while (trace_now_ns() < until) {
+        cpu_relax();
+    }
+}
+
+inline uint32_t clamp_ns(uint64_t ns) {
+    return static_cast<uint32_t>(std::min<uint64_t>(ns, UINT32_MAX));
+}
+
+template <class Queue>
+void dag_worker(graph_run_t& run, Queue& queue, worker_stats_t& stats) {
+    IdleBackoff backoff(run.idle);
+    constexpr size_t burst = 64;
+    Task* ready[burst];
+    while (!run.go.load(std::memory_order_acquire)) {
+        cpu_relax();
+    }
+    while (run.remaining.load(std::memory_order_acquire) > 0) {
+        uint64_t poll = trace_now_ns();
+        Task* task = nullptr;
+        if (!queue.pop(task)) {
+            stats.empty_polls++;
+            if (backoff.wait()) {
+                // No parking here: the loop also has to notice the end.
+                std::this_thread::yield();
+                backoff.reset();
+            }
+            continue;
+        }
+        uint64_t start = trace_now_ns();
+        backoff.reset();
+        stats.pops++;
+        stats.pop_ns += start - poll;
+        stats.latencies_ns.push_back(clamp_ns(start - run.released[run.index(task)]));
+
+        spin_for(run.work_ns);
+
+        uint64_t now = trace_now_ns();
+        size_t pending = 0;
+        for (Task* next : task->successors) {
+            if (next->unmet.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                run.released[run.index(next)] = now;
+                ready[pending++] = next;
+                if (pending == burst) {
+                    queue.push(ready, pending);
+                    pending = 0;
+                }
+            }
+        }
+        queue.push(ready, pending);
+        run.remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+// The phases of barrier.out: worker 0 runs the panel of the block, then
+// every worker the updates of the task rows below it round-robin, with a
+// barrier after each phase. A task is released when the last worker
+// reaches the barrier before its phase.
+struct barrier_run_t {
+    TaskTable& table;
+    int work_ns;
+    int threads;
+    pthread_barrier_t barrier;
+    std::unique_ptr<std::atomic<uint64_t>[]> phase_release;  // Latest arrival at the barrier before each phase.
+    std::atomic<bool> go{false};
+
+    barrier_run_t(TaskTable& t, int work, int num_threads) : table(t), work_ns(work), threads(num_threads),
+        phase_release(new std::atomic<uint64_t>[2 * t.cols() + 1]) {
+        for (int p = 0; p < 2 * t.cols() + 1; ++p) {
+            phase_release[p].store(0, std::memory_order_relaxed);
+        }
+        pthread_barrier_init(&barrier, nullptr, threads);
+    }
+    ~barrier_run_t() { pthread_barrier_destroy(&barrier); }
+
+    // Waits at the barrier before phase p; returns the phase's release time.
+    uint64_t wait(int p, worker_stats_t& stats) {
+        uint64_t arrival = trace_now_ns();
+        uint64_t seen = phase_release[p].load(std::memory_order_relaxed);
+        while (seen < arrival && !phase_release[p].compare_exchange_weak(seen, arrival)) {
+        }
+        pthread_barrier_wait(&barrier);
+        stats.pop_ns += trace_now_ns() - arrival;
+        return phase_release[p].load(std::memory_order_acquire);
+    }
+
+    void run_task(uint64_t released, worker_stats_t& stats) {
+        stats.pops++;
+        stats.latencies_ns.push_back(clamp_ns(trace_now_ns() - released));
+        spin_for(work_ns);
+    }
+};
+
+void barrier_worker(barrier_run_t& run, int tid, worker_stats_t& stats) {
+    const TaskTable& table = run.table;
+    while (!run.go.load(std::memory_order_acquire)) {
+        cpu_relax();
+    }
+    for (int j = 0; j < table.cols(); ++j) {
+        int panel = 0;
+        while (table.getTask(panel, j) == nullptr) {
+            panel++;
+        }
+        uint64_t released = run.wait(2 * j, stats);
+        if (tid == 0) {
+            run.run_task(released, stats);
+        }
+        released = run.wait(2 * j + 1, stats);
+        for (int i = panel + 1 + tid; i < table.rows(); i += run.threads) {
+            run.run_task(released, stats);
+        }
+    }
+    run.wait(2 * table.cols(), stats);
+}
+
+sched_metrics_t summarize_run(std::vector<worker_stats_t>& stats, double elapsed_ns, int threads, int tasks,
+                              int work_ns) {
+    std::vector<uint32_t> latencies;
+    uint64_t empty_polls = 0, pops = 0, pop_ns = 0;
+    for (worker_stats_t& s : stats) {
+        latencies.insert(latencies.end(), s.latencies_ns.begin(), s.latencies_ns.end());
+        empty_polls += s.empty_polls;
+        pops += s.pops;
+        pop_ns += s.pop_ns;
+    }
+    sched_metrics_t m;
+    m.elapsed_ms = elapsed_ns / 1e6;
+    m.tasks_per_s = elapsed_ns > 0 ? tasks / (elapsed_ns / 1e9) : 0;
+    m.overhead_ns = tasks > 0 ? std::max(0.0, (elapsed_ns * threads - static_cast<double>(tasks) * work_ns) / tasks)
+                              : 0;
+    if (!latencies.empty()) {
+        double sum = 0;
+        for (uint32_t l : latencies) {
+            sum += l;
+        }
+        m.latency_mean_ns = sum / latencies.size();
+        size_t p99 = latencies.size() * 99 / 100;
+        std::nth_element(latencies.begin(), latencies.begin() + p99, latencies.end());
+        m.latency_p99_ns = latencies[p99];
+    }
+    m.empty_polls = tasks > 0 ? static_cast<double>(empty_polls) / tasks : 0;
+    m.pop_ns = pops > 0 ? static_cast<double>(pop_ns) / pops : 0;
+    return m;
+}
+
+// Runs the graph once on threads workers, pinned as params says; the
+// clock starts once every worker is up.
+template <class Queue>
+sched_metrics_t run_queue(TaskTable& table, int threads, const qr_params_t& params, int work_ns) {
+    table.reset();
+    Queue queue(table);
+    graph_run_t run(table, work_ns, params.idle);
+    run.remaining.store(table.numTasks());
+    std::vector<worker_stats_t> stats(threads);
+    for (worker_stats_t& s : stats) {
+        s.latencies_ns.reserve(table.numTasks() / threads + 64);
+    }
+    std::vector<int> cpus = affinity_map(params.affinity, threads);
+    std::vector<std::thread> workers;
+    for (int tid = 0; tid < threads; ++tid) {
+        workers.emplace_back([&, tid] {
+            pin_current_thread(cpus[tid]);
+            dag_worker(run, queue, stats[tid]);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t start = trace_now_ns();
+    Task* first = table.getTask(0, 0);
+    run.released[run.index(first)] = start;
+    queue.push(&first, 1);
+    run.go.store(true, std::memory_order_release);
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    double elapsed_ns = static_cast<double>(trace_now_ns() - start);
+    return summarize_run(stats, elapsed_ns, threads, table.numTasks(), work_ns);
+}
+
+sched_metrics_t run_barrier(TaskTable& table, int threads, const qr_params_t& params, int work_ns) {
+    barrier_run_t run(table, work_ns, threads);
+    std::vector<worker_stats_t> stats(threads);
+    std::vector<int> cpus = affinity_map(params.affinity, threads);
+    std::vector<std::thread> workers;
+    for (int tid = 0; tid < threads; ++tid) {
+        workers.emplace_back([&, tid] {
+            pin_current_thread(cpus[tid]);
+            barrier_worker(run, tid, stats[tid]);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t start = trace_now_ns();
+    run.go.store(true, std::memory_order_release);
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    double elapsed_ns = static_cast<double>(trace_now_ns() - start);
+    return summarize_run(stats, elapsed_ns, threads, table.numTasks(), work_ns);
+}
+
+sched_metrics_t run_once(const std::string& queue, TaskTable& table, int threads, const qr_params_t& params,
+                         int work_ns) {
+    if (queue == "tbb-fifo") {
+        return run_queue<tbb_fifo_queue_t>(table, threads, params, work_ns);
+    } else if (queue == "tbb-priority") {
+        return run_queue<tbb_priority_queue_t>(table, threads, params, work_ns);
+    } else if (queue == "mutex-ring") {
+        return run_queue<mutex_ring_queue_t>(table, threads, params, work_ns);
+    } else if (queue == "atomic-ring") {
+        return run_queue<atomic_ring_queue_t>(table, threads, params, work_ns);
+    } else if (queue == "bucket") {
+        return run_queue<bucket_queue_t>(table, threads, params, work_ns);
+    }
+    return run_barrier(table, threads, params, work_ns);
+}
+
+struct sched_result_t {
+    std::string queue;
+    int threads = 0;
+    sched_metrics_t median;    // The timed run of median elapsed time.
+    std::vector<double> times_ms;
+};
+
+void write_sched_results(const sched_options_t& opts, const qr_params_t& params, int rows, int cols, int tasks,
+                         const std::vector<sched_result_t>& results) {
+    if (!opts.json.empty()) {
+        std::ofstream file;
+        std::ostream& os = open_append(opts.json, file, nullptr);
+        os << std::setprecision(6) << "{\"rows\":" << rows << ",\"cols\":" << cols << ",\"alpha\":" << params.alpha
+           << ",\"beta\":" << params.beta << ",\"tasks\":" << tasks << ",\"work_ns\":" << opts.work_ns
+           << ",\"warmup\":" << opts.warmup << ",\"reps\":" << opts.reps << ",\"results\":[";
+        for (size_t k = 0; k < results.size(); ++k) {
+            const sched_result_t& r = results[k];
+            const sched_metrics_t& m = r.median;
+            os << (k ? "," : "") << "{\"queue\":" << json_string(r.queue) << ",\"threads\":" << r.threads
+               << ",\"median_ms\":" << m.elapsed_ms << ",\"tasks_per_s\":" << m.tasks_per_s
+               << ",\"overhead_ns\":" << m.overhead_ns << ",\"latency_mean_ns\":" << m.latency_mean_ns
+               << ",\"latency_p99_ns\":" << m.latency_p99_ns << ",\"empty_polls_per_task\":" << m.empty_polls
+               << ",\"pop_ns\":" << m.pop_ns << ",\"times_ms\":[";
+            for (size_t i = 0; i < r.times_ms.size(); ++i) {
+                os << (i ? "," : "") << r.times_ms[i];
+            }
+            os << "]}";
+        }
+        os << "]}" << std::endl;
+    }
+    if (!opts.csv.empty()) {
+        std::ofstream file;
+        std::ostream& os = open_append(opts.csv, file,
+            "rows,cols,alpha,beta,tasks,work_ns,queue,threads,median_ms,tasks_per_s,overhead_ns,"
+            "latency_mean_ns,latency_p99_ns,empty_polls_per_task,pop_ns");
+        for (const sched_result_t& r : results) {
+            const sched_metrics_t& m = r.median;
+            os << std::setprecision(6) << rows << "," << cols << "," << params.alpha << "," << params.beta << ","
+               << tasks << "," << opts.work_ns << "," << r.queue << "," << r.threads << "," << m.elapsed_ms << ","
+               << m.tasks_per_s << "," << m.overhead_ns << "," << m.latency_mean_ns << "," << m.latency_p99_ns
+               << "," << m.empty_polls << "," << m.pop_ns << "\n";
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        print_sched_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    sched_options_t opts;
+    qr_params_t params;
+    int rows = 0, cols = 0;
+    try
+    {
+        std::vector<char*> rest = parse_sched_options(argc, argv, opts);
+        parse_qr_params(static_cast<int>(rest.size()), rest.data(), params);
+        parse_random_spec(std::string("random:") + argv[1], rows, cols);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << std::endl;
+        print_sched_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    TaskTable table;
+    table.init(params.task_rows(rows), params.task_cols(rows, cols), params.alpha, params.beta, rows, cols);
+    std::cout << "Task graph of a " << rows << " x " << cols << " matrix, ALPHA=" << params.alpha
+              << ", BETA=" << params.beta << ": " << table.numTasks() << " tasks, "
+              << (opts.work_ns > 0 ? "spin " + std::to_string(opts.work_ns) + " ns" : std::string("null"))
+              << " kernels" << std::endl;
+
+    std::vector<sched_result_t> results;
+    for (const std::string& queue : opts.queues)
+    {
+        for (int threads : opts.threads)
+        {
+            std::vector<sched_metrics_t> runs;
+            for (int rep = 0; rep < opts.warmup + opts.reps; ++rep)
+            {
+                sched_metrics_t m = run_once(queue, table, threads, params, opts.work_ns);
+                if (rep >= opts.warmup)
+                {
+                    runs.push_back(m);
+                }
+            }
+            sched_result_t result;
+            result.queue = queue;
+            result.threads = threads;
+            for (const sched_metrics_t& m : runs)
+            {
+                result.times_ms.push_back(m.elapsed_ms);
+            }
+            std::sort(runs.begin(), runs.end(),
+                      [](const sched_metrics_t& a, const sched_metrics_t& b) { return a.elapsed_ms < b.elapsed_ms; });
+            result.median = runs[runs.size() / 2];
+            const sched_metrics_t& m = result.median;
+            std::cout << std::left << std::setw(13) << queue << std::right << std::setw(3) << threads << " threads"
+                      << std::fixed << std::setprecision(1) << ": " << m.tasks_per_s / 1e6 << " M tasks/s, "
+                      << m.overhead_ns << " ns/task scheduling, latency " << m.latency_mean_ns << " ns (p99 "
+                      << m.latency_p99_ns << "), " << std::setprecision(2) << m.empty_polls
+                      << " empty polls/task, pop " << std::setprecision(1) << m.pop_ns << " ns" << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            results.push_back(std::move(result));
+        }
+    }
+
+    try
+    {
+        write_sched_results(opts, params, rows, cols, table.numTasks(), results);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# ------------------------------------------------------------------------------
+# Converts matrix files between the text format written by the experiment
+# scripts (optional "m n" header line, then rows of space separated values)
+# and the binary .dtsm format of include/matrix_file.h, which a.out maps
+# without parsing.
+#
+#   ./convert_matrix.py ../testcase/input_2000.txt ../testcase/input_2000.dtsm
+#   ./convert_matrix.py --layout row --dtype f32 in.txt out.dtsm
+#   ./convert_matrix.py in.dtsm out.txt
+#   ./convert_matrix.py --all ../testcase      # every .txt next to a .dtsm
+#
+# Only the standard library is needed.
+# ------------------------------------------------------------------------------
+import argparse
+import array
+import os
+import struct
+import sys
+
+MAGIC = b"DTSMATRX"
+VERSION = 1
+BYTE_ORDER = 0x01020304
+DATA_OFFSET = 4096
+HEADER = struct.Struct("=8sIIQQQIIQQ")  # 64 bytes, see matrix_file.h
+
+DTYPES = {"f64": (1, "d"), "f32": (2, "f")}
+CODES = {code: typecode for code, typecode in DTYPES.values()}
+
+
+def padded_stride(cols, elem_size):
+    # Same rule as matrix_t::stride_for(cols, padded).
+    line = max(1, 64 // elem_size)
+    ld = (cols + line - 1) // line * line
+    if (ld * elem_size) % 4096 == 0:
+        ld += line
+    return ld
+
+
+def read_text(path):
+    with open(path) as f:
+        lines = [line.split() for line in f]
+    lines = [tokens for tokens in lines if tokens]
+    if not lines:
+        raise ValueError(f"{path}: file is empty")
+    header = None
+    if len(lines[0]) == 2 and all(t.lstrip("-").isdigit() for t in lines[0]):
+        header = (int(lines[0][0]), int(lines[0][1]))
+        lines = lines[1:]
+    values = array.array("d", (float(t) for tokens in lines for t in tokens))
+    if header is not None:
+        rows, cols = header
+        if len(values) != rows * cols:
+            raise ValueError(f"{path}: header says {rows}x{cols}, found {len(values)} values")
+    else:
+        rows, cols = len(lines), len(lines[0])
+        for i, tokens in enumerate(lines):
+            if len(tokens) != cols:
+                raise ValueError(f"{path}: row {i} has {len(tokens)} values, expected {cols}")
+    return rows, cols, values
+
+
+def write_binary(path, rows, cols, values, layout, dtype):
+    code, typecode = DTYPES[dtype]
+    elem_size = array.array(typecode).itemsize
+    ld = padded_stride(cols, elem_size) if layout == "padded" and cols > 0 else cols
+    header = HEADER.pack(MAGIC, VERSION, code, rows, cols, ld,
+                         1 if layout == "padded" else 0, BYTE_ORDER, DATA_OFFSET, 0)
+    pad = array.array(typecode, [0.0]) * (ld - cols)
+    with open(path, "wb") as f:
+        f.write(header.ljust(DATA_OFFSET, b"\0"))
+        for i in range(rows):
+            row = array.array(typecode, values[i * cols:(i + 1) * cols])
+            row.tofile(f)
+            pad.tofile(f)
+
+
+def read_binary(path):
+    with open(path, "rb") as f:
+        magic, version, code, rows, cols, ld, _, byte_order, offset, _ = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC or version != VERSION or byte_order != BYTE_ORDER or code not in CODES:
+            raise ValueError(f"{path}: not a binary matrix file this script can read")
+        f.seek(offset)
+        data = array.array(CODES[code])
+        data.fromfile(f, rows * ld)
+    values = array.array("d")
+    for i in range(rows):
+        values.extend(data[i * ld:i * ld + cols])
+    return rows, cols, values
+
+
+def write_text(path, rows, cols, values):
+    with open(path, "w") as f:
+        f.write(f"{rows} {cols}\n")
+        for i in range(rows):
+            f.write(" ".join(f"{x:.6f}" for x in values[i * cols:(i + 1) * cols]) + "\n")
+
+
+def is_binary(path):
+    with open(path, "rb") as f:
+        return f.read(len(MAGIC)) == MAGIC
+
+
+def convert(src, dst, layout, dtype):
+    if is_binary(src):
+        write_text(dst, *read_binary(src))
+    else:
+        write_binary(dst, *read_text(src), layout, dtype)
+    print(f"[INFO] {src} -> {dst}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert matrix files between text and binary (.dtsm).")
+    parser.add_argument("src", help="input file, or a folder with --all")
+    parser.add_argument("dst", nargs="?", help="output file (the format is the other one)")
+    parser.add_argument("--layout", choices=["row", "padded"], default="padded",
+                        help="row stride of the binary file; padded (default) maps without a copy into a.out")
+    parser.add_argument("--dtype", choices=sorted(DTYPES), default="f64", help="element type of the binary file")
+    parser.add_argument("--all", action="store_true", help="convert every .txt file in the folder src")
+    args = parser.parse_args()
+
+    try:
+        if args.all:
+            for name in sorted(os.listdir(args.src)):
+                if name.endswith(".txt"):
+                    src = os.path.join(args.src, name)
+                    convert(src, src[:-len(".txt")] + ".dtsm", args.layout, args.dtype)
+        elif args.dst:
+            convert(args.src, args.dst, args.layout, args.dtype)
+        else:
+            parser.error("dst is required unless --all is given")
+    except (OSError, ValueError) as e:
+        print(f"[ERROR] {e}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -6,6 +6,7 @@ import numpy as np
 import csv
 import os
 import matplotlib.pyplot as plt # For plotting graphs
+import pandas as pd
 from collections import defaultdict
 
 # ------------------------------------------------------------------------------
@@ -28,42 +29,15 @@ RUNS_PER_CONFIG = 3  # Number of times to run each (alpha, beta) pair for averag
 TESTCASE_FOLDER = "../testcase"
 EXECUTABLE_NAME = "../a.out"
 MAKEFILE_NAME = "../Makefile"
-INTEL_SRC_FILE_NAME = "intel.cpp" # Source file for lock-free queue versions
-# BARRIER_SRC_FILE_NAME = "barrier_main.cpp" # If you also want to tune barrier
+# Threads, ALPHA, BETA and the ready queue are run-time options of a.out
+# (--threads, --alpha, --beta, --sched): one build serves every point.
+SCHED_FOR_PRIORITY = {0: "fifo", 1: "priority"}
 
 # --- Helper Functions (Adapted from previous scripts) ---
 
-def update_makefile_for_source(source_file_name_only):
-    source_path_in_makefile = f"src/{source_file_name_only}"
-    cmd = f"sed -i 's|^MAIN_SRC * =.*|MAIN_SRC = {source_path_in_makefile}|' {MAKEFILE_NAME}"
-    subprocess.run(cmd, shell=True, check=True)
-    print(f"[INFO] Makefile updated to use MAIN_SRC = {source_path_in_makefile}")
-
-def get_cpp_source_path(source_file_name_only):
-    return os.path.join("..", source_file_name_only)
-
-def update_threads_in_cpp(cpp_file_path, threads):
-    cmd = f"sed -i 's/^#define[[:space:]]\\+NUM_THREADS[[:space:]]\\+[0-9]\\+/#define NUM_THREADS {threads}/' {cpp_file_path}"
-    subprocess.run(cmd, shell=True, check=True)
-    print(f"[INFO] {os.path.basename(cpp_file_path)}: NUM_THREADS set to {threads}.")
-
-def update_priority_in_cpp(cpp_file_path, priority_flag): # 0 for no priority, 1 for with priority
-    cmd = f"sed -i 's/^#define[[:space:]]\\+USE_PRIORITY_MAIN_QUEUE[[:space:]]\\+[0-9]\\+/#define USE_PRIORITY_MAIN_QUEUE {priority_flag}/' {cpp_file_path}"
-    subprocess.run(cmd, shell=True, check=True)
-    mode = "WITH PRIORITY" if priority_flag == 1 else "WITHOUT PRIORITY"
-    print(f"[INFO] {os.path.basename(cpp_file_path)}: USE_PRIORITY_MAIN_QUEUE set to {priority_flag} ({mode}).")
-
-def update_alpha_beta_in_cpp(cpp_file_path, alpha, beta):
-    cmd_alpha = f"sed -i 's/^#define[[:space:]]\\+ALPHA[[:space:]]\\+[0-9.]\\+/#define ALPHA {alpha}/' {cpp_file_path}"
-    cmd_beta  = f"sed -i 's/^#define[[:space:]]\\+BETA[[:space:]]\\+[0-9.]\\+/#define BETA {beta}/' {cpp_file_path}"
-    subprocess.run(cmd_alpha, shell=True, check=True)
-    subprocess.run(cmd_beta, shell=True, check=True)
-    print(f"[INFO] {os.path.basename(cpp_file_path)}: ALPHA set to {alpha}, BETA set to {beta}.")
-
 def compile_code():
     print("[INFO] Compiling QR factorization code...")
     compile_dir = os.path.dirname(MAKEFILE_NAME) # Should be ParQR root
-    subprocess.run("make clean", shell=True, check=True, cwd=compile_dir, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
     compile_process = subprocess.run("make all", shell=True, cwd=compile_dir, capture_output=True, text=True)
     if compile_process.returncode != 0:
         print("[ERROR] Compilation failed!")
@@ -80,10 +54,11 @@ def get_matrix_file_path(matrix_dim):
         sys.exit(1)
     return filename
 
-def run_qr_executable(matrix_dim, matrix_file_path_abs_or_rel_to_script):
+def run_qr_executable(matrix_file_path_abs_or_rel_to_script, threads, alpha, beta, sched):
     # Executable expects matrix path relative to its own location (ParQR root)
     matrix_file_for_exe = os.path.join(os.path.basename(TESTCASE_FOLDER), os.path.basename(matrix_file_path_abs_or_rel_to_script))
-    cmd_list = [EXECUTABLE_NAME, str(matrix_dim), str(matrix_dim), matrix_file_for_exe]
+    cmd_list = ["./" + os.path.basename(EXECUTABLE_NAME), matrix_file_for_exe,
+                "--threads", str(threads), "--alpha", str(alpha), "--beta", str(beta), "--sched", sched]
 
     print(f"[INFO] Executing: {' '.join(cmd_list)}")
     try:
@@ -123,21 +98,15 @@ def main():
     # Prepare matrix file path once
     matrix_file = get_matrix_file_path(FIXED_MATRIX_SIZE_FOR_TUNING)
 
-    # Ensure initial compilation with default settings in intel.cpp
-    # This also sets the NUM_THREADS for the first run.
-    intel_cpp_path = get_cpp_source_path(INTEL_SRC_FILE_NAME)
-    update_makefile_for_source(INTEL_SRC_FILE_NAME)
-    update_threads_in_cpp(intel_cpp_path, FIXED_THREADS_FOR_TUNING)
-    # Initial compile will happen before the first parameter update.
+    # One build: every (alpha, beta, priority) point is a set of options.
+    compile_code()
 
     # Iterate for "Without Priority" (0) and "With Priority" (1)
     for priority_setting in [0, 1]:
         priority_str = "with_priority" if priority_setting == 1 else "without_priority"
         print(f"\n[PHASE] Running parameter tuning for: {priority_str.upper().replace('_', ' ')}")
         
-        # Update priority setting in intel.cpp
-        update_priority_in_cpp(intel_cpp_path, priority_setting)
-        # No need to recompile here, will happen after alpha/beta update
+        sched = SCHED_FOR_PRIORITY[priority_setting]
 
         results_for_this_priority = []
         output_csv_filename = f"param_tuning_results_{priority_str}_m{FIXED_MATRIX_SIZE_FOR_TUNING}_t{FIXED_THREADS_FOR_TUNING}.csv"
@@ -168,13 +137,10 @@ def main():
                 #     print(f"[SKIP] Skipping Alpha={alpha_val}, Beta={beta_val} because matrix size {FIXED_MATRIX_SIZE_FOR_TUNING} is not divisible by Alpha or Beta.")
                 #     continue
 
-                update_alpha_beta_in_cpp(intel_cpp_path, alpha_val, beta_val)
-                compile_code() # Recompile because ALPHA/BETA are macros
-
                 run_times_ms = []
                 for run_num in range(1, RUNS_PER_CONFIG + 1):
                     print(f"[RUN {run_num}/{RUNS_PER_CONFIG}] Alpha={alpha_val}, Beta={beta_val}, Prio={priority_setting}")
-                    exec_time_ms = run_qr_executable(FIXED_MATRIX_SIZE_FOR_TUNING, matrix_file)
+                    exec_time_ms = run_qr_executable(matrix_file, FIXED_THREADS_FOR_TUNING, alpha_val, beta_val, sched)
                     if exec_time_ms is not None:
                         run_times_ms.append(exec_time_ms)
                     else:
@@ -48,7 +48,6 @@ runs_per_config = 3 # Number of cycles per configuration
 # --- Paths RELATIVE TO THIS SCRIPT'S LOCATION (e.g., ParQR/scripts/) ---
 base_testcase_folder_rel = "../testcase" 
 executable_name_rel = "../a.out"        
-makefile_name_rel = "../Makefile"        
 parqr_root_dir_rel = ".."                
 # --- Absolute paths will be resolved in main() or relevant functions ---
 
@@ -60,22 +59,18 @@ ALPHA_BETA_BARRIER = {"alpha": 12, "beta": 12} # VERIFY THIS CHOICE for Barrier
 # ------------------------------------------------------------------------------
 # Helper Functions
 # ------------------------------------------------------------------------------
-def update_makefile(abs_makefile_path, source_file_name_only):
-    source_path_in_makefile = f"{source_file_name_only}" # Assumes Makefile expects src/file.cpp
-    cmd = f"sed -i 's|^MAIN_SRC * =.*|MAIN_SRC = {source_path_in_makefile}|' {abs_makefile_path}"
-    subprocess.run(cmd, shell=True, check=True)
-    print(f"[DEBUG] Updated Makefile ({abs_makefile_path}) to use {source_path_in_makefile}")
-
-def update_cpp_macro(abs_source_file_path, macro_name, macro_value):
-    regex = f"'s/^#define[[:space:]]\\+{macro_name}[[:space:]]\\+[0-9.]\\+/#define {macro_name} {macro_value}/'"
-    cmd = f"sed -i {regex} {abs_source_file_path}"
-    subprocess.run(cmd, shell=True, check=True)
-    print(f"[DEBUG] Updated {abs_source_file_path}: {macro_name}={macro_value}")
+# Threads, ALPHA, BETA and the ready queue are run-time options of a.out and
+# barrier.out (--threads, --alpha, --beta, --sched): one build serves every
+# configuration.
+def qr_options(thread_count, priority_val, alpha_val, beta_val):
+    options = ["--threads", str(thread_count), "--alpha", str(alpha_val), "--beta", str(beta_val)]
+    if priority_val is not None: # a.out: 0 = fifo, 1 = priority
+        options += ["--sched", "priority" if priority_val == 1 else "fifo"]
+    return options
 
 def compile_code_cli(abs_parqr_root_dir):
     print("[DEBUG] Compiling code...")
-    subprocess.run("make clean", shell=True, check=True, cwd=abs_parqr_root_dir)
-    ret = subprocess.run("make -j", shell=True, cwd=abs_parqr_root_dir) # Use make -j for faster compiles
+    ret = subprocess.run("make -j all barrier", shell=True, cwd=abs_parqr_root_dir)
     if ret.returncode != 0:
         print("[ERROR] Compilation failed.")
         sys.exit(1)
@@ -95,11 +90,11 @@ def get_matrix_file_path_for_exe(current_rows, current_cols, abs_parqr_root_dir,
     return os.path.join(rel_testcase_folder_from_root, f"matrix_{current_rows}x{current_cols}.txt")
 
 
-def run_executable_cli(abs_parqr_root_dir, current_rows, current_cols, matrix_file_path_for_exe):
-    # Executable is expected to be in abs_parqr_root_dir, named "a.out"
-    executable_in_cwd = "./a.out" 
+def run_executable_cli(abs_parqr_root_dir, executable_name, matrix_file_path_for_exe, options):
+    # Executable is expected to be in abs_parqr_root_dir (a.out or barrier.out)
+    executable_in_cwd = "./" + executable_name
 
-    cmd_list = [executable_in_cwd, matrix_file_path_for_exe]
+    cmd_list = [executable_in_cwd, matrix_file_path_for_exe] + options
     print(f"[DEBUG] Running command (from {abs_parqr_root_dir}): {' '.join(cmd_list)}")
     try:
         result = subprocess.run(cmd_list, capture_output=True, text=True, check=True, cwd=abs_parqr_root_dir)
@@ -123,24 +118,13 @@ def run_executable_cli(abs_parqr_root_dir, current_rows, current_cols, matrix_fi
         print("[ERROR] Time not found in executable output."); print("--- STDOUT ---"); print(result.stdout.strip()); print("--- STDERR ---"); print(result.stderr.strip())
         return None
 
-def run_scalability_experiment(abs_parqr_root_dir, abs_makefile_path, source_file_name_only, 
+def run_scalability_experiment(abs_parqr_root_dir, executable_name, 
                                current_matrix_size, thread_count, priority_val, alpha_val, beta_val):
-    # Path to the specific C++ source file (e.g., intel.cpp, barrier_main.cpp)
-    abs_source_file_path = os.path.join(abs_parqr_root_dir, source_file_name_only)
-
-    update_makefile(abs_makefile_path, source_file_name_only)
-    update_cpp_macro(abs_source_file_path, "NUM_THREADS", thread_count)
-    if priority_val is not None: # For intel.cpp
-        update_cpp_macro(abs_source_file_path, "USE_PRIORITY_MAIN_QUEUE", priority_val)
-    update_cpp_macro(abs_source_file_path, "ALPHA", alpha_val)
-    update_cpp_macro(abs_source_file_path, "BETA", beta_val)
-
-    compile_code_cli(abs_parqr_root_dir)
-    
     # Get matrix path relative to project root, as expected by executable
     matrix_file_for_exe = get_matrix_file_path_for_exe(current_matrix_size, current_matrix_size, abs_parqr_root_dir)
     
-    exec_time = run_executable_cli(abs_parqr_root_dir, current_matrix_size, current_matrix_size, matrix_file_for_exe)
+    exec_time = run_executable_cli(abs_parqr_root_dir, executable_name, matrix_file_for_exe,
+                                   qr_options(thread_count, priority_val, alpha_val, beta_val))
     return exec_time
 
 # ------------------------------------------------------------------------------
@@ -153,24 +137,18 @@ def main():
 
     abs_parqr_root_dir = os.path.abspath(parqr_root_dir_rel)
     abs_executable_path = os.path.join(abs_parqr_root_dir, executable_name_rel.lstrip("../").lstrip("./"))
-    abs_makefile_path = os.path.join(abs_parqr_root_dir, makefile_name_rel.lstrip("../").lstrip("./"))
     # --- End of path resolution ---
 
+    # One build of a.out and barrier.out: no configuration needs a rebuild.
+    compile_code_cli(abs_parqr_root_dir)
     if not os.path.exists(abs_executable_path):
-        print(f"[INFO] Executable not found at {abs_executable_path}. Attempting initial compile...")
-        compile_code_cli(abs_parqr_root_dir) 
-        if not os.path.exists(abs_executable_path):
-             print(f"[ERROR] Executable still not found at {abs_executable_path} after compile. Exiting.")
-             sys.exit(1)
-        else:
-            print(f"[INFO] Executable found at {abs_executable_path} after compilation.")
-    else:
-        print(f"[INFO] Executable found at {abs_executable_path}.")
+        print(f"[ERROR] Executable not found at {abs_executable_path} after compile. Exiting.")
+        sys.exit(1)
 
 
     all_run_data = []
-    intel_source_name = "intel.cpp" # Just the filename
-    barrier_source_name = "barrier_main.cpp" # Just the filename
+    intel_executable_name = "a.out" # Just the filename
+    barrier_executable_name = "barrier.out" # Just the filename
 
     for threads in fixed_thread_counts:
         print(f"\n[INFO] Starting experiments for {threads} THREADS\n" + "="*50)
@@ -181,21 +159,21 @@ def main():
 
                 # 1. Without Priority
                 ab_np = ALPHA_BETA_NO_PRIORITY
-                time_val = run_scalability_experiment(abs_parqr_root_dir, abs_makefile_path, intel_source_name, 
+                time_val = run_scalability_experiment(abs_parqr_root_dir, intel_executable_name, 
                                                       m_size, threads, 0, ab_np["alpha"], ab_np["beta"])
                 print(f"  Without Priority ({ab_np['alpha']},{ab_np['beta']}), {threads} Thr, {m_size}x{m_size} => {time_val} ms")
                 if time_val is not None: all_run_data.append({"Method": "Without Priority", "MatrixSize": m_size, "Threads": threads, "Time_ms": time_val})
 
                 # 2. With Priority
                 ab_wp = ALPHA_BETA_WITH_PRIORITY
-                time_val = run_scalability_experiment(abs_parqr_root_dir, abs_makefile_path, intel_source_name, 
+                time_val = run_scalability_experiment(abs_parqr_root_dir, intel_executable_name, 
                                                       m_size, threads, 1, ab_wp["alpha"], ab_wp["beta"])
                 print(f"  With Priority ({ab_wp['alpha']},{ab_wp['beta']}), {threads} Thr, {m_size}x{m_size} => {time_val} ms")
                 if time_val is not None: all_run_data.append({"Method": "With Priority", "MatrixSize": m_size, "Threads": threads, "Time_ms": time_val})
                 
                 # 3. Barrier
                 ab_b = ALPHA_BETA_BARRIER
-                time_val = run_scalability_experiment(abs_parqr_root_dir, abs_makefile_path, barrier_source_name, 
+                time_val = run_scalability_experiment(abs_parqr_root_dir, barrier_executable_name, 
                                                       m_size, threads, None, ab_b["alpha"], ab_b["beta"])
                 print(f"  Barrier ({ab_b['alpha']},{ab_b['beta']}), {threads} Thr, {m_size}x{m_size} => {time_val} ms")
                 if time_val is not None: all_run_data.append({"Method": "Barrier", "MatrixSize": m_size, "Threads": threads, "Time_ms": time_val})
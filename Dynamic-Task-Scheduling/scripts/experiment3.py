@@ -39,7 +39,6 @@ runs_per_config = 3
 # --- Paths RELATIVE TO THIS SCRIPT'S LOCATION (e.g., ParQR/scripts/) ---
 base_testcase_folder_rel = "../testcase" 
 executable_name_rel = "../a.out"        
-makefile_name_rel = "../Makefile"        
 parqr_root_dir_rel = ".."                
 # --- Absolute paths will be resolved in main() or relevant functions ---
 
@@ -53,17 +52,17 @@ thread_configs_for_fig5_plot = [4, 24, 44, 64, 84, 100]
 # If these (32,32) and (16,16) are NOT those optimal ones, you should adjust them
 # or add runs for the actual optimal ones (e.g., 12,12 for no-prio, 30,30 for prio).
 ALPHA_BETA_CONFIGS = {
-    "intel_32_np": {"alpha": 32, "beta": 32, "prio": 0, "source_file": "intel.cpp", "label": "Intel 32,32 (no prio)", "method_label": "Without Priority (32,32)"},
-    "intel_32_wp": {"alpha": 32, "beta": 32, "prio": 1, "source_file": "intel.cpp", "label": "Intel 32,32 (with prio)", "method_label": "With Priority (32,32)"},
-    #"intel_16_np": {"alpha": 16, "beta": 16, "prio": 0, "source_file": "intel.cpp", "label": "Intel 16,16 (no prio)", "method_label": "Without Priority (16,16)"},
-    #"intel_16_wp": {"alpha": 16, "beta": 16, "prio": 1, "source_file": "intel.cpp", "label": "Intel 16,16 (with prio)", "method_label": "With Priority (16,16)"},
-    "barrier_32":  {"alpha": 32, "beta": 32, "prio": None, "source_file": "barrier_main.cpp", "label": "Barrier 32,32", "method_label": "Barrier (32,32)"},
-    #"barrier_16":  {"alpha": 16, "beta": 16, "prio": None, "source_file": "barrier_main.cpp", "label": "Barrier 16,16", "method_label": "Barrier (16,16)"},
+    "intel_32_np": {"alpha": 32, "beta": 32, "prio": 0, "executable": "a.out", "label": "Intel 32,32 (no prio)", "method_label": "Without Priority (32,32)"},
+    "intel_32_wp": {"alpha": 32, "beta": 32, "prio": 1, "executable": "a.out", "label": "Intel 32,32 (with prio)", "method_label": "With Priority (32,32)"},
+    #"intel_16_np": {"alpha": 16, "beta": 16, "prio": 0, "executable": "a.out", "label": "Intel 16,16 (no prio)", "method_label": "Without Priority (16,16)"},
+    #"intel_16_wp": {"alpha": 16, "beta": 16, "prio": 1, "executable": "a.out", "label": "Intel 16,16 (with prio)", "method_label": "With Priority (16,16)"},
+    "barrier_32":  {"alpha": 32, "beta": 32, "prio": None, "executable": "barrier.out", "label": "Barrier 32,32", "method_label": "Barrier (32,32)"},
+    #"barrier_16":  {"alpha": 16, "beta": 16, "prio": None, "executable": "barrier.out", "label": "Barrier 16,16", "method_label": "Barrier (16,16)"},
     # --- ADD OPTIMAL CONFIGS HERE IF DIFFERENT FOR FIG 5 ---
     # Example for optimal values from Exp 4.2 (Parameter Tuning)
-    # "intel_optimal_np": {"alpha": 12, "beta": 12, "prio": 0, "source_file": "intel.cpp", "label": "Intel Optimal (no prio)", "method_label": "Without Priority (Optimal)"},
-    # "intel_optimal_wp": {"alpha": 30, "beta": 30, "prio": 1, "source_file": "intel.cpp", "label": "Intel Optimal (with prio)", "method_label": "With Priority (Optimal)"},
-    # "barrier_optimal":  {"alpha": 12, "beta": 12, "prio": None, "source_file": "barrier_main.cpp", "label": "Barrier Optimal", "method_label": "Barrier (Optimal)"},
+    # "intel_optimal_np": {"alpha": 12, "beta": 12, "prio": 0, "executable": "a.out", "label": "Intel Optimal (no prio)", "method_label": "Without Priority (Optimal)"},
+    # "intel_optimal_wp": {"alpha": 30, "beta": 30, "prio": 1, "executable": "a.out", "label": "Intel Optimal (with prio)", "method_label": "With Priority (Optimal)"},
+    # "barrier_optimal":  {"alpha": 12, "beta": 12, "prio": None, "executable": "barrier.out", "label": "Barrier Optimal", "method_label": "Barrier (Optimal)"},
 }
 # Which configurations to use for the main Figure 5 plot
 # UPDATE THESE KEYS TO POINT TO THE "OPTIMAL" CONFIGURATIONS IF YOU ADD THEM ABOVE
@@ -76,22 +75,18 @@ FIG5_PLOT_KEYS = {
 # ------------------------------------------------------------------------------
 # Helper Functions
 # ------------------------------------------------------------------------------
-def update_makefile(abs_makefile_path, source_file_name_only):
-    # MAIN_SRC in Makefile expects just the filename (e.g., intel.cpp) as .cpp files are in root
-    cmd = f"sed -i 's|^MAIN_SRC * =.*|MAIN_SRC = {source_file_name_only}|' {abs_makefile_path}"
-    subprocess.run(cmd, shell=True, check=True)
-    print(f"[DEBUG] Updated Makefile ({abs_makefile_path}) to use {source_file_name_only}")
-
-def update_cpp_macro(abs_source_file_path, macro_name, macro_value):
-    regex = f"'s/^#define[[:space:]]\\+{macro_name}[[:space:]]\\+[0-9.]\\+/#define {macro_name} {macro_value}/'"
-    cmd = f"sed -i {regex} {abs_source_file_path}"
-    subprocess.run(cmd, shell=True, check=True)
-    print(f"[DEBUG] Updated {abs_source_file_path}: {macro_name}={macro_value}")
+# Threads, ALPHA, BETA and the ready queue are run-time options of a.out and
+# barrier.out (--threads, --alpha, --beta, --sched): one build serves every
+# configuration.
+def qr_options(thread_count, priority_val, alpha_val, beta_val):
+    options = ["--threads", str(thread_count), "--alpha", str(alpha_val), "--beta", str(beta_val)]
+    if priority_val is not None: # a.out: 0 = fifo, 1 = priority
+        options += ["--sched", "priority" if priority_val == 1 else "fifo"]
+    return options
 
 def compile_code_cli(abs_parqr_root_dir):
     print("[DEBUG] Compiling code...")
-    subprocess.run("make clean", shell=True, check=True, cwd=abs_parqr_root_dir)
-    ret = subprocess.run("make -j", shell=True, cwd=abs_parqr_root_dir)
+    ret = subprocess.run("make -j all barrier", shell=True, cwd=abs_parqr_root_dir)
     if ret.returncode != 0: print("[ERROR] Compilation failed."); sys.exit(1)
     print("[DEBUG] Compilation succeeded.")
 
@@ -102,9 +97,9 @@ def get_matrix_file_path_for_exe(current_rows, current_cols, abs_parqr_root_dir,
     if not os.path.exists(matrix_file_abs_path): print(f"[ERROR] Matrix file {matrix_file_abs_path} still not found."); sys.exit(1)
     return os.path.join(rel_testcase_folder_from_root, f"matrix_{current_rows}x{current_cols}.txt")
 
-def run_executable_cli(abs_parqr_root_dir, current_rows, current_cols, matrix_file_path_for_exe):
-    executable_in_cwd = "./a.out" 
-    cmd_list = [executable_in_cwd, matrix_file_path_for_exe]
+def run_executable_cli(abs_parqr_root_dir, executable_name, matrix_file_path_for_exe, options):
+    executable_in_cwd = "./" + executable_name
+    cmd_list = [executable_in_cwd, matrix_file_path_for_exe] + options
     print(f"[DEBUG] Running command (from {abs_parqr_root_dir}): {' '.join(cmd_list)}")
     try:
         result = subprocess.run(cmd_list, capture_output=True, text=True, check=True, cwd=abs_parqr_root_dir)
@@ -116,28 +111,19 @@ def run_executable_cli(abs_parqr_root_dir, current_rows, current_cols, matrix_fi
     if match: return float(match.group(1))
     else: print("[ERROR] Time not found in output."); print("--- STDOUT ---"); print(result.stdout.strip()); print("--- STDERR ---"); print(result.stderr.strip()); return None
 
-def run_throughput_experiment(abs_parqr_root_dir, abs_makefile_path, source_file_name_only, 
+def run_throughput_experiment(abs_parqr_root_dir, executable_name, 
                               thread_count, priority_val, alpha_val, beta_val):
-    # .cpp files are in the abs_parqr_root_dir
-    abs_source_file_path = os.path.join(abs_parqr_root_dir, source_file_name_only)
-
-    update_makefile(abs_makefile_path, source_file_name_only) # Pass only filename
-    update_cpp_macro(abs_source_file_path, "NUM_THREADS", thread_count)
-    if priority_val is not None:
-        update_cpp_macro(abs_source_file_path, "USE_PRIORITY_MAIN_QUEUE", priority_val)
-    update_cpp_macro(abs_source_file_path, "ALPHA", alpha_val)
-    update_cpp_macro(abs_source_file_path, "BETA", beta_val)
-    
-    compile_code_cli(abs_parqr_root_dir)
+    # The executables are in the abs_parqr_root_dir
     matrix_file_for_exe = get_matrix_file_path_for_exe(fixed_matrix_size, fixed_matrix_size, abs_parqr_root_dir)
-    exec_time = run_executable_cli(abs_parqr_root_dir, fixed_matrix_size, fixed_matrix_size, matrix_file_for_exe)
+    exec_time = run_executable_cli(abs_parqr_root_dir, executable_name, matrix_file_for_exe,
+                                   qr_options(thread_count, priority_val, alpha_val, beta_val))
     return exec_time
 
 # ------------------------------------------------------------------------------
 # Main Experiment Execution
 # ------------------------------------------------------------------------------
 # ... (all helper functions and global parameters from your script remain unchanged) ...
-# generate_matrix_if_needed, ALPHA_BETA_CONFIGS, FIG5_PLOT_KEYS, update_makefile, etc.
+# generate_matrix_if_needed, ALPHA_BETA_CONFIGS, FIG5_PLOT_KEYS, qr_options, etc.
 
 # ------------------------------------------------------------------------------
 # Main Experiment Execution (Reordered for Experiment 4)
@@ -148,18 +134,12 @@ def main():
 
     abs_parqr_root_dir = os.path.abspath(parqr_root_dir_rel)
     abs_executable_path = os.path.join(abs_parqr_root_dir, executable_name_rel.lstrip("../").lstrip("./"))
-    abs_makefile_path = os.path.join(abs_parqr_root_dir, makefile_name_rel.lstrip("../").lstrip("./"))
 
-    if not os.path.exists(abs_executable_path):
-        print(f"[INFO] Executable not found at {abs_executable_path}. Attempting initial compile...")
-        compile_code_cli(abs_parqr_root_dir)
-        if not os.path.exists(abs_executable_path): 
-            print(f"[ERROR] Executable still not found at {abs_executable_path}. Exiting.")
-            sys.exit(1)
-        else: 
-            print(f"[INFO] Executable found at {abs_executable_path} after compilation.")
-    else: 
-        print(f"[INFO] Executable found at {abs_executable_path}.")
+    # One build of a.out and barrier.out: no configuration needs a rebuild.
+    compile_code_cli(abs_parqr_root_dir)
+    if not os.path.exists(abs_executable_path): 
+        print(f"[ERROR] Executable not found at {abs_executable_path} after compile. Exiting.")
+        sys.exit(1)
 
     all_run_data = [] # This will store data from EACH individual run (not averaged yet)
 
@@ -170,10 +150,10 @@ def main():
             print(f"[INFO] --- Cycle {cycle}/{runs_per_config} for {threads} THREADS ---")
             # Loop through all defined Alpha/Beta configurations for this cycle
             for config_key, params in ALPHA_BETA_CONFIGS.items():
-                current_source_name = params["source_file"]
+                current_executable_name = params["executable"]
                 
                 print(f"[INFO] Running Config: {params['label']}, Threads: {threads}")
-                time_val = run_throughput_experiment(abs_parqr_root_dir, abs_makefile_path, current_source_name, 
+                time_val = run_throughput_experiment(abs_parqr_root_dir, current_executable_name, 
                                                      threads, params["prio"], params["alpha"], params["beta"])
                 print(f"  => {time_val} ms")
                 
@@ -0,0 +1,174 @@
+#include "barrier_qr.h"
+
+#include <chrono>
+#include <pthread.h>
+#include <type_traits>
+
+#include "householder.h"
+#include "perf_counters.h"
+
+namespace {
+
+// State shared by the workers of one call.
+template <class T>
+struct barrier_job_t {
+    TaskTable table;
+    T* mat = nullptr;
+    int n = 0;                  // Row stride of mat.
+    T* up = nullptr;
+    T* b = nullptr;
+    T* t = nullptr;             // update_t::wy: the T factor of every panel.
+    size_t t_stride = 0;
+    bool wy = false;
+    int num_threads = 0;
+    task_kernels_t<T> kernels;
+    std::vector<int> cpus;
+    pthread_barrier_t barrier;
+    std::vector<PerfAccumulator> perf;  // With --perf; time in barriers counts as scheduling.
+};
+
+template <class T>
+struct thread_args_t {
+    barrier_job_t<T>* job;
+    int tid;
+};
+
+template <class T>
+void* thdwork(void* arg) {
+    thread_args_t<T>* args = static_cast<thread_args_t<T>*>(arg);
+    barrier_job_t<T>& job = *args->job;
+    int tid = args->tid;
+    const TaskTable& table = job.table;
+
+    pin_current_thread(job.cpus[tid]);
+    PerfAccumulator* perf = job.perf.empty() ? nullptr : &job.perf[tid];
+    if (perf) {
+        perf->start();
+    }
+    pthread_barrier_wait(&job.barrier);
+
+    for (int j = 0; j < table.cols(); j++) {
+        // Task row of the panel of pivot block j; the rows above have no task here.
+        int panel = 0;
+        while (table.getTask(panel, j) == nullptr) {
+            panel++;
+        }
+
+        if (tid == 0) {
+            Task* first_task = table.getTask(panel, j);
+            if (perf) {
+                perf->charge(perf_category_t::scheduler);
+            }
+            job.kernels.task1(job.mat, job.n, first_task->row_start, first_task->row_end, first_task->col_end,
+                              job.up, job.b);
+            if (job.wy) {
+                build_block_reflector(job.mat, job.n, first_task->row_start, first_task->row_end, job.up, job.b,
+                                      job.t + j * job.t_stride);
+            }
+            if (perf) {
+                perf->charge(perf_category_t::type1);
+            }
+        }
+        pthread_barrier_wait(&job.barrier);
+
+        for (int i = panel + 1 + tid; i < table.rows(); i += job.num_threads) {
+            Task* task = table.getTask(i, j);
+            if (perf) {
+                perf->charge(perf_category_t::scheduler);
+            }
+            if (job.wy) {
+                job.kernels.task2_wy(job.mat, job.n, task->row_start, task->row_end, task->col_start, task->col_end,
+                                     job.up, job.t + j * job.t_stride);
+            } else {
+                job.kernels.task2(job.mat, job.n, task->row_start, task->row_end, task->col_start, task->col_end,
+                                  job.up, job.b);
+            }
+            if (perf) {
+                perf->charge(perf_category_t::type2);
+            }
+        }
+        pthread_barrier_wait(&job.barrier);
+    }
+
+    if (perf) {
+        perf->stop();
+    }
+    return nullptr;
+}
+
+} // namespace
+
+template <class T>
+qr_run_stats_t factorize_barrier(matrix_t<T>& mat, const qr_params_t& params) {
+    qr_factors_t<T> factors;
+    return factorize_barrier(mat, params, factors);
+}
+
+template <class T>
+qr_run_stats_t factorize_barrier(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors) {
+    params.validate();
+    if (!params.trace.empty() || params.batch > 1 || params.tsqr_leaf > 0 || params.offload != offload_device_t::none) {
+        throw std::invalid_argument("--trace, --batch, --tsqr and --offload are only supported by the dynamic "
+                                    "scheduler.");
+    }
+
+    barrier_job_t<T> job;
+    int task_cols = params.task_cols(mat.rows(), mat.cols());
+    job.table.init(params.task_rows(mat.rows()), task_cols, params.alpha, params.beta, mat);
+    job.wy = params.update == update_t::wy;
+    job.t_stride = static_cast<size_t>(params.alpha) * params.alpha;
+    factors.up.assign(mat.rows(), 0.0);
+    factors.b.assign(mat.rows(), 0.0);
+    if (job.wy) {
+        factors.t.assign(task_cols * job.t_stride, 0.0);
+    } else {
+        factors.t.clear();
+    }
+    job.mat = mat.data_ptr();
+    job.n = mat.ld();
+    job.up = factors.up.data();
+    job.b = factors.b.data();
+    job.t = factors.t.data();
+    job.num_threads = params.num_threads;
+    job.kernels = select_task_kernels<T>(params.alpha, params.beta, params.simd);
+    job.cpus = affinity_map(params.affinity, params.num_threads);
+    if (!params.perf.empty()) {
+        job.perf = std::vector<PerfAccumulator>(params.num_threads);
+    }
+
+    qr_run_stats_t stats;
+    stats.matrices = 1;
+    stats.tasks = job.table.numTasks();
+    stats.workers = params.num_threads;
+
+    std::vector<pthread_t> threads(params.num_threads);
+    std::vector<thread_args_t<T>> args(params.num_threads);
+    pthread_barrier_init(&job.barrier, NULL, params.num_threads);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < params.num_threads; i++) {
+        args[i] = {&job, i};
+        pthread_create(&threads[i], NULL, thdwork<T>, &args[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    pthread_barrier_destroy(&job.barrier);
+
+    if (!job.perf.empty()) {
+        qr_params_t described = params;
+        described.precision = std::is_same<T, float>::value ? precision_t::f32 : precision_t::f64;
+        auto run = describe_qr_params(described);
+        run.insert(run.begin(), {{"program", "barrier"}, {"matrix", params.label},
+                                 {"rows", std::to_string(mat.rows())}});
+        write_perf_report(params.perf, job.perf, stats.elapsed_ms, run);
+    }
+    return stats;
+}
+
+template qr_run_stats_t factorize_barrier(matrix_t<double>&, const qr_params_t&);
+template qr_run_stats_t factorize_barrier(matrix_t<float>&, const qr_params_t&);
+template qr_run_stats_t factorize_barrier(matrix_t<double>&, const qr_params_t&, qr_factors_t<double>&);
+template qr_run_stats_t factorize_barrier(matrix_t<float>&, const qr_params_t&, qr_factors_t<float>&);
@@ -0,0 +1,96 @@
+// AVX2 + FMA Householder kernels. Built with -mavx2 -mfma (see the Makefile)
+// and only called after select_task_kernels() checked the CPU.
+
+#include "householder.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct avx2_vec {
+    typedef double scalar;
+    typedef __m256d vec;
+    static constexpr int W = 4;
+
+    static vec zero() { return _mm256_setzero_pd(); }
+    static vec set1(double x) { return _mm256_set1_pd(x); }
+    static vec load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, vec x) { _mm256_storeu_pd(p, x); }
+    static vec fmadd(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+    static vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+    static vec max(vec a, vec b) { return _mm256_max_pd(a, b); }
+    static vec abs(vec x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+
+    static double hsum(vec x)
+    {
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+
+    static double hmax(vec x)
+    {
+        __m128d m = _mm_max_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+        return _mm_cvtsd_f64(_mm_max_sd(m, _mm_unpackhi_pd(m, m)));
+    }
+};
+
+struct avx2_vecf {
+    typedef float scalar;
+    typedef __m256 vec;
+    static constexpr int W = 8;
+
+    static vec zero() { return _mm256_setzero_ps(); }
+    static vec set1(float x) { return _mm256_set1_ps(x); }
+    static vec load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, vec x) { _mm256_storeu_ps(p, x); }
+    static vec fmadd(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+    static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+    static vec max(vec a, vec b) { return _mm256_max_ps(a, b); }
+    static vec abs(vec x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+
+    static float hsum(vec x)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehdup_ps(s)));
+    }
+
+    static float hmax(vec x)
+    {
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        return _mm_cvtss_f32(_mm_max_ss(m, _mm_movehdup_ps(m)));
+    }
+};
+
+} // namespace
+
+#include "householder_simd_impl.h"
+
+bool select_task_kernels_avx2(int alpha, int beta, task_kernels_t<double>& k)
+{
+    k = simd_select<avx2_vec>(alpha, beta);
+    return true;
+}
+
+bool select_task_kernels_avx2(int alpha, int beta, task_kernels_t<float>& k)
+{
+    k = simd_select<avx2_vecf>(alpha, beta);
+    return true;
+}
+
+#else
+
+bool select_task_kernels_avx2(int, int, task_kernels_t<double>&)
+{
+    return false;
+}
+
+bool select_task_kernels_avx2(int, int, task_kernels_t<float>&)
+{
+    return false;
+}
+
+#endif
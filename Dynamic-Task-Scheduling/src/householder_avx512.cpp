@@ -0,0 +1,111 @@
+// AVX-512 Householder kernels. Built with -mavx512f (see the Makefile) and
+// only called after select_task_kernels() checked the CPU.
+
+#include "householder.h"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct avx512_vec {
+    typedef double scalar;
+    typedef __m512d vec;
+    static constexpr int W = 8;
+
+    static vec zero() { return _mm512_setzero_pd(); }
+    static vec set1(double x) { return _mm512_set1_pd(x); }
+    static vec load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, vec x) { _mm512_storeu_pd(p, x); }
+    static vec fmadd(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+    static vec add(vec a, vec b) { return _mm512_add_pd(a, b); }
+    static vec max(vec a, vec b) { return _mm512_mask_max_pd(a, (__mmask8)-1, a, b); } // unmasked form trips -Wmaybe-uninitialized on GCC 12
+    static vec abs(vec x) { return _mm512_abs_pd(x); }
+
+    // Through memory: GCC 12 warns about _mm512_reduce_*_pd (-Wmaybe-uninitialized).
+    static double hsum(vec x)
+    {
+        alignas(64) double t[W];
+        _mm512_store_pd(t, x);
+        return ((t[0] + t[4]) + (t[1] + t[5])) + ((t[2] + t[6]) + (t[3] + t[7]));
+    }
+
+    static double hmax(vec x)
+    {
+        alignas(64) double t[W];
+        _mm512_store_pd(t, x);
+        double m = t[0];
+        for (int i = 1; i < W; i++) {
+            m = t[i] > m ? t[i] : m;
+        }
+        return m;
+    }
+};
+
+struct avx512_vecf {
+    typedef float scalar;
+    typedef __m512 vec;
+    static constexpr int W = 16;
+
+    static vec zero() { return _mm512_setzero_ps(); }
+    static vec set1(float x) { return _mm512_set1_ps(x); }
+    static vec load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, vec x) { _mm512_storeu_ps(p, x); }
+    static vec fmadd(vec a, vec b, vec c) { return _mm512_fmadd_ps(a, b, c); }
+    static vec add(vec a, vec b) { return _mm512_add_ps(a, b); }
+    static vec max(vec a, vec b) { return _mm512_mask_max_ps(a, (__mmask16)-1, a, b); } // as avx512_vec::max
+    static vec abs(vec x) { return _mm512_abs_ps(x); }
+
+    static float hsum(vec x)
+    {
+        alignas(64) float t[W];
+        _mm512_store_ps(t, x);
+        float s[8];
+        for (int i = 0; i < 8; i++) {
+            s[i] = t[i] + t[i + 8];
+        }
+        return ((s[0] + s[4]) + (s[1] + s[5])) + ((s[2] + s[6]) + (s[3] + s[7]));
+    }
+
+    static float hmax(vec x)
+    {
+        alignas(64) float t[W];
+        _mm512_store_ps(t, x);
+        float m = t[0];
+        for (int i = 1; i < W; i++) {
+            m = t[i] > m ? t[i] : m;
+        }
+        return m;
+    }
+};
+
+} // namespace
+
+#include "householder_simd_impl.h"
+
+bool select_task_kernels_avx512(int alpha, int beta, task_kernels_t<double>& k)
+{
+    k = simd_select<avx512_vec>(alpha, beta);
+    return true;
+}
+
+bool select_task_kernels_avx512(int alpha, int beta, task_kernels_t<float>& k)
+{
+    k = simd_select<avx512_vecf>(alpha, beta);
+    return true;
+}
+
+#else
+
+bool select_task_kernels_avx512(int, int, task_kernels_t<double>&)
+{
+    return false;
+}
+
+bool select_task_kernels_avx512(int, int, task_kernels_t<float>&)
+{
+    return false;
+}
+
+#endif
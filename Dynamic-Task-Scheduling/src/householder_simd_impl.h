@@ -0,0 +1,627 @@
+#pragma once
+
+// SIMD Householder kernels, included by householder_avx2.cpp and
+// householder_avx512.cpp. Each of them defines traits structs V for its
+// instruction set, one per scalar type (scalar, vec, W, zero, set1, load,
+// store, fmadd, add, abs, max, hsum, hmax), and is compiled with the matching -m flags; everything here is
+// in an anonymous namespace, and no std templates with out-of-line bodies
+// are instantiated, so no code built for one ISA can be picked by the
+// linker for another.
+//
+// Compared to the scalar kernels in householder.h:
+//  - rows are processed in groups of up to 4, so every load of a pivot row
+//    is shared by 4 dot products or 4 axpys;
+//  - the axpy that applies pivot p to a row is fused with the dot product of
+//    the updated row against the next pivot q, so a type-2 task sweeps its
+//    rows once per pivot instead of twice;
+//  - in a type-1 task the update of the next pivot row is fused with the
+//    norm needed to build its reflector.
+// A row whose dot product is zero gets a zero-scaled axpy instead of being
+// skipped, which leaves it unchanged.
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <type_traits>
+
+#include "householder.h"
+
+namespace {
+
+// out[k] = sum_i v[i] * r[k][i]
+template <class V, int NR, class T = typename V::scalar>
+inline void dot_rows(const T* v, T* const* r, int len, T* out)
+{
+    typename V::vec acc0[NR], acc1[NR];
+    for (int k = 0; k < NR; k++) {
+        acc0[k] = V::zero();
+        acc1[k] = V::zero();
+    }
+
+    int i = 0;
+    for (; i + 2 * V::W <= len; i += 2 * V::W) {
+        typename V::vec v0 = V::load(v + i);
+        typename V::vec v1 = V::load(v + i + V::W);
+        for (int k = 0; k < NR; k++) {
+            acc0[k] = V::fmadd(v0, V::load(r[k] + i), acc0[k]);
+            acc1[k] = V::fmadd(v1, V::load(r[k] + i + V::W), acc1[k]);
+        }
+    }
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec v0 = V::load(v + i);
+        for (int k = 0; k < NR; k++) {
+            acc0[k] = V::fmadd(v0, V::load(r[k] + i), acc0[k]);
+        }
+    }
+
+    for (int k = 0; k < NR; k++) {
+        out[k] = V::hsum(V::add(acc0[k], acc1[k]));
+    }
+    for (; i < len; i++) {
+        for (int k = 0; k < NR; k++) {
+            out[k] += v[i] * r[k][i];
+        }
+    }
+}
+
+// r[k][i] += s[k] * v[i]
+template <class V, int NR, class T = typename V::scalar>
+inline void axpy_rows(const T* v, T* const* r, const T* s, int len)
+{
+    typename V::vec vs[NR];
+    for (int k = 0; k < NR; k++) {
+        vs[k] = V::set1(s[k]);
+    }
+
+    int i = 0;
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec v0 = V::load(v + i);
+        for (int k = 0; k < NR; k++) {
+            V::store(r[k] + i, V::fmadd(vs[k], v0, V::load(r[k] + i)));
+        }
+    }
+    for (; i < len; i++) {
+        for (int k = 0; k < NR; k++) {
+            r[k][i] += s[k] * v[i];
+        }
+    }
+}
+
+// r[k][i] += s[k] * v[i], then out[k] = sum_i r[k][i] * w[i] over the updated rows.
+template <class V, int NR, class T = typename V::scalar>
+inline void axpy_dot_rows(const T* v, const T* w, T* const* r, const T* s, int len, T* out)
+{
+    typename V::vec vs[NR], acc[NR];
+    for (int k = 0; k < NR; k++) {
+        vs[k] = V::set1(s[k]);
+        acc[k] = V::zero();
+    }
+
+    int i = 0;
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec v0 = V::load(v + i);
+        typename V::vec w0 = V::load(w + i);
+        for (int k = 0; k < NR; k++) {
+            typename V::vec x = V::fmadd(vs[k], v0, V::load(r[k] + i));
+            V::store(r[k] + i, x);
+            acc[k] = V::fmadd(x, w0, acc[k]);
+        }
+    }
+
+    for (int k = 0; k < NR; k++) {
+        out[k] = V::hsum(acc[k]);
+    }
+    for (; i < len; i++) {
+        for (int k = 0; k < NR; k++) {
+            T x = r[k][i] + s[k] * v[i];
+            r[k][i] = x;
+            out[k] += x * w[i];
+        }
+    }
+}
+
+// Max |r[i]| and sum r[i]^2, the inputs of a reflector.
+template <class V, class T = typename V::scalar>
+inline void norm_row(const T* r, int len, T& maxabs, T& sumsq)
+{
+    typename V::vec vmax = V::zero(), vsum = V::zero();
+    int i = 0;
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec x = V::load(r + i);
+        vmax = V::max(vmax, V::abs(x));
+        vsum = V::fmadd(x, x, vsum);
+    }
+    maxabs = V::hmax(vmax);
+    sumsq = V::hsum(vsum);
+    for (; i < len; i++) {
+        maxabs = std::fmax(maxabs, std::fabs(r[i]));
+        sumsq += r[i] * r[i];
+    }
+}
+
+// r[i] += s * v[i], returning the norm inputs of the updated row.
+template <class V, class T = typename V::scalar>
+inline void axpy_norm_row(const T* v, T* r, T s, int len, T& maxabs, T& sumsq)
+{
+    typename V::vec vs = V::set1(s), vmax = V::zero(), vsum = V::zero();
+    int i = 0;
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec x = V::fmadd(vs, V::load(v + i), V::load(r + i));
+        V::store(r + i, x);
+        vmax = V::max(vmax, V::abs(x));
+        vsum = V::fmadd(x, x, vsum);
+    }
+    maxabs = V::hmax(vmax);
+    sumsq = V::hsum(vsum);
+    for (; i < len; i++) {
+        T x = r[i] + s * v[i];
+        r[i] = x;
+        maxabs = std::fmax(maxabs, std::fabs(x));
+        sumsq += x * x;
+    }
+}
+
+// The reflector of make_reflector() built from precomputed norm inputs of
+// the part of the row right of the pivot.
+template <class T>
+inline bool reflector_from_norm(T* pivot, T maxabs, T sumsq, T& up, T& b)
+{
+    T cl = std::fmax(std::fabs(*pivot), maxabs);
+    if (cl <= 0.0) {
+        return false;
+    }
+    T clinv = 1.0 / cl;
+
+    T d__1 = *pivot * clinv;
+    T sm = d__1 * d__1;
+    sm += sumsq * clinv * clinv;
+
+    cl *= std::sqrt(sm);
+    if (*pivot > 0.0) {
+        cl = -cl;
+    }
+
+    up = *pivot - cl;
+    *pivot = cl;
+
+    b = up * cl;
+    if (b >= 0.0) {
+        return false;
+    }
+    b = 1.0 / b;
+    return true;
+}
+
+template <int NR, class T>
+inline void row_ptrs(T* mat, int n, int j, int offset, T** r)
+{
+    for (int k = 0; k < NR; k++) {
+        r[k] = mat + (index_t)(j + k) * n + offset;
+    }
+}
+
+// s[k] = dot of rows j..j+NR-1 with the reflector of pivot p.
+template <class V, int NR, class T = typename V::scalar>
+inline void rows_dot(T* mat, int n, int p, T up, int j, T* s)
+{
+    T* r[NR];
+    row_ptrs<NR>(mat, n, j, p + 1, r);
+    dot_rows<V, NR>(mat + (index_t)p * n + p + 1, r, n - p - 1, s);
+    for (int k = 0; k < NR; k++) {
+        s[k] += mat[(index_t)(j + k) * n + p] * up;
+    }
+}
+
+// Applies pivot p (with scaled dots s) to rows j..j+NR-1.
+template <class V, int NR, class T = typename V::scalar>
+inline void rows_apply(T* mat, int n, int p, T up, int j, const T* s)
+{
+    T* r[NR];
+    for (int k = 0; k < NR; k++) {
+        mat[(index_t)(j + k) * n + p] += s[k] * up;
+    }
+    row_ptrs<NR>(mat, n, j, p + 1, r);
+    axpy_rows<V, NR>(mat + (index_t)p * n + p + 1, r, s, n - p - 1);
+}
+
+// Applies pivot p (scaled dots s) to rows j..j+NR-1 and returns in next their
+// dots with the reflector of a later pivot q.
+template <class V, int NR, class T = typename V::scalar>
+inline void rows_apply_dot(T* mat, int n, int p, T up, int q, T upq, int j, const T* s, T* next)
+{
+    const T* v = mat + (index_t)p * n;
+    const T* w = mat + (index_t)q * n;
+    T* r[NR];
+
+    for (int k = 0; k < NR; k++) {
+        mat[(index_t)(j + k) * n + p] += s[k] * up;
+    }
+    if (q > p + 1) {
+        row_ptrs<NR>(mat, n, j, p + 1, r);
+        axpy_rows<V, NR>(v + p + 1, r, s, q - p - 1);
+    }
+    for (int k = 0; k < NR; k++) {
+        mat[(index_t)(j + k) * n + q] += s[k] * v[q];
+    }
+    row_ptrs<NR>(mat, n, j, q + 1, r);
+    axpy_dot_rows<V, NR>(v + q + 1, w + q + 1, r, s, n - q - 1, next);
+    for (int k = 0; k < NR; k++) {
+        next[k] += mat[(index_t)(j + k) * n + q] * upq;
+    }
+}
+
+// Calls f(std::integral_constant<int, G'>, j) for groups of G' <= G indices
+// covering [j0, j1): full groups of G, then the remainder.
+template <int G, class F>
+inline void for_groups(int j0, int j1, F&& f)
+{
+    int j = j0;
+    for (; j + G <= j1; j += G) {
+        f(std::integral_constant<int, G>(), j);
+    }
+    if constexpr (G > 1) {
+        if (j < j1) {
+            for_groups<G - 1>(j, j1, f);
+        }
+    }
+}
+
+// Row groups of up to 4.
+template <class F>
+inline void for_row_groups(int j0, int j1, F&& f)
+{
+    for_groups<4>(j0, j1, f);
+}
+
+template <class T>
+inline int next_pivot(const T* b_array, int p, int row_end)
+{
+    while (p < row_end && b_array[p] == 0.0) {
+        p++;
+    }
+    return p;
+}
+
+// Type 2 on NR rows: all pivots are applied to the group before moving on,
+// fusing each pivot's axpy with the next pivot's dot product.
+template <class V, int NR, class T = typename V::scalar>
+inline void task2_rows(T* mat, int n, int row_start, int row_end, int j,
+                       const T* up_array, const T* b_array)
+{
+    int p = next_pivot(b_array, row_start, row_end);
+    if (p == row_end) {
+        return;
+    }
+
+    T s[NR], next[NR];
+    rows_dot<V, NR>(mat, n, p, up_array[p], j, s);
+
+    while (true) {
+        for (int k = 0; k < NR; k++) {
+            s[k] *= b_array[p];
+        }
+        int q = next_pivot(b_array, p + 1, row_end);
+        if (q == row_end) {
+            rows_apply<V, NR>(mat, n, p, up_array[p], j, s);
+            return;
+        }
+        rows_apply_dot<V, NR>(mat, n, p, up_array[p], q, up_array[q], j, s, next);
+        for (int k = 0; k < NR; k++) {
+            s[k] = next[k];
+        }
+        p = q;
+    }
+}
+
+template <class V, class T = typename V::scalar>
+inline void task2_simd(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                       const T* up_array, const T* b_array)
+{
+    for_row_groups(col_start, col_end, [&](auto nr, int j) {
+        task2_rows<V, decltype(nr)::value>(mat, n, row_start, row_end, j, up_array, b_array);
+    });
+}
+
+// Type 1. Rows (p, col_end) keep their dots with the current pivot in s;
+// applying pivot p first updates row p+1 together with its norm, builds the
+// reflector of p+1, then updates the remaining rows together with their dots
+// against it.
+template <class V, class T = typename V::scalar>
+inline void task1_simd(T* mat, int n, int row_start, int row_end, int col_end,
+                       T* up_array, T* b_array)
+{
+    // Dots of the rows below the current pivot: on the stack for tiles,
+    // malloc'ed for larger calls.
+    constexpr int STACK_ROWS = 256;
+    T stack_buf[2 * STACK_ROWS];
+    int max_rows = col_end - row_start;
+    T* heap_buf = max_rows > STACK_ROWS ? static_cast<T*>(std::malloc(2 * sizeof(T) * max_rows)) : nullptr;
+    T* s = heap_buf ? heap_buf : stack_buf;
+    T* next = s + (heap_buf ? max_rows : STACK_ROWS);
+
+    bool built = false;     // reflector of p already built by the previous step
+    bool have_dots = false; // s holds the dots of rows (p, col_end) with pivot p
+    bool ok = false;
+    T up = 0.0, b = 0.0;
+
+    for (int p = row_start; p < row_end; p++) {
+        T* rowp = mat + (index_t)p * n;
+
+        if (!built) {
+            T maxabs, sumsq;
+            norm_row<V>(rowp + p + 1, n - p - 1, maxabs, sumsq);
+            ok = reflector_from_norm(rowp + p, maxabs, sumsq, up, b);
+            up_array[p] = ok ? up : 0.0;
+            b_array[p] = ok ? b : 0.0;
+        }
+        built = false;
+
+        int first = p + 1;
+        if (!ok || first >= col_end) {
+            have_dots = false;
+            continue;
+        }
+
+        if (!have_dots) {
+            for_row_groups(first, col_end, [&](auto nr, int j) {
+                rows_dot<V, decltype(nr)::value>(mat, n, p, up, j, s + (j - first));
+            });
+        }
+        for (int t = 0; t < col_end - first; t++) {
+            s[t] *= b;
+        }
+
+        int q = p + 1;
+        if (q >= row_end) {
+            // Last pivot of the panel: plain update.
+            for_row_groups(first, col_end, [&](auto nr, int j) {
+                rows_apply<V, decltype(nr)::value>(mat, n, p, up, j, s + (j - first));
+            });
+            have_dots = false;
+            continue;
+        }
+
+        // Row q: apply p and collect its norm, then build the reflector of q.
+        T* rowq = mat + (index_t)q * n;
+        T sq = s[0];
+        T maxabs, sumsq;
+        rowq[p] += sq * up;
+        rowq[q] += sq * rowp[q];
+        axpy_norm_row<V>(rowp + q + 1, rowq + q + 1, sq, n - q - 1, maxabs, sumsq);
+
+        T upq = 0.0, bq = 0.0;
+        bool okq = reflector_from_norm(rowq + q, maxabs, sumsq, upq, bq);
+        up_array[q] = okq ? upq : 0.0;
+        b_array[q] = okq ? bq : 0.0;
+
+        // Rows (q, col_end): apply p, and dot with q if it is usable.
+        if (okq) {
+            for_row_groups(q + 1, col_end, [&](auto nr, int j) {
+                rows_apply_dot<V, decltype(nr)::value>(mat, n, p, up, q, upq, j, s + (j - first), next + (j - q - 1));
+            });
+            T* t = s;
+            s = next;
+            next = t;
+            have_dots = true;
+        } else {
+            for_row_groups(q + 1, col_end, [&](auto nr, int j) {
+                rows_apply<V, decltype(nr)::value>(mat, n, p, up, j, s + (j - first));
+            });
+            have_dots = false;
+        }
+
+        built = true;
+        ok = okq;
+        up = upq;
+        b = bq;
+    }
+
+    std::free(heap_buf);
+}
+
+// ---- Compact WY type 2 ----
+
+// w[k * ldw + q] = sum_i r[k][i] * v_q[i] for NP consecutive pivot rows
+// v_q = v + q * n (dense part of the reflectors).
+template <class V, int NR, int NP, class T = typename V::scalar>
+inline void wy_dot_block(T* const* r, const T* v, int n, int len, T* w, int ldw)
+{
+    typename V::vec acc[NR][NP];
+    for (int k = 0; k < NR; k++) {
+        for (int q = 0; q < NP; q++) {
+            acc[k][q] = V::zero();
+        }
+    }
+
+    int i = 0;
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec c[NR];
+        for (int k = 0; k < NR; k++) {
+            c[k] = V::load(r[k] + i);
+        }
+        for (int q = 0; q < NP; q++) {
+            typename V::vec vq = V::load(v + (index_t)q * n + i);
+            for (int k = 0; k < NR; k++) {
+                acc[k][q] = V::fmadd(c[k], vq, acc[k][q]);
+            }
+        }
+    }
+
+    for (int k = 0; k < NR; k++) {
+        for (int q = 0; q < NP; q++) {
+            T s = V::hsum(acc[k][q]);
+            for (int t = i; t < len; t++) {
+                s += r[k][t] * v[(index_t)q * n + t];
+            }
+            w[k * ldw + q] = s;
+        }
+    }
+}
+
+// r[k][i] += sum_q w[k * ldw + q] * v_q[i] over all kp pivots.
+template <class V, int NR, class T = typename V::scalar>
+inline void wy_update_block(T* const* r, const T* v, int n, int kp, int len, const T* w, int ldw)
+{
+    int i = 0;
+    for (; i + V::W <= len; i += V::W) {
+        typename V::vec c[NR];
+        for (int k = 0; k < NR; k++) {
+            c[k] = V::load(r[k] + i);
+        }
+        for (int q = 0; q < kp; q++) {
+            typename V::vec vq = V::load(v + (index_t)q * n + i);
+            for (int k = 0; k < NR; k++) {
+                c[k] = V::fmadd(V::set1(w[k * ldw + q]), vq, c[k]);
+            }
+        }
+        for (int k = 0; k < NR; k++) {
+            V::store(r[k] + i, c[k]);
+        }
+    }
+    for (; i < len; i++) {
+        for (int k = 0; k < NR; k++) {
+            T s = r[k][i];
+            for (int q = 0; q < kp; q++) {
+                s += w[k * ldw + q] * v[(index_t)q * n + i];
+            }
+            r[k][i] = s;
+        }
+    }
+}
+
+// C = C - (C V) T V^T on NR rows starting at j. Columns [row_start, row_end)
+// hold the triangular head of V and are done in scalar code; the columns
+// from row_end on are dense in every reflector.
+template <class V, int NR, class T = typename V::scalar>
+inline void wy_rows(T* mat, int n, int row_start, int kp, int j, const T* up_array, const T* t, T* w)
+{
+    // Pivots per block of dot products: bounded by the vector registers.
+    constexpr int NP = sizeof(typename V::vec) >= 64 ? 4 : 2;
+    int body = row_start + kp;
+    const T* v = mat + (index_t)row_start * n + body;
+    T* r[NR];
+    row_ptrs<NR>(mat, n, j, body, r);
+
+    // W = C V
+    for_groups<NP>(0, kp, [&](auto np, int q) {
+        wy_dot_block<V, NR, decltype(np)::value>(r, v + (index_t)q * n, n, n - body, w + q, kp);
+    });
+    for (int k = 0; k < NR; k++) {
+        const T* c = mat + (index_t)(j + k) * n;
+        for (int q = 0; q < kp; q++) {
+            int p = row_start + q;
+            T s = c[p] * up_array[p];
+            for (int l = p + 1; l < body; l++) {
+                s += c[l] * mat[(index_t)p * n + l];
+            }
+            w[k * kp + q] += s;
+        }
+    }
+
+    // W = -W T
+    for (int k = 0; k < NR; k++) {
+        T* wk = w + k * kp;
+        for (int q = kp - 1; q >= 0; q--) {
+            T s = 0.0;
+            for (int m = 0; m <= q; m++) {
+                s += wk[m] * t[m * kp + q];
+            }
+            wk[q] = -s;
+        }
+    }
+
+    // C = C + W V^T
+    for (int k = 0; k < NR; k++) {
+        T* c = mat + (index_t)(j + k) * n;
+        for (int q = 0; q < kp; q++) {
+            int p = row_start + q;
+            T s = w[k * kp + q];
+            c[p] += s * up_array[p];
+            for (int l = p + 1; l < body; l++) {
+                c[l] += s * mat[(index_t)p * n + l];
+            }
+        }
+    }
+    wy_update_block<V, NR>(r, v, n, kp, n - body, w, kp);
+}
+
+template <class V, class T = typename V::scalar>
+void complete_task2_wy_simd(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                            const T* up_array, const T* t)
+{
+    int kp = row_end - row_start;
+    constexpr int STACK_PIVOTS = 64;
+    T stack_buf[4 * STACK_PIVOTS];
+    T* heap_buf = kp > STACK_PIVOTS ? static_cast<T*>(std::malloc(4 * sizeof(T) * kp)) : nullptr;
+    T* w = heap_buf ? heap_buf : stack_buf;
+
+    for_row_groups(col_start, col_end, [&](auto nr, int j) {
+        wy_rows<V, decltype(nr)::value>(mat, n, row_start, kp, j, up_array, t, w);
+    });
+
+    std::free(heap_buf);
+}
+
+template <class V, class T = typename V::scalar>
+void complete_task1_simd(T* mat, int n, int row_start, int row_end, int col_end,
+                         T* up_array, T* b_array)
+{
+    task1_simd<V>(mat, n, row_start, row_end, col_end, up_array, b_array);
+}
+
+template <class V, class T = typename V::scalar>
+void complete_task2_simd(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                         const T* up_array, const T* b_array)
+{
+    task2_simd<V>(mat, n, row_start, row_end, col_start, col_end, up_array, b_array);
+}
+
+// Fixed tile shapes: the pivot and row-group loops get constant trip counts.
+template <class V, int ALPHA_T, class T = typename V::scalar>
+void complete_task1_simd_fixed(T* mat, int n, int row_start, int row_end, int col_end,
+                               T* up_array, T* b_array)
+{
+    if (row_end - row_start != ALPHA_T) {
+        task1_simd<V>(mat, n, row_start, row_end, col_end, up_array, b_array);
+        return;
+    }
+    task1_simd<V>(mat, n, row_start, row_start + ALPHA_T, col_end, up_array, b_array);
+}
+
+template <class V, int ALPHA_T, int BETA_T, class T = typename V::scalar>
+void complete_task2_simd_fixed(T* mat, int n, int row_start, int row_end, int col_start, int col_end,
+                               const T* up_array, const T* b_array)
+{
+    if (row_end - row_start != ALPHA_T || col_end - col_start != BETA_T) {
+        task2_simd<V>(mat, n, row_start, row_end, col_start, col_end, up_array, b_array);
+        return;
+    }
+    task2_simd<V>(mat, n, row_start, row_start + ALPHA_T, col_start, col_start + BETA_T, up_array, b_array);
+}
+
+template <class V, int A, int... Ks>
+bool simd_select_beta(int beta, task_kernels_t<typename V::scalar>& k, std::integer_sequence<int, Ks...>)
+{
+    return ((beta == A * (Ks + 1) ? (k.task2 = &complete_task2_simd_fixed<V, A, A * (Ks + 1)>, true) : false) || ...);
+}
+
+template <class V, int... Is>
+bool simd_select_alpha(int alpha, int beta, task_kernels_t<typename V::scalar>& k, std::integer_sequence<int, Is...>)
+{
+    using householder_detail::MAX_TILE;
+    return ((alpha == Is + 2
+                 ? (k.task1 = &complete_task1_simd_fixed<V, Is + 2>,
+                    simd_select_beta<V, Is + 2>(beta, k, std::make_integer_sequence<int, MAX_TILE / (Is + 2)>{}),
+                    true)
+                 : false) || ...);
+}
+
+template <class V, class T = typename V::scalar>
+task_kernels_t<T> simd_select(int alpha, int beta)
+{
+    task_kernels_t<T> k{&complete_task1_simd<V>, &complete_task2_simd<V>, &complete_task2_wy_simd<V>};
+    simd_select_alpha<V>(alpha, beta, k, std::make_integer_sequence<int, householder_detail::MAX_TILE - 1>{});
+    return k;
+}
+
+} // namespace
@@ -0,0 +1,277 @@
+#include "mpi_qr.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if QR_MPI
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <mpi.h>
+#endif
+
+template <class T>
+matrix_t<T> make_distributed_matrix(int rows, int cols, const qr_params_t& params) {
+    alloc_policy_t policy = params.alloc;
+    policy.numa = numa_placement_t::first_touch;
+    return matrix_t<T>(rows, cols, params.layout, policy);
+}
+
+template matrix_t<double> make_distributed_matrix(int, int, const qr_params_t&);
+template matrix_t<float> make_distributed_matrix(int, int, const qr_params_t&);
+
+namespace {
+
+// Gives back the pages wholly inside [begin, end) of a mapping.
+size_t release_pages(void* begin, void* end) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page - 1) / page * page;
+    uintptr_t last = reinterpret_cast<uintptr_t>(end) / page * page;
+    if (last <= first || madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0) {
+        return 0;
+    }
+    return last - first;
+}
+
+} // namespace
+
+template <class T>
+size_t release_distributed_rows(matrix_t<T>& mat, int first, int last) {
+    if (mat.alloc_policy().uses_heap() || mat.alloc_policy().huge_pages != huge_pages_t::none) {
+        return 0;
+    }
+    T* data = mat.data_ptr();
+    return release_pages(data + static_cast<size_t>(first) * mat.ld(), data + static_cast<size_t>(last) * mat.ld());
+}
+
+template size_t release_distributed_rows(matrix_t<double>&, int, int);
+template size_t release_distributed_rows(matrix_t<float>&, int, int);
+
+#if QR_MPI
+
+namespace {
+
+template <class T>
+MPI_Datatype mpi_scalar() {
+    return std::is_same<T, float>::value ? MPI_FLOAT : MPI_DOUBLE;
+}
+
+// The broadcast of one pivot block: its pivot rows from the first pivot
+// column on, straight from / into the matrix, and up, b and T packed.
+template <class T>
+struct panel_message_t {
+    int row_start = 0;
+    int row_end = 0;
+    int root = 0;
+    std::vector<T> reflectors;
+    MPI_Datatype rows_type = MPI_DATATYPE_NULL;
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+};
+
+} // namespace
+
+template <class T>
+mpi_qr_stats_t factorize_mpi(QREngine& engine, matrix_t<T>& mat, const qr_params_t& params,
+                             qr_factors_t<T>& factors) {
+    int is_main = 0;
+    int level = MPI_THREAD_SINGLE;
+    MPI_Is_thread_main(&is_main);
+    MPI_Query_thread(&level);
+    if (!is_main || level < MPI_THREAD_FUNNELED) {
+        throw std::runtime_error("factorize_mpi() needs MPI_THREAD_FUNNELED and the main thread.");
+    }
+    params.validate();
+    if (!params.trace.empty()) {
+        throw std::invalid_argument("--trace cannot be split over processes.");
+    }
+
+    MPI_Comm comm = MPI_COMM_WORLD;
+    mpi_qr_stats_t stats;
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &stats.ranks);
+
+    const int task_rows = params.task_rows(mat.rows());
+    const int blocks = params.task_cols(mat.rows(), mat.cols());
+    const int panels_per_row = params.beta / params.alpha;
+    const int pivots = std::min(mat.rows(), mat.cols());
+    const size_t t_stride = static_cast<size_t>(params.alpha) * params.alpha;
+    const bool wy = params.update == update_t::wy;
+    const int ld = mat.ld();
+    T* data = mat.data_ptr();
+
+    task_partition_t partition;
+    partition.owned.resize(task_rows);
+    for (int i = 0; i < task_rows; ++i) {
+        partition.owned[i] = mpi_task_row_owner(i, stats.ranks) == rank;
+        stats.owned_task_rows += partition.owned[i];
+    }
+
+    std::vector<panel_message_t<T>> panels(blocks);
+    for (int j = 0; j < blocks; ++j) {
+        panel_message_t<T>& p = panels[j];
+        p.row_start = params.alpha * j;
+        p.row_end = std::min(params.alpha * (j + 1), pivots);
+        p.root = mpi_task_row_owner(j / panels_per_row, stats.ranks);
+        int k = p.row_end - p.row_start;
+        p.reflectors.resize(2 * k + (wy ? t_stride : 0));
+        MPI_Type_vector(k, ld - p.row_start, ld, mpi_scalar<T>(), &p.rows_type);
+        MPI_Type_commit(&p.rows_type);
+    }
+
+    // Panel j is computed here (computed[j]) or its broadcast is in
+    // (arrived[j]); the reflectors are unpacked by the waiting worker, since
+    // factors is only sized once the job has started.
+    std::unique_ptr<std::atomic<bool>[]> computed(new std::atomic<bool>[blocks]);
+    std::unique_ptr<bool[]> arrived(new bool[blocks]);
+    for (int j = 0; j < blocks; ++j) {
+        computed[j].store(false, std::memory_order_relaxed);
+        arrived[j] = false;
+    }
+    std::mutex arrival_mutex;
+    std::condition_variable arrival_cv;
+    std::atomic<int64_t> wait_ns{0};
+    std::atomic<size_t> released{0};
+    bool release = !mat.alloc_policy().uses_heap() && mat.alloc_policy().huge_pages == huge_pages_t::none;
+
+    partition.panel_done = [&](int j) { computed[j].store(true, std::memory_order_release); };
+    partition.wait_panel = [&](int j) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(arrival_mutex);
+            arrival_cv.wait(lock, [&] { return arrived[j]; });
+        }
+        wait_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start).count(),
+                          std::memory_order_relaxed);
+        const panel_message_t<T>& p = panels[j];
+        int k = p.row_end - p.row_start;
+        std::copy(p.reflectors.begin(), p.reflectors.begin() + k, factors.up.begin() + p.row_start);
+        std::copy(p.reflectors.begin() + k, p.reflectors.begin() + 2 * k, factors.b.begin() + p.row_start);
+        if (wy) {
+            std::copy(p.reflectors.begin() + 2 * k, p.reflectors.end(), factors.t.begin() + j * t_stride);
+        }
+    };
+    partition.block_done = [&](int j) {
+        const panel_message_t<T>& p = panels[j];
+        if (release && p.root != rank) {
+            released += release_pages(data + static_cast<size_t>(p.row_start) * ld,
+                                      data + static_cast<size_t>(p.row_end) * ld);
+        }
+    };
+
+    std::atomic<bool> job_done{false};
+    std::exception_ptr error;
+    std::thread job([&] {
+        try {
+            stats.run = engine.factorize_partitioned(mat, params, factors, partition);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        job_done.store(true, std::memory_order_release);
+    });
+
+    // Every process posts the broadcasts in block order, a few ahead of the
+    // ones it waits for; a root posts its block once the panel is done. If
+    // the local job fails, the process still posts the rest of its blocks
+    // (whatever its rows hold) rather than stopping: a nonblocking
+    // collective cannot be cancelled, so this is what lets every posted
+    // request, here and elsewhere, complete before the datatypes are freed.
+    const size_t lookahead = 8;
+    std::vector<int> inflight;
+    int next = 0;
+    IdleBackoff backoff(params.idle);
+    while (true) {
+        bool finished = job_done.load(std::memory_order_acquire);
+        bool failed = finished && error;
+        bool progress = false;
+        while (next < blocks && inflight.size() < lookahead) {
+            panel_message_t<T>& p = panels[next];
+            int k = p.row_end - p.row_start;
+            if (p.root == rank && !failed) {
+                if (!computed[next].load(std::memory_order_acquire)) {
+                    break;
+                }
+                std::copy(factors.up.begin() + p.row_start, factors.up.begin() + p.row_end, p.reflectors.begin());
+                std::copy(factors.b.begin() + p.row_start, factors.b.begin() + p.row_end,
+                          p.reflectors.begin() + k);
+                if (wy) {
+                    std::copy(factors.t.begin() + next * t_stride, factors.t.begin() + (next + 1) * t_stride,
+                              p.reflectors.begin() + 2 * k);
+                }
+                stats.panels_sent++;
+            }
+            MPI_Ibcast(data + static_cast<size_t>(p.row_start) * ld + p.row_start, 1, p.rows_type, p.root, comm,
+                       &p.requests[0]);
+            MPI_Ibcast(p.reflectors.data(), static_cast<int>(p.reflectors.size()), mpi_scalar<T>(), p.root, comm,
+                       &p.requests[1]);
+            inflight.push_back(next++);
+            progress = true;
+        }
+
+        for (size_t q = 0; q < inflight.size();) {
+            panel_message_t<T>& p = panels[inflight[q]];
+            int done = 0;
+            MPI_Testall(2, p.requests, &done, MPI_STATUSES_IGNORE);
+            if (!done) {
+                ++q;
+                continue;
+            }
+            if (p.root != rank) {
+                int k = p.row_end - p.row_start;
+                stats.panels_received++;
+                stats.bytes_received += (static_cast<double>(k) * (ld - p.row_start) + p.reflectors.size()) * sizeof(T);
+                {
+                    std::lock_guard<std::mutex> lock(arrival_mutex);
+                    arrived[inflight[q]] = true;
+                }
+                arrival_cv.notify_all();
+            }
+            inflight.erase(inflight.begin() + q);
+            progress = true;
+        }
+
+        if (finished && next == blocks && inflight.empty()) {
+            break;
+        }
+        if (progress) {
+            backoff.reset();
+        } else if (backoff.wait()) {
+            // MPI cannot wake the thread; poll at a slow pace instead.
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    job.join();
+
+    for (panel_message_t<T>& p : panels) {
+        MPI_Type_free(&p.rows_type);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    stats.panel_wait_ms = wait_ns.load() / 1e6;
+    stats.released_bytes = static_cast<double>(released.load());
+    return stats;
+}
+
+#else
+
+template <class T>
+mpi_qr_stats_t factorize_mpi(QREngine&, matrix_t<T>&, const qr_params_t&, qr_factors_t<T>&) {
+    throw std::runtime_error("This build has no MPI; build mpi.out with make mpi.");
+}
+
+#endif
+
+template mpi_qr_stats_t factorize_mpi(QREngine&, matrix_t<double>&, const qr_params_t&, qr_factors_t<double>&);
+template mpi_qr_stats_t factorize_mpi(QREngine&, matrix_t<float>&, const qr_params_t&, qr_factors_t<float>&);
@@ -0,0 +1,111 @@
+#include "offload.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "householder.h"
+
+namespace {
+
+// The emulated device, a stand-in until a real backend exists: its memory
+// is a second copy of the matrix and the reflectors, and it runs the CPU
+// kernels there, synchronously, on the thread that drives it. It is no
+// faster than the workers and doubles the matrix's memory; what it is for
+// is moving the same data a real device would, so that the engine's tile
+// caching and split can be checked on any machine.
+template <class T>
+struct emulated_device_t {
+    int ld = 0;
+    bool wy = false;
+    size_t t_stride = 0;
+    std::vector<T> mat;
+    std::vector<T> up;
+    std::vector<T> b;
+    std::vector<T> t;
+    task_kernels_t<T> kernels;
+};
+
+template <class T>
+void* emulated_open(int rows, int cols, int ld, const qr_params_t& params) {
+    emulated_device_t<T>* dev = new emulated_device_t<T>;
+    dev->ld = ld;
+    dev->wy = params.update == update_t::wy;
+    dev->t_stride = static_cast<size_t>(params.alpha) * params.alpha;
+    dev->mat.assign(static_cast<size_t>(rows) * ld, T());
+    dev->up.assign(rows, T());
+    dev->b.assign(rows, T());
+    if (dev->wy) {
+        dev->t.assign(params.task_cols(rows, cols) * dev->t_stride, T());
+    }
+    dev->kernels = select_task_kernels<T>(params.alpha, params.beta, params.simd);
+    return dev;
+}
+
+template <class T>
+void emulated_close(void* device) {
+    delete static_cast<emulated_device_t<T>*>(device);
+}
+
+template <class T>
+void emulated_upload_rows(void* device, const T* mat, int row_start, int row_end, int col) {
+    emulated_device_t<T>& dev = *static_cast<emulated_device_t<T>*>(device);
+    for (int r = row_start; r < row_end; ++r) {
+        const T* src = mat + static_cast<size_t>(r) * dev.ld;
+        std::copy(src + col, src + dev.ld, dev.mat.begin() + static_cast<size_t>(r) * dev.ld + col);
+    }
+}
+
+template <class T>
+void emulated_download_rows(void* device, T* mat, int row_start, int row_end) {
+    emulated_device_t<T>& dev = *static_cast<emulated_device_t<T>*>(device);
+    std::copy(dev.mat.begin() + static_cast<size_t>(row_start) * dev.ld,
+              dev.mat.begin() + static_cast<size_t>(row_end) * dev.ld, mat + static_cast<size_t>(row_start) * dev.ld);
+}
+
+template <class T>
+void emulated_upload_reflectors(void* device, const T* up, const T* b, int row_start, int row_end, int block,
+                            const T* t) {
+    emulated_device_t<T>& dev = *static_cast<emulated_device_t<T>*>(device);
+    std::copy(up + row_start, up + row_end, dev.up.begin() + row_start);
+    std::copy(b + row_start, b + row_end, dev.b.begin() + row_start);
+    if (dev.wy) {
+        std::copy(t, t + dev.t_stride, dev.t.begin() + block * dev.t_stride);
+    }
+}
+
+template <class T>
+void emulated_run_updates(void* device, const offload_update_t* updates, int count) {
+    emulated_device_t<T>& dev = *static_cast<emulated_device_t<T>*>(device);
+    for (int k = 0; k < count; ++k) {
+        const offload_update_t& u = updates[k];
+        if (dev.wy) {
+            dev.kernels.task2_wy(dev.mat.data(), dev.ld, u.row_start, u.row_end, u.col_start, u.col_end,
+                                 dev.up.data(), dev.t.data() + u.block * dev.t_stride);
+        } else {
+            dev.kernels.task2(dev.mat.data(), dev.ld, u.row_start, u.row_end, u.col_start, u.col_end,
+                              dev.up.data(), dev.b.data());
+        }
+    }
+}
+
+} // namespace
+
+template <class T>
+offload_backend_t<T> select_offload_backend(offload_device_t d) {
+    if (d != offload_device_t::emulated) {
+        throw std::invalid_argument(std::string("No backend for offload device ") + offload_device_name(d) + ".");
+    }
+    offload_backend_t<T> backend;
+    backend.name = "emulated";
+    backend.open = &emulated_open<T>;
+    backend.close = &emulated_close<T>;
+    backend.upload_rows = &emulated_upload_rows<T>;
+    backend.download_rows = &emulated_download_rows<T>;
+    backend.upload_reflectors = &emulated_upload_reflectors<T>;
+    backend.run_updates = &emulated_run_updates<T>;
+    return backend;
+}
+
+template offload_backend_t<double> select_offload_backend(offload_device_t);
+template offload_backend_t<float> select_offload_backend(offload_device_t);
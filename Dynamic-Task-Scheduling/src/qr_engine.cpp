@@ -0,0 +1,1367 @@
+#include "qr_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <tbb/concurrent_queue.h>
+
+#include "householder.h"
+#include "offload.h"
+#include "perf_counters.h"
+#include "tile_pager.h"
+#include "trace.h"
+
+namespace {
+
+template <class T>
+void check_least_squares_shape(const matrix_t<T>& mat, const matrix_t<T>& rhs) {
+    if (mat.cols() < mat.rows()) {
+        throw std::invalid_argument("A least-squares solve needs at least as many columns as rows.");
+    }
+    if (rhs.rows() > 0 && rhs.cols() != mat.cols()) {
+        throw std::invalid_argument("Every right-hand side needs one entry per column of the matrix.");
+    }
+}
+
+} // namespace
+
+struct QREngine::Impl {
+    // The pool. A job is published by bumping 'generation'; every worker
+    // then runs it (or skips it when the job wants fewer workers) and
+    // decrements 'running', and the last one wakes the client.
+    std::vector<std::thread> threads;
+    std::vector<int> cpus;
+    idle_policy_t between_jobs;
+    std::mutex job_mutex;  // Held by the client whose job runs.
+    std::mutex pool_mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<bool> stopping{false};
+    int running = 0;
+
+    // Where the tasks of a matrix read and write, in its scalar type.
+    template <class T>
+    struct buffers_t {
+        T* mat = nullptr;
+        T* rhs = nullptr;  // Right-hand sides of a solve, one per row of stride ldr.
+        T* tail = nullptr; // append_rows(): the appended entries of every pivot row, of stride ldt.
+        T* up = nullptr;
+        T* b = nullptr;
+        T* t = nullptr;
+    };
+
+    // One matrix of a job: its task graph (kept, with the shape it was
+    // built for, to be re-armed when the shape repeats) and its buffers.
+    struct member_t {
+        TaskTable table;
+        int rows = -1;
+        int alpha = 0;
+        int beta = 0;
+        int rhs_count = 0;
+        int ld = 0;
+        int cols = 0;
+        int ldr = 0;
+        int ldt = 0;
+        int tail_cols = 0;  // append_rows(): rows appended.
+        buffers_t<double> f64;
+        buffers_t<float> f32;   // Used instead of f64 by float jobs.
+        size_t first_slot = 0;  // Offset of its (i, j) slots in per-slot job arrays.
+
+        template <class T>
+        buffers_t<T>& buffers() {
+            if constexpr (std::is_same<T, float>::value) {
+                return f32;
+            } else {
+                return f64;
+            }
+        }
+    };
+
+    // Kernels of the current job and reflector storage reused by the calls
+    // that do not ask for the factors, per scalar type.
+    template <class T>
+    struct typed_t {
+        task_kernels_t<T> kernels;
+        offload_backend_t<T> backend;  // --offload.
+        qr_factors_t<T> scratch;
+        std::vector<qr_factors_t<T>> batch_scratch;
+    };
+    typed_t<double> f64;
+    typed_t<float> f32;
+
+    template <class T>
+    typed_t<T>& typed() {
+        if constexpr (std::is_same<T, float>::value) {
+            return f32;
+        } else {
+            return f64;
+        }
+    }
+
+    // The matrices of the current job (the first few members) and the
+    // queues, reused across jobs.
+    std::vector<std::unique_ptr<member_t>> members;
+    size_t rank_levels = 0;  // Every type-1 task ranks above every type-2 task of any matrix.
+    std::vector<size_t> rank_counts;
+    BucketPriorityQueue<Task*> rank_queue;
+    std::unique_ptr<CircularQueueAtomic<Task*>> fifo;  // Room for every task slot of the job.
+    std::vector<std::unique_ptr<WorkStealingDeque<Task*>>> deques;
+
+    // The current job.
+    std::atomic<int> tasks_remaining{0};
+    WorkerParker parker;
+    scheduler_t scheduler = scheduler_t::fifo;
+    idle_policy_t idle;
+    bool single = false;  // The matrices are float (member_t::f32, f32.kernels).
+    bool append = false;  // An append_rows() job: the append kernels, on member_t::tail.
+    bool wy = false;
+    size_t t_stride = 0;
+    int workers = 0;
+    task_partition_t* partition = nullptr;  // factorize_partitioned().
+    const std::function<int(int)>* loader = nullptr;  // factorize_streaming(): loads the rows.
+    std::unique_ptr<std::atomic<int>[]> block_pending;  // Per pivot block: its panel and owned updates left.
+    bool perf_enabled = false;
+    std::vector<PerfAccumulator> perf;
+
+    // --granularity adaptive. ready_depth counts the tasks in the ready
+    // queues. While fewer than the workers are ready, a worker cuts the
+    // type-2 update it pops into pieces of split_rows rows or more, publishes
+    // them in its slot of 'splits', and idle workers run pieces until none
+    // is left; the task completes once every piece is done. While
+    // merge_depth tasks per worker are ready, a worker runs the next update
+    // of the tile it just updated itself instead of queueing it. Either way
+    // every task still runs once, after its predecessors.
+    //
+    // 'claim' packs the split's epoch (high 32 bits), its number of pieces
+    // and the next piece to run (16 bits each), so that a helper cannot
+    // claim a piece of a split that has ended or a new one it has not read.
+    struct alignas(64) split_slot_t {
+        std::atomic<uint64_t> claim{0};
+        std::atomic<Task*> task{nullptr};
+        std::atomic<int> done{0};
+    };
+    bool adaptive = false;
+    int split_rows = 0;
+    int merge_depth = 0;
+    alignas(64) std::atomic<int> ready_depth{0};
+    alignas(64) std::atomic<int> open_splits{0};
+    std::unique_ptr<split_slot_t[]> splits;  // One per pool thread.
+    std::atomic<int> split_count{0};
+    std::atomic<int> merged_count{0};
+
+    // --offload: the device of the current job, driven by the client thread.
+    // A tile whose update goes to the device stays resident there, and gets
+    // all its updates there, until its first panel. Of the tiles that are
+    // not, an update goes to the device while the device's part of the
+    // updates is below device_share: the part of the throughput measured on
+    // it, against the workers' (the times per update are kept across jobs).
+    void* device = nullptr;
+    tbb::concurrent_queue<Task*> device_ready;
+    // Per task row; set by the workers that route to the device and cleared
+    // by the client thread once the tile is downloaded.
+    std::unique_ptr<std::atomic<uint8_t>[]> resident;
+    std::atomic<long> routed{0};
+    std::atomic<long> routed_device{0};
+    std::atomic<double> device_share{0};
+    double fixed_share = -1;
+    size_t device_batch = 1;
+    std::atomic<int64_t> cpu_update_ns{0};
+    std::atomic<int64_t> cpu_updates{0};
+    double cpu_ns_per_update = 0;           // Measured; 0 until an update has run.
+    double device_ns_per_update = 0;
+
+    // factorize_out_of_core(): the tiles of the matrix in memory. A ready
+    // task whose tile the pager cannot admit waits in cold_ready, which
+    // workers take from only once the ready queues are empty.
+    TilePager* pager = nullptr;
+    tbb::concurrent_queue<Task*> cold_ready;
+#if QR_TRACE
+    std::vector<TraceBuffer> trace_buffers;
+    std::vector<uint64_t> release_ns;
+#endif
+
+    Impl(int num_threads, const affinity_policy_t& affinity, const idle_policy_t& idle_policy)
+        : cpus(affinity_map(affinity, num_threads)), between_jobs(idle_policy),
+          splits(new split_slot_t[num_threads]) {
+        for (int tid = 0; tid < num_threads; ++tid) {
+            threads.emplace_back([this, tid] { worker_main(tid); });
+        }
+    }
+
+    ~Impl() {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            stopping.store(true, std::memory_order_release);
+            generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+        start_cv.notify_all();
+        for (std::thread& th : threads) {
+            th.join();
+        }
+    }
+
+    void worker_main(int tid) {
+        pin_current_thread(cpus[tid]);
+        IdleBackoff backoff(between_jobs);
+        uint64_t seen = 0;
+        while (true) {
+            while (generation.load(std::memory_order_acquire) == seen) {
+                if (!backoff.wait()) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(pool_mutex);
+                start_cv.wait(lock, [&] { return generation.load(std::memory_order_acquire) != seen; });
+            }
+            backoff.reset();
+            seen = generation.load(std::memory_order_acquire);
+            if (stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            if (tid < workers) {
+                run_worker(tid);
+            }
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (--running == 0) {
+                done_cv.notify_all();
+            }
+        }
+    }
+
+    // TaskTable::rank over the whole batch.
+    size_t rank_of(const Task* task) const {
+        return task->type == 1 ? rank_levels + task->priority : task->priority;
+    }
+
+    size_t slot_of(const Task* task) const {
+        const member_t& m = *members[task->matrix];
+        return m.first_slot + static_cast<size_t>(task->chunk_idx_i) * m.table.cols() + task->chunk_idx_j;
+    }
+
+    void push_ready(Task* task, int tid) {
+        QR_TRACE_ONLY(release_ns[slot_of(task)] = trace_now_ns();)
+        if (adaptive) {
+            ready_depth.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (pager != nullptr && !pager->admit(task->chunk_idx_i)) {
+            if (task->type != 1) {
+                cold_ready.push(task);
+                return;
+            }
+            pager->load(task->chunk_idx_i);  // Panels are on the critical path.
+        }
+        if (device != nullptr && task->type == 2 && to_device(*task)) {
+            device_ready.push(task);
+        } else if (scheduler == scheduler_t::steal && tid >= 0) {
+            deques[tid]->push_back(task);
+        } else if (scheduler == scheduler_t::steal) {
+            fifo->push(task);  // From the loader, which owns no deque.
+        } else if (scheduler == scheduler_t::priority) {
+            rank_queue.push(task, rank_of(task));
+        } else {
+            fifo->push(task);
+        }
+    }
+
+    // Tasks released together by one completion; on the global queue they
+    // take one reservation between them.
+    void push_ready_bulk(Task* const* tasks, size_t count, int tid) {
+        if (scheduler != scheduler_t::fifo || device != nullptr || pager != nullptr) {
+            for (size_t k = 0; k < count; ++k) {
+                push_ready(tasks[k], tid);
+            }
+            return;
+        }
+#if QR_TRACE
+        for (size_t k = 0; k < count; ++k) {
+            release_ns[slot_of(tasks[k])] = trace_now_ns();
+        }
+#endif
+        if (adaptive) {
+            ready_depth.fetch_add(static_cast<int>(count), std::memory_order_relaxed);
+        }
+        while (count > 0) {
+            size_t pushed = fifo->push_bulk(tasks, count);
+            tasks += pushed;
+            count -= pushed;
+        }
+    }
+
+    bool to_device(const Task& task) {
+        long total = routed.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!resident[task.chunk_idx_i].load(std::memory_order_acquire)) {
+            if (routed_device.load(std::memory_order_relaxed) >= device_share.load(std::memory_order_relaxed) * total) {
+                return false;
+            }
+            resident[task.chunk_idx_i].store(1, std::memory_order_release);
+        }
+        routed_device.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Pops from the worker's own deque first, then steals from the others,
+    // starting at a random victim so thieves spread out.
+    bool pop_ready(Task*& task, int tid, unsigned& seed) {
+        if (scheduler == scheduler_t::priority) {
+            if (auto ready = rank_queue.pop()) {
+                task = *ready;
+                return true;
+            }
+            return false;
+        }
+        if (scheduler != scheduler_t::steal) {
+            return fifo->try_pop(task);
+        }
+
+        if (auto own = deques[tid]->pop_back()) {
+            task = *own;
+            return true;
+        }
+        if (loader != nullptr && fifo->try_pop(task)) {
+            return true;
+        }
+
+        seed = seed * 1103515245u + 12345u;
+        int victim = static_cast<int>((seed >> 16) % static_cast<unsigned>(workers));
+        for (int k = 0; k < workers; k++, victim = (victim + 1) % workers) {
+            if (victim == tid) {
+                continue;
+            }
+            if (auto stolen = deques[victim]->steal()) {
+                task = *stolen;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A task whose tile was not admitted, once its tile is loaded.
+    bool pop_cold(Task*& task) {
+        if (pager == nullptr || !cold_ready.try_pop(task)) {
+            return false;
+        }
+        pager->load(task->chunk_idx_i);
+        return true;
+    }
+
+    // Prefetches the tiles of the successors this task is the last
+    // predecessor of, ahead of their getting ready.
+    void prefetch_successors(const Task& task, const member_t& m) {
+        pager->touch(task.chunk_idx_i);
+        pager->touch(task.row_start / m.beta);
+        for (const Task* next : task.successors) {
+            if (next->unmet.load(std::memory_order_relaxed) == 1) {
+                pager->admit(next->chunk_idx_i);
+            }
+        }
+    }
+
+    void run_worker(int tid) {
+        unsigned seed = 2654435761u * (tid + 1);
+        IdleBackoff backoff(idle);
+        PerfAccumulator* counters = perf_enabled ? &perf[tid] : nullptr;
+        if (counters) {
+            counters->start();
+        }
+
+        Task* carried = nullptr;  // The next update of the tile, chained by complete().
+        while (!parker.finished()) {
+            Task* task = carried;
+            carried = nullptr;
+            if (task == nullptr) {
+                if (!pop_ready(task, tid, seed) && !pop_cold(task)) {
+                    if (adaptive && help_split(tid)) {
+                        backoff.reset();
+                        continue;
+                    }
+                    if (!backoff.wait()) {
+                        continue;
+                    }
+                    bool found = parker.park([&]() {
+                        return pop_ready(task, tid, seed) || pop_cold(task) ||
+                               open_splits.load(std::memory_order_acquire) > 0;
+                    });
+                    backoff.reset();
+                    if (!found || task == nullptr) {
+                        continue;
+                    }
+                }
+                if (adaptive) {
+                    ready_depth.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            backoff.reset();
+
+            member_t& m = *members[task->matrix];
+            QR_TRACE_ONLY(uint64_t start_ns = trace_now_ns();)
+            if (counters) {
+                counters->charge(perf_category_t::scheduler);
+            }
+
+            uint64_t update_start = device != nullptr && task->type == 2 ? trace_now_ns() : 0;
+            int pieces = adaptive ? split_pieces(*task) : 1;
+            if (pager != nullptr) {
+                prefetch_successors(*task, m);
+            }
+            if (partition != nullptr && !partition->owned[task->chunk_idx_i]) {
+                // Another process updates this tile; here only its panels matter.
+                if (task->type == 1) {
+                    partition->wait_panel(task->chunk_idx_j);
+                }
+            } else if (pieces > 1) {
+                run_split(task, tid, pieces);
+            } else if (single) {
+                execute(*task, m, m.f32, f32.kernels);
+            } else {
+                execute(*task, m, m.f64, f64.kernels);
+            }
+            if (partition != nullptr) {
+                finish_partitioned(*task);
+            }
+            if (update_start != 0) {
+                cpu_update_ns.fetch_add(static_cast<int64_t>(trace_now_ns() - update_start), std::memory_order_relaxed);
+                cpu_updates.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (counters) {
+                counters->charge(task->type == 1 ? perf_category_t::type1 : perf_category_t::type2);
+            }
+            QR_TRACE_ONLY(trace_buffers[tid].record({task->chunk_idx_i, task->chunk_idx_j, task->type, tid,
+                                                     release_ns[slot_of(task)], start_ns, trace_now_ns(),
+                                                     task->matrix});)
+
+            complete(task, tid, adaptive ? &carried : nullptr);
+        }
+
+        if (counters) {
+            counters->stop();
+        }
+    }
+
+    // The thread that completes the last predecessor of a task enqueues it.
+    // With carry, the next update of the tile of a type-2 task is handed
+    // back through it instead while the ready queues are deep.
+    void complete(Task* task, int tid, Task** carry = nullptr) {
+        constexpr size_t burst = 64;
+        Task* ready[burst];
+        size_t pending = 0;
+        int released = 0;
+        bool chain = carry != nullptr && task->type == 2 &&
+                     ready_depth.load(std::memory_order_relaxed) >= merge_depth * workers;
+        for (Task* next : task->successors) {
+            if (next->unmet.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (chain && next->type == 2 && next->chunk_idx_i == task->chunk_idx_i) {
+                    QR_TRACE_ONLY(release_ns[slot_of(next)] = trace_now_ns();)
+                    *carry = next;
+                    chain = false;
+                    merged_count.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                ready[pending++] = next;
+                released++;
+                if (pending == burst) {
+                    push_ready_bulk(ready, pending, tid);
+                    pending = 0;
+                }
+            }
+        }
+        push_ready_bulk(ready, pending, tid);
+        if (released > 0) {
+            parker.notify(released);
+        }
+
+        if (tasks_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            parker.shutdown();
+        }
+    }
+
+    // How many pieces to cut a task into: a type-2 update is shared with
+    // the workers the ready queues leave idle, in pieces of split_rows or
+    // more of its rows.
+    int split_pieces(const Task& task) const {
+        if (task.type != 2 || append) {
+            return 1;
+        }
+        int idle_workers = workers - 1 - ready_depth.load(std::memory_order_relaxed);
+        int most = (task.col_end - task.col_start) / split_rows;
+        return std::max(1, std::min(idle_workers + 1, most));
+    }
+
+    // Claims the next piece of the split in s; false once none is left.
+    static bool claim_piece(split_slot_t& s, Task*& task, int& piece, int& pieces) {
+        uint64_t claim = s.claim.load(std::memory_order_acquire);
+        while (true) {
+            pieces = static_cast<int>((claim >> 16) & 0xffff);
+            piece = static_cast<int>(claim & 0xffff);
+            if (piece >= pieces) {
+                return false;
+            }
+            task = s.task.load(std::memory_order_acquire);
+            if (s.claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+                return true;
+            }
+        }
+    }
+
+    // Rows [first, last) of a type-2 task.
+    template <class T>
+    void update_rows(const Task& task, const member_t& m, const buffers_t<T>& buf, const task_kernels_t<T>& kernels,
+                     int first, int last) {
+        int j = task.chunk_idx_j;
+        if (wy) {
+            kernels.task2_wy(buf.mat, m.ld, task.row_start, task.row_end, first, last, buf.up, buf.t + j * t_stride);
+        } else {
+            kernels.task2(buf.mat, m.ld, task.row_start, task.row_end, first, last, buf.up, buf.b);
+        }
+    }
+
+    void run_piece(const Task& task, int piece, int pieces) {
+        member_t& m = *members[task.matrix];
+        int64_t rows = task.col_end - task.col_start;
+        int first = task.col_start + static_cast<int>(rows * piece / pieces);
+        int last = task.col_start + static_cast<int>(rows * (piece + 1) / pieces);
+        if (single) {
+            update_rows(task, m, m.f32, f32.kernels, first, last);
+        } else {
+            update_rows(task, m, m.f64, f64.kernels, first, last);
+        }
+    }
+
+    // Shares the rows of a type-2 update out in pieces through the
+    // worker's slot, runs pieces until none is left, and waits for the
+    // helpers' pieces.
+    void run_split(Task* task, int tid, int pieces) {
+        split_slot_t& s = splits[tid];
+        s.task.store(task, std::memory_order_relaxed);
+        s.done.store(0, std::memory_order_relaxed);
+        uint64_t epoch = ((s.claim.load(std::memory_order_relaxed) >> 32) + 1) & 0xffffffffu;
+        open_splits.fetch_add(1, std::memory_order_relaxed);
+        s.claim.store(epoch << 32 | static_cast<uint64_t>(pieces) << 16, std::memory_order_release);
+        split_count.fetch_add(1, std::memory_order_relaxed);
+        parker.notify(pieces - 1);
+
+        Task* claimed = nullptr;
+        int piece = 0;
+        while (claim_piece(s, claimed, piece, pieces)) {
+            run_piece(*task, piece, pieces);
+            s.done.fetch_add(1, std::memory_order_relaxed);
+        }
+        open_splits.fetch_sub(1, std::memory_order_relaxed);
+        IdleBackoff backoff(idle);
+        while (s.done.load(std::memory_order_acquire) < pieces) {
+            if (backoff.wait()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Runs a piece of an update another worker is sharing out, if any.
+    bool help_split(int tid) {
+        if (open_splits.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        for (int k = 1; k < workers; ++k) {
+            split_slot_t& s = splits[(tid + k) % workers];
+            Task* task = nullptr;
+            int piece = 0, pieces = 0;
+            if (claim_piece(s, task, piece, pieces)) {
+                run_piece(*task, piece, pieces);
+                s.done.fetch_add(1, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // factorize_streaming(): calls the loader until every row is in, and
+    // releases each task row once its rows are. After a failed load the
+    // remaining rows are released as they are, so that the job can end.
+    std::exception_ptr stream_rows(int rows, int beta, qr_run_stats_t& stats) {
+        const TaskTable& table = members[0]->table;
+        const int task_rows = (rows + beta - 1) / beta;
+        int loaded = 0;
+        int released = 0;
+        std::exception_ptr error;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (released < task_rows) {
+            if (!error) {
+                try {
+                    int now = (*loader)(loaded);
+                    if (now <= loaded || now > rows) {
+                        throw std::runtime_error("The row loader returned " + std::to_string(now) + " rows after " +
+                                                 std::to_string(loaded) + ".");
+                    }
+                    loaded = now;
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            int ready = error || loaded == rows ? task_rows : loaded / beta;
+            for (; released < ready; ++released) {
+                Task* first = table.getTask(released, 0);
+                if (first != nullptr && first->unmet.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    push_ready(first, -1);
+                    parker.notify(1);
+                }
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        stats.load_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        return error;
+    }
+
+    // Runs the updates routed to the device in batches until the job is
+    // done: uploads a tile before its first update there and the pivot rows
+    // and reflectors of a block before its first use, and downloads a tile
+    // once its next task is a panel (or it has none).
+    template <class T>
+    void drive_device(qr_run_stats_t& stats) {
+        member_t& m = *members[0];
+        const buffers_t<T>& buf = m.buffers<T>();
+        const offload_backend_t<T>& backend = typed<T>().backend;
+        const TaskTable& table = m.table;
+        std::vector<char> tile_on_device(table.rows(), 0);
+        std::vector<char> block_on_device(table.cols(), 0);
+        std::vector<Task*> batch;
+        std::vector<offload_update_t> updates;
+        const double row_bytes = static_cast<double>(m.ld) * sizeof(T);
+        IdleBackoff backoff(idle);
+
+        while (!parker.finished()) {
+            batch.clear();
+            updates.clear();
+            Task* task = nullptr;
+            while (batch.size() < device_batch && device_ready.try_pop(task)) {
+                batch.push_back(task);
+            }
+            if (batch.empty()) {
+                if (backoff.wait()) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(20));
+                }
+                continue;
+            }
+            backoff.reset();
+
+            uint64_t start = trace_now_ns();
+            for (Task* t : batch) {
+                int i = t->chunk_idx_i;
+                int j = t->chunk_idx_j;
+                if (!tile_on_device[i]) {
+                    backend.upload_rows(device, buf.mat, t->col_start, t->col_end, 0);
+                    stats.offload_bytes += (t->col_end - t->col_start) * row_bytes;
+                    tile_on_device[i] = 1;
+                }
+                if (!block_on_device[j]) {
+                    backend.upload_rows(device, buf.mat, t->row_start, t->row_end, t->row_start);
+                    backend.upload_reflectors(device, buf.up, buf.b, t->row_start, t->row_end, j,
+                                              wy ? buf.t + j * t_stride : nullptr);
+                    stats.offload_bytes += (t->row_end - t->row_start) * (row_bytes - t->row_start * sizeof(T));
+                    block_on_device[j] = 1;
+                }
+                updates.push_back({t->row_start, t->row_end, t->col_start, t->col_end, j});
+            }
+            backend.run_updates(device, updates.data(), static_cast<int>(updates.size()));
+            for (Task* t : batch) {
+                const Task* next = table.getTask(t->chunk_idx_i, t->chunk_idx_j + 1);
+                if (next == nullptr || next->type != 2) {
+                    backend.download_rows(device, buf.mat, t->col_start, t->col_end);
+                    stats.offload_bytes += (t->col_end - t->col_start) * row_bytes;
+                    tile_on_device[t->chunk_idx_i] = 0;
+                    resident[t->chunk_idx_i].store(0, std::memory_order_release);
+                }
+            }
+            double per_update = static_cast<double>(trace_now_ns() - start) / batch.size();
+            device_ns_per_update = device_ns_per_update > 0 ? 0.75 * device_ns_per_update + 0.25 * per_update
+                                                            : per_update;
+            update_device_share();
+            stats.offloaded_tasks += static_cast<int>(batch.size());
+            for (Task* t : batch) {
+                complete(t, 0);
+            }
+        }
+    }
+
+    void update_device_share() {
+        int64_t count = cpu_updates.load(std::memory_order_relaxed);
+        if (count > 0) {
+            cpu_ns_per_update = static_cast<double>(cpu_update_ns.load(std::memory_order_relaxed)) / count;
+        }
+        double share = 1.0 / (workers + 1);  // The device as one more worker, until both sides are measured.
+        if (fixed_share >= 0) {
+            share = fixed_share;
+        } else if (cpu_ns_per_update > 0 && device_ns_per_update > 0) {
+            double device_rate = 1.0 / device_ns_per_update;
+            share = device_rate / (device_rate + workers / cpu_ns_per_update);
+        }
+        device_share.store(share, std::memory_order_relaxed);
+    }
+
+    // Every pivot block has one panel task; block_pending counts it and the
+    // owned updates with the block.
+    void finish_partitioned(const Task& task) {
+        int j = task.chunk_idx_j;
+        bool owned = partition->owned[task.chunk_idx_i];
+        if (task.type == 1 && owned) {
+            partition->panel_done(j);
+        }
+        if ((task.type == 1 || owned) && block_pending[j].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            partition->block_done(j);
+        }
+    }
+
+    template <class T>
+    void execute(const Task& task, const member_t& m, const buffers_t<T>& buf, const task_kernels_t<T>& kernels) {
+        int j = task.chunk_idx_j;
+        int row_start = task.row_start;
+        int row_end = task.row_end;
+        int col_start = task.col_start;
+        int col_end = task.col_end;
+
+        if (append) {
+            if (task.type == 1) {
+                append_task1(buf.mat, m.ld, buf.tail, m.ldt, m.tail_cols, row_start, row_end, col_end, buf.up, buf.b);
+            } else {
+                append_task2(buf.mat, m.ld, buf.tail, m.ldt, m.tail_cols, row_start, row_end, col_start, col_end,
+                             buf.up, buf.b);
+            }
+        } else if (task.type == 1) {
+            kernels.task1(buf.mat, m.ld, row_start, row_end, col_end, buf.up, buf.b);
+            if (wy) {
+                build_block_reflector(buf.mat, m.ld, row_start, row_end, buf.up, buf.b, buf.t + j * t_stride);
+            }
+        } else if (task.type == 3) {
+            apply_reflectors_rhs(buf.mat, m.ld, m.cols, row_start, row_end, buf.up, buf.b,
+                                 buf.rhs, m.ldr, col_start, col_end);
+        } else if (task.type == 4) {
+            back_substitute_rhs(buf.mat, m.ld, row_end, buf.rhs, m.ldr, col_start, col_end);
+        } else {
+            update_rows(task, m, buf, kernels, col_start, col_end);
+        }
+    }
+
+    // Builds (or re-arms) the graphs, queues and buffers for a job. Called
+    // with job_mutex held and the pool idle. Returns whether every graph
+    // was re-armed. rhs, if given, holds the right-hand sides to solve
+    // with the first matrix.
+    template <class T>
+    bool prepare(matrix_t<T>* const* mats, qr_factors_t<T>* const* factors, size_t count,
+                 const qr_params_t& params, matrix_t<T>* rhs) {
+        while (members.size() < count) {
+            members.push_back(std::make_unique<member_t>());
+        }
+        wy = params.update == update_t::wy;
+        t_stride = static_cast<size_t>(params.alpha) * params.alpha;
+
+        bool reuse = true;
+        size_t slots = 0;
+        rank_levels = 0;
+        for (size_t k = 0; k < count; ++k) {
+            member_t& m = *members[k];
+            matrix_t<T>& matrix = *mats[k];
+            int rows = matrix.rows();
+            int task_cols = params.task_cols(rows, matrix.cols());
+            int rhs_count = k == 0 && rhs != nullptr ? rhs->rows() : 0;
+            if (rows == m.rows && matrix.cols() == m.cols && params.alpha == m.alpha && params.beta == m.beta &&
+                rhs_count == m.rhs_count) {
+                m.table.reset();
+            } else {
+                m.table.init(params.task_rows(rows), task_cols, params.alpha, params.beta, matrix, rhs_count);
+                for (Task& task : m.table) {
+                    task.matrix = static_cast<int>(k);
+                }
+                m.rows = rows;
+                m.alpha = params.alpha;
+                m.beta = params.beta;
+                m.rhs_count = rhs_count;
+                reuse = false;
+            }
+
+            qr_factors_t<T>& f = *factors[k];
+            f.up.assign(rows, 0.0);
+            f.b.assign(rows, 0.0);
+            if (wy) {
+                f.t.assign(task_cols * t_stride, 0.0);
+            } else {
+                f.t.clear();
+            }
+            buffers_t<T>& buf = m.buffers<T>();
+            buf.mat = matrix.data_ptr();
+            buf.rhs = rhs_count > 0 ? rhs->data_ptr() : nullptr;
+            buf.up = f.up.data();
+            buf.b = f.b.data();
+            buf.t = f.t.data();
+            m.ld = matrix.ld();
+            m.cols = matrix.cols();
+            m.ldr = rhs_count > 0 ? rhs->ld() : 0;
+            m.first_slot = slots;
+            slots += static_cast<size_t>(m.table.rows()) * m.table.cols();
+            rank_levels = std::max(rank_levels, static_cast<size_t>(m.table.rows() + m.table.cols()));
+        }
+
+        workers = std::min(params.num_threads, static_cast<int>(threads.size()));
+        scheduler = params.scheduler;
+        if (!fifo || fifo->max_size() < slots) {
+            fifo = std::make_unique<CircularQueueAtomic<Task*>>(slots);
+        }
+        if (scheduler == scheduler_t::steal) {
+            while (deques.size() < static_cast<size_t>(workers)) {
+                deques.push_back(std::make_unique<WorkStealingDeque<Task*>>(members[0]->table.rows()));
+            }
+        } else if (scheduler == scheduler_t::priority) {
+            std::vector<size_t> counts(2 * rank_levels, 0);
+            for (size_t k = 0; k < count; ++k) {
+                for (const Task& task : members[k]->table) {
+                    ++counts[rank_of(&task)];
+                }
+            }
+            if (counts == rank_counts) {
+                rank_queue.clear();
+            } else {
+                rank_queue.init(counts);
+                rank_counts = std::move(counts);
+            }
+        }
+
+        single = std::is_same<T, float>::value;
+        typed<T>().kernels = select_task_kernels<T>(params.alpha, params.beta, params.simd);
+        idle = params.idle;
+        adaptive = params.granularity == granularity_t::adaptive;
+        split_rows = params.split_rows > 0 ? params.split_rows : params.alpha;
+        merge_depth = params.merge_depth;
+        ready_depth.store(0, std::memory_order_relaxed);
+        split_count.store(0, std::memory_order_relaxed);
+        merged_count.store(0, std::memory_order_relaxed);
+        perf_enabled = !params.perf.empty();
+        if (perf_enabled) {
+            perf = std::vector<PerfAccumulator>(workers);
+        }
+#if QR_TRACE
+        if (!params.trace.empty()) {
+            trace_buffers.assign(workers, TraceBuffer(params.trace_capacity));
+            release_ns.assign(slots, 0);
+        }
+#endif
+        parker.reset();
+        return reuse;
+    }
+
+    // block_pending of a partitioned job (one matrix, no right-hand sides).
+    void arm_partition(task_partition_t* split) {
+        partition = split;
+        if (partition == nullptr) {
+            return;
+        }
+        const TaskTable& table = members[0]->table;
+        block_pending.reset(new std::atomic<int>[table.cols()]);
+        std::vector<int> pending(table.cols(), 1);
+        for (const Task& task : table) {
+            if (task.type == 2 && partition->owned[task.chunk_idx_i]) {
+                ++pending[task.chunk_idx_j];
+            }
+        }
+        for (int j = 0; j < table.cols(); ++j) {
+            block_pending[j].store(pending[j], std::memory_order_relaxed);
+        }
+    }
+
+    // Opens the device of an --offload job, whose graph prepare() has built.
+    template <class T>
+    void open_device(const matrix_t<T>& mat, size_t count, const qr_params_t& params, bool reuse) {
+        if (count != 1 || partition != nullptr) {
+            throw std::invalid_argument("--offload factorizes one matrix, in one process.");
+        }
+        typed_t<T>& t = typed<T>();
+        t.backend = select_offload_backend<T>(params.offload);
+        resident.reset(new std::atomic<uint8_t>[members[0]->table.rows()]);
+        for (int i = 0; i < members[0]->table.rows(); ++i) {
+            resident[i].store(0, std::memory_order_relaxed);
+        }
+        routed.store(0);
+        routed_device.store(0);
+        device_batch = static_cast<size_t>(params.offload_batch);
+        fixed_share = params.offload_share;
+        if (!reuse) {
+            cpu_update_ns.store(0);
+            cpu_updates.store(0);
+            cpu_ns_per_update = 0;
+            device_ns_per_update = 0;
+        }
+        update_device_share();
+        device = t.backend.open(mat.rows(), mat.cols(), mat.ld(), params);
+    }
+
+    template <class T>
+    qr_run_stats_t run(matrix_t<T>* const* mats, qr_factors_t<T>* const* factors, size_t count,
+                       const qr_params_t& params, matrix_t<T>* rhs = nullptr,
+                       task_partition_t* split = nullptr, matrix_t<T>* tail = nullptr,
+                       const std::function<int(int)>* load = nullptr, TilePager* pages = nullptr) {
+        params.validate();
+#if !QR_TRACE
+        if (!params.trace.empty()) {
+            throw std::invalid_argument("This build has no tracing; rebuild with make TRACE=1 to use --trace.");
+        }
+#endif
+        std::lock_guard<std::mutex> job(job_mutex);
+        qr_run_stats_t stats;
+        stats.matrices = static_cast<int>(count);
+        stats.reused_graph = prepare(mats, factors, count, params, rhs);
+        arm_partition(split);
+        append = tail != nullptr;
+        if (append) {
+            members[0]->buffers<T>().tail = tail->data_ptr();
+            members[0]->ldt = tail->ld();
+            members[0]->tail_cols = tail->cols();
+        }
+        for (size_t k = 0; k < count; ++k) {
+            stats.tasks += members[k]->table.numTasks();
+        }
+        stats.workers = workers;
+        if (stats.tasks == 0) {
+            return stats;
+        }
+        tasks_remaining.store(stats.tasks);
+        loader = load;
+        pager = pages;
+        if (loader != nullptr) {
+            // Its rows are one more predecessor of every task row. With any
+            // task in the job, every task row has a first task.
+            for (int i = 0; i < params.task_rows(mats[0]->rows()); ++i) {
+                if (Task* first = members[0]->table.getTask(i, 0)) {
+                    first->unmet.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        if (params.offload != offload_device_t::none) {
+            open_device(*mats[0], count, params, stats.reused_graph);
+        }
+
+        QR_TRACE_ONLY(uint64_t trace_origin = trace_now_ns();)
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t k = 0; k < count; ++k) {
+            if (members[k]->table.numTasks() > 0 && loader == nullptr) {
+                push_ready(members[k]->table.getTask(0, 0), static_cast<int>(k % workers));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            running = static_cast<int>(threads.size());
+            generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+        start_cv.notify_all();
+        std::exception_ptr load_error;
+        if (device != nullptr) {
+            drive_device<T>(stats);
+        } else if (loader != nullptr) {
+            load_error = stream_rows(mats[0]->rows(), params.beta, stats);
+        }
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            done_cv.wait(lock, [&] { return running == 0; });
+        }
+        if (device != nullptr) {
+            typed<T>().backend.close(device);
+            device = nullptr;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        stats.elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        stats.split_tasks = split_count.load(std::memory_order_relaxed);
+        stats.merged_tasks = merged_count.load(std::memory_order_relaxed);
+
+        if (perf_enabled) {
+            qr_params_t described = params;
+            described.precision = single ? precision_t::f32 : precision_t::f64;
+            auto desc = describe_qr_params(described);
+            desc[0].second = std::to_string(workers);
+            desc.insert(desc.begin(), {{"program", "dynamic"}, {"matrix", params.label},
+                                       {"rows", std::to_string(mats[0]->rows())},
+                                       {"batch", std::to_string(count)}});
+            write_perf_report(params.perf, perf, stats.elapsed_ms, desc);
+        }
+#if QR_TRACE
+        if (!params.trace.empty()) {
+            std::vector<trace_event_t> events = collect_trace(trace_buffers, trace_origin);
+            uint64_t dropped = 0;
+            for (const TraceBuffer& buffer : trace_buffers) {
+                dropped += buffer.dropped();
+            }
+            std::vector<const TaskTable*> tables;
+            for (size_t k = 0; k < count; ++k) {
+                tables.push_back(&members[k]->table);
+            }
+            write_chrome_trace(params.trace + ".json", events, workers);
+            write_trace_csv(params.trace + ".csv", events);
+            print_trace_summary(summarize_trace(events, tables, workers), dropped, std::cout);
+        }
+#endif
+        loader = nullptr;
+        pager = nullptr;
+        if (load_error) {
+            std::rethrow_exception(load_error);
+        }
+        return stats;
+    }
+};
+
+QREngine::QREngine(int num_threads, const affinity_policy_t& affinity, const idle_policy_t& idle) {
+    if (num_threads < 1) {
+        throw std::invalid_argument("Number of threads must be at least 1.");
+    }
+    impl = std::make_unique<Impl>(num_threads, affinity, idle);
+}
+
+QREngine::~QREngine() = default;
+
+int QREngine::num_threads() const {
+    return static_cast<int>(impl->threads.size());
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize(matrix_t<T>& mat, const qr_params_t& params) {
+    return factorize(mat, params, impl->typed<T>().scratch);
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors) {
+    matrix_t<T>* mats[] = {&mat};
+    qr_factors_t<T>* out[] = {&factors};
+    return impl->run(mats, out, 1, params);
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize_streaming(matrix_t<T>& mat, const qr_params_t& params, qr_factors_t<T>& factors,
+                                             const std::function<int(int)>& load) {
+    if (params.batch > 1 || params.tsqr_leaf > 0 || params.offload != offload_device_t::none) {
+        throw std::invalid_argument("A streaming factorization runs one matrix: drop --batch, --tsqr and --offload.");
+    }
+    matrix_t<T>* mats[] = {&mat};
+    qr_factors_t<T>* out[] = {&factors};
+    return impl->run(mats, out, 1, params, static_cast<matrix_t<T>*>(nullptr), nullptr,
+                     static_cast<matrix_t<T>*>(nullptr), &load);
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize_out_of_core(matrix_t<T>& mat, const qr_params_t& params,
+                                               qr_factors_t<T>& factors) {
+    params.validate();
+    if (params.batch > 1 || params.tsqr_leaf > 0 || params.offload != offload_device_t::none ||
+        params.stream_rows > 0) {
+        throw std::invalid_argument("An out-of-core factorization runs one matrix: drop --batch, --tsqr, --offload "
+                                    "and --stream.");
+    }
+    TilePager pages(mat.data_ptr(), static_cast<size_t>(mat.ld()) * sizeof(T), mat.rows(), params.beta,
+                    static_cast<size_t>(params.memory_budget_mb) << 20);
+
+    // Every row is owned; the partition is only there for block_done. The
+    // last pivot block of a tile is the last one its rows are read for (by
+    // the updates below) or written in (by its own panel).
+    const int bda = params.beta_div_alpha();
+    const int blocks = params.task_cols(mat.rows(), mat.cols());
+    task_partition_t partition;
+    partition.owned.assign(params.task_rows(mat.rows()), 1);
+    partition.panel_done = [](int) {};
+    partition.wait_panel = [](int) {};
+    partition.block_done = [&](int j) {
+        int i = j / bda;
+        if (j == std::min((i + 1) * bda, blocks) - 1) {
+            pages.finish(i);
+        }
+    };
+
+    matrix_t<T>* mats[] = {&mat};
+    qr_factors_t<T>* out[] = {&factors};
+    qr_run_stats_t stats = impl->run(mats, out, 1, params, static_cast<matrix_t<T>*>(nullptr), &partition,
+                                     static_cast<matrix_t<T>*>(nullptr), nullptr, &pages);
+    pages.finish_all();
+    stats.tile_loads = pages.loads();
+    stats.tile_evictions = pages.evictions();
+    stats.peak_resident_bytes = pages.peak_bytes();
+    return stats;
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize_batch(std::vector<matrix_t<T>>& mats, const qr_params_t& params) {
+    return factorize_batch(mats, params, impl->typed<T>().batch_scratch);
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize_batch(std::vector<matrix_t<T>>& mats, const qr_params_t& params,
+                                         std::vector<qr_factors_t<T>>& factors) {
+    if (mats.empty()) {
+        throw std::invalid_argument("A batch needs at least one matrix.");
+    }
+    factors.resize(mats.size());
+    std::vector<matrix_t<T>*> mat_ptrs;
+    std::vector<qr_factors_t<T>*> factor_ptrs;
+    for (size_t k = 0; k < mats.size(); ++k) {
+        mat_ptrs.push_back(&mats[k]);
+        factor_ptrs.push_back(&factors[k]);
+    }
+    return impl->run(mat_ptrs.data(), factor_ptrs.data(), mats.size(), params);
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize_tsqr(matrix_t<T>& mat, const qr_params_t& params) {
+    int rows = mat.rows();
+    int cols = mat.cols();
+    int leaf = params.tsqr_leaf;
+    if (leaf < std::max(rows, 1) || cols < rows) {
+        throw std::invalid_argument("A TSQR leaf needs at least as many columns as the matrix has rows.");
+    }
+
+    // Leaves: copies of the column blocks.
+    int leaves = std::max(1, cols / leaf);
+    std::vector<matrix_t<T>> level;
+    for (int k = 0; k < leaves; ++k) {
+        int first = k * leaf;
+        int last = k + 1 == leaves ? cols : first + leaf;
+        level.emplace_back(rows, last - first, params.layout, params.alloc);
+        for (int i = 0; i < rows; ++i) {
+            std::copy(mat.data_ptr() + static_cast<size_t>(i) * mat.ld() + first,
+                      mat.data_ptr() + static_cast<size_t>(i) * mat.ld() + last,
+                      level.back().data_ptr() + static_cast<size_t>(i) * level.back().ld());
+        }
+    }
+
+    // Every level factorizes the matrices in 'level'; their L factors join
+    // 'factored', which is then paired up for the next level. With an odd
+    // count the last L waits for the next level as it is.
+    qr_run_stats_t total;
+    std::vector<matrix_t<T>> factored;
+    while (!level.empty()) {
+        qr_run_stats_t stats = factorize_batch(level, params);
+        total.elapsed_ms += stats.elapsed_ms;
+        total.matrices += stats.matrices;
+        total.tasks += stats.tasks;
+        total.workers = stats.workers;
+        for (matrix_t<T>& l : level) {
+            factored.push_back(std::move(l));
+        }
+        level.clear();
+
+        for (size_t k = 0; k + 1 < factored.size(); k += 2) {
+            level.emplace_back(rows, 2 * rows, params.layout, params.alloc);
+            for (size_t h = 0; h < 2; ++h) {
+                const matrix_t<T>& l = factored[k + h];
+                for (int i = 0; i < rows; ++i) {
+                    const T* src = l.data_ptr() + static_cast<size_t>(i) * l.ld();
+                    std::copy(src, src + i + 1, level.back().data_ptr() + static_cast<size_t>(i) * level.back().ld()
+                                                    + h * rows);
+                }
+            }
+        }
+        factored.erase(factored.begin(), factored.begin() + 2 * level.size());
+    }
+
+    // mat = [L 0].
+    for (int i = 0; i < rows; ++i) {
+        T* dst = mat.data_ptr() + static_cast<size_t>(i) * mat.ld();
+        const T* src = factored[0].data_ptr() + static_cast<size_t>(i) * factored[0].ld();
+        std::fill(dst, dst + cols, T(0));
+        std::copy(src, src + i + 1, dst);
+    }
+    return total;
+}
+
+template <class T>
+qr_run_stats_t QREngine::solve(matrix_t<T>& mat, matrix_t<T>& rhs, const qr_params_t& params) {
+    return solve(mat, rhs, params, impl->typed<T>().scratch);
+}
+
+template <class T>
+qr_run_stats_t QREngine::solve(matrix_t<T>& mat, matrix_t<T>& rhs, const qr_params_t& params,
+                               qr_factors_t<T>& factors) {
+    check_least_squares_shape(mat, rhs);
+    matrix_t<T>* mats[] = {&mat};
+    qr_factors_t<T>* out[] = {&factors};
+    return impl->run(mats, out, 1, params, rhs.rows() > 0 ? &rhs : nullptr);
+}
+
+qr_run_stats_t QREngine::solve_mixed(const matrix_t<double>& mat, matrix_t<double>& rhs, const qr_params_t& params,
+                                     const refinement_options_t& opts) {
+    check_least_squares_shape(mat, rhs);
+    if (opts.max_steps < 0 || !(opts.tolerance > 0)) {
+        throw std::invalid_argument("Refinement needs max_steps >= 0 and a positive tolerance.");
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    int k = mat.rows();
+    int m = mat.cols();
+
+    matrix_t<float> low(mat, params.layout, params.alloc);
+    matrix_t<float> low_rhs(rhs, rhs.layout());
+    qr_run_stats_t stats = solve(low, low_rhs, params);
+
+    // R^T = L, the float factor, in double for the correction solves.
+    matrix_t<double> l(k, k);
+    for (int p = 0; p < k; ++p) {
+        const float* src = low.data_ptr() + static_cast<size_t>(p) * low.ld();
+        std::copy(src, src + p + 1, l.data_ptr() + static_cast<size_t>(p) * l.ld());
+    }
+
+    // Corrected semi-normal equations: with r = b - A x, R^T R dx = A^T r.
+    // Its fixed point has A^T r = 0 exactly, whatever the error of R; it
+    // contracts by about cond(A)^2 times the float epsilon per step.
+    matrix_t<double> b(rhs);
+    std::vector<double> x(k), r(m), d(k);
+    bool converged = true;
+    for (int row = 0; row < rhs.rows() && converged; ++row) {
+        const double* brow = b.data_ptr() + static_cast<size_t>(row) * b.ld();
+        const float* x0 = low_rhs.data_ptr() + static_cast<size_t>(row) * low_rhs.ld();
+        std::copy(x0, x0 + k, x.begin());
+
+        converged = false;
+        double last = std::numeric_limits<double>::infinity();
+        for (int step = 0; step < opts.max_steps; ++step) {
+            std::copy(brow, brow + m, r.begin());
+            for (int p = 0; p < k; ++p) {
+                const double* a = mat.data_ptr() + static_cast<size_t>(p) * mat.ld();
+                for (int i = 0; i < m; ++i) {
+                    r[i] -= a[i] * x[p];
+                }
+            }
+            // L y = A^T r, then L^T dx = y.
+            for (int p = 0; p < k; ++p) {
+                const double* a = mat.data_ptr() + static_cast<size_t>(p) * mat.ld();
+                const double* lp = l.data_ptr() + static_cast<size_t>(p) * l.ld();
+                double s = 0.0;
+                for (int i = 0; i < m; ++i) {
+                    s += a[i] * r[i];
+                }
+                for (int i = 0; i < p; ++i) {
+                    s -= lp[i] * d[i];
+                }
+                d[p] = s / lp[p];
+            }
+            back_substitute_rhs(l.data_ptr(), l.ld(), k, d.data(), k, 0, 1);
+
+            double dmax = 0.0, xmax = 0.0;
+            for (int p = 0; p < k; ++p) {
+                x[p] += d[p];
+                dmax = std::max(dmax, std::fabs(d[p]));
+                xmax = std::max(xmax, std::fabs(x[p]));
+            }
+            stats.refinement_steps++;
+            if (dmax <= opts.tolerance * xmax) {
+                converged = true;
+                break;
+            }
+            if (!(dmax < last)) {
+                break;  // Diverging, or stalled short of the tolerance.
+            }
+            last = dmax;
+        }
+        double* c = rhs.data_ptr() + static_cast<size_t>(row) * rhs.ld();
+        std::copy(x.begin(), x.end(), c);
+        std::fill(c + k, c + m, 0.0);
+    }
+
+    if (!converged) {
+        matrix_t<double> full(mat, params.layout, params.alloc);
+        qr_run_stats_t again = solve(full, b, params);
+        stats.tasks += again.tasks;
+        stats.refinement_fallback = true;
+        for (int row = 0; row < rhs.rows(); ++row) {
+            const double* src = b.data_ptr() + static_cast<size_t>(row) * b.ld();
+            double* c = rhs.data_ptr() + static_cast<size_t>(row) * rhs.ld();
+            std::copy(src, src + k, c);
+            std::fill(c + k, c + m, 0.0);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    return stats;
+}
+
+template <class T>
+qr_run_stats_t QREngine::append_rows(matrix_t<T>& mat, const matrix_t<T>& rows, const qr_params_t& params) {
+    qr_append_t<T> update;
+    return append_rows(mat, rows, params, update);
+}
+
+template <class T>
+qr_run_stats_t QREngine::append_rows(matrix_t<T>& mat, const matrix_t<T>& rows, const qr_params_t& params,
+                                     qr_append_t<T>& update) {
+    if (mat.cols() < mat.rows()) {
+        throw std::invalid_argument("Rows can only be appended to a factorization with at least as many columns "
+                                    "as rows.");
+    }
+    if (rows.cols() != mat.rows()) {
+        throw std::invalid_argument("Every appended row needs one entry per row of the factorized matrix.");
+    }
+    if (params.offload != offload_device_t::none) {
+        throw std::invalid_argument("--offload does not run appends.");
+    }
+    const int n = mat.rows();
+    const int k = rows.rows();
+    if (k == 0) {
+        return qr_run_stats_t();
+    }
+    if (update.tail.rows() != n || update.tail.cols() != k) {
+        update.tail = matrix_t<T>(n, k, matrix_layout_t::padded);
+    }
+    for (int q = 0; q < k; ++q) {
+        for (int p = 0; p < n; ++p) {
+            update.tail.set(p, q, rows.get(q, p));
+        }
+    }
+    matrix_t<T>* mats[] = {&mat};
+    qr_factors_t<T>* out[] = {&update.factors};
+    return impl->run(mats, out, 1, params, static_cast<matrix_t<T>*>(nullptr), nullptr, &update.tail);
+}
+
+template <class T>
+qr_run_stats_t QREngine::factorize_partitioned(matrix_t<T>& mat, const qr_params_t& params,
+                                               qr_factors_t<T>& factors, task_partition_t& partition) {
+    params.validate();
+    if (params.batch > 1 || params.tsqr_leaf > 0) {
+        throw std::invalid_argument("--batch and --tsqr cannot be split over processes.");
+    }
+    if (partition.owned.size() != static_cast<size_t>(params.task_rows(mat.rows()))) {
+        throw std::invalid_argument("The partition needs one entry per task row.");
+    }
+    matrix_t<T>* mats[] = {&mat};
+    qr_factors_t<T>* out[] = {&factors};
+    return impl->run(mats, out, 1, params, static_cast<matrix_t<T>*>(nullptr), &partition);
+}
+
+template <class T>
+void solve_factored(const matrix_t<T>& factored, const qr_factors_t<T>& factors, matrix_t<T>& rhs) {
+    check_least_squares_shape(factored, rhs);
+    if (factors.up.size() != static_cast<size_t>(factored.rows())
+        || factors.b.size() != static_cast<size_t>(factored.rows())) {
+        throw std::invalid_argument("The reflectors do not match the factored matrix.");
+    }
+    apply_reflectors_rhs(factored.data_ptr(), factored.ld(), factored.cols(), 0, factored.rows(),
+                         factors.up.data(), factors.b.data(), rhs.data_ptr(), rhs.ld(), 0, rhs.rows());
+    back_substitute_rhs(factored.data_ptr(), factored.ld(), factored.rows(), rhs.data_ptr(), rhs.ld(), 0, rhs.rows());
+}
+
+#define QR_ENGINE_INSTANTIATE(T)                                                                                   \
+    template qr_run_stats_t QREngine::factorize(matrix_t<T>&, const qr_params_t&);                                 \
+    template qr_run_stats_t QREngine::factorize(matrix_t<T>&, const qr_params_t&, qr_factors_t<T>&);               \
+    template qr_run_stats_t QREngine::factorize_batch(std::vector<matrix_t<T>>&, const qr_params_t&);              \
+    template qr_run_stats_t QREngine::factorize_batch(std::vector<matrix_t<T>>&, const qr_params_t&,               \
+                                                      std::vector<qr_factors_t<T>>&);                              \
+    template qr_run_stats_t QREngine::factorize_tsqr(matrix_t<T>&, const qr_params_t&);                            \
+    template qr_run_stats_t QREngine::solve(matrix_t<T>&, matrix_t<T>&, const qr_params_t&);                       \
+    template qr_run_stats_t QREngine::solve(matrix_t<T>&, matrix_t<T>&, const qr_params_t&, qr_factors_t<T>&);     \
+    template qr_run_stats_t QREngine::factorize_streaming(matrix_t<T>&, const qr_params_t&, qr_factors_t<T>&,     \
+                                                          const std::function<int(int)>&);                         \
+    template qr_run_stats_t QREngine::factorize_out_of_core(matrix_t<T>&, const qr_params_t&, qr_factors_t<T>&);  \
+    template qr_run_stats_t QREngine::append_rows(matrix_t<T>&, const matrix_t<T>&, const qr_params_t&);           \
+    template qr_run_stats_t QREngine::append_rows(matrix_t<T>&, const matrix_t<T>&, const qr_params_t&,            \
+                                                  qr_append_t<T>&);                                                \
+    template qr_run_stats_t QREngine::factorize_partitioned(matrix_t<T>&, const qr_params_t&, qr_factors_t<T>&,   \
+                                                            task_partition_t&);                                    \
+    template void solve_factored(const matrix_t<T>&, const qr_factors_t<T>&, matrix_t<T>&);
+
+QR_ENGINE_INSTANTIATE(double)
+QR_ENGINE_INSTANTIATE(float)
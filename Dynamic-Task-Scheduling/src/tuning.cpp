@@ -0,0 +1,247 @@
+#include "tuning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char* const db_header = "rows,cols,threads,sched,alpha,beta,time_ms,cpu";
+const char* const fig3_header = "matrix_size,threads,mode,best_alpha,best_beta";
+
+std::vector<std::string> split_fields(const std::string& line, size_t max_fields) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() + 1 < max_fields) {
+        size_t comma = line.find(',', start);
+        if (comma == std::string::npos) {
+            break;
+        }
+        fields.push_back(line.substr(start, comma - start));
+        start = comma + 1;
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+int to_int(const std::string& s, const std::string& line) {
+    try {
+        size_t pos = 0;
+        int v = std::stoi(s, &pos);
+        if (pos == s.size()) {
+            return v;
+        }
+    } catch (const std::exception&) {
+    }
+    throw std::runtime_error("Bad value '" + s + "' in tuning database line: " + line);
+}
+
+double to_double(const std::string& s, const std::string& line) {
+    try {
+        return std::stod(s);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Bad value '" + s + "' in tuning database line: " + line);
+    }
+}
+
+double log_distance(int a, int b) {
+    return std::fabs(std::log(static_cast<double>(std::max(a, 1)) / std::max(b, 1)));
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+} // namespace
+
+std::string cpu_model_name() {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                size_t start = line.find_first_not_of(" \t", colon + 1);
+                return start == std::string::npos ? "unknown" : line.substr(start);
+            }
+        }
+    }
+    return "unknown";
+}
+
+TuningDB TuningDB::load(const std::string& path) {
+    TuningDB db;
+    std::ifstream in(path);
+    if (!in) {
+        return db;
+    }
+    std::string header;
+    if (!std::getline(in, header)) {
+        return db;
+    }
+    bool fig3 = header.compare(0, std::strlen(fig3_header), fig3_header) == 0;
+    if (!fig3 && header != db_header) {
+        throw std::runtime_error("Not a tuning database: " + path);
+    }
+    std::string cpu = fig3 ? cpu_model_name() : "";
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        tuning_entry_t e;
+        if (fig3) {
+            // matrix_size,threads,mode,best_alpha,best_beta,runs,avg_time_ms,...
+            std::vector<std::string> f = split_fields(line, 8);
+            if (f.size() < 7) {
+                throw std::runtime_error("Short line in " + path + ": " + line);
+            }
+            size_t x = f[0].find('x');
+            e.rows = to_int(f[0].substr(0, x), line);
+            e.cols = x == std::string::npos ? e.rows : to_int(f[0].substr(x + 1), line);
+            e.threads = to_int(f[1], line);
+            // 0 / 1 are the former USE_PRIORITY_MAIN_QUEUE modes.
+            e.sched = f[2] == "0" ? "fifo" : f[2] == "1" ? "priority" : f[2];
+            e.alpha = to_int(f[3], line);
+            e.beta = to_int(f[4], line);
+            e.time_ms = to_double(f[6], line);
+            e.cpu = cpu;
+        } else {
+            std::vector<std::string> f = split_fields(line, 8);
+            if (f.size() < 8) {
+                throw std::runtime_error("Short line in " + path + ": " + line);
+            }
+            e.rows = to_int(f[0], line);
+            e.cols = to_int(f[1], line);
+            e.threads = to_int(f[2], line);
+            e.sched = f[3];
+            e.alpha = to_int(f[4], line);
+            e.beta = to_int(f[5], line);
+            e.time_ms = to_double(f[6], line);
+            e.cpu = f[7];
+        }
+        db.record(e);
+    }
+    return db;
+}
+
+void TuningDB::save(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + path + " for writing.");
+    }
+    out << db_header << "\n";
+    for (const tuning_entry_t& e : entries_) {
+        out << e.rows << "," << e.cols << "," << e.threads << "," << e.sched << "," << e.alpha << "," << e.beta
+            << "," << e.time_ms << "," << e.cpu << "\n";
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path + ".");
+    }
+}
+
+void TuningDB::record(const tuning_entry_t& e) {
+    for (tuning_entry_t& old : entries_) {
+        if (old.rows == e.rows && old.cols == e.cols && old.threads == e.threads && old.sched == e.sched &&
+            old.cpu == e.cpu) {
+            old = e;
+            return;
+        }
+    }
+    entries_.push_back(e);
+}
+
+const tuning_entry_t* TuningDB::lookup(const std::string& cpu, const std::string& sched, int rows, int cols,
+                                       int threads) const {
+    const tuning_entry_t* best = nullptr;
+    double best_distance = 0;
+    for (const tuning_entry_t& e : entries_) {
+        if (e.cpu != cpu || e.sched != sched) {
+            continue;
+        }
+        double d = log_distance(rows, e.rows) + log_distance(cols, e.cols) + log_distance(threads, e.threads);
+        if (best == nullptr || d < best_distance) {
+            best = &e;
+            best_distance = d;
+        }
+    }
+    return best;
+}
+
+const tuning_entry_t* apply_tuned_shape(const TuningDB& db, qr_params_t& params, int rows, int cols) {
+    const tuning_entry_t* e = db.lookup(cpu_model_name(), scheduler_name(params.scheduler), rows, cols,
+                                        params.num_threads);
+    if (e != nullptr) {
+        params.alpha = e->alpha;
+        params.beta = e->beta;
+    }
+    return e;
+}
+
+tuning_result_t tune_tile_shape(QREngine& engine, const matrix_t<double>& input, const qr_params_t& params,
+                                const tuning_options_t& opts) {
+    struct candidate_t {
+        int alpha;
+        int beta;
+        std::vector<double> times_ms;
+        double score = 0;
+    };
+    std::vector<candidate_t> alive;
+    for (int alpha : opts.alphas) {
+        for (int beta : opts.betas) {
+            if (alpha > 0 && beta >= alpha && beta % alpha == 0) {
+                alive.push_back({alpha, beta, {}});
+            }
+        }
+    }
+    if (alive.empty()) {
+        throw std::invalid_argument("No valid (ALPHA, BETA) pair to tune over.");
+    }
+    if (opts.warmup < 0 || opts.first_reps < 1) {
+        throw std::invalid_argument("Tuning needs warmup >= 0 and first_reps >= 1.");
+    }
+
+    tuning_result_t result;
+    result.candidates = static_cast<int>(alive.size());
+    matrix_t<double> work = input;
+    auto time_once = [&](const candidate_t& c) {
+        qr_params_t run = params;
+        run.alpha = c.alpha;
+        run.beta = c.beta;
+        std::copy(input.data_ptr(), input.data_ptr() + static_cast<size_t>(input.rows()) * input.ld(),
+                  work.data_ptr());
+        return engine.factorize(work, run).elapsed_ms;
+    };
+
+    for (candidate_t& c : alive) {
+        for (int w = 0; w < opts.warmup; ++w) {
+            time_once(c);
+        }
+    }
+    int reps = opts.first_reps;
+    do {
+        result.rounds++;
+        for (candidate_t& c : alive) {
+            for (int r = 0; r < reps; ++r) {
+                c.times_ms.push_back(time_once(c));
+                result.runs++;
+            }
+            c.score = median(c.times_ms);
+        }
+        std::stable_sort(alive.begin(), alive.end(),
+                         [](const candidate_t& a, const candidate_t& b) { return a.score < b.score; });
+        alive.resize((alive.size() + 1) / 2);
+        reps *= 2;
+    } while (alive.size() > 1);
+
+    result.alpha = alive[0].alpha;
+    result.beta = alive[0].beta;
+    result.time_ms = alive[0].score;
+    return result;
+}
@@ -4,10 +4,23 @@
 #include <fstream>
 #include <sstream>    // Added for std::stringstream
 #include <cstdlib>    // Added for std::remove
+#include <cstdint>
 #include "bn2.h"     
-
+#include "householder.h"
+#include "qr_params.h"
+#include "parking.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "qr_engine.h"
+#include "barrier_qr.h"
+#include "tuning.h"
+#include "mpi_qr.h"
+
+#include <chrono>
 #include <thread>
 
+#include <sys/mman.h>
+
 // Define color codes
 #define RED "\033[31m"
 #define GREEN "\033[32m"
@@ -160,6 +173,318 @@ void test_save() {
     }
 }
 
+double max_abs_diff(const matrix_t<double>& a, const matrix_t<double>& b);
+
+// Padded layout: aligned rows, zero padding, values kept across conversions
+// and written back row-major by save().
+void test_padded_layout() {
+    std::stringstream errors;
+
+    matrix_t<double> mat(5, 13);
+    for (int i = 0; i < mat.rows(); ++i) {
+        for (int j = 0; j < mat.cols(); ++j) {
+            mat.set(i, j, i * 100 + j);
+        }
+    }
+    matrix_t<double> original = mat;
+
+    mat.set_layout(matrix_layout_t::padded);
+    CHECK(mat.layout() == matrix_layout_t::padded, "Layout should be padded after set_layout", errors);
+    CHECK(mat.ld() >= mat.cols() && (mat.ld() * sizeof(double)) % 64 == 0,
+          "Padded rows should be whole cache lines, got ld=" << mat.ld(), errors);
+    CHECK(reinterpret_cast<uintptr_t>(mat.data_ptr()) % 64 == 0, "Storage should be cache-line aligned", errors);
+
+    bool same = true, zero_padding = true;
+    for (int i = 0; i < mat.rows(); ++i) {
+        for (int j = 0; j < mat.cols(); ++j) {
+            same = same && mat.get(i, j) == original.get(i, j);
+        }
+        for (int j = mat.cols(); j < mat.ld(); ++j) {
+            zero_padding = zero_padding && mat.data_ptr()[i * mat.ld() + j] == 0.0;
+        }
+    }
+    CHECK(same, "Values should survive the conversion to padded", errors);
+    CHECK(zero_padding, "Padding columns should be zero", errors);
+
+    matrix_t<double> wide(2, 512, matrix_layout_t::padded);
+    CHECK(wide.ld() != 512, "A 4 KiB row stride should be padded by a cache line", errors);
+
+    std::string filename = "test_padded_matrix.txt";
+    mat.save(filename);
+    matrix_t<double> loaded(filename, matrix_layout_t::padded);
+    matrix_t<double> loaded_rm(filename);
+    std::remove(filename.c_str());
+    CHECK(loaded.rows() == 5 && loaded.cols() == 13 && loaded.ld() == mat.ld(),
+          "Loading into the padded layout should keep the shape", errors);
+    CHECK(loaded_rm.ld() == 13, "Loading row-major should not pad", errors);
+    CHECK(max_abs_diff(loaded, original) == 0.0 && max_abs_diff(loaded_rm, original) == 0.0,
+          "Saved padded matrix should load back unchanged", errors);
+
+    mat.set_layout(matrix_layout_t::row_major);
+    CHECK(mat.ld() == mat.cols() && max_abs_diff(mat, original) == 0.0,
+          "Converting back to row-major should restore the original storage", errors);
+
+    if (errors.str().empty()) {
+        std::cout << std::left << std::setw(60) << "[MT4]. Test Padded Layout."
+                  << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+        std::cout << std::left << std::setw(60) << "[MT4]. Test Padded Layout."
+                  << RED << "[Failed]" << RESET << std::endl;
+        std::cout << errors.str()<< std::endl;
+    }
+}
+
+// Test Function 5: Huge-page / NUMA placed storage
+void test_placed_allocation() {
+    std::stringstream errors;
+
+    matrix_t<double> original(37, 29);
+    for (int i = 0; i < original.rows(); ++i) {
+        for (int j = 0; j < original.cols(); ++j) {
+            original.set(i, j, i * 100 + j);
+        }
+    }
+
+    alloc_policy_t thp;
+    thp.huge_pages = huge_pages_t::transparent;
+    thp.numa = numa_placement_t::interleave;
+    matrix_t<double> placed(original.rows(), original.cols(), matrix_layout_t::padded, thp);
+    CHECK(reinterpret_cast<uintptr_t>(placed.data_ptr()) % HUGE_PAGE_SIZE == 0,
+          "Huge-page storage should be 2 MB aligned", errors);
+    bool zero = true;
+    for (int i = 0; i < placed.rows() * placed.ld(); ++i) {
+        zero = zero && placed.data_ptr()[i] == 0.0;
+    }
+    CHECK(zero, "Mapped storage should start out zero", errors);
+
+    alloc_policy_t first_touch;
+    first_touch.numa = numa_placement_t::first_touch;
+    matrix_t<double> touched(original.rows(), original.cols(), matrix_layout_t::padded, first_touch);
+    first_touch_copy(touched, original, 8, std::vector<int>{-1, -1, -1});
+    CHECK(max_abs_diff(touched, original) == 0.0, "first_touch_copy should copy every tile", errors);
+
+    placed = touched;
+    matrix_t<double> moved(std::move(touched));
+    placed.set_layout(matrix_layout_t::row_major);
+    CHECK(max_abs_diff(placed, original) == 0.0 && max_abs_diff(moved, original) == 0.0,
+          "Placed matrices should copy, move and convert like heap ones", errors);
+    CHECK(placed.alloc_policy().numa == numa_placement_t::first_touch,
+          "Copies should keep the allocation policy", errors);
+
+    alloc_policy_t hugetlb;
+    hugetlb.huge_pages = huge_pages_t::hugetlb;
+    try {
+        matrix_t<double> reserved(original.rows(), original.cols(), matrix_layout_t::padded, hugetlb);
+        CHECK(reinterpret_cast<uintptr_t>(reserved.data_ptr()) % HUGE_PAGE_SIZE == 0,
+              "hugetlb storage should be 2 MB aligned", errors);
+    } catch (const std::runtime_error&) {
+        // No huge pages reserved on this machine: failing loudly is the contract.
+    }
+
+    if (errors.str().empty()) {
+        std::cout << std::left << std::setw(60) << "[MT5]. Test Placed Allocation."
+                  << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+        std::cout << std::left << std::setw(60) << "[MT5]. Test Placed Allocation."
+                  << RED << "[Failed]" << RESET << std::endl;
+        std::cout << errors.str()<< std::endl;
+    }
+}
+
+// Test Function 6: Worker affinity maps on a synthetic two-socket topology
+void test_affinity_map() {
+    std::stringstream errors;
+
+    // 2 sockets x 2 cores x 2 hyperthreads, numbered like Linux does:
+    // cpus 0-3 are the first siblings, 4-7 the second ones.
+    std::vector<cpu_info_t> topo = {
+        {0, 0, 0}, {1, 0, 1}, {2, 1, 0}, {3, 1, 1},
+        {4, 0, 0}, {5, 0, 1}, {6, 1, 0}, {7, 1, 1},
+    };
+
+    affinity_policy_t policy;
+    CHECK(affinity_map(policy, 3, topo) == std::vector<int>({-1, -1, -1}), "none should not pin", errors);
+
+    policy.kind = affinity_t::compact;
+    CHECK(affinity_map(policy, 8, topo) == std::vector<int>({0, 4, 1, 5, 2, 6, 3, 7}),
+          "compact should fill a core, then a socket", errors);
+
+    policy.kind = affinity_t::scatter;
+    CHECK(affinity_map(policy, 10, topo) == std::vector<int>({0, 2, 1, 3, 4, 6, 5, 7, 0, 2}),
+          "scatter should alternate sockets and use one sibling per core first", errors);
+
+    policy = parse_affinity("3,0-1");
+    CHECK(policy.kind == affinity_t::list && affinity_map(policy, 4, topo) == std::vector<int>({3, 0, 1, 3}),
+          "An explicit list should be used in order and wrap around", errors);
+
+    CHECK(parse_id_list("0,2,4-6\n") == std::vector<int>({0, 2, 4, 5, 6}), "parse_id_list should expand ranges", errors);
+    bool threw = false;
+    try {
+        parse_affinity("3-1");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "A malformed CPU list should be rejected", errors);
+
+    if (errors.str().empty()) {
+        std::cout << std::left << std::setw(60) << "[MT6]. Test Affinity Map."
+                  << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+        std::cout << std::left << std::setw(60) << "[MT6]. Test Affinity Map."
+                  << RED << "[Failed]" << RESET << std::endl;
+        std::cout << errors.str()<< std::endl;
+    }
+}
+
+// Test Function 7: Binary matrix files
+void test_binary_file() {
+    std::stringstream errors;
+
+    matrix_t<double> original(21, 13);
+    for (int i = 0; i < original.rows(); ++i) {
+        for (int j = 0; j < original.cols(); ++j) {
+            original.set(i, j, (i * 100 + j) * 0.25);
+        }
+    }
+    matrix_t<double> padded = original;
+    padded.set_layout(matrix_layout_t::padded);
+
+    std::string row_file = "test_matrix_row.dtsm", padded_file = "test_matrix_padded.dtsm";
+    original.save_binary(row_file);
+    padded.save_binary(padded_file);
+
+    // Every combination of file stride and requested layout: the matching
+    // ones are mapped, the others read row by row.
+    for (const std::string& file : {row_file, padded_file}) {
+        for (matrix_layout_t layout : {matrix_layout_t::row_major, matrix_layout_t::padded}) {
+            matrix_t<double> loaded(file, layout);
+            CHECK(loaded.layout() == layout && max_abs_diff(loaded, original) == 0.0,
+                  file << " should load unchanged into layout " << static_cast<int>(layout), errors);
+        }
+    }
+
+    // Mappings are private: writing the matrix must not change the file.
+    {
+        matrix_t<double> mapped(padded_file, matrix_layout_t::padded);
+        mapped.set(3, 4, -1.0);
+        matrix_t<double> copy = mapped;
+        CHECK(copy.get(3, 4) == -1.0, "A copy of a mapped matrix should see its writes", errors);
+    }
+    matrix_t<double> reloaded(padded_file, matrix_layout_t::padded);
+    CHECK(reloaded.get(3, 4) == original.get(3, 4), "Writes through a mapping should not reach the file", errors);
+
+    matrix_t<float> single(original.rows(), original.cols());
+    for (int i = 0; i < original.rows(); ++i) {
+        for (int j = 0; j < original.cols(); ++j) {
+            single.set(i, j, static_cast<float>(original.get(i, j)));
+        }
+    }
+    single.save_binary(row_file);
+    matrix_t<double> widened(row_file);
+    CHECK(max_abs_diff(widened, original) == 0.0, "A float file should convert to double on load", errors);
+
+    // Truncated file.
+    std::ifstream in(padded_file, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(padded_file, std::ios::binary) << bytes.substr(0, bytes.size() - 8);
+    bool threw = false;
+    try {
+        matrix_t<double> broken(padded_file);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw, "A truncated binary file should be rejected", errors);
+
+    std::remove(row_file.c_str());
+    std::remove(padded_file.c_str());
+
+    if (errors.str().empty()) {
+        std::cout << std::left << std::setw(60) << "[MT7]. Test Binary Matrix File."
+                  << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+        std::cout << std::left << std::setw(60) << "[MT7]. Test Binary Matrix File."
+                  << RED << "[Failed]" << RESET << std::endl;
+        std::cout << errors.str()<< std::endl;
+    }
+}
+
+// Expects loading contents as a text matrix to fail with exactly message,
+// whole and streamed.
+void check_text_error(const std::string& contents, const std::string& message, std::stringstream& errors) {
+    std::string filename = "test_text_error.txt";
+    std::ofstream(filename) << contents;
+    std::string got = "no error";
+    try {
+        matrix_t<double> mat(filename);
+    } catch (const std::runtime_error& e) {
+        got = e.what();
+    }
+    std::string streamed = "no error";
+    try {
+        matrix_stream_t stream(filename);
+        matrix_t<double> mat(stream.rows(), stream.cols());
+        for (int loaded = 0; loaded < stream.rows();) {
+            loaded = stream.load(mat, loaded, loaded + 1);
+        }
+    } catch (const std::runtime_error& e) {
+        streamed = e.what();
+    }
+    std::remove(filename.c_str());
+    CHECK(got == message, "Expected \"" << message << "\", got \"" << got << "\"", errors);
+    CHECK(streamed == message, "Streaming: expected \"" << message << "\", got \"" << streamed << "\"", errors);
+}
+
+// Test Function 8: Parallel text parser
+void test_text_parser() {
+    std::stringstream errors;
+
+    // Big enough for several chunks; no header, so rows follow lines.
+    matrix_t<double> original(1000, 997);
+    for (int i = 0; i < original.rows(); ++i) {
+        for (int j = 0; j < original.cols(); ++j) {
+            original.set(i, j, ((i * 997 + j) % 4001) * 0.25 - 500.0);
+        }
+    }
+    std::string filename = "test_text_parser.txt";
+    original.save(filename);
+
+    for (int threads : {1, 4}) {
+        text_matrix_file_t file(filename, threads);
+        matrix_t<double> parsed(file.rows(), file.cols(), matrix_layout_t::padded);
+        file.parse(parsed.data_ptr(), parsed.ld());
+        CHECK(!file.has_header() && max_abs_diff(parsed, original) == 0.0,
+              "Parsing with " << threads << " threads should give the saved matrix", errors);
+    }
+
+    std::ofstream(filename) << "2 3\n1 +2.5 -3e2\n\n4 5\n 6\n";
+    matrix_t<double> with_header(filename);
+    CHECK(with_header.rows() == 2 && with_header.cols() == 3 && with_header.get(0, 1) == 2.5 &&
+          with_header.get(0, 2) == -300.0 && with_header.get(1, 2) == 6.0,
+          "With a header the values should be read as one stream", errors);
+    std::ofstream(filename) << "1.5 2\n3 4\n\n";
+    matrix_t<double> no_header(filename);
+    CHECK(no_header.rows() == 2 && no_header.cols() == 2 && no_header.get(0, 0) == 1.5,
+          "A first line of non-integers should be a matrix row", errors);
+    std::remove(filename.c_str());
+
+    check_text_error("", "Error: file is empty.", errors);
+    check_text_error("\n1 2\n", "Error: first line does not contain any matrix data.", errors);
+    check_text_error("1 2 3\n4 5\n", "Inconsistent number of columns in the matrix file. Expected 3, but got 2.", errors);
+    check_text_error("1 2 3\n4 x 6\n", "Error reading matrix value at (1, 1).", errors);
+    check_text_error("2 2\n1 2 3\n", "Error reading matrix value at (1, 1).", errors);
+    check_text_error("1 2\n1 2 3\n", "Extra data found in the file after reading the matrix.", errors);
+
+    if (errors.str().empty()) {
+        std::cout << std::left << std::setw(60) << "[MT8]. Test Parallel Text Parser."
+                  << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+        std::cout << std::left << std::setw(60) << "[MT8]. Test Parallel Text Parser."
+                  << RED << "[Failed]" << RESET << std::endl;
+        std::cout << errors.str()<< std::endl;
+    }
+}
+
 // ========================= DependencyTable Tests =========================
 
 // Test Function 4: Default Constructor
@@ -1078,32 +1403,34 @@ void test_atomic_queue_push_pop_fifo() {
     }
 }
 
-// Test 3: Test push_front and pop_back (reverse order behavior).
-void test_atomic_queue_push_front_pop_back() {
+// Test 3: push_bulk / pop_bulk claim runs of slots, in FIFO order, and
+// stop at a full or empty ring.
+void test_atomic_queue_bulk() {
     std::stringstream errors;
     CircularQueueAtomic<int> queue(5);
-
-    // Insert elements using push_front.
-    for (int i = 0; i < 3; ++i) {
-        bool ok = queue.push_front(100 + i);
-        CHECK(ok, "push_front should succeed", errors);
-    }
-    // When using push_front, the first inserted element is at the back.
-    // Removing elements via pop_back should return them in the order of insertion.
-    for (int i = 0; i < 3; ++i) {
-        auto opt = queue.pop_back();
-        CHECK(opt.has_value(), "pop_back should return a value", errors);
-        CHECK(opt.value() == 100 + i, "pop_back value should match order", errors);
+    int values[7] = {10, 11, 12, 13, 14, 15, 16};
+    int out[7] = {};
+
+    CHECK(queue.push_bulk(values, 3) == 3, "push_bulk of 3 should push all 3", errors);
+    CHECK(queue.push_bulk(values + 3, 4) == 2, "push_bulk should stop at a full ring", errors);
+    CHECK(queue.full() && queue.push_bulk(values, 1) == 0, "push_bulk on a full ring should push nothing", errors);
+    CHECK(queue.pop_bulk(out, 2) == 2 && out[0] == 10 && out[1] == 11, "pop_bulk should take the oldest", errors);
+    CHECK(queue.push_bulk(values + 5, 2) == 2, "push_bulk should reuse the freed slots", errors);
+    size_t popped = queue.pop_bulk(out, 7);
+    bool order = popped == 5;
+    for (size_t k = 0; order && k < popped; ++k) {
+        order = out[k] == (k < 3 ? 12 + static_cast<int>(k) : 15 + static_cast<int>(k) - 3);
     }
-    CHECK(queue.empty(), "Queue should be empty after pop_back operations", errors);
+    CHECK(order, "pop_bulk across the wrap should return the values in push order", errors);
+    CHECK(queue.empty() && queue.pop_bulk(out, 3) == 0, "pop_bulk on an empty ring should pop nothing", errors);
 
     if (errors.str().empty()) {
          std::cout << std::left << std::setw(60)
-                   << "[AtomicQueueTest3] Test Push_Front and Pop_Back"
+                   << "[AtomicQueueTest3] Test Push_Bulk and Pop_Bulk"
                    << GREEN << "[Passed]" << RESET << std::endl;
     } else {
          std::cout << std::left << std::setw(60)
-                   << "[AtomicQueueTest3] Test Push_Front and Pop_Back"
+                   << "[AtomicQueueTest3] Test Push_Bulk and Pop_Bulk"
                    << RED << "[Failed]" << RESET << std::endl;
          std::cout << errors.str();
          total_failures++;
@@ -1123,7 +1450,6 @@ void test_atomic_queue_full() {
 
     // Additional pushes should fail.
     CHECK(!queue.push_back(4), "push_back 4 should fail on full queue", errors);
-    CHECK(!queue.push_front(5), "push_front 5 should fail on full queue", errors);
 
     // After a pop, the queue should no longer be full.
     auto opt = queue.pop_front();
@@ -1197,6 +1523,140 @@ void test_atomic_queue_multi_threaded() {
     }
 }
 
+// Test 7: Several producers and consumers, single and bulk, through a small
+// ring that wraps many times. Every value comes out exactly once, and each
+// consumer sees the values of one producer in the order they were pushed.
+void test_atomic_queue_mpmc_stress() {
+    std::stringstream errors;
+    const int producers = 4, consumers = 4, per_producer = 20000;
+    CircularQueueAtomic<int> queue(37);
+    std::vector<std::atomic<int>> seen(producers * per_producer);
+    for (auto& s : seen) {
+        s.store(0);
+    }
+    std::atomic<int> consumed{0};
+    std::atomic<int> order_errors{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            int buffer[9];
+            int next = 0;
+            unsigned seed = 7 + p;
+            while (next < per_producer) {
+                seed = seed * 1103515245u + 12345u;
+                int n = std::min<int>(1 + (seed >> 16) % 9, per_producer - next);
+                for (int k = 0; k < n; ++k) {
+                    buffer[k] = p * per_producer + next + k;
+                }
+                size_t pushed = p % 2 == 0 ? queue.push_bulk(buffer, n) : queue.push(buffer[0]);
+                if (pushed == 0) {
+                    std::this_thread::yield();
+                }
+                next += static_cast<int>(pushed);
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            std::vector<int> last(producers, -1);
+            int buffer[6];
+            while (consumed.load() < producers * per_producer) {
+                size_t n = c % 2 == 0 ? queue.pop_bulk(buffer, 6) : queue.pop_bulk(buffer, 1);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    int p = buffer[k] / per_producer;
+                    if (buffer[k] % per_producer <= last[p]) {
+                        order_errors++;
+                    }
+                    last[p] = buffer[k] % per_producer;
+                    seen[buffer[k]]++;
+                }
+                consumed += static_cast<int>(n);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    int wrong = 0;
+    for (auto& s : seen) {
+        wrong += s.load() != 1;
+    }
+    CHECK(wrong == 0, wrong << " values were lost or popped twice", errors);
+    CHECK(order_errors.load() == 0, order_errors.load() << " values came out of their producer's order", errors);
+    CHECK(queue.empty(), "The ring should be empty at the end", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[AtomicQueueTest7] Test MPMC Stress (single and bulk)"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[AtomicQueueTest7] Test MPMC Stress (single and bulk)"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+         total_failures++;
+    }
+}
+
+// Test 8: A value is visible whole to the consumer that pops it: every
+// producer writes a value the consumer can check against its key.
+void test_atomic_queue_publication() {
+    std::stringstream errors;
+    struct item_t {
+        uint64_t key;
+        uint64_t check;
+    };
+    const int producers = 3, per_producer = 50000;
+    CircularQueueAtomic<item_t> queue(8);
+    std::atomic<int> consumed{0};
+    std::atomic<int> torn{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int k = 0; k < per_producer;) {
+                uint64_t key = static_cast<uint64_t>(p) * per_producer + k;
+                item_t item = {key, key * 0x9E3779B97F4A7C15ull};
+                if (queue.push(item)) {
+                    ++k;
+                }
+            }
+        });
+    }
+    for (int c = 0; c < 2; ++c) {
+        threads.emplace_back([&] {
+            while (consumed.load() < producers * per_producer) {
+                if (auto item = queue.pop()) {
+                    torn += item->check != item->key * 0x9E3779B97F4A7C15ull;
+                    consumed++;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    CHECK(torn.load() == 0, torn.load() << " values were read before they were written", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[AtomicQueueTest8] Test Publication Before Pop"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[AtomicQueueTest8] Test Publication Before Pop"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+         total_failures++;
+    }
+}
+
 // Test 6: Verify the convenience push/pop methods.
 void test_atomic_queue_push_and_pop() {
     std::stringstream errors;
@@ -1227,57 +1687,2273 @@ void test_atomic_queue_push_and_pop() {
     }
 }
 
-int main(int argc, char *argv[]) {
-    std::cout << "Inside Test.\n" << std::endl;
+// Test 9: FIFO order holds while the positions wrap around the ring many
+// times: a fill and a drain from every offset, then a steady push/pop
+// stream that keeps the ring partly full, with the size checked throughout.
+void test_atomic_queue_wraparound() {
+    std::stringstream errors;
+    const size_t capacity = 3;
+    CircularQueueAtomic<int> queue(capacity);
+    int next_push = 0;
+    int next_pop = 0;
 
-    std::cout << YELLOW << "Starting matrix_t Test Cases." << RESET << std::endl;
+    for (size_t offset = 0; offset < 2 * capacity; ++offset) {
+        CHECK(queue.push_back(next_push++), "push_back should succeed on a partly full ring", errors);
+        for (size_t k = 1; k < capacity; ++k) {
+            CHECK(queue.push_back(next_push++), "push_back should fill the ring from offset " << offset, errors);
+        }
+        CHECK(queue.full() && !queue.push_back(-1), "A filled ring should reject a push", errors);
+        for (size_t k = 0; k < capacity; ++k) {
+            auto opt = queue.pop_front();
+            CHECK(opt.has_value() && opt.value() == next_pop, "pop_front should return push order after wrapping, offset "
+                  << offset << ": expected " << next_pop, errors);
+            ++next_pop;
+        }
+        CHECK(queue.empty() && !queue.pop_front().has_value(), "A drained ring should be empty", errors);
+        // Shift the next fill by one slot.
+        CHECK(queue.push_back(next_push++), "push_back should succeed on an empty ring", errors);
+        auto opt = queue.pop_front();
+        CHECK(opt.has_value() && opt.value() == next_pop, "pop_front should return the single value", errors);
+        ++next_pop;
+    }
 
-    // Run matrix_t test functions
-    test_operator_access();
-    test_get_set();
-    test_save();
+    CHECK(queue.push_back(next_push++) && queue.push_back(next_push++), "push_back should succeed", errors);
+    for (int round = 0; round < 1000; ++round) {
+        CHECK(queue.push_back(next_push++), "push_back should succeed in the stream", errors);
+        auto opt = queue.pop_front();
+        if (!opt.has_value() || opt.value() != next_pop) {
+            CHECK(false, "pop_front out of order in round " << round << ": expected " << next_pop, errors);
+            break;
+        }
+        ++next_pop;
+        CHECK(queue.size() == 2, "Size should stay 2 in the stream", errors);
+    }
+    while (auto opt = queue.pop_front()) {
+        CHECK(opt.value() == next_pop, "pop_front should drain in push order", errors);
+        ++next_pop;
+    }
+    CHECK(next_pop == next_push && queue.empty(), "Every pushed value should be popped once", errors);
 
-    std::cout << YELLOW << "\nStarting DependencyTable Test Cases." << RESET << std::endl;
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[AtomicQueueTest9] Test FIFO Order Across Wraparound"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[AtomicQueueTest9] Test FIFO Order Across Wraparound"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+         total_failures++;
+    }
+}
 
-    // Run DependencyTable test functions
-    test_default_constructor();
-    test_parameterized_constructor();
-    test_init();
-    test_move_constructor();
-    test_move_assignment();
-    test_get_set_dependency();
-    test_operator_overloading();
-    test_out_of_bounds();
+// ===================== WorkStealingDeque Tests ========================== //
 
-    std::cout << YELLOW << "\nStarting DependencyTableAtomic Test Cases." << RESET << std::endl;
+// Test 1: Owner pops LIFO, thieves steal FIFO.
+void test_ws_deque_lifo_fifo() {
+    std::stringstream errors;
+    WorkStealingDeque<int> deque(4);
 
-    // Run DependencyTableAtomic test functions
-    test_default_constructor_atomic();
-    test_parameterized_constructor_atomic();
-    test_init_atomic();
-    test_move_constructor_atomic();
-    test_move_assignment_atomic();
-    test_get_set_dependency_atomic();
-    test_operator_overloading_atomic();
-    test_out_of_bounds_atomic();
+    CHECK(deque.empty(), "New deque should be empty", errors);
+    for (int i = 0; i < 4; ++i) {
+         deque.push_back(i);
+    }
+    CHECK(deque.size() == 4, "Size should be 4 after four pushes", errors);
+
+    auto stolen = deque.steal();
+    CHECK(stolen.has_value() && stolen.value() == 0, "steal should take the oldest element", errors);
+    auto popped = deque.pop_back();
+    CHECK(popped.has_value() && popped.value() == 3, "pop_back should take the newest element", errors);
+    popped = deque.pop_back();
+    CHECK(popped.has_value() && popped.value() == 2, "pop_back should take the next newest element", errors);
+    stolen = deque.steal();
+    CHECK(stolen.has_value() && stolen.value() == 1, "steal should take the last element", errors);
+    CHECK(!deque.pop_back().has_value(), "pop_back on an empty deque should return nullopt", errors);
+    CHECK(!deque.steal().has_value(), "steal on an empty deque should return nullopt", errors);
 
-    std::cout << YELLOW << "\nStarting CircularQueueMtx Test Cases." << RESET << std::endl;
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[WSDequeTest1] Test Owner LIFO / Thief FIFO"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[WSDequeTest1] Test Owner LIFO / Thief FIFO"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
 
-    test_queue_empty_and_size();
-    test_queue_push_pop_fifo();
-    test_queue_push_front_pop_back();
-    test_queue_full();
-    test_queue_multi_threaded();
+// Test 2: The buffer grows past its initial capacity without losing elements.
+void test_ws_deque_grow() {
+    std::stringstream errors;
+    WorkStealingDeque<int> deque(2);
 
-    std::cout << YELLOW << "\nStarting CircularQueueAtomic Test Cases." << RESET << std::endl;
+    for (int i = 0; i < 100; ++i) {
+         deque.push_back(i);
+    }
+    CHECK(deque.size() == 100, "Size should be 100 after growing", errors);
+    for (int i = 0; i < 50; ++i) {
+         auto stolen = deque.steal();
+         CHECK(stolen.has_value() && stolen.value() == i, "steal should return elements in push order", errors);
+    }
+    for (int i = 99; i >= 50; --i) {
+         auto popped = deque.pop_back();
+         CHECK(popped.has_value() && popped.value() == i, "pop_back should return elements in reverse order", errors);
+    }
+    CHECK(deque.empty(), "Deque should be empty after draining", errors);
 
-    test_atomic_queue_empty_and_size();
-    test_atomic_queue_push_pop_fifo();
-    test_atomic_queue_push_front_pop_back();
-    test_atomic_queue_full();
-    test_atomic_queue_multi_threaded();
-    test_atomic_queue_push_and_pop();
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[WSDequeTest2] Test Growth"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[WSDequeTest2] Test Growth"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 3: One owner pushing/popping against several thieves; every element is
+// taken exactly once.
+void test_ws_deque_multi_threaded() {
+    std::stringstream errors;
+    const int numElements = 20000;
+    const int numThieves = 3;
+    WorkStealingDeque<int> deque(8);
+    std::vector<std::atomic<int>> taken(numElements);
+    for (auto& t : taken) {
+         t.store(0);
+    }
+    std::atomic<int> total{0};
+    std::atomic<bool> done{false};
+
+    auto thief = [&]() {
+         while (!done.load() || !deque.empty()) {
+              auto item = deque.steal();
+              if (item.has_value()) {
+                   taken[item.value()].fetch_add(1);
+                   total.fetch_add(1);
+              } else {
+                   std::this_thread::yield();
+              }
+         }
+    };
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < numThieves; ++i) {
+         thieves.emplace_back(thief);
+    }
+
+    for (int i = 0; i < numElements; ++i) {
+         deque.push_back(i);
+         if (i % 3 == 0) {
+              auto item = deque.pop_back();
+              if (item.has_value()) {
+                   taken[item.value()].fetch_add(1);
+                   total.fetch_add(1);
+              }
+         }
+    }
+    while (auto item = deque.pop_back()) {
+         taken[item.value()].fetch_add(1);
+         total.fetch_add(1);
+    }
+    done = true;
+    for (auto& t : thieves) {
+         t.join();
+    }
+
+    CHECK(total.load() == numElements, "Every pushed element should be taken", errors);
+    bool once = true;
+    for (auto& t : taken) {
+         once = once && t.load() == 1;
+    }
+    CHECK(once, "No element should be taken twice", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[WSDequeTest3] Test Multi-threaded Owner and Thieves"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[WSDequeTest3] Test Multi-threaded Owner and Thieves"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ==================== BucketPriorityQueue Tests ========================= //
+
+// Test 1: Highest priority first, FIFO within a priority, capacity enforced.
+void test_bucket_pq_order() {
+    std::stringstream errors;
+    // Priorities 0..69 so that the bitmap spans two words.
+    std::vector<size_t> capacity(70, 2);
+    BucketPriorityQueue<int> queue(capacity);
+
+    CHECK(queue.empty() && !queue.pop().has_value(), "A new queue should be empty", errors);
+    // Value = 10 * priority + push order within the priority.
+    for (int v : {30, 650, 0, 651, 31, 640}) {
+        queue.push(v, v / 10);
+    }
+    std::vector<int> popped;
+    while (auto v = queue.pop()) {
+        popped.push_back(v.value());
+    }
+    CHECK(popped == std::vector<int>({650, 651, 640, 30, 31, 0}),
+          "Elements should come out by priority, then in push order", errors);
+
+    queue.push(7, 5);
+    queue.push(8, 5);
+    bool threw = false;
+    try {
+        queue.push(9, 5);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    CHECK(threw, "Pushing past a priority's capacity should throw", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[BPQTest1] Test Priority and FIFO Order"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[BPQTest1] Test Priority and FIFO Order"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 2: Concurrent producers and consumers take every element exactly once.
+void test_bucket_pq_multi_threaded() {
+    std::stringstream errors;
+    const int numPriorities = 300;
+    const int perPriority = 64;
+    const int numThreads = 4;
+    const int total = numPriorities * perPriority;
+    BucketPriorityQueue<int> queue(std::vector<size_t>(numPriorities, perPriority));
+    std::vector<std::atomic<int>> taken(total);
+    for (auto& t : taken) {
+         t.store(0);
+    }
+    std::atomic<int> count{0};
+
+    auto worker = [&](int id) {
+         // Each thread pushes its share and pops whatever is there.
+         for (int k = id; k < total; k += numThreads) {
+              queue.push(k, k % numPriorities);
+              if (auto v = queue.pop()) {
+                   taken[v.value()].fetch_add(1);
+                   count.fetch_add(1);
+              }
+         }
+         while (count.load() < total) {
+              if (auto v = queue.pop()) {
+                   taken[v.value()].fetch_add(1);
+                   count.fetch_add(1);
+              } else {
+                   std::this_thread::yield();
+              }
+         }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+         threads.emplace_back(worker, i);
+    }
+    for (auto& t : threads) {
+         t.join();
+    }
+
+    bool once = true;
+    for (auto& t : taken) {
+         once = once && t.load() == 1;
+    }
+    CHECK(count.load() == total && once, "Every element should be taken exactly once", errors);
+    CHECK(queue.empty(), "The queue should be empty at the end", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[BPQTest2] Test Multi-threaded Push and Pop"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[BPQTest2] Test Multi-threaded Push and Pop"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 4: A push in flight in a higher bucket does not hide the elements of
+// the lower ones. The value's assignment, which push() runs before it marks
+// the slot full, holds the push until the test lets it go.
+std::atomic<bool> bpq_release_push{false};
+
+struct held_value_t {
+    int v = 0;
+    bool hold = false;
+    held_value_t() = default;
+    held_value_t(int value, bool held) : v(value), hold(held) {}
+    held_value_t(const held_value_t&) = default;
+    held_value_t& operator=(const held_value_t& other) {
+        while (other.hold && !bpq_release_push.load()) {
+            std::this_thread::yield();
+        }
+        v = other.v;
+        hold = false;
+        return *this;
+    }
+};
+
+void test_bucket_pq_push_in_flight() {
+    std::stringstream errors;
+    BucketPriorityQueue<held_value_t> queue(std::vector<size_t>(70, 2));
+    queue.push(held_value_t(3, false), 3);
+    std::atomic<bool> started{false};
+    std::thread pusher([&] {
+         started.store(true);
+         queue.push(held_value_t(69, true), 69);
+    });
+    while (!started.load()) {
+         std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));  // Into the held assignment.
+
+    auto low = queue.pop();
+    CHECK(low.has_value() && low->v == 3, "pop() should skip the bucket with a push in flight", errors);
+    bpq_release_push.store(true);
+    pusher.join();
+    auto high = queue.pop();
+    CHECK(high.has_value() && high->v == 69 && queue.empty(),
+          "The pushed element should be found once its push returns", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[BPQTest4] Test Pop Past a Push in Flight"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[BPQTest4] Test Pop Past a Push in Flight"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 3: Task ranks put every panel task above every update task.
+void test_task_ranks() {
+    std::stringstream errors;
+    matrix_t<double> mat(40, 40);
+    TaskTable table;
+    table.init(5, 10, 4, 8, mat);
+
+    std::vector<size_t> counts = table.rankCounts();
+    size_t sum = 0, lowest_type1 = SIZE_MAX, highest_type2 = 0;
+    for (size_t c : counts) {
+         sum += c;
+    }
+    for (int i = 0; i < table.rows(); ++i) {
+         for (int j = 0; j < table.cols(); ++j) {
+              const Task* t = table.getTask(i, j);
+              if (t == nullptr) {
+                   continue;
+              }
+              size_t r = table.rank(t);
+              if (t->type == 1) {
+                   lowest_type1 = std::min(lowest_type1, r);
+              } else {
+                   highest_type2 = std::max(highest_type2, r);
+              }
+         }
+    }
+    CHECK(counts.size() == table.numRanks() && sum == static_cast<size_t>(table.numTasks()),
+          "rankCounts should count every task once", errors);
+    CHECK(lowest_type1 > highest_type2, "Type-1 tasks should rank above all type-2 tasks", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[BPQTest3] Test Task Ranks"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[BPQTest3] Test Task Ranks"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ========================== Trace Tests ================================= //
+
+// Test 1: The ring keeps the most recent events and counts the dropped ones.
+void test_trace_buffer() {
+    std::stringstream errors;
+    TraceBuffer buffer(3);
+    CHECK(buffer.capacity() == 4, "Capacity should round up to a power of two", errors);
+    for (int k = 0; k < 6; ++k) {
+         buffer.record({k, 0, 2, 0, 0, static_cast<uint64_t>(k), static_cast<uint64_t>(k + 1)});
+    }
+    std::vector<trace_event_t> kept = buffer.snapshot();
+    CHECK(buffer.dropped() == 2 && kept.size() == 4 && kept.front().i == 2 && kept.back().i == 5,
+          "The last four events should be kept, oldest first", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[TraceTest1] Test Event Ring"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[TraceTest1] Test Event Ring"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 2: Summary of a hand-made schedule of a 2 x 2 task graph, and export.
+void test_trace_summary() {
+    std::stringstream errors;
+    // ALPHA = BETA = 4 on 8 rows: tasks (0,0) T1, (1,0) T2, (1,1) T1.
+    matrix_t<double> mat(8, 8);
+    TaskTable table;
+    table.init(2, 2, 4, 4, mat);
+
+    std::vector<TraceBuffer> buffers(2, TraceBuffer(8));
+    uint64_t origin = 1000;
+    buffers[0].record({0, 0, 1, 0, 1000, 1000, 1100});  // 100 ns.
+    buffers[1].record({1, 0, 2, 1, 1100, 1150, 1400});  // 250 ns, queued 50.
+    buffers[0].record({1, 1, 1, 0, 1400, 1400, 1500});  // 100 ns.
+    std::vector<trace_event_t> events = collect_trace(buffers, origin);
+    trace_summary_t s = summarize_trace(events, table, 2);
+
+    CHECK(events.size() == 3 && events[1].i == 1 && events[1].start_ns == 150,
+          "Events should be merged by start time relative to the origin", errors);
+    CHECK(s.makespan_ns == 500 && s.critical_path_ns == 450 && s.busy_ns == 450,
+          "Makespan " << s.makespan_ns << ", critical path " << s.critical_path_ns << ", busy " << s.busy_ns, errors);
+    CHECK(s.idle_ns == std::vector<uint64_t>({300, 250}) && s.max_queue_ns == 50,
+          "Idle and queueing times should follow the schedule", errors);
+
+    std::string prefix = "test_trace";
+    write_chrome_trace(prefix + ".json", events, 2);
+    write_trace_csv(prefix + ".csv", events);
+    std::ifstream json(prefix + ".json"), csv(prefix + ".csv");
+    std::string json_text((std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+    int csv_lines = 0;
+    for (std::string line; std::getline(csv, line);) {
+         ++csv_lines;
+    }
+    CHECK(json_text.find("\"name\":\"T2(1,0)\"") != std::string::npos && json_text.find("\"dur\":0.250") != std::string::npos,
+          "The Chrome trace should hold every task", errors);
+    CHECK(csv_lines == 4, "The CSV should have a header and one line per task", errors);
+    std::remove((prefix + ".json").c_str());
+    std::remove((prefix + ".csv").c_str());
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[TraceTest2] Test Summary and Export"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[TraceTest2] Test Summary and Export"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ===================== Performance Counter Tests ======================== //
+
+// Test 1: Counts are charged to the category that ran and reported as JSON;
+// without perf_event access every event must come out null.
+void test_perf_counters() {
+    std::stringstream errors;
+    std::vector<PerfAccumulator> workers(1);
+    bool opened = workers[0].start();
+
+    volatile double sink = 0;
+    for (int k = 0; k < 2000000; ++k) {
+         sink = sink + k * 0.5;
+    }
+    workers[0].charge(perf_category_t::type2);
+    workers[0].charge(perf_category_t::type1);
+    workers[0].stop();
+
+    CHECK(workers[0].tasks[0] == 1 && workers[0].tasks[1] == 1 && workers[0].tasks[2] == 0,
+          "Every kernel charge should count one task", errors);
+    int clock = -1;
+    for (size_t k = 0; k < perf_event_specs().size(); ++k) {
+         if (std::string(perf_event_specs()[k].name) == "task_clock_ns") {
+              clock = static_cast<int>(k);
+         }
+    }
+    if (opened && workers[0].counters().has_event(clock)) {
+         CHECK(workers[0].totals[1].value[clock] > workers[0].totals[0].value[clock],
+               "The loop should be charged to type2", errors);
+    }
+
+    std::stringstream json;
+    write_perf_report(json, workers, 1.5, {{"alpha", "4"}});
+    std::string text = json.str();
+    CHECK(text.find("{\"run\":{\"alpha\":\"4\"},\"wall_ms\":1.5,\"workers\":1") == 0 &&
+          text.find("\"type2\":{\"tasks\":1") != std::string::npos && text.back() == '\n',
+          "The report should be one JSON line per run: " << text, errors);
+    if (!opened) {
+         CHECK(text.find("\"task_clock_ns\":null") != std::string::npos, "Unavailable events should be null", errors);
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[PerfTest1] Test Counter Charging and Report"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[PerfTest1] Test Counter Charging and Report"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ======================== WorkerParker Tests ============================ //
+
+// Test 1: Workers that park immediately are woken for every pushed item and
+// by the termination broadcast.
+void test_parker_wakeups() {
+    std::stringstream errors;
+    const int numWorkers = 4;
+    const int numElements = 2000;
+    CircularQueueMtx<int> queue(numElements);
+    WorkerParker parker;
+    idle_policy_t policy;
+    policy.spin = 0;
+    policy.yield = 0;
+    std::atomic<int> consumed{0};
+
+    auto worker = [&]() {
+         IdleBackoff backoff(policy);
+         while (!parker.finished()) {
+              std::optional<int> item = queue.pop();
+              if (!item.has_value()) {
+                   if (!backoff.wait()) {
+                        continue;
+                   }
+                   parker.park([&]() { item = queue.pop(); return item.has_value(); });
+                   backoff.reset();
+                   if (!item.has_value()) {
+                        continue;
+                   }
+              }
+              consumed.fetch_add(1);
+         }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < numWorkers; ++i) {
+         workers.emplace_back(worker);
+    }
+    for (int i = 0; i < numElements; ++i) {
+         queue.push(i);
+         parker.notify(1);
+         if (i % 100 == 0) {
+              std::this_thread::sleep_for(std::chrono::microseconds(200));
+         }
+    }
+    while (consumed.load() < numElements) {
+         std::this_thread::yield();
+    }
+    parker.shutdown();
+    for (auto& t : workers) {
+         t.join();
+    }
+
+    CHECK(consumed.load() == numElements, "Every pushed item should be consumed", errors);
+    CHECK(parker.finished(), "Parker should report finished after shutdown", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[ParkerTest1] Test Wake-ups and Shutdown"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[ParkerTest1] Test Wake-ups and Shutdown"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ====================== Householder Kernel Tests ========================= //
+
+// Fills an m x n matrix with deterministic pseudo-random values in [-0.5, 0.5).
+void fill_test_matrix(matrix_t<double>& mat, unsigned seed) {
+    unsigned state = seed;
+    for (int i = 0; i < mat.rows(); ++i) {
+        for (int j = 0; j < mat.cols(); ++j) {
+            state = state * 1103515245u + 12345u;
+            mat.set(i, j, static_cast<double>((state >> 8) & 0xFFFF) / 65536.0 - 0.5);
+        }
+    }
+}
+
+// Reference result: every pivot applied by a single type-1 task.
+void factorize_unblocked(matrix_t<double>& mat) {
+    std::vector<double> up(mat.rows(), 0.0), b(mat.rows(), 0.0);
+    complete_task1(mat.data_ptr(), mat.ld(), 0, std::min(mat.rows(), mat.cols()), mat.rows(), up.data(), b.data());
+}
+
+// Runs the tiled task graph sequentially, one pivot block at a time.
+void factorize_tiled(matrix_t<double>& mat, const qr_params_t& params) {
+    int total_task_rows = params.task_rows(mat.rows());
+    int total_task_cols = params.task_cols(mat.rows(), mat.cols());
+    TaskTable table(total_task_rows, total_task_cols, params.alpha, params.beta, mat);
+    task_kernels_t<double> kernels = select_task_kernels(params.alpha, params.beta, params.simd);
+    std::vector<double> up(mat.rows(), 0.0), b(mat.rows(), 0.0);
+    std::vector<double> t(params.alpha * params.alpha, 0.0);
+    bool wy = params.update == update_t::wy;
+
+    for (int j = 0; j < total_task_cols; ++j) {
+        int r = j / params.beta_div_alpha();
+        Task* t1 = table.getTask(r, j);
+        kernels.task1(mat.data_ptr(), mat.ld(), t1->row_start, t1->row_end, t1->col_end, up.data(), b.data());
+        if (wy) {
+            build_block_reflector(mat.data_ptr(), mat.ld(), t1->row_start, t1->row_end, up.data(), b.data(), t.data());
+        }
+        for (int k = r + 1; k < total_task_rows; ++k) {
+            Task* t2 = table.getTask(k, j);
+            if (wy) {
+                kernels.task2_wy(mat.data_ptr(), mat.ld(), t2->row_start, t2->row_end, t2->col_start, t2->col_end,
+                                 up.data(), t.data());
+            } else {
+                kernels.task2(mat.data_ptr(), mat.ld(), t2->row_start, t2->row_end, t2->col_start, t2->col_end,
+                              up.data(), b.data());
+            }
+        }
+    }
+}
+
+double max_abs_diff(const matrix_t<double>& a, const matrix_t<double>& b) {
+    double diff = 0.0;
+    for (int i = 0; i < a.rows(); ++i) {
+        for (int j = 0; j < a.cols(); ++j) {
+            diff = std::max(diff, std::fabs(a.get(i, j) - b.get(i, j)));
+        }
+    }
+    return diff;
+}
+
+// Kernel ISAs this CPU can run.
+std::vector<simd_isa_t> supported_isas() {
+    std::vector<simd_isa_t> isas;
+    for (simd_isa_t isa : {simd_isa_t::scalar, simd_isa_t::avx2, simd_isa_t::avx512}) {
+        if (simd_isa_supported(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    return isas;
+}
+
+// Test 1: Tiled kernels (specialized and generic tile shapes, full and clipped
+// tiles, every supported ISA) reproduce the unblocked factorization.
+void test_tiled_kernels_match_unblocked() {
+    std::stringstream errors;
+    const int shapes[][2] = {{2, 2}, {4, 16}, {8, 32}, {32, 32}, {3, 9}, {5, 5}, {7, 28}, {36, 36}};
+
+    for (int size : {64, 75}) {
+        matrix_t<double> reference(size, size);
+        fill_test_matrix(reference, 7u + size);
+        matrix_t<double> input = reference;
+        factorize_unblocked(reference);
+
+        for (simd_isa_t isa : supported_isas()) {
+            for (const auto& shape : shapes) {
+                qr_params_t params;
+                params.alpha = shape[0];
+                params.beta = shape[1];
+                params.simd = isa;
+                for (matrix_layout_t layout : {matrix_layout_t::row_major, matrix_layout_t::padded}) {
+                    matrix_t<double> tiled = input;
+                    tiled.set_layout(layout);
+                    factorize_tiled(tiled, params);
+                    CHECK(max_abs_diff(tiled, reference) < 1e-10,
+                          "Tiled result differs for size " << size << ", ALPHA=" << shape[0] << ", BETA=" << shape[1]
+                          << ", ISA=" << simd_isa_name(isa)
+                          << (layout == matrix_layout_t::padded ? ", padded" : ""), errors);
+                }
+            }
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK1]. Test Tiled Kernels Match Unblocked"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK1]. Test Tiled Kernels Match Unblocked"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 2: Kernel selection picks specialized kernels only for supported shapes.
+void test_kernel_selection() {
+    std::stringstream errors;
+
+    task_kernels_t<double> fixed = select_task_kernels(4, 16, simd_isa_t::scalar);
+    CHECK((fixed.task1 == &complete_task1_fixed<double, 4>), "ALPHA=4 should select the specialized type-1 kernel", errors);
+    CHECK((fixed.task2 == &complete_task2_fixed<double, 4, 16>), "ALPHA=4, BETA=16 should select the specialized type-2 kernel", errors);
+
+    task_kernels_t<double> odd = select_task_kernels(3, 9, simd_isa_t::scalar);
+    CHECK((odd.task1 == &complete_task1_fixed<double, 3>), "ALPHA=3 should select the specialized type-1 kernel", errors);
+    CHECK((odd.task2 == &complete_task2_fixed<double, 3, 9>), "ALPHA=3, BETA=9 should select the specialized type-2 kernel", errors);
+
+    task_kernels_t<double> generic = select_task_kernels(36, 36, simd_isa_t::scalar);
+    CHECK(generic.task1 == &complete_task1<double>, "ALPHA=36 should fall back to the generic type-1 kernel", errors);
+    CHECK(generic.task2 == &complete_task2<double>, "ALPHA=36, BETA=36 should fall back to the generic type-2 kernel", errors);
+
+    task_kernels_t<double> large = select_task_kernels(32, 64, simd_isa_t::scalar);
+    CHECK((large.task1 == &complete_task1_fixed<double, 32>), "ALPHA=32 should select the specialized type-1 kernel", errors);
+    CHECK(large.task2 == &complete_task2<double>, "BETA=64 should fall back to the generic type-2 kernel", errors);
+
+    qr_params_t bad;
+    bad.alpha = 4;
+    bad.beta = 6;
+    bool threw = false;
+    try {
+        bad.validate();
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "BETA not a multiple of ALPHA should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK2]. Test Kernel Selection"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK2]. Test Kernel Selection"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Runs the task graph sequentially in the order the dependency counters
+// release tasks; 'lifo' picks the most recently released task first.
+// Returns the number of tasks executed.
+int factorize_by_release(matrix_t<double>& mat, const qr_params_t& params, bool lifo) {
+    TaskTable table(params.task_rows(mat.rows()), params.task_cols(mat.rows(), mat.cols()), params.alpha, params.beta, mat);
+    task_kernels_t<double> kernels = select_task_kernels(params.alpha, params.beta, params.simd);
+    std::vector<double> up(mat.rows(), 0.0), b(mat.rows(), 0.0);
+
+    std::vector<Task*> ready{table.getTask(0, 0)};
+    int executed = 0;
+    while (!ready.empty()) {
+        Task* t;
+        if (lifo) {
+            t = ready.back();
+            ready.pop_back();
+        } else {
+            t = ready.front();
+            ready.erase(ready.begin());
+        }
+        if (t->type == 1) {
+            kernels.task1(mat.data_ptr(), mat.ld(), t->row_start, t->row_end, t->col_end, up.data(), b.data());
+        } else {
+            kernels.task2(mat.data_ptr(), mat.ld(), t->row_start, t->row_end, t->col_start, t->col_end,
+                          up.data(), b.data());
+        }
+        ++executed;
+        for (Task* next : t->successors) {
+            if (next->unmet.fetch_sub(1) == 1) {
+                ready.push_back(next);
+            }
+        }
+    }
+    return executed;
+}
+
+// Test 3: Dependency counters form a graph rooted at (0, 0) that releases
+// every task exactly once.
+void test_task_graph_counts() {
+    std::stringstream errors;
+    matrix_t<double> mat(75, 75);
+
+    for (const auto& shape : {std::make_pair(4, 16), std::make_pair(8, 8), std::make_pair(2, 32)}) {
+        qr_params_t params;
+        params.alpha = shape.first;
+        params.beta = shape.second;
+        TaskTable table(params.task_rows(mat.rows()), params.task_cols(mat.rows(), mat.cols()), params.alpha, params.beta, mat);
+
+        int roots = 0, tasks = 0;
+        for (int i = 0; i < table.rows(); ++i) {
+            for (int j = 0; j < table.cols(); ++j) {
+                Task* t = table.getTask(i, j);
+                if (t == nullptr) {
+                    continue;
+                }
+                ++tasks;
+                roots += t->num_deps == 0;
+                CHECK(t->num_deps == (j > 0) + (t->type == 2),
+                      "Task (" << i << ", " << j << ") has an unexpected number of predecessors", errors);
+            }
+        }
+        CHECK(tasks == table.numTasks(), "numTasks should count the non-null tasks", errors);
+        CHECK(roots == 1 && table.getTask(0, 0)->num_deps == 0, "Task (0, 0) should be the only root", errors);
+
+        matrix_t<double> copy = mat;
+        copy.fill(1.0);
+        CHECK(factorize_by_release(copy, params, true) == table.numTasks(),
+              "Every task should be released exactly once for ALPHA=" << params.alpha << ", BETA=" << params.beta, errors);
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK3]. Test Task Graph Dependency Counts"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK3]. Test Task Graph Dependency Counts"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 4: Any release order of the task graph reproduces the unblocked result.
+void test_task_graph_order() {
+    std::stringstream errors;
+    matrix_t<double> reference(75, 75);
+    fill_test_matrix(reference, 11u);
+    matrix_t<double> input = reference;
+    factorize_unblocked(reference);
+
+    for (const auto& shape : {std::make_pair(4, 16), std::make_pair(8, 8), std::make_pair(3, 12)}) {
+        qr_params_t params;
+        params.alpha = shape.first;
+        params.beta = shape.second;
+        for (bool lifo : {false, true}) {
+            matrix_t<double> tiled = input;
+            factorize_by_release(tiled, params, lifo);
+            CHECK(max_abs_diff(tiled, reference) < 1e-10,
+                  "Release order " << (lifo ? "LIFO" : "FIFO") << " differs for ALPHA=" << params.alpha
+                  << ", BETA=" << params.beta, errors);
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK4]. Test Task Graph Release Order"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK4]. Test Task Graph Release Order"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 5: SIMD kernels handle degenerate pivots (zero rows, which stay zero) and
+// row lengths that are not a multiple of the vector width like the scalar ones.
+void test_simd_degenerate_pivots() {
+    std::stringstream errors;
+
+    for (int size : {37, 64}) {
+        matrix_t<double> input(size, size + 3);
+        fill_test_matrix(input, 23u + size);
+        for (int j = 0; j < input.cols(); ++j) {
+            input.set(5, j, 0.0);
+            input.set(6, j, 0.0);
+            input.set(16, j, 0.0);
+            input.set(size - 1, j, 0.0);
+        }
+
+        matrix_t<double> reference = input;
+        factorize_unblocked(reference);
+
+        for (simd_isa_t isa : supported_isas()) {
+            for (const auto& shape : {std::make_pair(4, 16), std::make_pair(3, 9), std::make_pair(1, 1)}) {
+                qr_params_t params;
+                params.alpha = shape.first;
+                params.beta = shape.second;
+                params.simd = isa;
+                matrix_t<double> tiled = input;
+                factorize_tiled(tiled, params);
+                CHECK(max_abs_diff(tiled, reference) < 1e-10,
+                      "Degenerate pivots differ for size " << size << ", ALPHA=" << params.alpha
+                      << ", BETA=" << params.beta << ", ISA=" << simd_isa_name(isa), errors);
+            }
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK5]. Test SIMD Kernels on Degenerate Pivots"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK5]. Test SIMD Kernels on Degenerate Pivots"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 6: Compact WY type-2 updates reproduce the unblocked factorization
+// (clipped panels and degenerate pivots included) for every supported ISA.
+void test_wy_update() {
+    std::stringstream errors;
+
+    for (int size : {64, 75}) {
+        matrix_t<double> input(size, size + 5);
+        fill_test_matrix(input, 31u + size);
+        for (int j = 0; j < input.cols(); ++j) {
+            input.set(10, j, 0.0);
+        }
+        matrix_t<double> reference = input;
+        factorize_unblocked(reference);
+
+        for (simd_isa_t isa : supported_isas()) {
+            for (const auto& shape : {std::make_pair(4, 16), std::make_pair(8, 8), std::make_pair(3, 9),
+                                      std::make_pair(16, 32), std::make_pair(1, 4)}) {
+                qr_params_t params;
+                params.alpha = shape.first;
+                params.beta = shape.second;
+                params.simd = isa;
+                params.update = update_t::wy;
+                matrix_t<double> tiled = input;
+                factorize_tiled(tiled, params);
+                CHECK(max_abs_diff(tiled, reference) < 1e-10,
+                      "WY update differs for size " << size << ", ALPHA=" << params.alpha
+                      << ", BETA=" << params.beta << ", ISA=" << simd_isa_name(isa), errors);
+            }
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK6]. Test Compact WY Update"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK6]. Test Compact WY Update"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 7: The task arena holds exactly the band of valid tasks, in
+// row-major order, and is rebuilt in place for a graph that fits.
+void test_task_table_arena() {
+    std::stringstream errors;
+    matrix_t<double> large(160, 160), small(90, 90);
+    qr_params_t params;
+    params.alpha = 4;
+    params.beta = 16;
+
+    TaskTable table(params.task_rows(large.rows()), params.task_cols(large.rows(), large.cols()), params.alpha, params.beta, large);
+    const Task* arena = table.begin();
+    CHECK(sizeof(Task) == 64 && reinterpret_cast<uintptr_t>(arena) % 64 == 0,
+          "Task records should fill exactly one aligned cache line", errors);
+
+    for (int round = 0; round < 2; ++round) {
+        const Task* expected = table.begin();
+        for (int i = 0; i < table.rows(); ++i) {
+            for (int j = 0; j < table.cols(); ++j) {
+                Task* t = table.getTask(i, j);
+                bool valid = j < (i + 1) * params.beta_div_alpha();
+                CHECK((t != nullptr) == valid, "Task (" << i << ", " << j << ") should exist iff it is in the band",
+                      errors);
+                if (t == nullptr) {
+                    continue;
+                }
+                CHECK(t == expected++ && t->chunk_idx_i == i && t->chunk_idx_j == j,
+                      "Task (" << i << ", " << j << ") should be stored in row-major order", errors);
+                size_t successors = (table.getTask(i, j + 1) != nullptr) +
+                                    (t->type == 1 ? table.rows() - 1 - i : 0);
+                CHECK(t->successors.size() == successors, "Task (" << i << ", " << j << ") has "
+                      << t->successors.size() << " successors, expected " << successors, errors);
+            }
+        }
+        CHECK(expected == table.end(), "The arena should hold only the valid tasks", errors);
+
+        table.init(params.task_rows(small.rows()), params.task_cols(small.rows(), small.cols()), params.alpha, params.beta, small);
+        CHECK(table.begin() == arena, "A smaller graph should reuse the arena", errors);
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK7]. Test Task Table Arena"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK7]. Test Task Table Arena"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 8: Rectangular matrices, with more rows or more columns, take
+// min(rows, cols) pivots: the tiled order and the engine match the
+// unblocked factorization.
+void test_rectangular_matrices() {
+    std::stringstream errors;
+    const int shapes[][2] = {{50, 30}, {30, 50}, {64, 20}, {20, 64}, {33, 33}};
+    QREngine engine(3);
+
+    for (const auto& shape : shapes) {
+        matrix_t<double> input(shape[0], shape[1]);
+        fill_test_matrix(input, 5u + shape[0] * 3u + shape[1]);
+        matrix_t<double> reference = input;
+        factorize_unblocked(reference);
+
+        qr_params_t params;
+        params.num_threads = 3;
+        params.alpha = 4;
+        params.beta = 8;
+        matrix_t<double> tiled = input;
+        factorize_tiled(tiled, params);
+        CHECK(max_abs_diff(tiled, reference) < 1e-10,
+              "Tiled result differs for " << shape[0] << " x " << shape[1], errors);
+
+        for (scheduler_t sched : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+            params.scheduler = sched;
+            matrix_t<double> result = input;
+            engine.factorize(result, params);
+            CHECK(max_abs_diff(result, tiled) == 0.0, "Engine result differs for " << shape[0] << " x "
+                  << shape[1] << ", sched " << scheduler_name(sched), errors);
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK8]. Test Rectangular Matrices"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK8]. Test Rectangular Matrices"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 9: Rows past 2^31 elements from the start of the matrix, as in a large
+// out-of-core store: a sparse mapping with a stride of about 2^20 and the
+// updated row at offset far * n > INT32_MAX. Every type-2 path (generic and
+// SIMD reflector and WY kernels, right-hand sides) gives what a compact
+// matrix of the same rows gives.
+void test_kernels_wide_offsets() {
+    std::stringstream errors;
+    const int n = (1 << 20) + 16;  // Row stride; columns past w are zero.
+    const int far = 2100;
+    const int w = 8;
+    const int k = 4;               // Pivot rows 0..k-1.
+    size_t bytes = static_cast<size_t>(far + 1) * n * sizeof(double);
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapped == MAP_FAILED) {
+         std::cout << std::left << std::setw(60) << "[HK9]. Test Kernels Past 2^31 Elements"
+                   << YELLOW << "[Skipped: no address space]" << RESET << std::endl;
+         return;
+    }
+    double* big = static_cast<double*>(mapped);
+    CHECK(static_cast<long long>(far) * n > INT32_MAX, "The far row should be past the int range", errors);
+
+    matrix_t<double> values(k + 1, w);
+    fill_test_matrix(values, 71);
+    std::vector<double> small((k + 1) * w);
+    double* far_row = big + static_cast<size_t>(far) * n;
+    auto reset = [&] {
+         for (int c = 0; c < w; ++c) {
+              for (int i = 0; i < k; ++i) {
+                   small[i * w + c] = values.get(i, c);
+                   big[static_cast<size_t>(i) * n + c] = values.get(i, c);
+              }
+              small[k * w + c] = values.get(k, c);
+              far_row[c] = values.get(k, c);
+         }
+    };
+    auto same = [&](const char* what) {
+         double diff = 0;
+         for (int c = 0; c < w; ++c) {
+              diff = std::max(diff, std::fabs(far_row[c] - small[k * w + c]));
+         }
+         CHECK(diff < 1e-12, what << " differs past 2^31 elements by " << diff, errors);
+    };
+
+    std::vector<double> up_big(far + 1), b_big(far + 1), up_small(k + 1), b_small(k + 1);
+    std::vector<double> t_big(k * k), t_small(k * k);
+    auto panel = [&] {
+         reset();
+         complete_task1(big, n, 0, k, k, up_big.data(), b_big.data());
+         build_block_reflector(big, n, 0, k, up_big.data(), b_big.data(), t_big.data());
+         complete_task1(small.data(), w, 0, k, k, up_small.data(), b_small.data());
+         build_block_reflector(small.data(), w, 0, k, up_small.data(), b_small.data(), t_small.data());
+    };
+
+    for (simd_isa_t isa : supported_isas()) {
+         task_kernels_t<double> kernels = select_task_kernels(k, 4 * k, isa);
+         panel();
+         kernels.task2(big, n, 0, k, far, far + 1, up_big.data(), b_big.data());
+         kernels.task2(small.data(), w, 0, k, k, k + 1, up_small.data(), b_small.data());
+         same(simd_isa_name(isa));
+         panel();
+         kernels.task2_wy(big, n, 0, k, far, far + 1, up_big.data(), t_big.data());
+         kernels.task2_wy(small.data(), w, 0, k, k, k + 1, up_small.data(), t_small.data());
+         same("WY update");
+    }
+    panel();
+    apply_reflectors_rhs(big, n, w, 0, k, up_big.data(), b_big.data(), big, n, far, far + 1);
+    apply_reflectors_rhs(small.data(), w, w, 0, k, up_small.data(), b_small.data(), small.data(), w, k, k + 1);
+    same("Right-hand side");
+    munmap(mapped, bytes);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60)
+                   << "[HK9]. Test Kernels Past 2^31 Elements"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60)
+                   << "[HK9]. Test Kernels Past 2^31 Elements"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ========================== QREngine Tests ============================== //
+
+// Test 1: One engine, many jobs: every scheduler and update mode, repeated
+// shapes (re-armed graph) and new ones, match the sequential tile order.
+void test_engine_repeated_jobs() {
+    std::stringstream errors;
+    QREngine engine(3);
+    qr_factors_t<double> factors;
+
+    for (scheduler_t sched : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+        for (update_t update : {update_t::reflector, update_t::wy}) {
+            for (int size : {70, 70, 45, 70}) {
+                qr_params_t params;
+                params.num_threads = 8;
+                params.alpha = size == 45 ? 2 : 4;
+                params.beta = size == 45 ? 8 : 16;
+                params.scheduler = sched;
+                params.update = update;
+                matrix_t<double> input(size, size, matrix_layout_t::padded);
+                fill_test_matrix(input, static_cast<unsigned>(size) * 7u + static_cast<unsigned>(sched));
+                matrix_t<double> expected = input;
+                factorize_tiled(expected, params);
+
+                matrix_t<double> result = input;
+                qr_run_stats_t stats = engine.factorize(result, params, factors);
+                CHECK(max_abs_diff(result, expected) == 0.0,
+                      "Engine result differs for size " << size << ", sched " << scheduler_name(sched)
+                      << ", update " << update_name(update), errors);
+                CHECK(stats.workers == 3 && stats.tasks > 0, "A job should run on at most the pool's workers", errors);
+                CHECK(factors.up.size() == static_cast<size_t>(size) &&
+                      factors.t.size() == (update == update_t::wy ? static_cast<size_t>(params.task_cols(size, size)) * params.alpha * params.alpha : 0u),
+                      "The factors should be sized for the job", errors);
+            }
+        }
+    }
+
+    matrix_t<double> input(40, 40);
+    fill_test_matrix(input, 11);
+    qr_params_t params;
+    params.alpha = 4;
+    params.beta = 8;
+    matrix_t<double> first = input, second = input;
+    engine.factorize(first, params);
+    qr_run_stats_t stats = engine.factorize(second, params);
+    CHECK(stats.reused_graph && max_abs_diff(first, second) == 0.0,
+          "A repeated shape should re-arm the graph and give the same result", errors);
+
+    bool threw = false;
+    params.beta = 6;
+    try {
+        engine.factorize(first, params);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "Invalid parameters should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest1] Test Repeated Jobs"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest1] Test Repeated Jobs"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 2: Client threads sharing an engine each get their own result.
+void test_engine_concurrent_clients() {
+    std::stringstream errors;
+    const int num_clients = 4;
+    const int jobs_per_client = 6;
+    QREngine engine(2);
+    std::vector<int> mismatches(num_clients, 0);  // Checked after the join: CHECK is not thread-safe.
+    std::vector<std::thread> clients;
+
+    for (int c = 0; c < num_clients; ++c) {
+        clients.emplace_back([&, c] {
+            qr_params_t params;
+            params.alpha = 4;
+            params.beta = c % 2 ? 8 : 16;
+            params.scheduler = c % 2 ? scheduler_t::steal : scheduler_t::fifo;
+            qr_factors_t<double> factors;
+            for (int k = 0; k < jobs_per_client; ++k) {
+                int size = 32 + 8 * c;
+                matrix_t<double> input(size, size);
+                fill_test_matrix(input, static_cast<unsigned>(c * 100 + k));
+                matrix_t<double> expected = input;
+                factorize_tiled(expected, params);
+                engine.factorize(input, params, factors);
+                if (max_abs_diff(input, expected) != 0.0) {
+                    ++mismatches[c];
+                }
+            }
+        });
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+    for (int c = 0; c < num_clients; ++c) {
+        CHECK(mismatches[c] == 0, "Client " << c << ": " << mismatches[c] << " of " << jobs_per_client
+              << " results differ", errors);
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest2] Test Concurrent Clients"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest2] Test Concurrent Clients"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 3: A batch of matrices of different shapes in one job matches each
+// matrix factorized alone, reflectors included, and re-arms on repeat.
+void test_engine_batch() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const std::vector<int> sizes = {40, 70, 33, 64, 40};
+
+    for (scheduler_t sched : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+        qr_params_t params;
+        params.num_threads = 3;
+        params.alpha = 4;
+        params.beta = 8;
+        params.scheduler = sched;
+        std::vector<matrix_t<double>> inputs;
+        for (size_t k = 0; k < sizes.size(); ++k) {
+            inputs.emplace_back(sizes[k], sizes[k]);
+            fill_test_matrix(inputs.back(), static_cast<unsigned>(k + 3));
+        }
+
+        for (int round = 0; round < 2; ++round) {
+            std::vector<matrix_t<double>> batch = inputs;
+            std::vector<qr_factors_t<double>> factors;
+            qr_run_stats_t stats = engine.factorize_batch(batch, params, factors);
+            CHECK(stats.matrices == static_cast<int>(sizes.size()) && factors.size() == sizes.size(),
+                  "The batch should report every matrix", errors);
+            CHECK(round == 0 || stats.reused_graph, "A repeated batch should re-arm its graphs", errors);
+            for (size_t k = 0; k < sizes.size(); ++k) {
+                matrix_t<double> alone = inputs[k];
+                qr_factors_t<double> alone_factors;
+                QREngine single(1);
+                single.factorize(alone, params, alone_factors);
+                CHECK(max_abs_diff(batch[k], alone) == 0.0 && factors[k].up == alone_factors.up &&
+                      factors[k].b == alone_factors.b,
+                      "Batched matrix " << k << " differs, sched " << scheduler_name(sched), errors);
+            }
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest3] Test Batched Jobs"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest3] Test Batched Jobs"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 4: A least-squares solve in the factorization job matches the
+// sequential solve with the stored factors, satisfies the normal equations,
+// and leaves the residual in the tail of every right-hand side.
+void test_engine_least_squares() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int rows = 37, cols = 60, count = 21;
+    matrix_t<double> input(rows, cols), rhs_input(count, cols);
+    fill_test_matrix(input, 11);
+    fill_test_matrix(rhs_input, 12);
+
+    for (update_t update : {update_t::reflector, update_t::wy}) {
+        for (scheduler_t sched : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+            qr_params_t params;
+            params.num_threads = 3;
+            params.alpha = 4;
+            params.beta = 8;
+            params.scheduler = sched;
+            params.update = update;
+
+            matrix_t<double> plain = input;
+            engine.factorize(plain, params);
+            for (int round = 0; round < 2; ++round) {
+                matrix_t<double> mat = input, rhs = rhs_input;
+                qr_factors_t<double> factors;
+                qr_run_stats_t stats = engine.solve(mat, rhs, params, factors);
+                CHECK(stats.reused_graph == (round == 1),
+                      "Only a repeated solve should re-arm its graph", errors);
+
+                matrix_t<double> ref = input, ref_rhs = rhs_input;
+                qr_factors_t<double> ref_factors;
+                QREngine single(1);
+                single.factorize(ref, params, ref_factors);
+                solve_factored(ref, ref_factors, ref_rhs);
+                CHECK(max_abs_diff(mat, ref) == 0.0 && max_abs_diff(rhs, ref_rhs) == 0.0,
+                      "Solve differs from the sequential one, sched " << scheduler_name(sched), errors);
+            }
+        }
+    }
+
+    // A = input^T: A^T (b - A x) = 0, and |b - A x| is the norm of the tail.
+    matrix_t<double> mat = input, rhs = rhs_input;
+    engine.solve(mat, rhs, qr_params_t{});
+    double worst_normal = 0.0, worst_norm = 0.0;
+    for (int r = 0; r < count; ++r) {
+        std::vector<double> res(cols);
+        double res_norm = 0.0, tail_norm = 0.0;
+        for (int i = 0; i < cols; ++i) {
+            res[i] = rhs_input.get(r, i);
+            for (int p = 0; p < rows; ++p) {
+                res[i] -= input.get(p, i) * rhs.get(r, p);
+            }
+            res_norm += res[i] * res[i];
+        }
+        for (int i = rows; i < cols; ++i) {
+            tail_norm += rhs.get(r, i) * rhs.get(r, i);
+        }
+        for (int p = 0; p < rows; ++p) {
+            double dot = 0.0;
+            for (int i = 0; i < cols; ++i) {
+                dot += input.get(p, i) * res[i];
+            }
+            worst_normal = std::max(worst_normal, std::fabs(dot));
+        }
+        worst_norm = std::max(worst_norm, std::fabs(std::sqrt(res_norm) - std::sqrt(tail_norm)));
+    }
+    CHECK(worst_normal < 1e-10, "Residual not orthogonal to the columns of A: " << worst_normal, errors);
+    CHECK(worst_norm < 1e-10, "Tail norm differs from the residual norm by " << worst_norm, errors);
+
+    bool threw = false;
+    try {
+        matrix_t<double> tall(10, 5), b(1, 5);
+        engine.solve(tall, b, qr_params_t{});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "A matrix with fewer columns than rows should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest4] Test Least-Squares Solve"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest4] Test Least-Squares Solve"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 5: TSQR gives the L of the whole matrix, up to the signs of its
+// columns, for even and odd numbers of leaves, and [L 0] in place.
+void test_engine_tsqr() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int rows = 12, cols = 400;
+    matrix_t<double> input(rows, cols);
+    fill_test_matrix(input, 21);
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+    matrix_t<double> expected = input;
+    engine.factorize(expected, params);
+
+    for (int leaf : {48, 70, 200, 400}) {
+        for (scheduler_t sched : {scheduler_t::fifo, scheduler_t::priority}) {
+            params.scheduler = sched;
+            params.tsqr_leaf = leaf;
+            matrix_t<double> result = input;
+            qr_run_stats_t stats = engine.factorize_tsqr(result, params);
+            CHECK(stats.matrices == 2 * (cols / leaf) - 1, "Leaf width " << leaf << " ran " << stats.matrices
+                  << " factorizations", errors);
+            double diff = 0.0;
+            for (int j = 0; j < rows; ++j) {
+                double sign = (result.get(j, j) < 0) == (expected.get(j, j) < 0) ? 1.0 : -1.0;
+                for (int i = j; i < rows; ++i) {
+                    diff = std::max(diff, std::fabs(result.get(i, j) - sign * expected.get(i, j)));
+                }
+            }
+            for (int i = 0; i < rows; ++i) {
+                for (int j = i + 1; j < cols; ++j) {
+                    diff = std::max(diff, std::fabs(result.get(i, j)));
+                }
+            }
+            CHECK(diff < 1e-10, "TSQR L differs by " << diff << " for leaf width " << leaf
+                  << ", sched " << scheduler_name(sched), errors);
+        }
+    }
+
+    bool threw = false;
+    params.tsqr_leaf = rows - 1;
+    try {
+        matrix_t<double> result = input;
+        engine.factorize_tsqr(result, params);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "Leaves narrower than the matrix is tall should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest5] Test TSQR"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest5] Test TSQR"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 6: The barrier baseline runs the tiles in the sequential order, so
+// it matches factorize_tiled exactly, for square and rectangular matrices.
+void test_barrier_baseline() {
+    std::stringstream errors;
+    const int shapes[][2] = {{75, 75}, {64, 40}, {40, 64}};
+
+    for (update_t update : {update_t::reflector, update_t::wy}) {
+        for (const auto& shape : shapes) {
+            for (int threads : {1, 3}) {
+                qr_params_t params;
+                params.num_threads = threads;
+                params.alpha = 4;
+                params.beta = 8;
+                params.update = update;
+                matrix_t<double> input(shape[0], shape[1]);
+                fill_test_matrix(input, 31u + shape[0] + shape[1]);
+                matrix_t<double> expected = input;
+                factorize_tiled(expected, params);
+
+                matrix_t<double> result = input;
+                qr_run_stats_t stats = factorize_barrier(result, params);
+                CHECK(max_abs_diff(result, expected) == 0.0 && stats.workers == threads,
+                      "Barrier result differs for " << shape[0] << " x " << shape[1] << ", " << threads
+                      << " threads, update " << update_name(update), errors);
+            }
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest6] Test Barrier Baseline"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest6] Test Barrier Baseline"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 7: Single precision: the float kernels of every ISA, through the
+// engine and the barrier baseline, agree with the double factorization to
+// float accuracy.
+void test_engine_single_precision() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int shapes[][2] = {{75, 75}, {40, 90}};
+
+    for (const auto& shape : shapes) {
+        matrix_t<double> input(shape[0], shape[1]);
+        fill_test_matrix(input, 51u + shape[0]);
+        for (update_t update : {update_t::reflector, update_t::wy}) {
+            qr_params_t params;
+            params.num_threads = 3;
+            params.alpha = 4;
+            params.beta = 8;
+            params.update = update;
+            matrix_t<double> expected = input;
+            engine.factorize(expected, params);
+
+            for (simd_isa_t isa : {simd_isa_t::scalar, simd_isa_t::avx2, simd_isa_t::avx512}) {
+                if (!simd_isa_supported(isa)) {
+                    continue;
+                }
+                params.simd = isa;
+                for (bool barrier : {false, true}) {
+                    matrix_t<float> result(input, matrix_layout_t::padded);
+                    qr_factors_t<float> factors;
+                    if (barrier) {
+                        factorize_barrier(result, params, factors);
+                    } else {
+                        engine.factorize(result, params, factors);
+                    }
+                    double diff = 0.0;
+                    for (int i = 0; i < shape[0]; ++i) {
+                        for (int j = 0; j < shape[1]; ++j) {
+                            diff = std::max(diff, std::fabs(result.get(i, j) - expected.get(i, j)));
+                        }
+                    }
+                    CHECK(diff < 1e-4 && factors.up.size() == static_cast<size_t>(shape[0]),
+                          "Float factorization differs by " << diff << ", " << simd_isa_name(isa) << ", update "
+                          << update_name(update) << (barrier ? ", barrier" : ""), errors);
+                }
+            }
+        }
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest7] Test Single Precision"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest7] Test Single Precision"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 8: Mixed precision reaches the double least-squares solution on a
+// well-conditioned problem, and falls back to double on an ill-conditioned
+// one.
+void test_engine_mixed_solve() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int rows = 30, cols = 80, count = 4;
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+
+    for (bool ill : {false, true}) {
+        matrix_t<double> input(rows, cols), rhs_input(count, cols);
+        fill_test_matrix(input, 61);
+        fill_test_matrix(rhs_input, 62);
+        if (ill) {
+            // Two columns of A 1e-5 apart: cond(A)^2 far beyond 1 / float epsilon.
+            for (int i = 0; i < cols; ++i) {
+                input.set(rows - 1, i, input.get(rows - 2, i) + 1e-5 * input.get(rows - 1, i));
+            }
+        }
+        matrix_t<double> mat(input, params.layout), expected = rhs_input;
+        engine.solve(mat, expected, params);
+
+        matrix_t<double> original = input, rhs = rhs_input;
+        qr_run_stats_t stats = engine.solve_mixed(input, rhs, params);
+        double diff = 0.0, norm = 0.0, tail = 0.0;
+        for (int r = 0; r < count; ++r) {
+            for (int p = 0; p < rows; ++p) {
+                diff = std::max(diff, std::fabs(rhs.get(r, p) - expected.get(r, p)));
+                norm = std::max(norm, std::fabs(expected.get(r, p)));
+            }
+            for (int i = rows; i < cols; ++i) {
+                tail = std::max(tail, std::fabs(rhs.get(r, i)));
+            }
+        }
+        CHECK(stats.refinement_fallback == ill && stats.refinement_steps > 0,
+              "Expected " << (ill ? "a" : "no") << " fallback, got " << stats.refinement_fallback << " after "
+              << stats.refinement_steps << " steps", errors);
+        CHECK(diff <= (ill ? 0.0 : 1e-10) * norm && tail == 0.0,
+              "Mixed solution differs by " << diff << (ill ? " after the fallback" : ""), errors);
+        CHECK(max_abs_diff(input, original) == 0.0, "solve_mixed should leave its matrix unchanged", errors);
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest8] Test Mixed-Precision Solve"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest8] Test Mixed-Precision Solve"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Each half of the task rows factorized on its own, the panels of the other
+// half taken from a full factorization: the owned rows come out the same.
+void test_engine_partitioned() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int rows = 70, cols = 90;
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+
+    for (update_t update : {update_t::reflector, update_t::wy}) {
+        params.update = update;
+        params.scheduler = update == update_t::wy ? scheduler_t::priority : scheduler_t::fifo;
+        matrix_t<double> input(rows, cols);
+        fill_test_matrix(input, 71);
+        matrix_t<double> expected(input, params.layout);
+        qr_factors_t<double> expected_factors;
+        engine.factorize(expected, params, expected_factors);
+
+        const int task_rows = params.task_rows(rows);
+        const int blocks = params.task_cols(rows, cols);
+        for (int part = 0; part < 2; ++part) {
+            matrix_t<double> mat = make_distributed_matrix<double>(rows, cols, params);
+            for (int r = 0; r < rows; ++r) {
+                if (mpi_owns_row(r, params, part, 2)) {
+                    for (int c = 0; c < cols; ++c) {
+                        mat.set(r, c, input.get(r, c));
+                    }
+                }
+            }
+            qr_factors_t<double> factors;
+            std::atomic<int> panels{0}, waits{0}, blocks_done{0};
+            task_partition_t partition;
+            for (int i = 0; i < task_rows; ++i) {
+                partition.owned.push_back(mpi_task_row_owner(i, 2) == part);
+            }
+            partition.panel_done = [&](int) { panels++; };
+            partition.wait_panel = [&](int j) {
+                waits++;
+                size_t t_stride = static_cast<size_t>(params.alpha) * params.alpha;
+                for (int p = params.alpha * j; p < std::min(params.alpha * (j + 1), rows); ++p) {
+                    for (int c = 0; c < cols; ++c) {
+                        mat.set(p, c, expected.get(p, c));
+                    }
+                    factors.up[p] = expected_factors.up[p];
+                    factors.b[p] = expected_factors.b[p];
+                }
+                if (update == update_t::wy) {
+                    std::copy(expected_factors.t.begin() + j * t_stride,
+                              expected_factors.t.begin() + (j + 1) * t_stride, factors.t.begin() + j * t_stride);
+                }
+            };
+            partition.block_done = [&](int) { blocks_done++; };
+            engine.factorize_partitioned(mat, params, factors, partition);
+
+            double diff = 0.0;
+            for (int r = 0; r < rows; ++r) {
+                for (int c = 0; c < cols && mpi_owns_row(r, params, part, 2); ++c) {
+                    diff = std::max(diff, std::fabs(mat.get(r, c) - expected.get(r, c)));
+                }
+            }
+            CHECK(diff == 0.0 && factors.up == expected_factors.up && factors.b == expected_factors.b,
+                  "Part " << part << " (" << update_name(update) << ") differs by " << diff, errors);
+            CHECK(panels + waits == blocks && blocks_done == blocks,
+                  "Part " << part << ": " << panels << " panels, " << waits << " waits and " << blocks_done
+                  << " finished blocks of " << blocks, errors);
+        }
+    }
+
+    bool threw = false;
+    try {
+        matrix_t<double> mat(rows, cols);
+        qr_factors_t<double> factors;
+        task_partition_t partition;
+        engine.factorize_partitioned(mat, params, factors, partition);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "A partition without its task rows should be rejected", errors);
+#if !QR_MPI
+    threw = false;
+    try {
+        matrix_t<double> mat(rows, cols);
+        qr_factors_t<double> factors;
+        factorize_mpi(engine, mat, params, factors);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw, "factorize_mpi() should throw in a build without MPI", errors);
+#endif
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest9] Test Partitioned Factorization"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest9] Test Partitioned Factorization"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Type-2 updates on the emulated device: every share gives the CPU result,
+// and a tile crosses to the device and back at most once.
+void test_engine_offload() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int rows = 90, cols = 120;
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+    params.scheduler = scheduler_t::priority;
+
+    matrix_t<double> input(rows, cols);
+    fill_test_matrix(input, 81);
+    for (update_t update : {update_t::reflector, update_t::wy}) {
+        params.update = update;
+        params.offload = offload_device_t::none;
+        matrix_t<double> expected(input, params.layout);
+        qr_run_stats_t plain = engine.factorize(expected, params);
+        int updates = 0;
+        for (int i = 0; i < params.task_rows(rows); ++i) {
+            for (int j = 0; j < params.task_cols(rows, cols); ++j) {
+                int pivot_row = j / params.beta_div_alpha();
+                updates += i > pivot_row && j < std::min(params.task_cols(rows, cols), (i + 1) * params.beta_div_alpha());
+            }
+        }
+
+        params.offload = offload_device_t::emulated;
+        for (double share : {1.0, 0.0, -1.0}) {
+            params.offload_share = share;
+            params.offload_batch = share < 0 ? 5 : 16;
+            matrix_t<double> mat(input, params.layout);
+            qr_run_stats_t stats = engine.factorize(mat, params);
+            double bound = 3.0 * rows * mat.ld() * sizeof(double);
+            CHECK(max_abs_diff(mat, expected) == 0.0 && stats.tasks == plain.tasks,
+                  "Offload (" << update_name(update) << ", share " << share << ") changed the factorization", errors);
+            CHECK((share == 1.0 ? stats.offloaded_tasks == updates : share == 0.0 ? stats.offloaded_tasks == 0
+                                                                                    : stats.offloaded_tasks <= updates),
+                  "Share " << share << " ran " << stats.offloaded_tasks << " of " << updates << " updates on the device",
+                  errors);
+            CHECK(stats.offload_bytes <= bound, "Share " << share << " moved " << stats.offload_bytes << " bytes",
+                  errors);
+        }
+    }
+
+    matrix_t<double> mat(input, params.layout), rhs(2, cols), expected_rhs(2, cols);
+    fill_test_matrix(rhs, 82);
+    expected_rhs = rhs;
+    matrix_t<double> plain_mat(input, params.layout);
+    qr_params_t cpu = params;
+    cpu.offload = offload_device_t::none;
+    engine.solve(plain_mat, expected_rhs, cpu);
+    params.offload_share = 0.5;
+    engine.solve(mat, rhs, params);
+    CHECK(max_abs_diff(rhs, expected_rhs) == 0.0, "Offload changed a least-squares solve", errors);
+
+    bool threw = false;
+    try {
+        params.scheduler = scheduler_t::steal;
+        params.validate();
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "--offload with --sched steal should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest10] Test Update Offload"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest10] Test Update Offload"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// L of a factorized A^T with every column scaled to a nonnegative diagonal,
+// so that factorizations that differ in reflector signs compare equal.
+double signed_l_diff(const matrix_t<double>& a, const matrix_t<double>& b, int n) {
+    double diff = 0;
+    for (int c = 0; c < n; ++c) {
+        double sa = a.get(c, c) < 0 ? -1 : 1;
+        double sb = b.get(c, c) < 0 ? -1 : 1;
+        for (int r = c; r < n; ++r) {
+            diff = std::max(diff, std::fabs(sa * a.get(r, c) - sb * b.get(r, c)));
+        }
+    }
+    return diff;
+}
+
+void test_engine_append_rows() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int n = 37, m = 60, k = 11;
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+
+    // A is (m + 2k) x n; mat holds A^T.
+    matrix_t<double> all(n, m + 2 * k);
+    fill_test_matrix(all, 91);
+    matrix_t<double> first(n, m), rows(k, n), more(k, n);
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < m; ++c) {
+            first.set(r, c, all.get(r, c));
+        }
+        for (int q = 0; q < k; ++q) {
+            rows.set(q, r, all.get(r, m + q));
+            more.set(q, r, all.get(r, m + k + q));
+        }
+    }
+
+    for (scheduler_t scheduler : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+        params.scheduler = scheduler;
+        matrix_t<double> expected(all, params.layout);
+        engine.factorize(expected, params);
+
+        matrix_t<double> mat(first, params.layout);
+        engine.factorize(mat, params);
+        matrix_t<double> factored(mat);
+        qr_append_t<double> update;
+        qr_run_stats_t once = engine.append_rows(mat, rows, params, update);
+        qr_run_stats_t twice = engine.append_rows(mat, more, params, update);
+        double scale = 0;
+        for (int r = 0; r < n; ++r) {
+            scale = std::max(scale, std::fabs(expected.get(r, r)));
+        }
+        double diff = signed_l_diff(mat, expected, n);
+        CHECK(diff <= 1e-10 * scale, "Appending rows (" << scheduler_name(scheduler) << ") is " << diff
+              << " from refactorizing", errors);
+        CHECK(twice.reused_graph && once.tasks == twice.tasks,
+              "A second append of the same shape should re-arm the graph", errors);
+        double kept = 0;
+        for (int r = 0; r < n; ++r) {
+            for (int c = r + 1; c < m; ++c) {
+                kept = std::max(kept, std::fabs(mat.get(r, c) - factored.get(r, c)));
+            }
+        }
+        CHECK(kept == 0.0, "Appending rows changed the reflectors of the factorization", errors);
+    }
+
+    bool threw = false;
+    try {
+        matrix_t<double> wide(n, m), bad(k, n + 1);
+        engine.append_rows(wide, bad, params);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "Rows of the wrong length should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest11] Test Row Append"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest11] Test Row Append"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+void test_engine_streaming() {
+    std::stringstream errors;
+    QREngine engine(3);
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+
+    matrix_t<double> input(83, 70);
+    fill_test_matrix(input, 101);
+    std::string text_file = "test_streaming.txt";
+    std::string binary_file = "test_streaming.bin";
+    input.save(text_file);
+    input.save_binary(binary_file);
+
+    for (scheduler_t scheduler : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+        params.scheduler = scheduler;
+        for (const std::string& file : {text_file, binary_file}) {
+            matrix_t<double> expected(file, params.layout);
+            engine.factorize(expected, params);
+
+            matrix_stream_t stream(file);
+            matrix_t<double> mat(stream.rows(), stream.cols(), params.layout);
+            qr_factors_t<double> factors;
+            int calls = 0;
+            qr_run_stats_t stats = engine.factorize_streaming(mat, params, factors, [&](int loaded) {
+                ++calls;
+                return stream.load(mat, loaded, loaded + 5);
+            });
+            CHECK(max_abs_diff(mat, expected) == 0.0 && calls == (input.rows() + 4) / 5,
+                  "Streaming " << file << " (" << scheduler_name(scheduler) << ") changed the factorization",
+                  errors);
+            CHECK(stats.tasks > 0 && stats.load_ms >= 0, "Streaming should report its job", errors);
+        }
+    }
+
+    // A failing loader ends the job and its error reaches the caller.
+    std::string got = "no error";
+    try {
+        matrix_t<double> mat(input.rows(), input.cols(), params.layout);
+        qr_factors_t<double> factors;
+        engine.factorize_streaming(mat, params, factors, [&](int loaded) -> int {
+            if (loaded >= 20) {
+                throw std::runtime_error("disk gone");
+            }
+            return loaded + 10;
+        });
+    } catch (const std::runtime_error& e) {
+        got = e.what();
+    }
+    matrix_t<double> after(input, params.layout), expected(input, params.layout);
+    engine.factorize(after, params);
+    qr_params_t fresh = params;
+    QREngine other(3);
+    other.factorize(expected, fresh);
+    CHECK(got == "disk gone" && max_abs_diff(after, expected) == 0.0,
+          "A failed load should be rethrown and leave the engine usable, got \"" << got << "\"", errors);
+
+    std::remove(text_file.c_str());
+    std::remove(binary_file.c_str());
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest12] Test Streaming Ingest"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest12] Test Streaming Ingest"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+void test_engine_adaptive_granularity() {
+    std::stringstream errors;
+    QREngine engine(4);
+    qr_params_t params;
+    params.num_threads = 4;
+    params.alpha = 4;
+    params.beta = 16;
+
+    matrix_t<double> input(150, 130);
+    fill_test_matrix(input, 107);
+
+    // Pieces update disjoint rows and chaining keeps the order of a tile's
+    // updates; only a piece running the generic kernel where the full tile
+    // had a specialized one can round differently.
+    int split = 0, merged = 0;
+    for (update_t update : {update_t::reflector, update_t::wy}) {
+        params.update = update;
+        for (scheduler_t scheduler : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+            params.scheduler = scheduler;
+            params.granularity = granularity_t::fixed;
+            matrix_t<double> expected(input, params.layout);
+            engine.factorize(expected, params);
+
+            params.granularity = granularity_t::adaptive;
+            for (int merge_depth : {1, 4}) {
+                params.merge_depth = merge_depth;
+                matrix_t<double> mat(input, params.layout);
+                qr_run_stats_t stats = engine.factorize(mat, params);
+                split += stats.split_tasks;
+                merged += stats.merged_tasks;
+                double diff = max_abs_diff(mat, expected);
+                CHECK(diff <= 1e-12, "Adaptive granularity (" << scheduler_name(scheduler) << ", "
+                      << update_name(update) << ") is " << diff << " from fixed tiles", errors);
+            }
+        }
+    }
+    CHECK(split > 0 && merged > 0, "Adaptive runs should split and chain updates, got " << split << " and "
+          << merged, errors);
+
+    bool threw = false;
+    try {
+        params.offload = offload_device_t::emulated;
+        params.validate();
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "--granularity adaptive with --offload should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest13] Test Adaptive Granularity"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest13] Test Adaptive Granularity"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 14: An out-of-core factorization of a store larger than its budget
+// pages tiles in and out and still matches the in-memory one exactly.
+void test_engine_out_of_core() {
+    std::stringstream errors;
+    const std::string store = "test_engine_out_of_core.dtsm";
+    QREngine engine(4);
+    qr_params_t params;
+    params.num_threads = 4;
+    params.alpha = 8;
+    params.beta = 32;
+    params.memory_budget_mb = 1;  // About four of the eight tiles.
+
+    matrix_t<double> input(256, 1024);
+    fill_test_matrix(input, 113);
+    for (scheduler_t scheduler : {scheduler_t::fifo, scheduler_t::steal, scheduler_t::priority}) {
+        params.scheduler = scheduler;
+        matrix_t<double> expected(input, params.layout);
+        engine.factorize(expected, params);
+
+        qr_factors_t<double> factors;
+        qr_run_stats_t stats;
+        {
+            matrix_t<double> mat(0, 0, params.layout);
+            mat.create_binary(store, input.rows(), input.cols());
+            for (int i = 0; i < input.rows(); ++i) {
+                std::copy(input.data_ptr() + static_cast<size_t>(i) * input.ld(),
+                          input.data_ptr() + static_cast<size_t>(i) * input.ld() + input.cols(),
+                          mat.data_ptr() + static_cast<size_t>(i) * mat.ld());
+            }
+            stats = engine.factorize_out_of_core(mat, params, factors);
+        }
+        // What the store holds once it is unmapped.
+        matrix_t<double> result(store, params.layout);
+        CHECK(max_abs_diff(result, expected) == 0.0,
+              "Out-of-core result differs (" << scheduler_name(scheduler) << ")", errors);
+        CHECK(stats.tile_evictions > 0 && stats.peak_resident_bytes <= (size_t(1) << 20),
+              "A 1 MiB budget should evict tiles and stay within it (" << scheduler_name(scheduler) << "), got "
+              << stats.tile_evictions << " evictions, " << stats.peak_resident_bytes << " bytes", errors);
+    }
+    std::remove(store.c_str());
+
+    bool threw = false;
+    try {
+        params.out_of_core = store;
+        params.batch = 2;
+        params.validate();
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "--out-of-core with --batch should be rejected", errors);
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest14] Test Out-of-Core Factorization"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest14] Test Out-of-Core Factorization"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 15: Jobs with the same row count and new column counts on one engine
+// rebuild the graph, since the columns set the task columns and pivots,
+// and re-arm it only when the whole shape repeats.
+void test_engine_same_rows_new_cols() {
+    std::stringstream errors;
+    QREngine engine(3);
+    const int cols[] = {64, 40, 40, 80, 64};
+
+    qr_params_t params;
+    params.num_threads = 3;
+    params.alpha = 4;
+    params.beta = 8;
+    for (size_t k = 0; k < sizeof(cols) / sizeof(cols[0]); ++k) {
+        matrix_t<double> input(64, cols[k]);
+        fill_test_matrix(input, 17u + static_cast<unsigned>(cols[k]));
+        matrix_t<double> expected = input;
+        factorize_tiled(expected, params);
+
+        matrix_t<double> result = input;
+        qr_run_stats_t stats = engine.factorize(result, params);
+        CHECK(max_abs_diff(result, expected) == 0.0, "Engine result differs for 64 x " << cols[k]
+              << " after 64 x " << (k > 0 ? cols[k - 1] : 0), errors);
+        CHECK(stats.reused_graph == (k > 0 && cols[k] == cols[k - 1]),
+              "The graph should be re-armed only for a repeated shape (64 x " << cols[k] << ")", errors);
+    }
+
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << "[EngineTest15] Test Same Rows, New Columns"
+                   << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << "[EngineTest15] Test Same Rows, New Columns"
+                   << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// ========================== Tuning Tests ================================ //
+
+void report_tuning_test(const char* label, const std::stringstream& errors) {
+    if (errors.str().empty()) {
+         std::cout << std::left << std::setw(60) << label << GREEN << "[Passed]" << RESET << std::endl;
+    } else {
+         std::cout << std::left << std::setw(60) << label << RED << "[Failed]" << RESET << std::endl;
+         std::cout << errors.str();
+    }
+}
+
+// Test 1: The database round-trips through its file, replaces entries of
+// the same key, and looks up the exact or the nearest shape.
+void test_tuning_db() {
+    std::stringstream errors;
+    const std::string filename = "test_tuning_db.csv";
+    const std::string cpu = "Test CPU @ 2.0GHz, rev 1";
+    TuningDB db;
+    db.record({1000, 1000, 8, "fifo", 4, 16, 10.0, cpu});
+    db.record({4000, 4000, 8, "fifo", 16, 32, 500.0, cpu});
+    db.record({4000, 4000, 32, "fifo", 8, 32, 150.0, cpu});
+    db.record({1000, 1000, 8, "priority", 8, 8, 9.0, cpu});
+    db.record({1000, 1000, 8, "fifo", 8, 16, 8.0, cpu});
+    CHECK(db.entries().size() == 4, "A repeated key should replace its entry", errors);
+    db.save(filename);
+
+    TuningDB loaded = TuningDB::load(filename);
+    CHECK(loaded.entries().size() == 4 && loaded.entries()[0].cpu == cpu && loaded.entries()[0].alpha == 8,
+          "The database should round-trip through its file", errors);
+    const tuning_entry_t* e = loaded.lookup(cpu, "fifo", 1000, 1000, 8);
+    CHECK(e && e->alpha == 8 && e->beta == 16, "Exact lookup failed", errors);
+    e = loaded.lookup(cpu, "fifo", 3000, 3000, 8);
+    CHECK(e && e->rows == 4000 && e->threads == 8, "3000 rows should take the 4000-row shape", errors);
+    e = loaded.lookup(cpu, "fifo", 3000, 3000, 28);
+    CHECK(e && e->threads == 32, "28 threads should take the 32-thread shape", errors);
+    CHECK(loaded.lookup("Other CPU", "fifo", 1000, 1000, 8) == nullptr &&
+          loaded.lookup(cpu, "steal", 1000, 1000, 8) == nullptr,
+          "Other CPUs and schedulers should not match", errors);
+
+    // A fig3_best_by_size_threads.csv counts as measured on this CPU.
+    {
+        std::ofstream out(filename);
+        out << "matrix_size,threads,mode,best_alpha,best_beta,runs,avg_time_ms,std_time_ms\n"
+            << "2400,26,1,30,30,3,120.5,1.2\n"
+            << "2400,26,fifo,12,24,3,130.0,2.0\n";
+    }
+    TuningDB fig3 = TuningDB::load(filename);
+    qr_params_t params;
+    params.num_threads = 26;
+    params.scheduler = scheduler_t::priority;
+    e = apply_tuned_shape(fig3, params, 2400, 2400);
+    CHECK(e && params.alpha == 30 && params.beta == 30, "The fig3 CSV should give the priority shape", errors);
+    std::remove(filename.c_str());
+
+    report_tuning_test("[TuneTest1] Test Tuning Database", errors);
+}
+
+// Test 2: Successive halving keeps half the candidates per round, doubles
+// the runs, and returns a valid candidate.
+void test_tune_tile_shape() {
+    std::stringstream errors;
+    QREngine engine(2);
+    matrix_t<double> input(48, 48);
+    fill_test_matrix(input, 41);
+    qr_params_t params;
+    params.num_threads = 2;
+    tuning_options_t opts;
+    opts.alphas = {2, 4, 8};
+    opts.betas = {4, 8, 16};
+    opts.warmup = 0;
+
+    tuning_result_t r = tune_tile_shape(engine, input, params, opts);
+    // Candidates (2,4) (2,8) (2,16) (4,4) (4,8) (4,16) (8,8) (8,16): 8 -> 4 -> 2 -> 1.
+    CHECK(r.candidates == 8 && r.rounds == 3 && r.runs == 8 * 1 + 4 * 2 + 2 * 4,
+          "Expected 8 candidates in 3 rounds, got " << r.candidates << " in " << r.rounds
+          << " with " << r.runs << " runs", errors);
+    CHECK(r.beta % r.alpha == 0 && r.time_ms > 0, "The winner should be a valid shape", errors);
+
+    bool threw = false;
+    opts.betas = {3};
+    try {
+        tune_tile_shape(engine, input, params, opts);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "No valid candidate should be rejected", errors);
+
+    report_tuning_test("[TuneTest2] Test Successive Halving", errors);
+}
+
+int main(int argc, char *argv[]) {
+    std::cout << "Inside Test.\n" << std::endl;
+
+    std::cout << YELLOW << "Starting matrix_t Test Cases." << RESET << std::endl;
+
+    // Run matrix_t test functions
+    test_operator_access();
+    test_get_set();
+    test_save();
+    test_padded_layout();
+    test_placed_allocation();
+    test_affinity_map();
+    test_binary_file();
+    test_text_parser();
+
+    std::cout << YELLOW << "\nStarting DependencyTable Test Cases." << RESET << std::endl;
+
+    // Run DependencyTable test functions
+    test_default_constructor();
+    test_parameterized_constructor();
+    test_init();
+    test_move_constructor();
+    test_move_assignment();
+    test_get_set_dependency();
+    test_operator_overloading();
+    test_out_of_bounds();
+
+    std::cout << YELLOW << "\nStarting DependencyTableAtomic Test Cases." << RESET << std::endl;
+
+    // Run DependencyTableAtomic test functions
+    test_default_constructor_atomic();
+    test_parameterized_constructor_atomic();
+    test_init_atomic();
+    test_move_constructor_atomic();
+    test_move_assignment_atomic();
+    test_get_set_dependency_atomic();
+    test_operator_overloading_atomic();
+    test_out_of_bounds_atomic();
+
+    std::cout << YELLOW << "\nStarting CircularQueueMtx Test Cases." << RESET << std::endl;
+
+    test_queue_empty_and_size();
+    test_queue_push_pop_fifo();
+    test_queue_push_front_pop_back();
+    test_queue_full();
+    test_queue_multi_threaded();
+
+    std::cout << YELLOW << "\nStarting CircularQueueAtomic Test Cases." << RESET << std::endl;
+
+    test_atomic_queue_empty_and_size();
+    test_atomic_queue_push_pop_fifo();
+    test_atomic_queue_bulk();
+    test_atomic_queue_full();
+    test_atomic_queue_multi_threaded();
+    test_atomic_queue_push_and_pop();
+    test_atomic_queue_mpmc_stress();
+    test_atomic_queue_publication();
+    test_atomic_queue_wraparound();
+
+    std::cout << YELLOW << "\nStarting WorkStealingDeque Test Cases." << RESET << std::endl;
+
+    test_ws_deque_lifo_fifo();
+    test_ws_deque_grow();
+    test_ws_deque_multi_threaded();
+
+    std::cout << YELLOW << "\nStarting BucketPriorityQueue Test Cases." << RESET << std::endl;
+
+    test_bucket_pq_order();
+    test_bucket_pq_multi_threaded();
+    test_task_ranks();
+    test_bucket_pq_push_in_flight();
+
+    std::cout << YELLOW << "\nStarting Trace Test Cases." << RESET << std::endl;
+
+    test_trace_buffer();
+    test_trace_summary();
+
+    std::cout << YELLOW << "\nStarting Performance Counter Test Cases." << RESET << std::endl;
+
+    test_perf_counters();
+
+    std::cout << YELLOW << "\nStarting WorkerParker Test Cases." << RESET << std::endl;
+
+    test_parker_wakeups();
+
+    std::cout << YELLOW << "\nStarting Householder Kernel Test Cases." << RESET << std::endl;
+
+    test_tiled_kernels_match_unblocked();
+    test_kernel_selection();
+    test_task_graph_counts();
+    test_task_graph_order();
+    test_simd_degenerate_pivots();
+    test_wy_update();
+    test_task_table_arena();
+    test_rectangular_matrices();
+    test_kernels_wide_offsets();
+
+    std::cout << YELLOW << "\nStarting QREngine Test Cases." << RESET << std::endl;
+
+    test_engine_repeated_jobs();
+    test_engine_concurrent_clients();
+    test_engine_batch();
+    test_engine_least_squares();
+    test_engine_tsqr();
+    test_barrier_baseline();
+    test_engine_single_precision();
+    test_engine_mixed_solve();
+    test_engine_partitioned();
+    test_engine_offload();
+    test_engine_append_rows();
+    test_engine_streaming();
+    test_engine_adaptive_granularity();
+    test_engine_out_of_core();
+    test_engine_same_rows_new_cols();
+
+    std::cout << YELLOW << "\nStarting Tuning Test Cases." << RESET << std::endl;
 
+    test_tuning_db();
+    test_tune_tile_shape();
 
     std::cout << std::endl;
 